@@ -5,6 +5,16 @@
       "sources": [
         "native/memoryfile.c",
         "native/stringtable.c",
+        "native/pmap.c",
+        "native/trigram.c",
+        "native/regex_query.c",
+        "native/regex_dfa.c",
+        "native/pool.c",
+        "native/textindex.c",
+        "native/fuzzy.c",
+        "native/btree.c",
+        "native/minhash.c",
+        "native/hnsw.c",
         "native/graph.c",
         "native/graphbind.c"
       ],
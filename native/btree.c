@@ -0,0 +1,428 @@
+#include "btree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TH_TOP      0
+#define TH_COUNT    8
+#define TH_HEIGHT   16
+#define TH_SIZE     32u
+
+#define N_COUNT     0
+#define N_LEAF      4
+#define N_PREV      8
+#define N_NEXT      16
+#define N_HDR       32u
+#define NODE_SIZE   1024u
+#define LEAF_CAP    ((NODE_SIZE - N_HDR) / 16)   /* 62 */
+#define INNER_CAP   ((NODE_SIZE - N_HDR) / 32)   /* 31 */
+#define MAX_DEPTH   24u
+
+static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
+
+/* entry j: key at +0, value at +8 in both kinds; inner adds child +16, count +24 */
+static inline u64 lent(u64 node, u32 j) { return node + N_HDR + (u64)j * 16; }
+static inline u64 ient(u64 node, u32 j) { return node + N_HDR + (u64)j * 32; }
+
+static inline u32 ncount(memfile_t *mf, u64 node) { return rdu32(mf, node + N_COUNT); }
+static inline int is_leaf(memfile_t *mf, u64 node) { return rdu32(mf, node + N_LEAF) != 0; }
+static inline u64 child(memfile_t *mf, u64 node, u32 j) { return rdu64(mf, ient(node, j) + 16); }
+
+static int ecmp(const btree_t *t, u64 K, u64 V, u64 k, u64 v) {
+    if (K != k) return K < k ? -1 : 1;
+    if (t->cmp) return t->cmp(t->ctx, V, v);
+    return (V > v) - (V < v);
+}
+
+static u64 new_node(memfile_t *mf, int leaf) {
+    u64 n = memfile_alloc(mf, NODE_SIZE);
+    if (n) { memset(memfile_ptr(mf, n), 0, N_HDR); wru32(mf, n + N_LEAF, leaf ? 1u : 0u); }
+    return n;
+}
+
+static u64 sub_count(memfile_t *mf, u64 node) {
+    u32 n = ncount(mf, node);
+    if (is_leaf(mf, node)) return n;
+    u64 c = 0;
+    for (u32 j = 0; j < n; j++) c += rdu64(mf, ient(node, j) + 24);
+    return c;
+}
+
+/* point inner entry j at `c`: its first pair and its count */
+static void set_entry(memfile_t *mf, u64 node, u32 j, u64 c) {
+    u64 e = ient(node, j);
+    wru64(mf, e + 0, rdu64(mf, c + N_HDR));
+    wru64(mf, e + 8, rdu64(mf, c + N_HDR + 8));
+    wru64(mf, e + 16, c);
+    wru64(mf, e + 24, sub_count(mf, c));
+}
+
+/* index of the child whose range holds (k, v): the last whose first pair is <= it */
+static u32 route(const btree_t *t, u64 node, u64 k, u64 v) {
+    memfile_t *mf = t->mf;
+    u32 lo = 1, hi = ncount(mf, node);
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        u64 e = ient(node, mid);
+        if (ecmp(t, k, v, rdu64(mf, e), rdu64(mf, e + 8)) >= 0) lo = mid + 1; else hi = mid;
+    }
+    return lo - 1;
+}
+
+/* first leaf slot whose pair is >= (k, v) */
+static u32 leaf_lower(const btree_t *t, u64 node, u64 k, u64 v, int *eq) {
+    memfile_t *mf = t->mf;
+    u32 lo = 0, hi = ncount(mf, node);
+    *eq = 0;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        u64 e = lent(node, mid);
+        int c = ecmp(t, k, v, rdu64(mf, e), rdu64(mf, e + 8));
+        if (c > 0) lo = mid + 1; else { hi = mid; if (c == 0) *eq = 1; }
+    }
+    return lo;
+}
+
+/* open slot j in a node of entry size sz and bump its count */
+static u64 open_slot(memfile_t *mf, u64 node, u32 j, u32 sz) {
+    u32 n = ncount(mf, node);
+    u8 *p = memfile_ptr(mf, node + N_HDR);
+    memmove(p + (size_t)(j + 1) * sz, p + (size_t)j * sz, (size_t)(n - j) * sz);
+    wru32(mf, node + N_COUNT, n + 1);
+    return node + N_HDR + (u64)j * sz;
+}
+
+static void close_slot(memfile_t *mf, u64 node, u32 j, u32 sz) {
+    u32 n = ncount(mf, node);
+    u8 *p = memfile_ptr(mf, node + N_HDR);
+    memmove(p + (size_t)j * sz, p + (size_t)(j + 1) * sz, (size_t)(n - j - 1) * sz);
+    wru32(mf, node + N_COUNT, n - 1);
+}
+
+/* move the upper half of `node` into the empty node `right`, linked after it; returns the split point */
+static u32 split(memfile_t *mf, u64 node, u64 right) {
+    int leaf = is_leaf(mf, node);
+    u32 n = ncount(mf, node), half = n / 2, sz = leaf ? 16 : 32;
+    memcpy(memfile_ptr(mf, right + N_HDR), memfile_ptr(mf, node + N_HDR + (u64)half * sz), (size_t)(n - half) * sz);
+    wru32(mf, right + N_COUNT, n - half);
+    wru32(mf, node + N_COUNT, half);
+    if (leaf) {
+        u64 next = rdu64(mf, node + N_NEXT);
+        wru64(mf, right + N_PREV, node);
+        wru64(mf, right + N_NEXT, next);
+        if (next) wru64(mf, next + N_PREV, right);
+        wru64(mf, node + N_NEXT, right);
+    }
+    return half;
+}
+
+/* append `right`'s entries to `left` and free it */
+static void merge(memfile_t *mf, u64 left, u64 right) {
+    int leaf = is_leaf(mf, left);
+    u32 nl = ncount(mf, left), nr = ncount(mf, right), sz = leaf ? 16 : 32;
+    memcpy(memfile_ptr(mf, left + N_HDR + (u64)nl * sz), memfile_ptr(mf, right + N_HDR), (size_t)nr * sz);
+    wru32(mf, left + N_COUNT, nl + nr);
+    if (leaf) {
+        u64 next = rdu64(mf, right + N_NEXT);
+        wru64(mf, left + N_NEXT, next);
+        if (next) wru64(mf, next + N_PREV, left);
+    }
+    memfile_free(mf, right, NODE_SIZE);
+}
+
+static void unlink_leaf(memfile_t *mf, u64 leaf) {
+    u64 prev = rdu64(mf, leaf + N_PREV), next = rdu64(mf, leaf + N_NEXT);
+    if (prev) wru64(mf, prev + N_NEXT, next);
+    if (next) wru64(mf, next + N_PREV, prev);
+}
+
+int bt_create(const btree_t *t) {
+    memfile_t *mf = t->mf;
+    u64 hdr = memfile_alloc(mf, TH_SIZE);
+    if (!hdr) return 0;
+    u64 leaf = new_node(mf, 1);
+    if (!leaf) { memfile_free(mf, hdr, TH_SIZE); return 0; }
+    memset(memfile_ptr(mf, hdr), 0, TH_SIZE);
+    wru64(mf, hdr + TH_TOP, leaf);
+    wru64(mf, t->root, hdr);
+    return 1;
+}
+
+static void free_subtree(memfile_t *mf, u64 node) {
+    if (!is_leaf(mf, node))
+        for (u32 j = 0, n = ncount(mf, node); j < n; j++) free_subtree(mf, child(mf, node, j));
+    memfile_free(mf, node, NODE_SIZE);
+}
+
+void bt_destroy(const btree_t *t) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root);
+    if (!hdr) return;
+    free_subtree(mf, rdu64(mf, hdr + TH_TOP));
+    memfile_free(mf, hdr, TH_SIZE);
+    wru64(mf, t->root, 0);
+}
+
+int bt_build(const btree_t *t, const u64 *k, const u64 *v, size_t n) {
+    memfile_t *mf = t->mf;
+    if (!n) return bt_create(t);
+    /* leaves and inner nodes three-quarters full, leaving room for inserts */
+    const u32 lfill = LEAF_CAP * 3 / 4, ifill = INNER_CAP * 3 / 4;
+    size_t nl = (n + lfill - 1) / lfill, total = nl, lv = nl;
+    while (lv > 1) { lv = (lv + ifill - 1) / ifill; total += lv; }
+    u64 *nodes = calloc(total, 8), hdr = memfile_alloc(mf, TH_SIZE);
+    if (!nodes || !hdr) goto fail;
+    for (size_t i = 0; i < total; i++)
+        if (!(nodes[i] = memfile_alloc(mf, NODE_SIZE))) goto fail;
+    for (size_t i = 0; i < nl; i++) {                       /* leaves, linked */
+        u64 nd = nodes[i];
+        size_t lo = i * lfill, cnt = n - lo < lfill ? n - lo : lfill;
+        memset(memfile_ptr(mf, nd), 0, N_HDR);
+        wru32(mf, nd + N_COUNT, (u32)cnt);
+        wru32(mf, nd + N_LEAF, 1);
+        wru64(mf, nd + N_PREV, i ? nodes[i - 1] : 0);
+        wru64(mf, nd + N_NEXT, i + 1 < nl ? nodes[i + 1] : 0);
+        for (size_t j = 0; j < cnt; j++) { wru64(mf, lent(nd, (u32)j), k[lo + j]); wru64(mf, lent(nd, (u32)j) + 8, v[lo + j]); }
+    }
+    u32 height = 0;
+    size_t below = 0, nb = nl, at = nl;                     /* level under construction reads nodes[below..below+nb) */
+    while (nb > 1) {
+        size_t up = (nb + ifill - 1) / ifill;
+        for (size_t i = 0; i < up; i++) {
+            u64 nd = nodes[at + i];
+            size_t lo = i * ifill, cnt = nb - lo < ifill ? nb - lo : ifill;
+            memset(memfile_ptr(mf, nd), 0, N_HDR);
+            wru32(mf, nd + N_COUNT, (u32)cnt);
+            for (size_t j = 0; j < cnt; j++) set_entry(mf, nd, (u32)j, nodes[below + lo + j]);
+        }
+        below = at; at += up; nb = up; height++;
+    }
+    memset(memfile_ptr(mf, hdr), 0, TH_SIZE);
+    wru64(mf, hdr + TH_TOP, nodes[below]);
+    wru64(mf, hdr + TH_COUNT, n);
+    wru32(mf, hdr + TH_HEIGHT, height);
+    wru64(mf, t->root, hdr);
+    free(nodes);
+    return 1;
+fail:
+    if (nodes) for (size_t i = 0; i < total && nodes[i]; i++) memfile_free(mf, nodes[i], NODE_SIZE);
+    if (hdr) memfile_free(mf, hdr, TH_SIZE);
+    free(nodes);
+    return 0;
+}
+
+u64 bt_count(const btree_t *t) {
+    u64 hdr = rdu64(t->mf, t->root);
+    return hdr ? rdu64(t->mf, hdr + TH_COUNT) : 0;
+}
+
+int bt_insert(const btree_t *t, u64 k, u64 v) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root), path[MAX_DEPTH];
+    u32 h = rdu32(mf, hdr + TH_HEIGHT), idx[MAX_DEPTH];
+    u64 node = rdu64(mf, hdr + TH_TOP);
+    for (u32 l = 0; l < h; l++) { path[l] = node; idx[l] = route(t, node, k, v); node = child(mf, node, idx[l]); }
+    int eq;
+    u32 pos = leaf_lower(t, node, k, v, &eq);
+    if (eq) return 2;
+
+    /* every node a split will need, up front, so a failure leaves the tree as it was */
+    u64 spare[MAX_DEPTH + 2];
+    u32 need = 0, sp = 0;
+    if (ncount(mf, node) == LEAF_CAP) {
+        need = 1;
+        for (u32 l = h; l-- > 0 && ncount(mf, path[l]) == INNER_CAP;) need++;
+        if (need == h + 1) need++;                            /* the top splits: a new top above it */
+    }
+    for (u32 i = 0; i < need; i++)
+        if (!(spare[i] = new_node(mf, i == 0))) { while (i--) memfile_free(mf, spare[i], NODE_SIZE); return 0; }
+
+    u64 right = 0;
+    if (ncount(mf, node) == LEAF_CAP) {
+        right = spare[sp++];
+        u32 half = split(mf, node, right);
+        u64 e = pos > half ? open_slot(mf, right, pos - half, 16) : open_slot(mf, node, pos, 16);
+        wru64(mf, e, k); wru64(mf, e + 8, v);
+    } else {
+        u64 e = open_slot(mf, node, pos, 16);
+        wru64(mf, e, k); wru64(mf, e + 8, v);
+    }
+    for (u32 l = h; l-- > 0;) {
+        u64 p = path[l];
+        u32 i = idx[l];
+        set_entry(mf, p, i, child(mf, p, i));
+        if (!right) continue;
+        u64 up = 0, dst = p;
+        u32 j = i + 1;
+        if (ncount(mf, p) == INNER_CAP) {
+            up = spare[sp++];
+            u32 half = split(mf, p, up);
+            if (j > half) { dst = up; j -= half; }
+        }
+        open_slot(mf, dst, j, 32);
+        set_entry(mf, dst, j, right);
+        right = up;
+    }
+    if (right) {
+        u64 top = spare[sp++], old = rdu64(mf, hdr + TH_TOP);
+        wru32(mf, top + N_COUNT, 2);
+        set_entry(mf, top, 0, old);
+        set_entry(mf, top, 1, right);
+        wru64(mf, hdr + TH_TOP, top);
+        wru32(mf, hdr + TH_HEIGHT, h + 1);
+    }
+    wru64(mf, hdr + TH_COUNT, rdu64(mf, hdr + TH_COUNT) + 1);
+    return 1;
+}
+
+int bt_delete(const btree_t *t, u64 k, u64 v) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root), path[MAX_DEPTH];
+    u32 h = rdu32(mf, hdr + TH_HEIGHT), idx[MAX_DEPTH];
+    u64 node = rdu64(mf, hdr + TH_TOP);
+    for (u32 l = 0; l < h; l++) { path[l] = node; idx[l] = route(t, node, k, v); node = child(mf, node, idx[l]); }
+    int eq;
+    u32 pos = leaf_lower(t, node, k, v, &eq);
+    if (!eq) return 0;
+    close_slot(mf, node, pos, 16);
+
+    for (u32 l = h; l-- > 0;) {
+        u64 p = path[l];
+        u32 i = idx[l], n = ncount(mf, p);
+        u64 c = child(mf, p, i);
+        u32 cn = ncount(mf, c), cap = is_leaf(mf, c) ? LEAF_CAP : INNER_CAP;
+        if (cn == 0) {                                        /* only leaves empty out */
+            unlink_leaf(mf, c);
+            memfile_free(mf, c, NODE_SIZE);
+            close_slot(mf, p, i, 32);
+            continue;
+        }
+        if (cn < cap / 4) {
+            if (i + 1 < n && cn + ncount(mf, child(mf, p, i + 1)) <= cap) {
+                merge(mf, c, child(mf, p, i + 1));
+                close_slot(mf, p, i + 1, 32);
+            } else if (i > 0 && ncount(mf, child(mf, p, i - 1)) + cn <= cap) {
+                merge(mf, child(mf, p, i - 1), c);
+                close_slot(mf, p, i, 32);
+                i--;
+            }
+        }
+        set_entry(mf, p, i, child(mf, p, i));
+    }
+    while (h > 0) {                                           /* a top with one child gives way to it */
+        u64 top = rdu64(mf, hdr + TH_TOP);
+        if (ncount(mf, top) != 1) break;
+        wru64(mf, hdr + TH_TOP, child(mf, top, 0));
+        memfile_free(mf, top, NODE_SIZE);
+        wru32(mf, hdr + TH_HEIGHT, --h);
+    }
+    wru64(mf, hdr + TH_COUNT, rdu64(mf, hdr + TH_COUNT) - 1);
+    return 1;
+}
+
+u64 bt_lower(const btree_t *t, bt_probe_fn probe, void *pctx) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root), rank = 0;
+    u32 h = rdu32(mf, hdr + TH_HEIGHT);
+    u64 node = rdu64(mf, hdr + TH_TOP);
+    for (u32 l = 0; l < h; l++) {
+        u32 lo = 1, hi = ncount(mf, node);                    /* last child whose first pair the probe falls after */
+        while (lo < hi) {
+            u32 mid = (lo + hi) / 2;
+            u64 e = ient(node, mid);
+            if (probe(pctx, rdu64(mf, e), rdu64(mf, e + 8)) > 0) lo = mid + 1; else hi = mid;
+        }
+        for (u32 j = 0; j + 1 < lo; j++) rank += rdu64(mf, ient(node, j) + 24);
+        node = child(mf, node, lo - 1);
+    }
+    u32 lo = 0, hi = ncount(mf, node);
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        u64 e = lent(node, mid);
+        if (probe(pctx, rdu64(mf, e), rdu64(mf, e + 8)) > 0) lo = mid + 1; else hi = mid;
+    }
+    return rank + lo;
+}
+
+int bt_at(const btree_t *t, u64 pos, bt_iter *it) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root);
+    it->leaf = 0; it->i = 0;
+    if (pos >= rdu64(mf, hdr + TH_COUNT)) return 0;
+    u32 h = rdu32(mf, hdr + TH_HEIGHT);
+    u64 node = rdu64(mf, hdr + TH_TOP);
+    for (u32 l = 0; l < h; l++) {
+        u32 j = 0, n = ncount(mf, node);
+        for (; j + 1 < n; j++) {
+            u64 c = rdu64(mf, ient(node, j) + 24);
+            if (pos < c) break;
+            pos -= c;
+        }
+        node = child(mf, node, j);
+    }
+    it->leaf = node; it->i = (u32)pos;
+    return 1;
+}
+
+int bt_get(const btree_t *t, const bt_iter *it, u64 *k, u64 *v) {
+    if (!it->leaf || it->i >= ncount(t->mf, it->leaf)) return 0;
+    u64 e = lent(it->leaf, it->i);
+    if (k) *k = rdu64(t->mf, e);
+    if (v) *v = rdu64(t->mf, e + 8);
+    return 1;
+}
+
+void bt_next(const btree_t *t, bt_iter *it) {
+    if (!it->leaf) return;
+    if (++it->i >= ncount(t->mf, it->leaf)) { it->leaf = rdu64(t->mf, it->leaf + N_NEXT); it->i = 0; }
+}
+
+void bt_prev(const btree_t *t, bt_iter *it) {
+    if (!it->leaf) return;
+    if (it->i > 0) { it->i--; return; }
+    it->leaf = rdu64(t->mf, it->leaf + N_PREV);
+    it->i = it->leaf ? ncount(t->mf, it->leaf) - 1 : 0;
+}
+
+/* audit one subtree: entries ascend from (*pk, *pv) on, counts and first pairs
+ * agree, leaves sit at one depth and chain in order; returns its pair count or -1 */
+static long long check_node(const btree_t *t, u64 node, u32 depth, u32 h, int *have, u64 *pk, u64 *pv, u64 *leaf) {
+    memfile_t *mf = t->mf;
+    u32 n = ncount(mf, node);
+    if (is_leaf(mf, node) != (depth == h) || (depth && !n)) return -1;
+    if (depth == h) {
+        if (rdu64(mf, node + N_PREV) != *leaf) return -1;
+        if (*leaf && rdu64(mf, *leaf + N_NEXT) != node) return -1;
+        *leaf = node;
+        for (u32 j = 0; j < n; j++) {
+            u64 k = rdu64(mf, lent(node, j)), v = rdu64(mf, lent(node, j) + 8);
+            if (*have && ecmp(t, *pk, *pv, k, v) >= 0) return -1;
+            *have = 1; *pk = k; *pv = v;
+        }
+        return n;
+    }
+    long long total = 0;
+    for (u32 j = 0; j < n; j++) {
+        u64 e = ient(node, j), c = rdu64(mf, e + 16);
+        if (rdu64(mf, e) != rdu64(mf, c + N_HDR) || rdu64(mf, e + 8) != rdu64(mf, c + N_HDR + 8)) return -1;
+        long long s = check_node(t, c, depth + 1, h, have, pk, pv, leaf);
+        if (s < 0 || (u64)s != rdu64(mf, e + 24)) return -1;
+        total += s;
+    }
+    return total;
+}
+
+int bt_check(const btree_t *t) {
+    memfile_t *mf = t->mf;
+    u64 hdr = rdu64(mf, t->root), pk = 0, pv = 0, leaf = 0;
+    if (!hdr) return 0;
+    int have = 0;
+    u32 h = rdu32(mf, hdr + TH_HEIGHT);
+    u64 top = rdu64(mf, hdr + TH_TOP);
+    if (h && ncount(mf, top) < 2) return 0;
+    long long n = check_node(t, top, 0, h, &have, &pk, &pv, &leaf);
+    return n >= 0 && (u64)n == rdu64(mf, hdr + TH_COUNT) && rdu64(mf, leaf + N_NEXT) == 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Persistent counted B+tree over a v3 MemoryFile: an ordered set of (k, v) u64
+ * pairs with rank (position) seeks.
+ *
+ * Entries order by k, then — when the keys tie — by the caller's `cmp` over the
+ * values (by value when cmp is NULL). A key can thus be a cheap prefix of some
+ * longer sort key that `cmp` finishes off (the graph's name order packs the
+ * first 8 bytes of a folded name into k and compares the rest through the
+ * entity offset in v). Pairs are unique: inserting one already present is a
+ * no-op.
+ *
+ *   header: [u64 top][u64 count][u32 height][u32 pad][u64 pad]   (32 bytes)
+ *   node:   [u32 n][u32 leaf][u64 prev][u64 next][u64 pad] + entries (1 KiB)
+ *     leaf entry:  {u64 k, u64 v}                          62 per node
+ *     inner entry: {u64 k, u64 v, u64 child, u64 count}    31 per node
+ * An inner entry carries its child's first pair and the number of pairs under
+ * it. Leaves are linked both ways for ordered scans. Deletion merges a node
+ * that falls under a quarter full into a neighbour when the two fit in one.
+ *
+ * As with pmap.h, `root` is the offset of the u64 slot holding the header.
+ * Callers hold the file's exclusive lock for insert/delete.
+ */
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stddef.h>
+#include "memoryfile.h"
+
+/* order of two values whose keys tie: <0, 0, >0 */
+typedef int (*bt_cmp_fn)(void *ctx, u64 va, u64 vb);
+/* where a probe falls against entry (k, v): <0 before it, 0 on it, >0 after it */
+typedef int (*bt_probe_fn)(void *ctx, u64 k, u64 v);
+
+typedef struct {
+    memfile_t *mf;
+    u64        root;
+    bt_cmp_fn  cmp;    /* NULL: by value */
+    void      *ctx;
+} btree_t;
+
+/* position in a leaf; valid until the next insert/delete */
+typedef struct { u64 leaf; u32 i; } bt_iter;
+
+/* empty tree at `root`; 0 on failure */
+int  bt_create(const btree_t *t);
+/* tree at `root` from n pairs already in tree order (bulk load); 0 on failure */
+int  bt_build(const btree_t *t, const u64 *k, const u64 *v, size_t n);
+/* free every node and the header, zeroing `root` */
+void bt_destroy(const btree_t *t);
+
+int  bt_insert(const btree_t *t, u64 k, u64 v);   /* 1 inserted, 2 already present, 0 on failure */
+int  bt_delete(const btree_t *t, u64 k, u64 v);   /* 1 if removed */
+u64  bt_count(const btree_t *t);
+
+/* rank of the first entry the probe does not fall after (count when none) */
+u64  bt_lower(const btree_t *t, bt_probe_fn probe, void *pctx);
+/* iterator at rank `pos`; 0 when pos >= count */
+int  bt_at(const btree_t *t, u64 pos, bt_iter *it);
+/* pair under the iterator; 0 once it has run off either end */
+int  bt_get(const btree_t *t, const bt_iter *it, u64 *k, u64 *v);
+void bt_next(const btree_t *t, bt_iter *it);
+void bt_prev(const btree_t *t, bt_iter *it);
+
+/* structural audit (order, counts, first pairs, leaf links); 1 if sound */
+int  bt_check(const btree_t *t);
+
+#endif /* BTREE_H */
@@ -17,11 +17,34 @@
               u64 structural_visits; u64 walker_visits; double psi; })
 
 /* Future schema changes append one line each, e.g.:
- *   V(2, 1, { <v1 fields>; f32 score; },
- *     { LENS_COPY(c->name_id, v->name_id); ...; c->score = 0; })  */
-#define ENTITY_UPGRADES
+ *   V(3, 2, { <v2 fields>; f32 score; },
+ *     { LENS_COPY(c->name_id, v->name_id); ...; c->score = 0; })
+ *
+ * v2: short name/type bytes inline after the v1 body, so reading an entity's
+ * identity stays inside its own record instead of a jump into the strings file
+ * per field. The record is 124 bytes (a 128-byte allocation, two cache lines);
+ * the inline fields start at byte 76, past the first line, because the v1 body
+ * must stay a strict prefix. Observations stay in the string table: two copies
+ * of up to 140 bytes would more than double the record.
+ * name_id/type_id stay authoritative (refcounts, name index, type compares);
+ * the inline copy is a read cache. *_len == ENTITY_INLINE_NONE means "too long,
+ * follow the id". The v1 body is a strict prefix, so the lens is a prefix copy. */
+#define ENTITY_INLINE_NONE 0xFFu
+#define ENTITY_NAME_INLINE 30
+#define ENTITY_TYPE_INLINE 16
 
-#define ENTITY_CURRENT 1
+#define ENTITY_UPGRADES \
+    V(2, 1, { u32 name_id; u32 type_id; u64 adj_offset; u64 mtime; u64 obs_mtime; \
+              u8 obs_count; u8 _pad0[3]; u32 obs0_id; u32 obs1_id; u32 _pad1; \
+              u64 structural_visits; u64 walker_visits; double psi; \
+              u8 name_len; u8 type_len; char name_inline[ENTITY_NAME_INLINE]; \
+              char type_inline[ENTITY_TYPE_INLINE]; }, \
+      { memcpy(c, v, sizeof(*v)); \
+        c->name_len = ENTITY_INLINE_NONE; c->type_len = ENTITY_INLINE_NONE; \
+        memset(c->name_inline, 0, sizeof c->name_inline); \
+        memset(c->type_inline, 0, sizeof c->type_inline); })
+
+#define ENTITY_CURRENT 2
 
 //=============================================================================
 // Expand: struct typedefs
@@ -33,7 +56,7 @@ ENTITY_UPGRADES
 #undef BASE
 #undef V
 
-typedef Entity_v1 Entity;
+typedef Entity_v2 Entity;
 #define ENTITY_VERSION ENTITY_CURRENT
 
 //=============================================================================
@@ -0,0 +1,150 @@
+#include "fuzzy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "trigram.h"
+
+static int cmp_u32(const void *a, const void *b) { u32 x = *(const u32 *)a, y = *(const u32 *)b; return (x > y) - (x < y); }
+
+static u32 uniq(u32 *v, u32 n) {
+    qsort(v, n, 4, cmp_u32);
+    u32 m = 0;
+    for (u32 i = 0; i < n; i++) if (m == 0 || v[m - 1] != v[i]) v[m++] = v[i];
+    return m;
+}
+
+/* code points of s into cp (at most max); a malformed byte stands for itself */
+static u32 decode(const u8 *s, u32 len, u32 *cp, u32 max) {
+    u32 n = 0;
+    for (u32 i = 0; i < len && n < max;) {
+        u8 c = s[i];
+        u32 l = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : (c >> 3) == 30 ? 4 : 0;
+        u32 v = l > 1 ? c & (0x7fu >> l) : c;
+        if (l == 0 || i + l > len) l = 1, v = c;
+        for (u32 k = 1; k < l; k++) {
+            if ((s[i + k] & 0xc0) != 0x80) { l = 1; v = c; break; }
+            v = v << 6 | (s[i + k] & 0x3fu);
+        }
+        cp[n++] = v;
+        i += l;
+    }
+    return n;
+}
+
+#define BASIS_HEAD 2166136261u                 /* FNV offset basis */
+#define BASIS_TAIL (2166136261u ^ 0x5bd1e995u)  /* a separate key space for the suffix */
+
+/* FNV-1a over the code points from basis h, skipping positions a and b */
+static u32 hash_without(const u32 *cp, u32 n, u32 a, u32 b, u32 h) {
+    for (u32 i = 0; i < n; i++) {
+        if (i == a || i == b) continue;
+        for (u32 k = 0; k < 4; k++) { h ^= (cp[i] >> (8 * k)) & 0xffu; h *= 16777619u; }
+    }
+    return h;
+}
+
+static u32 keys_of(const u32 *cp, u32 n, u32 maxd, u32 basis, u32 *out) {
+    u32 k = 0;
+    out[k++] = hash_without(cp, n, n, n, basis);
+    if (maxd >= 1)
+        for (u32 i = 0; i < n; i++) out[k++] = hash_without(cp, n, i, n, basis);
+    if (maxd >= 2)
+        for (u32 i = 0; i < n; i++)
+            for (u32 j = i + 1; j < n; j++) out[k++] = hash_without(cp, n, i, j, basis);
+    return uniq(out, k);
+}
+
+u32 fz_keys(const u8 *s, u32 len, u32 maxd, u32 *out, u32 *nhead) {
+    u32 *cp = malloc(((size_t)len + 1) * 4);
+    if (!cp) return *nhead = 0;
+    u32 n = decode(s, len, cp, len), w = n < FZ_PREFIX ? n : FZ_PREFIX;
+    u32 h = keys_of(cp, w, maxd, BASIS_HEAD, out);
+    u32 t = keys_of(cp + n - w, w, maxd, BASIS_TAIL, out + h);
+    free(cp);
+    *nhead = h;
+    return h + t;
+}
+
+int fz_index_build(memfile_t *mf, u64 root, u64 *pairs, size_t n) { return tri_index_build(mf, root, pairs, n); }
+void fz_index_destroy(memfile_t *mf, u64 root) { tri_index_destroy(mf, root); }
+
+int fz_index_add(memfile_t *mf, u64 root, u32 id, const u8 *s, u32 len) {
+    u32 keys[FZ_KEYS_MAX], h, k = fz_keys(s, len, FZ_MAX_DIST, keys, &h);
+    if (!k) return 0;
+    for (u32 i = 0; i < k; i++) if (!tri_post(mf, root, keys[i], id)) return 0;
+    return 1;
+}
+
+void fz_index_remove(memfile_t *mf, u64 root, u32 id, const u8 *s, u32 len) {
+    u32 keys[FZ_KEYS_MAX], h, k = fz_keys(s, len, FZ_MAX_DIST, keys, &h);
+    for (u32 i = 0; i < k; i++) tri_unpost(mf, root, keys[i], id);
+}
+
+static u32 postings_total(memfile_t *mf, u64 root, const u32 *keys, u32 k) {
+    u32 total = 0;
+    for (u32 i = 0; i < k; i++) { u32 c; tri_postings_at(mf, root, keys[i], &c); total += c; }
+    return total;
+}
+
+/* id in any of the postings under keys[0..k) (binary search per key) */
+static int posted_any(memfile_t *mf, u64 root, const u32 *keys, u32 k, u32 id) {
+    for (u32 i = 0; i < k; i++) {
+        u32 c, lo = 0, v;
+        const u8 *p = tri_postings_at(mf, root, keys[i], &c);
+        for (u32 hi = c; lo < hi;) {
+            u32 mid = (lo + hi) / 2;
+            memcpy(&v, p + (size_t)mid * 4, 4);
+            if (v < id) lo = mid + 1; else hi = mid;
+        }
+        if (lo < c && (memcpy(&v, p + (size_t)lo * 4, 4), v == id)) return 1;
+    }
+    return 0;
+}
+
+u32 fz_candidates(memfile_t *mf, u64 root, const u8 *s, u32 len, u32 maxd, u32 **ids) {
+    u32 keys[FZ_KEYS_MAX], h, k = fz_keys(s, len, maxd > FZ_MAX_DIST ? FZ_MAX_DIST : maxd, keys, &h);
+    *ids = NULL;
+    if (!k) return 0;
+    /* A match needs both its head and its tail: gather the ids under the side
+     * with fewer postings, keep those the other side also has. */
+    u32 th = postings_total(mf, root, keys, h), tt = postings_total(mf, root, keys + h, k - h);
+    const u32 *dk = th <= tt ? keys : keys + h, *fk = th <= tt ? keys + h : keys;
+    u32 dn = th <= tt ? h : k - h, fn = k - dn, n = 0, m = 0;
+    if (!(*ids = malloc(((size_t)(th <= tt ? th : tt) + 1) * 4))) return 0;
+    for (u32 i = 0; i < dn; i++) {
+        u32 c;
+        const u8 *p = tri_postings_at(mf, root, dk[i], &c);
+        if (c) memcpy(*ids + n, p, (size_t)c * 4);
+        n += c;
+    }
+    n = uniq(*ids, n);
+    for (u32 i = 0; i < n; i++) if (posted_any(mf, root, fk, fn, (*ids)[i])) (*ids)[m++] = (*ids)[i];
+    return m;
+}
+
+u32 fz_distance(const u8 *a, u32 alen, const u8 *b, u32 blen, u32 maxd) {
+    u32 *buf = malloc(((size_t)alen + (size_t)blen * 4 + 4) * 4);
+    if (!buf) return maxd + 1;
+    u32 *x = buf, n = decode(a, alen, x, alen);
+    u32 *y = x + alen, m = decode(b, blen, y, blen);
+    u32 *p2 = y + blen, *p1 = p2 + m + 1, *cur = p1 + m + 1, d = maxd + 1;
+    if ((n > m ? n - m : m - n) > maxd) goto out;
+    for (u32 j = 0; j <= m; j++) p1[j] = j;
+    for (u32 i = 1; i <= n; i++) {
+        u32 lo = cur[0] = i;
+        for (u32 j = 1; j <= m; j++) {
+            u32 v = p1[j - 1] + (x[i - 1] != y[j - 1]);
+            if (p1[j] + 1 < v) v = p1[j] + 1;
+            if (cur[j - 1] + 1 < v) v = cur[j - 1] + 1;
+            if (i > 1 && j > 1 && x[i - 1] == y[j - 2] && x[i - 2] == y[j - 1] && p2[j - 2] + 1 < v) v = p2[j - 2] + 1;
+            cur[j] = v;
+            if (v < lo) lo = v;
+        }
+        if (lo > maxd) goto out;
+        u32 *t = p2; p2 = p1; p1 = cur; cur = t;
+    }
+    if (p1[m] <= maxd) d = p1[m];
+out:
+    free(buf);
+    return d;
+}
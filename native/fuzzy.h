@@ -0,0 +1,46 @@
+/*
+ * Typo-tolerant name lookup by symmetric deletion (as in SymSpell).
+ *
+ * A name is posted under the hash of every string reachable from its first
+ * FZ_PREFIX code points by deleting at most FZ_MAX_DIST of them, and likewise
+ * for its last FZ_PREFIX (in a separate key space). Two strings within d edits
+ * share such a string with at most d deletions on each side, at both ends, so a
+ * query's own deletions (up to its d) reach every name that can match; keying
+ * both ends keeps names with a common prefix ("project-…") from all colliding.
+ * The ends ignore the middle and hashes may collide, so candidates are verified
+ * with fz_distance afterwards.
+ *
+ * Postings use the trigram index layout (trigram.h) under their own root: a
+ * pmap from key to an ascending block of the caller's u32 ids. Names are given
+ * case-folded; distances count code points.
+ */
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+#include "memoryfile.h"
+
+#define FZ_PREFIX    7u
+#define FZ_MAX_DIST  2u
+#define FZ_KEYS_MAX  58u     /* (1 + 7 + 21) strings from each 7-code-point end */
+
+/* distinct deletion keys of `s` for up to maxd (<= FZ_MAX_DIST) deletions into
+ * out (FZ_KEYS_MAX entries): *nhead prefix keys, then the suffix keys, each run
+ * ascending; returns the total, 0 on OOM */
+u32  fz_keys(const u8 *s, u32 len, u32 maxd, u32 *out, u32 *nhead);
+
+/* create the index from (key << 32 | id) pairs (sorted in place); 0 on failure */
+int  fz_index_build(memfile_t *mf, u64 root, u64 *pairs, size_t n);
+void fz_index_destroy(memfile_t *mf, u64 root);
+int  fz_index_add(memfile_t *mf, u64 root, u32 id, const u8 *s, u32 len);
+void fz_index_remove(memfile_t *mf, u64 root, u32 id, const u8 *s, u32 len);
+
+/* Ids that may lie within maxd edits of `s`: *ids (malloc'd, ascending, distinct;
+ * caller frees) gets every one; returns the count, 0 with *ids NULL on OOM. */
+u32  fz_candidates(memfile_t *mf, u64 root, const u8 *s, u32 len, u32 maxd, u32 **ids);
+
+/* Optimal string alignment distance in code points (an adjacent transposition is
+ * one edit); returns maxd + 1 as soon as it is known to exceed maxd. */
+u32  fz_distance(const u8 *a, u32 alen, const u8 *b, u32 blen, u32 maxd);
+
+#endif /* FUZZY_H */
@@ -2,10 +2,18 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <regex.h>
 #include "entity.h"   /* versioned record schema (single source of truth) */
-
-#define GRAPH_HEADER_SIZE 40u   /* node_log_off, structural_total, walker_total, name_index_off, schema_ver, pad */
+#include "regex_query.h"
+#include "regex_dfa.h"
+#include "pmap.h"
+#include "pool.h"
+#include "textindex.h"
+#include "fuzzy.h"
+#include "btree.h"
+#include "minhash.h"
+#include "hnsw.h"
+
+#define GRAPH_HEADER_SIZE 64u   /* node_log_off, structural_total, walker_total, name_index_off, schema_ver, pad, refs_root, aux_dir[2] */
 
 /* graph header field offsets */
 #define GH_NODE_LOG_OFF     0
@@ -13,8 +21,25 @@
 #define GH_WALKER_TOTAL     16
 #define GH_NAME_INDEX_OFF   24
 #define GH_SCHEMA_VERSION   32
-
-/* entity record on-disk layout: [u32 version][Entity_v1 body]. Body fields are
+#define GH_STRING_REFS      40  /* pmap root: string id -> ref block (0 = not built) */
+#define GH_AUX_DIR          48  /* 2 x u64 -> [u64 slots[GAUX_DIR_SLOTS]], each allocated on first use */
+
+/* Optional indexes hang off the aux directories, as in the string table. The
+ * header always had a 64-byte quantum, so older files read zero directories. */
+#define GAUX_DIR_SLOTS      8u
+#define GAUX_TEXT           0u  /* BM25 word index over entity text (textindex.h) */
+#define GAUX_FUZZY          1u  /* deletion keys of folded names -> entities (fuzzy.h) */
+#define GAUX_NAMES          2u  /* entities in name order (btree.h) */
+#define GAUX_DUPS           3u  /* MinHash sketches + LSH bands of entity text (minhash.h) */
+#define GAUX_VECTORS        4u  /* client-supplied entity vectors, HNSW-indexed (hnsw.h) */
+#define GAUX_TYPES          5u  /* type id -> entities of that type (ref blocks) */
+#define GAUX_RELTYPES       6u  /* relType id -> live adjacency entries; key 0 = all of them */
+#define GAUX_CONNECT        7u  /* [u64 orphan set][u64 component forest] pmap roots */
+#define GAUX_MTIME          8u  /* entities by mtime (btree.h) */
+#define GAUX_OBS_MTIME      9u  /* entities by obsMtime */
+#define GAUX_REL_MTIME     10u  /* relations by mtime: v = from doc id << 32 | to doc id */
+
+/* entity record on-disk layout: [u32 version][Entity body]. Body fields are
  * at sizeof(u32) + offsetof(Entity, field); the static_assert binds these to the
  * entity.h single-source struct so they cannot silently drift. */
 #define E_VERSION 0
@@ -29,10 +54,17 @@
 #define E_SVIS    52
 #define E_WVIS    60
 #define E_PSI     68
+#define E_NAME_LEN 76   /* v2+ only: older records end at E_PSI + 8 */
+#define E_TYPE_LEN 77
+#define E_NAME_INL 78
+#define E_TYPE_INL 108
 _Static_assert(sizeof(u32) + sizeof(Entity) == ENTITY_RECORD_SIZE, "entity record size");
 _Static_assert(E_NAME_ID == sizeof(u32) + offsetof(Entity, name_id), "name_id offset");
 _Static_assert(E_ADJ     == sizeof(u32) + offsetof(Entity, adj_offset), "adj offset");
 _Static_assert(E_PSI     == sizeof(u32) + offsetof(Entity, psi), "psi offset");
+_Static_assert(E_NAME_LEN == sizeof(u32) + offsetof(Entity, name_len), "name_len offset");
+_Static_assert(E_NAME_INL == sizeof(u32) + offsetof(Entity, name_inline), "name_inline offset");
+_Static_assert(E_TYPE_INL == sizeof(u32) + offsetof(Entity, type_inline), "type_inline offset");
 
 /* adj entry field offsets */
 #define AE_TARGET_DIR 0
@@ -42,6 +74,10 @@ _Static_assert(E_PSI     == sizeof(u32) + offsetof(Entity, psi), "psi offset");
 /* name-index block: [u32 bucket_count][u32 ni_count][bucket{u32 name_id,u32 pad,u64 offset}...] */
 #define NI_BUCKET_SIZE 16u
 
+/* string ref block: [u32 count][u32 cap][u64 refs...], refs ascending.
+ * A ref is entity_offset | GRAPH_REF_* role (records are 32-byte aligned). */
+#define RB_HDR 8u
+
 /* ---- aliasing-safe field access ---- */
 static inline u8  rdu8 (memfile_t *mf, u64 o) { return *(const u8 *)memfile_ptr(mf, o); }
 static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
@@ -174,6 +210,19 @@ static void ni_rehash(graph_t *g, u32 new_bc) {
  * Entity records
  * ====================================================================== */
 
+/* Allocation size of the record at `off`, from its own version tag: v1 records
+ * written before the inline tail existed are still live and freed at 76 bytes. */
+static inline u64 record_size(graph_t *g, u64 off) {
+    return entity_bufsize(rdu32(g->mf, off + E_VERSION));
+}
+
+/* Inline copy of a name/type if it fits, else ENTITY_INLINE_NONE (reader follows the id). */
+static void write_inline(memfile_t *mf, u64 len_pos, u64 data_pos, u32 cap, const u8 *s, u16 len) {
+    if (len > cap) { wru8(mf, len_pos, ENTITY_INLINE_NONE); return; }
+    wru8(mf, len_pos, (u8)len);
+    if (len) memcpy(memfile_ptr(mf, data_pos), s, len);
+}
+
 void graph_read_entity(graph_t *g, u64 off, entity_t *e) {
     memfile_t *mf = g->mf;
     e->offset = off;
@@ -232,6 +281,976 @@ static void log_remove(graph_t *g, u64 ent_off) {
     }
 }
 
+/* ======================================================================
+ * String reverse index (string id -> referencing entities)
+ *
+ * One ref per (entity, role) reference, so an entity whose two observations are
+ * the same string holds two equal refs; removal drops one. Blocks relocate when
+ * full and are freed when empty. Kept current by the entity/observation ops;
+ * files written before it existed get it built on open.
+ * ====================================================================== */
+
+static inline u64 refs_root(graph_t *g) { return g->header_offset + GH_STRING_REFS; }
+static inline u64 rb_size(u32 cap) { return RB_HDR + (u64)cap * 8; }
+static inline u32 rb_cap(u32 want) { return (u32)((((rb_size(want) + 31) & ~31ull) - RB_HDR) / 8); }
+
+/* first index in the block whose ref is >= r */
+static u32 rb_lower(memfile_t *mf, u64 b, u32 cnt, u64 r) {
+    u32 lo = 0, hi = cnt;
+    while (lo < hi) { u32 mid = lo + (hi - lo) / 2; if (rdu64(mf, b + RB_HDR + (u64)mid * 8) < r) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+
+/* Ref blocks behind a pmap: key -> block of u64s kept ascending. The string
+ * refs and the entity-type index share them. */
+static void rb_insert(memfile_t *mf, u64 root, u32 key, u64 r) {
+    u64 b = pmap_get(mf, root, key);
+    if (!b) {
+        u32 cap = rb_cap(1);
+        if (!(b = memfile_alloc(mf, rb_size(cap)))) return;
+        wru32(mf, b + 0, 1); wru32(mf, b + 4, cap); wru64(mf, b + RB_HDR, r);
+        if (!pmap_put(mf, root, key, b)) memfile_free(mf, b, rb_size(cap));
+        return;
+    }
+    u32 cnt = rdu32(mf, b + 0), cap = rdu32(mf, b + 4);
+    if (cnt == cap) {
+        u32 ncap = rb_cap(cap * 2);
+        u64 nb = memfile_alloc(mf, rb_size(ncap));
+        if (!nb) return;
+        memcpy(memfile_ptr(mf, nb + RB_HDR), memfile_ptr(mf, b + RB_HDR), (u64)cnt * 8);
+        wru32(mf, nb + 4, ncap);
+        memfile_free(mf, b, rb_size(cap));
+        pmap_put(mf, root, key, nb);   /* replaces in place: no allocation */
+        b = nb;
+    }
+    u32 at = rb_lower(mf, b, cnt, r);
+    u8 *p = memfile_ptr(mf, b + RB_HDR);
+    memmove(p + (u64)(at + 1) * 8, p + (u64)at * 8, (u64)(cnt - at) * 8);
+    wru64(mf, b + RB_HDR + (u64)at * 8, r);
+    wru32(mf, b + 0, cnt + 1);
+}
+
+static void rb_erase(memfile_t *mf, u64 root, u32 key, u64 r) {
+    u64 b = pmap_get(mf, root, key);
+    if (!b) return;
+    u32 cnt = rdu32(mf, b + 0), at = rb_lower(mf, b, cnt, r);
+    if (at == cnt || rdu64(mf, b + RB_HDR + (u64)at * 8) != r) return;
+    if (cnt == 1) { memfile_free(mf, b, rb_size(rdu32(mf, b + 4))); pmap_del(mf, root, key); return; }
+    u8 *p = memfile_ptr(mf, b + RB_HDR);
+    memmove(p + (u64)at * 8, p + (u64)(at + 1) * 8, (u64)(cnt - at - 1) * 8);
+    wru32(mf, b + 0, cnt - 1);
+}
+
+static void rb_destroy(memfile_t *mf, u64 root) {
+    u32 cap = pmap_capacity(mf, root);
+    for (u32 i = 0; i < cap; i++) {
+        u64 b;
+        if (pmap_at(mf, root, i, NULL, &b)) memfile_free(mf, b, rb_size(rdu32(mf, b + 4)));
+    }
+    pmap_destroy(mf, root);
+}
+
+/* how many u64s key's block holds; copies the first `max` */
+static u32 rb_read(memfile_t *mf, u64 root, u32 key, u64 *out, u32 max) {
+    u64 b = pmap_get(mf, root, key);
+    if (!b) return 0;
+    u32 cnt = rdu32(mf, b + 0), n = cnt < max ? cnt : max;
+    for (u32 i = 0; i < n; i++) out[i] = rdu64(mf, b + RB_HDR + (u64)i * 8);
+    return cnt;
+}
+
+typedef struct { u32 sid; u64 ref; } sref;
+static int cmp_sref(const void *a, const void *b) {
+    const sref *x = a, *y = b;
+    if (x->sid != y->sid) return (x->sid > y->sid) - (x->sid < y->sid);
+    return (x->ref > y->ref) - (x->ref < y->ref);
+}
+
+/* Bulk build: sort every (key, ref) pair once, then write each key's block at
+ * its final size. Consumes v. */
+static int rb_build(memfile_t *mf, u64 root, sref *v, size_t n) {
+    qsort(v, n, sizeof(sref), cmp_sref);
+    u32 distinct = 0;
+    for (size_t i = 0; i < n; i++) if (i == 0 || v[i].sid != v[i - 1].sid) distinct++;
+    u32 buckets = PMAP_INITIAL_BUCKETS;
+    while ((u64)buckets * 7 < (u64)distinct * 10) buckets *= 2;
+    if (!pmap_create(mf, root, buckets)) { free(v); return 0; }
+    for (size_t i = 0; i < n; ) {
+        size_t j = i;
+        while (j < n && v[j].sid == v[i].sid) j++;
+        u32 cap = rb_cap((u32)(j - i));
+        u64 b = memfile_alloc(mf, rb_size(cap));
+        if (!b) { free(v); rb_destroy(mf, root); return 0; }
+        wru32(mf, b + 0, (u32)(j - i)); wru32(mf, b + 4, cap);
+        for (size_t k = i; k < j; k++) wru64(mf, b + RB_HDR + (u64)(k - i) * 8, v[k].ref);
+        if (!pmap_put(mf, root, v[i].sid, b)) { memfile_free(mf, b, rb_size(cap)); free(v); rb_destroy(mf, root); return 0; }
+        i = j;
+    }
+    free(v);
+    return 1;
+}
+
+static void ref_add(graph_t *g, u32 sid, u64 ent_off, u32 role) {
+    if (sid && rdu64(g->mf, refs_root(g))) rb_insert(g->mf, refs_root(g), sid, ent_off | role);
+}
+
+static void ref_remove(graph_t *g, u32 sid, u64 ent_off, u32 role) {
+    if (sid && rdu64(g->mf, refs_root(g))) rb_erase(g->mf, refs_root(g), sid, ent_off | role);
+}
+
+static int refs_build(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0);
+    sref *v = malloc(((size_t)count * 4 + 1) * sizeof(sref));
+    if (!v) return 0;
+    size_t n = 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        u32 o0 = rdu32(mf, e + E_OBS0), o1 = rdu32(mf, e + E_OBS1);
+        v[n++] = (sref){ rdu32(mf, e + E_NAME_ID), e | GRAPH_REF_NAME };
+        v[n++] = (sref){ rdu32(mf, e + E_TYPE_ID), e | GRAPH_REF_TYPE };
+        if (o0) v[n++] = (sref){ o0, e | GRAPH_REF_OBS };
+        if (o1) v[n++] = (sref){ o1, e | GRAPH_REF_OBS };
+    }
+    return rb_build(mf, refs_root(g), v, n);
+}
+
+u32 graph_string_refs(graph_t *g, u32 sid, u64 *out, u32 max) {
+    return rdu64(g->mf, refs_root(g)) ? rb_read(g->mf, refs_root(g), sid, out, max) : 0;
+}
+
+/* ======================================================================
+ * Full-text index (BM25 over name + observations; textindex.h)
+ *
+ * An entity's document is its folded name and observations, keyed by its
+ * offset >> 5 (records are 32-byte aligned and never move). Built on demand;
+ * once built the entity/observation ops keep it current by unindexing the old
+ * text before a change and indexing the new text after it.
+ * ====================================================================== */
+
+static u64 gaux_root(graph_t *g, u32 slot) {
+    u64 dir = rdu64(g->mf, g->header_offset + GH_AUX_DIR + (u64)(slot / GAUX_DIR_SLOTS) * 8);
+    u64 r = dir ? dir + (u64)(slot % GAUX_DIR_SLOTS) * 8 : 0;
+    return r && rdu64(g->mf, r) ? r : 0;
+}
+/* Offset of a slot's u64 (allocating the directory on first use); 0 on failure. */
+static u64 gaux_slot(graph_t *g, u32 slot) {
+    u64 at = g->header_offset + GH_AUX_DIR + (u64)(slot / GAUX_DIR_SLOTS) * 8;
+    u64 dir = rdu64(g->mf, at);
+    if (!dir) {
+        dir = memfile_alloc(g->mf, GAUX_DIR_SLOTS * 8);
+        if (!dir) return 0;
+        memset(memfile_ptr(g->mf, dir), 0, GAUX_DIR_SLOTS * 8);
+        wru64(g->mf, at, dir);
+    }
+    return dir + (u64)(slot % GAUX_DIR_SLOTS) * 8;
+}
+
+static inline u32 text_doc_id(u64 e) { return (u32)(e >> 5); }
+
+/* malloc'd folded "name obs0 obs1" of an entity; NULL on OOM */
+static u8 *text_doc(graph_t *g, u64 e, u32 *len) {
+    u32 o0 = rdu32(g->mf, e + E_OBS0), o1 = rdu32(g->mf, e + E_OBS1);
+    u16 nl;
+    const u8 *s = graph_entity_name(g, e, &nl);
+    size_t cap = (size_t)nl + 2 + (o0 ? st_len(g->st, o0) : 0) + (o1 ? st_len(g->st, o1) : 0);
+    u8 *buf = malloc(cap);
+    if (!buf) return NULL;
+    u32 n = st_fold_utf8(s, nl, buf);
+    u32 os[2] = { o0, o1 };
+    for (u32 k = 0; k < 2; k++) {
+        if (!os[k]) continue;
+        u16 ol;
+        s = st_get(g->st, os[k], &ol);
+        buf[n++] = ' ';
+        n += st_fold_utf8(s, ol, buf + n);
+    }
+    *len = n;
+    return buf;
+}
+
+static int text_add(graph_t *g, u64 root, u64 e) {
+    u32 len;
+    u8 *doc = text_doc(g, e, &len);
+    if (!doc) return 0;
+    int ok = ti_add(g->mf, root, text_doc_id(e), doc, len);
+    free(doc);
+    return ok;
+}
+
+static void text_remove(graph_t *g, u64 root, u64 e) {
+    u32 len;
+    u8 *doc = text_doc(g, e, &len);
+    if (!doc) return;
+    ti_remove(g->mf, root, text_doc_id(e), doc, len);
+    free(doc);
+}
+
+int graph_has_text_index(graph_t *g) { return gaux_root(g, GAUX_TEXT) != 0; }
+
+int graph_build_text_index(graph_t *g) {
+    if (gaux_root(g, GAUX_TEXT)) return 1;
+    u64 root = gaux_slot(g, GAUX_TEXT);
+    if (!root || !ti_create(g->mf, root)) return 0;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(g->mf, log + 0);
+    for (u32 i = 0; i < count; i++)
+        if (!text_add(g, root, rdu64(g->mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8))) {
+            ti_destroy(g->mf, root);
+            return 0;
+        }
+    return 1;
+}
+
+u32 graph_text_search(graph_t *g, const u8 *query, u32 len, u32 k, u64 *out, double *scores) {
+    u64 root = gaux_root(g, GAUX_TEXT);
+    if (!root || !k) return 0;
+    u8 *q = malloc((size_t)len + 1);
+    u32 *docs = malloc((size_t)k * sizeof(u32));
+    u32 n = 0;
+    if (q && docs) {
+        n = ti_search(g->mf, root, q, st_fold_utf8(query, len, q), k, docs, scores);
+        for (u32 i = 0; i < n; i++) out[i] = (u64)docs[i] << 5;
+    }
+    free(q); free(docs);
+    return n;
+}
+
+/* ======================================================================
+ * Fuzzy name index (fuzzy.h)
+ *
+ * Folded names keyed by entity offset >> 5, as in the text index. Built on
+ * open when absent and kept current by create/delete (names never change).
+ * ====================================================================== */
+
+static u8 *fold_name(graph_t *g, u64 e, u32 *len) {
+    u16 nl;
+    const u8 *s = graph_entity_name(g, e, &nl);
+    u8 *buf = malloc((size_t)nl + 1);
+    if (buf) *len = st_fold_utf8(s, nl, buf);
+    return buf;
+}
+
+static void fuzzy_add(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_FUZZY);
+    u32 len;
+    u8 *nm = root ? fold_name(g, e, &len) : NULL;
+    if (nm) fz_index_add(g->mf, root, text_doc_id(e), nm, len);
+    free(nm);
+}
+
+static void fuzzy_remove(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_FUZZY);
+    u32 len;
+    u8 *nm = root ? fold_name(g, e, &len) : NULL;
+    if (nm) fz_index_remove(g->mf, root, text_doc_id(e), nm, len);
+    free(nm);
+}
+
+static int fuzzy_build(graph_t *g) {
+    u64 log = node_log_off(g);
+    u32 count = rdu32(g->mf, log + 0);
+    u64 *pairs = malloc(((size_t)count * FZ_KEYS_MAX + 1) * 8);
+    if (!pairs) return 0;
+    size_t n = 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 e = rdu64(g->mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        u32 len, h, keys[FZ_KEYS_MAX];
+        u8 *nm = fold_name(g, e, &len);
+        u32 k = nm ? fz_keys(nm, len, FZ_MAX_DIST, keys, &h) : 0;
+        if (!k) { free(nm); free(pairs); return 0; }
+        for (u32 j = 0; j < k; j++) pairs[n++] = (u64)keys[j] << 32 | text_doc_id(e);
+        free(nm);
+    }
+    u64 root = gaux_slot(g, GAUX_FUZZY);
+    int ok = root && fz_index_build(g->mf, root, pairs, n);
+    if (!ok && root && rdu64(g->mf, root)) fz_index_destroy(g->mf, root);
+    free(pairs);
+    return ok;
+}
+
+u32 graph_fuzzy_lookup(graph_t *g, const u8 *name, u16 len, u32 maxd, u32 k, u64 *out, u32 *dist) {
+    u64 root = gaux_root(g, GAUX_FUZZY);
+    if (!root || !k) return 0;
+    if (maxd > GRAPH_FUZZY_MAX_DIST) maxd = GRAPH_FUZZY_MAX_DIST;
+    u8 *q = malloc((size_t)len + 1);
+    if (!q) return 0;
+    u32 ql = st_fold_utf8(name, len, q), *ids, n = 0;
+    u32 nc = fz_candidates(g->mf, root, q, ql, maxd, &ids);
+    for (u32 i = 0; i < nc; i++) {
+        u64 e = (u64)ids[i] << 5;
+        u32 nl;
+        u8 *nm = fold_name(g, e, &nl);
+        if (!nm) break;
+        u32 d = fz_distance(q, ql, nm, nl, maxd);
+        free(nm);
+        if (d > maxd || (n == k && d >= dist[n - 1])) continue;
+        u32 j = n < k ? n++ : n - 1;                 /* ids ascend, so equal distances keep offset order */
+        while (j > 0 && dist[j - 1] > d) { out[j] = out[j - 1]; dist[j] = dist[j - 1]; j--; }
+        out[j] = e; dist[j] = d;
+    }
+    free(ids); free(q);
+    return n;
+}
+
+/* ======================================================================
+ * Name order (btree.h)
+ *
+ * Every live entity, sorted by its case-folded name byte-wise (code-point
+ * order), then its raw name, then its offset. The tree key packs the first 8
+ * folded bytes big-endian, so most comparisons never leave the node; ties are
+ * settled by name_cmp through the entity offset. Built on open when absent and
+ * kept current by create/delete, like the fuzzy index.
+ * ====================================================================== */
+
+typedef struct { u8 small[256]; u8 *p; u32 len; } folded_t;
+
+static void fold_of(graph_t *g, u64 e, folded_t *f) {
+    u16 nl;
+    const u8 *s = graph_entity_name(g, e, &nl);
+    f->p = nl <= sizeof f->small ? f->small : malloc(nl);
+    f->len = f->p ? st_fold_utf8(s, nl, f->p) : 0;
+}
+static void fold_done(folded_t *f) { if (f->p != f->small) free(f->p); }
+
+static u64 name_key(const u8 *f, u32 len) {
+    u64 k = 0;
+    for (u32 i = 0; i < 8; i++) k = k << 8 | (i < len ? f[i] : 0);
+    return k;
+}
+
+static int bytes_cmp(const u8 *a, u32 al, const u8 *b, u32 bl) {
+    int c = memcmp(a, b, al < bl ? al : bl);
+    return c ? c : (al > bl) - (al < bl);
+}
+
+static int name_cmp(void *ctx, u64 a, u64 b) {
+    graph_t *g = ctx;
+    if (a == b) return 0;
+    folded_t fa, fb;
+    fold_of(g, a, &fa); fold_of(g, b, &fb);
+    int c = bytes_cmp(fa.p, fa.len, fb.p, fb.len);
+    fold_done(&fa); fold_done(&fb);
+    if (c) return c;
+    u16 al, bl;
+    const u8 *ra = graph_entity_name(g, a, &al), *rb = graph_entity_name(g, b, &bl);
+    c = bytes_cmp(ra, al, rb, bl);
+    return c ? c : (a > b) - (a < b);
+}
+
+static btree_t name_tree(graph_t *g, u64 root) { return (btree_t){ g->mf, root, name_cmp, g }; }
+
+static void names_add(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    if (!root) return;
+    folded_t f;
+    fold_of(g, e, &f);
+    btree_t t = name_tree(g, root);
+    bt_insert(&t, name_key(f.p, f.len), e);
+    fold_done(&f);
+}
+
+static void names_remove(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    if (!root) return;
+    folded_t f;
+    fold_of(g, e, &f);
+    btree_t t = name_tree(g, root);
+    bt_delete(&t, name_key(f.p, f.len), e);
+    fold_done(&f);
+}
+
+/* bulk-build input: the folded and raw names, read once. Both are copies (one
+ * buffer, raw after folded): st_get's decode ring cannot hold n names. */
+typedef struct { u64 k, e; u8 *f; u32 fl; const u8 *raw; u16 rl; } name_item;
+
+static int cmp_name_item(const void *pa, const void *pb) {
+    const name_item *a = pa, *b = pb;
+    if (a->k != b->k) return a->k < b->k ? -1 : 1;
+    int c = bytes_cmp(a->f, a->fl, b->f, b->fl);
+    if (!c) c = bytes_cmp(a->raw, a->rl, b->raw, b->rl);
+    return c ? c : (a->e > b->e) - (a->e < b->e);
+}
+
+/* sort e[0..n) into name order in place, with their tree keys in k (may be NULL) */
+static int name_sort(graph_t *g, u64 *e, u64 *k, u32 n) {
+    name_item *it = calloc((size_t)n + 1, sizeof *it);
+    u32 i = 0;
+    int ok = it != NULL;
+    for (; ok && i < n; i++) {
+        it[i].e = e[i];
+        const u8 *raw = graph_entity_name(g, e[i], &it[i].rl);
+        if (!(it[i].f = malloc((size_t)it[i].rl * 2 + 1))) { ok = 0; break; }
+        it[i].raw = memcpy(it[i].f + it[i].rl, raw, it[i].rl);
+        it[i].fl = st_fold_utf8(raw, it[i].rl, it[i].f);
+        it[i].k = name_key(it[i].f, it[i].fl);
+    }
+    if (ok) {
+        qsort(it, n, sizeof *it, cmp_name_item);
+        for (u32 j = 0; j < n; j++) { e[j] = it[j].e; if (k) k[j] = it[j].k; }
+    }
+    for (u32 j = 0; it && j < i; j++) free(it[j].f);
+    free(it);
+    return ok;
+}
+
+static int names_build(graph_t *g) {
+    u64 log = node_log_off(g);
+    u32 count = rdu32(g->mf, log + 0);
+    u64 *k = malloc(((size_t)count + 1) * 8), *v = malloc(((size_t)count + 1) * 8);
+    int ok = k && v;
+    for (u32 i = 0; ok && i < count; i++) v[i] = rdu64(g->mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+    ok = ok && name_sort(g, v, k, count);
+    u64 root = ok ? gaux_slot(g, GAUX_NAMES) : 0;
+    if (root) {
+        btree_t t = name_tree(g, root);
+        ok = bt_build(&t, k, v, count);
+    }
+    free(k); free(v);
+    return ok && root;
+}
+
+int graph_has_name_index(graph_t *g) { return gaux_root(g, GAUX_NAMES) != 0; }
+
+/* Probe for bt_lower over the name order: the first entity whose folded name is
+ * >= the folded probe (lower), or the first past every name it prefixes (upper). */
+typedef struct { graph_t *g; const u8 *p; u32 len; u64 k; int upper; } name_probe;
+
+static int probe_name(void *ctx, u64 k, u64 v) {
+    name_probe *q = ctx;
+    u32 m = q->len < 8 ? q->len : 8;
+    u64 mask = m ? ~0ull << (64 - 8 * m) : 0;
+    if ((q->k & mask) != (k & mask)) return (q->k & mask) < (k & mask) ? -1 : 1;
+    folded_t f;
+    fold_of(q->g, v, &f);
+    u32 n = q->len < f.len ? q->len : f.len;
+    int c = memcmp(q->p, f.p, n);
+    fold_done(&f);
+    if (c) return c;
+    if (q->upper) return 1;                        /* a name the probe prefixes, or a prefix of it */
+    return q->len > f.len ? 1 : q->len < f.len ? -1 : 0;
+}
+
+static u32 name_lower(graph_t *g, u64 root, const u8 *name, u16 len, int upper) {
+    u8 *f = malloc((size_t)len + 1);
+    if (!f) return 0;
+    name_probe q = { g, f, st_fold_utf8(name, len, f), 0, upper };
+    q.k = name_key(f, q.len);
+    btree_t t = name_tree(g, root);
+    u32 r = (u32)bt_lower(&t, probe_name, &q);
+    free(f);
+    return r;
+}
+
+u32 graph_name_rank(graph_t *g, const u8 *name, u16 len) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    return root ? name_lower(g, root, name, len, 0) : 0;
+}
+
+u32 graph_name_prefix(graph_t *g, const u8 *prefix, u16 len, u32 *first) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    *first = 0;
+    if (!root) return 0;
+    *first = name_lower(g, root, prefix, len, 0);
+    return name_lower(g, root, prefix, len, 1) - *first;
+}
+
+u32 graph_names_at(graph_t *g, u32 pos, u32 max, int desc, u64 *out) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    if (!root) return 0;
+    btree_t t = name_tree(g, root);
+    bt_iter it;
+    u32 n = 0;
+    if (!bt_at(&t, pos, &it)) return 0;
+    while (n < max && bt_get(&t, &it, NULL, &out[n])) {
+        n++;
+        if (desc) bt_prev(&t, &it); else bt_next(&t, &it);
+    }
+    return n;
+}
+
+/* ======================================================================
+ * Recency order (btree.h)
+ *
+ * Entities by mtime and by obsMtime (k = the timestamp, v = the entity), and
+ * relations by mtime (v = the ends' doc ids, from high). Every timestamp write
+ * goes through set_mtime, and the adjacency primitives keep the relation tree
+ * from the forward entries. A relation entry is an (instant, from, to) triple:
+ * relation types linking one pair at one instant share it, and are read back
+ * from the source's adjacency. Built on open when absent.
+ * ====================================================================== */
+
+static btree_t recent_tree(graph_t *g, u64 root) { return (btree_t){ g->mf, root, NULL, NULL }; }
+
+static void recent_put(graph_t *g, u32 slot, u64 k, u64 v, int add) {
+    u64 root = gaux_root(g, slot);
+    if (!root) return;
+    btree_t t = recent_tree(g, root);
+    if (add) bt_insert(&t, k, v); else bt_delete(&t, k, v);
+}
+
+/* write an entity timestamp (E_MTIME or E_OBSM), moving it in its order */
+static void set_mtime(graph_t *g, u64 e, u32 field, u64 m) {
+    u32 slot = field == E_MTIME ? GAUX_MTIME : GAUX_OBS_MTIME;
+    u64 old = rdu64(g->mf, e + field);
+    if (old == m) return;
+    recent_put(g, slot, old, e, 0);
+    recent_put(g, slot, m, e, 1);
+    wru64(g->mf, e + field, m);
+}
+
+static void recent_add(graph_t *g, u64 e, int add) {
+    recent_put(g, GAUX_MTIME, rdu64(g->mf, e + E_MTIME), e, add);
+    recent_put(g, GAUX_OBS_MTIME, rdu64(g->mf, e + E_OBSM), e, add);
+}
+
+static inline u64 rel_pair(u64 from, u64 to) { return (u64)text_doc_id(from) << 32 | text_doc_id(to); }
+
+/* forward entries from -> to at instant m still in from's adjacency */
+static u32 rel_at(graph_t *g, u64 from, u64 to, u64 m, u32 *rtids, u32 max) {
+    memfile_t *mf = g->mf;
+    u64 adj = rdu64(mf, from + E_ADJ);
+    u32 ec = adj ? rdu32(mf, adj + 0) : 0, n = 0;
+    u64 packed = (to << 2) | DIR_FORWARD;
+    for (u32 j = 0; j < ec; j++) {
+        u64 base = adj + ADJ_HEADER_SIZE + (u64)j * ADJ_ENTRY_SIZE;
+        if (rdu64(mf, base + AE_TARGET_DIR) != packed || rdu64(mf, base + AE_MTIME) != m) continue;
+        if (n < max) rtids[n] = rdu32(mf, base + AE_RELTYPE);
+        n++;
+    }
+    return n;
+}
+
+/* a forward entry went away: drop its triple unless another type still shares it */
+static void rel_recent_remove(graph_t *g, u64 from, u64 to, u64 m) {
+    if (!gaux_root(g, GAUX_REL_MTIME) || rel_at(g, from, to, m, NULL, 0)) return;
+    recent_put(g, GAUX_REL_MTIME, m, rel_pair(from, to), 0);
+}
+
+typedef struct { u64 k, v; } kv_item;
+
+static int cmp_kv(const void *pa, const void *pb) {
+    const kv_item *a = pa, *b = pb;
+    if (a->k != b->k) return a->k < b->k ? -1 : 1;
+    return (a->v > b->v) - (a->v < b->v);
+}
+
+/* sort, drop repeats and bulk-load n items into slot */
+static int recent_load(graph_t *g, u32 slot, kv_item *it, u32 n) {
+    qsort(it, n, sizeof *it, cmp_kv);
+    u64 *k = malloc(((size_t)n + 1) * 8), *v = malloc(((size_t)n + 1) * 8);
+    u32 m = 0;
+    for (u32 i = 0; k && v && i < n; i++)
+        if (!m || it[i].k != k[m - 1] || it[i].v != v[m - 1]) { k[m] = it[i].k; v[m] = it[i].v; m++; }
+    u64 root = k && v ? gaux_slot(g, slot) : 0;
+    btree_t t = recent_tree(g, root);
+    int ok = root && bt_build(&t, k, v, m);
+    free(k); free(v);
+    return ok;
+}
+
+static int recent_build(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0), nr = 0;
+    u64 edges = 0;
+    for (u32 i = 0; i < count; i++) edges += graph_edge_count(g, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8));
+    kv_item *it = malloc(((size_t)count + 1) * sizeof *it), *rel = malloc(((size_t)edges + 1) * sizeof *rel);
+    int ok = it && rel;
+    for (u32 f = 0; ok && f < 2; f++) {
+        for (u32 i = 0; i < count; i++) {
+            u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+            it[i] = (kv_item){ rdu64(mf, e + (f ? E_OBSM : E_MTIME)), e };
+        }
+        ok = recent_load(g, f ? GAUX_OBS_MTIME : GAUX_MTIME, it, count);
+    }
+    for (u32 i = 0; ok && i < count; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8), adj = rdu64(mf, e + E_ADJ);
+        u32 ec = adj ? rdu32(mf, adj + 0) : 0;
+        for (u32 j = 0; j < ec; j++) {
+            u64 base = adj + ADJ_HEADER_SIZE + (u64)j * ADJ_ENTRY_SIZE, packed = rdu64(mf, base + AE_TARGET_DIR);
+            if ((packed & 3u) == DIR_FORWARD) rel[nr++] = (kv_item){ rdu64(mf, base + AE_MTIME), rel_pair(e, packed >> 2) };
+        }
+    }
+    if (ok) ok = recent_load(g, GAUX_REL_MTIME, rel, nr);
+    free(it); free(rel);
+    return ok;
+}
+
+static int probe_since(void *ctx, u64 k, u64 v) { (void)v; return *(const u64 *)ctx <= k ? -1 : 1; }
+
+/* iterator at position pos among the entries with k >= since (from the newest
+ * unless asc); *total is their count */
+static int recent_seek(const btree_t *t, u64 since, u32 pos, int asc, bt_iter *it, u32 *total) {
+    u64 lo = bt_lower(t, probe_since, &since), cnt = bt_count(t);
+    *total = (u32)(cnt - lo);
+    return pos < *total && bt_at(t, asc ? lo + pos : cnt - 1 - pos, it);
+}
+
+u32 graph_changed_since(graph_t *g, u32 key, u64 since, u32 pos, u32 max, u64 *out, u32 *total) {
+    u64 root = gaux_root(g, (key & GRAPH_RANK_KEY) == GRAPH_RANK_OBS_MTIME ? GAUX_OBS_MTIME : GAUX_MTIME);
+    int asc = (key & GRAPH_RANK_ASC) != 0;
+    *total = 0;
+    if (!root) return 0;
+    btree_t t = recent_tree(g, root);
+    bt_iter it;
+    u32 n = 0;
+    if (!recent_seek(&t, since, pos, asc, &it, total)) return 0;
+    while (n < max && pos + n < *total && bt_get(&t, &it, NULL, &out[n])) {
+        n++;
+        if (asc) bt_next(&t, &it); else bt_prev(&t, &it);
+    }
+    return n;
+}
+
+u32 graph_relations_since(graph_t *g, u64 since, int asc, u32 pos, u32 max,
+                          graph_rel_t *out, u32 *entry, u32 *total) {
+    u64 root = gaux_root(g, GAUX_REL_MTIME);
+    *total = 0;
+    if (!root || !max) return 0;
+    btree_t t = recent_tree(g, root);
+    bt_iter it;
+    u32 n = 0, *rt = malloc((size_t)max * 4);
+    if (!rt) return 0;
+    if (!recent_seek(&t, since, pos, asc, &it, total)) { free(rt); return 0; }
+    for (u32 r = pos; r < *total; r++) {
+        u64 m, v;
+        if (!bt_get(&t, &it, &m, &v)) break;
+        u64 from = (v >> 32) << 5, to = (v & 0xffffffffu) << 5;
+        u32 c = rel_at(g, from, to, m, rt, max);
+        if (n && n + c > max) break;               /* an entry's types stay on one page */
+        if (c > max) c = max;
+        for (u32 j = 0; j < c; j++, n++) {
+            out[n] = (graph_rel_t){ from, to, m, rt[j], 0 };
+            if (entry) entry[n] = r;
+        }
+        if (n >= max) break;
+        if (asc) bt_next(&t, &it); else bt_prev(&t, &it);
+    }
+    free(rt);
+    return n;
+}
+
+/* ======================================================================
+ * Near-duplicate sketches (minhash.h)
+ *
+ * One MinHash sketch per entity over its text-index document (folded name and
+ * observations), keyed by offset >> 5. Built on open when absent; create and
+ * delete post and drop it, the observation ops re-sketch.
+ * ====================================================================== */
+
+static int dup_sketch(graph_t *g, u64 e, u32 *sig) {
+    u32 len;
+    u8 *doc = text_doc(g, e, &len);
+    if (!doc) return 0;
+    mh_sketch(doc, len, sig);
+    free(doc);
+    return 1;
+}
+
+static void dups_add(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_DUPS);
+    u32 sig[MH_HASHES];
+    if (root && dup_sketch(g, e, sig)) mh_add(g->mf, root, text_doc_id(e), sig);
+}
+
+static void dups_remove(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_DUPS);
+    if (root) mh_remove(g->mf, root, text_doc_id(e));
+}
+
+static int dups_build(graph_t *g) {
+    u64 log = node_log_off(g);
+    u32 count = rdu32(g->mf, log + 0);
+    u32 *ids = malloc(((size_t)count + 1) * 4), *sigs = malloc(((size_t)count + 1) * MH_HASHES * 4);
+    int ok = ids && sigs;
+    for (u32 i = 0; i < count && ok; i++) {
+        u64 e = rdu64(g->mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        ids[i] = text_doc_id(e);
+        ok = dup_sketch(g, e, sigs + (size_t)i * MH_HASHES);
+    }
+    u64 root = ok ? gaux_slot(g, GAUX_DUPS) : 0;
+    ok = root && mh_build(g->mf, root, ids, sigs, count);
+    free(ids); free(sigs);
+    return ok;
+}
+
+u32 graph_near_duplicates(graph_t *g, const u8 *text, u32 len, double min_sim, u32 k, u64 *out, double *sim) {
+    u64 root = gaux_root(g, GAUX_DUPS);
+    if (!root || !k) return 0;
+    u8 *q = malloc((size_t)len + 1);
+    if (!q) return 0;
+    u32 sig[MH_HASHES], other[MH_HASHES], *ids, n = 0;
+    mh_sketch(q, st_fold_utf8(text, len, q), sig);
+    free(q);
+    u32 nc = mh_candidates(g->mf, root, sig, &ids);
+    for (u32 i = 0; i < nc; i++) {
+        if (!mh_get(g->mf, root, ids[i], other)) continue;
+        double s = mh_similarity(sig, other);
+        if (s < min_sim || (n == k && s <= sim[n - 1])) continue;
+        u32 j = n < k ? n++ : n - 1;                 /* ids ascend, so equal similarities keep offset order */
+        while (j > 0 && sim[j - 1] < s) { out[j] = out[j - 1]; sim[j] = sim[j - 1]; j--; }
+        out[j] = (u64)ids[i] << 5; sim[j] = s;
+    }
+    free(ids);
+    return n;
+}
+
+u32 graph_duplicate_clusters(graph_t *g, double min_sim, u64 *out, u32 *cluster, u32 max) {
+    u64 root = gaux_root(g, GAUX_DUPS);
+    u32 *ids, *cl;
+    u32 n = root ? mh_clusters(g->mf, root, min_sim, &ids, &cl) : 0;
+    for (u32 i = 0; i < n && i < max; i++) { out[i] = (u64)ids[i] << 5; cluster[i] = cl[i]; }
+    if (n) { free(ids); free(cl); }
+    return n;
+}
+
+/* ======================================================================
+ * Entity-type index (type id -> entities)
+ *
+ * A ref block per type string, holding the offsets of its entities ascending:
+ * a type's entities cost O(matches), its count is the block's, and the types
+ * are the pmap's keys. Built on open when absent; create and delete keep it.
+ * ====================================================================== */
+
+static void types_add(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_TYPES);
+    if (root) rb_insert(g->mf, root, rdu32(g->mf, e + E_TYPE_ID), e);
+}
+
+static void types_remove(graph_t *g, u64 e) {
+    u64 root = gaux_root(g, GAUX_TYPES);
+    if (root) rb_erase(g->mf, root, rdu32(g->mf, e + E_TYPE_ID), e);
+}
+
+static int types_build(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0);
+    sref *v = malloc(((size_t)count + 1) * sizeof(sref));
+    u64 root = v ? gaux_slot(g, GAUX_TYPES) : 0;
+    if (!root) { free(v); return 0; }
+    for (u32 i = 0; i < count; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        v[i] = (sref){ rdu32(mf, e + E_TYPE_ID), e };
+    }
+    return rb_build(mf, root, v, count);
+}
+
+typedef struct { u32 id, n; } type_count;
+static int cmp_type_count(const void *a, const void *b) {
+    u32 x = ((const type_count *)a)->id, y = ((const type_count *)b)->id;
+    return (x > y) - (x < y);
+}
+
+/* ======================================================================
+ * Relation-type catalog (relType id -> live adjacency entries)
+ *
+ * Kept by graph_add_edge / graph_remove_edge and the bulk drop of a deleted
+ * entity's block. Every relation is one forward plus one backward entry, so
+ * a type's relations are its entries / 2; key 0 (never a string id) holds the
+ * total, which makes the relation count O(1). Built on open when absent.
+ * ====================================================================== */
+
+/* one entry of type rtid added (up) or removed */
+static void reltypes_bump(graph_t *g, u32 rtid, int up) {
+    u64 root = gaux_root(g, GAUX_RELTYPES);
+    if (!root) return;
+    const u32 keys[2] = { 0, rtid };
+    for (int i = 0; i < 2; i++) {
+        u64 n = pmap_get(g->mf, root, keys[i]);
+        if (up) pmap_put(g->mf, root, keys[i], n + 1);
+        else if (n > 1) pmap_put(g->mf, root, keys[i], n - 1);
+        else pmap_del(g->mf, root, keys[i]);
+    }
+}
+
+static int reltypes_build(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0);
+    u64 root = gaux_slot(g, GAUX_RELTYPES);
+    if (!root || !pmap_create(mf, root, PMAP_INITIAL_BUCKETS)) return 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 adj = rdu64(mf, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8) + E_ADJ);
+        u32 ec = adj ? rdu32(mf, adj + 0) : 0;
+        for (u32 j = 0; j < ec; j++)
+            reltypes_bump(g, rdu32(mf, adj + ADJ_HEADER_SIZE + (u64)j * ADJ_ENTRY_SIZE + AE_RELTYPE), 1);
+    }
+    return 1;
+}
+
+/* ======================================================================
+ * Zero-degree set and connected components
+ *
+ * Two pmaps behind the GAUX_CONNECT block. The orphan set maps each entity
+ * without adjacency entries (offset >> 5) to its offset; the adjacency
+ * primitives move an entity out with its first entry and back with its last.
+ * Built on open when absent.
+ *
+ * Components (edges undirected) are a union-find forest: a node's value is its
+ * parent's offset | its rank (offsets are 32-aligned), and a node without one
+ * is a root of rank 0. New relations union their ends, compressing paths on
+ * that write path only, so lookups never write. Removing an edge may split a
+ * component, which the forest cannot undo: it is dropped, and whoever next
+ * wants labels rebuilds it (graph_build_components).
+ * ====================================================================== */
+
+#define CONN_ORPHANS 0u
+#define CONN_FOREST  1u
+#define UF_RANK      31u   /* low bits of a forest value */
+
+/* offset of one of the block's roots if that map exists, else 0 */
+static u64 conn_root(graph_t *g, u32 which) {
+    u64 slot = gaux_root(g, GAUX_CONNECT);
+    u64 r = slot ? rdu64(g->mf, slot) + (u64)which * 8 : 0;
+    return r && rdu64(g->mf, r) ? r : 0;
+}
+/* the same, allocating the block on first use (the map itself may be empty) */
+static u64 conn_slot(graph_t *g, u32 which) {
+    u64 slot = gaux_slot(g, GAUX_CONNECT);
+    if (!slot) return 0;
+    if (!rdu64(g->mf, slot)) {
+        u64 b = memfile_alloc(g->mf, 16);
+        if (!b) return 0;
+        memset(memfile_ptr(g->mf, b), 0, 16);
+        wru64(g->mf, slot, b);
+    }
+    return rdu64(g->mf, slot) + (u64)which * 8;
+}
+
+static void orphans_set(graph_t *g, u64 e, int orphan) {
+    u64 root = conn_root(g, CONN_ORPHANS);
+    if (!root) return;
+    if (orphan) pmap_put(g->mf, root, text_doc_id(e), e);
+    else pmap_del(g->mf, root, text_doc_id(e));
+}
+
+static u64 uf_find(memfile_t *mf, u64 root, u64 e) {
+    for (;;) {
+        u64 v = pmap_get(mf, root, text_doc_id(e)), p = v & ~(u64)UF_RANK;
+        if (!v || p == e) return e;
+        e = p;
+    }
+}
+
+/* point every node on e's path straight at its root r */
+static void uf_compress(memfile_t *mf, u64 root, u64 e, u64 r) {
+    while (e != r) {
+        u64 v = pmap_get(mf, root, text_doc_id(e)), p = v & ~(u64)UF_RANK;
+        if (p != r) pmap_put(mf, root, text_doc_id(e), r | (v & UF_RANK));
+        e = p;
+    }
+}
+
+static void comps_union(graph_t *g, u64 a, u64 b) {
+    memfile_t *mf = g->mf;
+    u64 root = conn_root(g, CONN_FOREST);
+    if (!root) return;
+    u64 ra = uf_find(mf, root, a), rb = uf_find(mf, root, b);
+    uf_compress(mf, root, a, ra);
+    uf_compress(mf, root, b, rb);
+    if (ra == rb) return;
+    u32 ka = (u32)(pmap_get(mf, root, text_doc_id(ra)) & UF_RANK);
+    u32 kb = (u32)(pmap_get(mf, root, text_doc_id(rb)) & UF_RANK);
+    if (ka < kb) { u64 t = ra; ra = rb; rb = t; u32 k = ka; ka = kb; kb = k; }
+    pmap_put(mf, root, text_doc_id(rb), ra | kb);
+    if (ka == kb) pmap_put(mf, root, text_doc_id(ra), ra | (ka + 1));
+}
+
+/* an edge went away: labels may be wrong from here until a rebuild */
+static void comps_drop(graph_t *g) {
+    u64 root = conn_root(g, CONN_FOREST);
+    if (root) pmap_destroy(g->mf, root);
+}
+
+/* a deleted entity whose edges are gone: nothing in the forest points at it */
+static void comps_forget(graph_t *g, u64 e) {
+    u64 root = conn_root(g, CONN_FOREST);
+    if (root) pmap_del(g->mf, root, text_doc_id(e));
+}
+
+/* ======================================================================
+ * Entity vectors (hnsw.h)
+ *
+ * An optional vector per entity, keyed by offset >> 5, supplied by the client
+ * (an embedding) rather than derived here — so nothing is built on open and
+ * only delete touches it. Dimension and storage format are fixed when the
+ * index is created.
+ * ====================================================================== */
+
+#define VEC_SCAN_MAX 2048u   /* a type filter matching at most this many is ranked exactly */
+_Static_assert(GRAPH_VEC_F32 == HNSW_F32 && GRAPH_VEC_F16 == HNSW_F16 && GRAPH_VEC_I8 == HNSW_I8, "vector formats");
+
+int graph_vector_index(graph_t *g, u32 dim, u32 format) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    if (root) return hnsw_dim(g->mf, root) == dim && hnsw_format(g->mf, root) == format;
+    root = gaux_slot(g, GAUX_VECTORS);
+    return root && hnsw_create(g->mf, root, dim, format);
+}
+
+int graph_vector_info(graph_t *g, u32 *dim, u32 *format, u32 *count) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    if (!root) return 0;
+    *dim = hnsw_dim(g->mf, root);
+    *format = hnsw_format(g->mf, root);
+    *count = hnsw_count(g->mf, root);
+    return 1;
+}
+
+int graph_set_vector(graph_t *g, u64 off, const float *v, u32 dim) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    return root && hnsw_dim(g->mf, root) == dim && hnsw_put(g->mf, root, text_doc_id(off), v);
+}
+
+int graph_clear_vector(graph_t *g, u64 off) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    return root && hnsw_remove(g->mf, root, text_doc_id(off));
+}
+
+int graph_get_vector(graph_t *g, u64 off, float *out) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    return root && hnsw_get(g->mf, root, text_doc_id(off), out);
+}
+
+typedef struct { graph_t *g; u32 type_id; } vec_type_t;
+
+static int vec_of_type(void *ctx, u32 id) {
+    vec_type_t *t = ctx;
+    return rdu32(t->g->mf, ((u64)id << 5) + E_TYPE_ID) == t->type_id;
+}
+
+u32 graph_vector_search(graph_t *g, const float *q, u32 dim, const u8 *type, u16 type_len,
+                        u32 k, u64 *out, double *sim) {
+    u64 root = gaux_root(g, GAUX_VECTORS);
+    if (!root || !k || hnsw_dim(g->mf, root) != dim) return 0;
+    u32 *ids = malloc((size_t)k * 4), n = 0;
+    if (!ids) return 0;
+    if (!type) {
+        n = hnsw_search(g->mf, root, q, k, 0, NULL, NULL, ids, sim);
+    } else {
+        /* a rare type is ranked exactly from its entities; a common one filters the walk */
+        vec_type_t t = { g, (u32)st_find(g->st, type, type_len) };
+        u32 nr = t.type_id ? graph_entities_by_type(g, type, type_len, NULL, 0) : 0;
+        if (nr > VEC_SCAN_MAX) {
+            n = hnsw_search(g->mf, root, q, k, 0, vec_of_type, &t, ids, sim);
+        } else if (nr) {
+            u64 *ents = malloc((size_t)nr * 8);
+            u32 *cand = malloc((size_t)nr * 4);
+            if (ents && cand) {
+                nr = graph_entities_by_type(g, type, type_len, ents, nr);
+                for (u32 i = 0; i < nr; i++) cand[i] = text_doc_id(ents[i]);
+                n = hnsw_rank(g->mf, root, q, cand, nr, k, ids, sim);
+            }
+            free(ents); free(cand);
+        }
+    }
+    for (u32 i = 0; i < n; i++) out[i] = (u64)ids[i] << 5;
+    free(ids);
+    return n;
+}
+
 /* ======================================================================
  * Adjacency
  * ====================================================================== */
@@ -243,29 +1262,29 @@ static void write_adj_entry(memfile_t *mf, u64 pos, const adj_entry_t *e) {
     wru64(mf, pos + AE_MTIME, e->mtime);
 }
 
-void graph_add_edge(graph_t *g, u64 ent_off, const adj_entry_t *e) {
+static int adj_append(graph_t *g, u64 ent_off, const adj_entry_t *e) {
     memfile_t *mf = g->mf;
     u64 adj = rdu64(mf, ent_off + E_ADJ);
     if (adj == 0) {
         u64 sz = ADJ_HEADER_SIZE + (u64)INITIAL_ADJ_CAPACITY * ADJ_ENTRY_SIZE;
         u64 noff = memfile_alloc(mf, sz);
-        if (!noff) return;
+        if (!noff) return 0;
         wru32(mf, noff + 0, 1);
         wru32(mf, noff + 4, INITIAL_ADJ_CAPACITY);
         write_adj_entry(mf, noff + ADJ_HEADER_SIZE, e);
         wru64(mf, ent_off + E_ADJ, noff);
-        return;
+        return 1;
     }
     u32 count = rdu32(mf, adj + 0);
     u32 cap = rdu32(mf, adj + 4);
     if (count < cap) {
         write_adj_entry(mf, adj + ADJ_HEADER_SIZE + (u64)count * ADJ_ENTRY_SIZE, e);
         wru32(mf, adj + 0, count + 1);
-        return;
+        return 1;
     }
     u32 newcap = cap * 2;
     u64 nadj = memfile_alloc(mf, ADJ_HEADER_SIZE + (u64)newcap * ADJ_ENTRY_SIZE);
-    if (!nadj) return;
+    if (!nadj) return 0;
     wru32(mf, nadj + 0, count + 1);
     wru32(mf, nadj + 4, newcap);
     if (count) memcpy(memfile_ptr(mf, nadj + ADJ_HEADER_SIZE),
@@ -273,6 +1292,15 @@ void graph_add_edge(graph_t *g, u64 ent_off, const adj_entry_t *e) {
     write_adj_entry(mf, nadj + ADJ_HEADER_SIZE + (u64)count * ADJ_ENTRY_SIZE, e);
     memfile_free(mf, adj, ADJ_HEADER_SIZE + (u64)cap * ADJ_ENTRY_SIZE);
     wru64(mf, ent_off + E_ADJ, nadj);
+    return 1;
+}
+
+void graph_add_edge(graph_t *g, u64 ent_off, const adj_entry_t *e) {
+    u32 before = graph_edge_count(g, ent_off);
+    if (!adj_append(g, ent_off, e)) return;
+    reltypes_bump(g, e->rel_type_id, 1);
+    if (e->direction == DIR_FORWARD) recent_put(g, GAUX_REL_MTIME, e->mtime, rel_pair(ent_off, e->target_offset), 1);
+    if (!before) orphans_set(g, ent_off, 0);
 }
 
 int graph_remove_edge(graph_t *g, u64 ent_off, u64 target_off, u32 rel_type_id, u32 direction) {
@@ -285,10 +1313,15 @@ int graph_remove_edge(graph_t *g, u64 ent_off, u64 target_off, u32 rel_type_id,
         u64 base = adj + ADJ_HEADER_SIZE + (u64)i * ADJ_ENTRY_SIZE;
         if (rdu64(mf, base + AE_TARGET_DIR) == packed && rdu32(mf, base + AE_RELTYPE) == rel_type_id) {
             u32 last = count - 1;
+            u64 m = rdu64(mf, base + AE_MTIME);
             if (i < last)
                 memcpy(memfile_ptr(mf, base),
                        memfile_ptr(mf, adj + ADJ_HEADER_SIZE + (u64)last * ADJ_ENTRY_SIZE), ADJ_ENTRY_SIZE);
             wru32(mf, adj + 0, last);
+            reltypes_bump(g, rel_type_id, 0);
+            if (direction == DIR_FORWARD) rel_recent_remove(g, ent_off, target_off, m);
+            if (!last) orphans_set(g, ent_off, 1);
+            comps_drop(g);
             return 1;
         }
     }
@@ -342,16 +1375,36 @@ u64 graph_create_entity(graph_t *g, const u8 *name, u16 name_len,
     wru32(g->mf, off + E_NAME_ID, (u32)nid);
     wru32(g->mf, off + E_TYPE_ID, (u32)tid);
     wru64(g->mf, off + E_MTIME, mtime);
+    write_inline(g->mf, off + E_NAME_LEN, off + E_NAME_INL, ENTITY_NAME_INLINE, name, name_len);
+    write_inline(g->mf, off + E_TYPE_LEN, off + E_TYPE_INL, ENTITY_TYPE_INLINE, type, type_len);
     /* obs_mtime stays 0 until an observation is added (matches old no-obs => 0). */
 
     log_append(g, off);
     ni_insert(g, (u32)nid, off);
+    ref_add(g, (u32)nid, off, GRAPH_REF_NAME);
+    ref_add(g, (u32)tid, off, GRAPH_REF_TYPE);
+    u64 tx = gaux_root(g, GAUX_TEXT);
+    if (tx) text_add(g, tx, off);
+    fuzzy_add(g, off);
+    names_add(g, off);
+    recent_add(g, off, 1);
+    dups_add(g, off);
+    types_add(g, off);
+    orphans_set(g, off, 1);
     return off;
 }
 
 int graph_delete_entity(graph_t *g, u64 off) {
     entity_t e;
     graph_read_entity(g, off, &e);
+    u64 tx = gaux_root(g, GAUX_TEXT);
+    if (tx) text_remove(g, tx, off);
+    fuzzy_remove(g, off);
+    names_remove(g, off);
+    recent_add(g, off, 0);
+    dups_remove(g, off);
+    types_remove(g, off);
+    graph_clear_vector(g, off);
 
     /* edges: release every relType ref this entity's edges touch, drop mirrors */
     u32 ec = graph_edge_count(g, off);
@@ -361,6 +1414,9 @@ int graph_delete_entity(graph_t *g, u64 off) {
         graph_read_edges(g, off, es, ec);
         for (u32 k = 0; k < ec; k++) {
             st_release(g->st, es[k].rel_type_id);          /* this entity's own entry */
+            reltypes_bump(g, es[k].rel_type_id, 0);
+            if (es[k].direction == DIR_FORWARD)
+                recent_put(g, GAUX_REL_MTIME, es[k].mtime, rel_pair(off, es[k].target_offset), 0);
             if (es[k].target_offset != off) {              /* not a self-loop */
                 u32 rev = (es[k].direction == DIR_FORWARD) ? DIR_BACKWARD : DIR_FORWARD;
                 if (graph_remove_edge(g, es[k].target_offset, off, es[k].rel_type_id, rev))
@@ -371,15 +1427,21 @@ int graph_delete_entity(graph_t *g, u64 off) {
         memfile_free(g->mf, e.adj_offset, ADJ_HEADER_SIZE + (u64)cap * ADJ_ENTRY_SIZE);
     }
 
+    orphans_set(g, off, 0);
+    comps_forget(g, off);
     ni_remove(g, e.name_id);
     log_remove(g, off);
+    ref_remove(g, e.name_id, off, GRAPH_REF_NAME);
+    ref_remove(g, e.type_id, off, GRAPH_REF_TYPE);
+    ref_remove(g, e.obs0_id, off, GRAPH_REF_OBS);
+    ref_remove(g, e.obs1_id, off, GRAPH_REF_OBS);
 
     st_release(g->st, e.name_id);
     st_release(g->st, e.type_id);
     if (e.obs0_id) st_release(g->st, e.obs0_id);
     if (e.obs1_id) st_release(g->st, e.obs1_id);
 
-    memfile_free(g->mf, off, ENTITY_RECORD_SIZE);
+    memfile_free(g->mf, off, record_size(g, off));
     return 1;
 }
 
@@ -391,7 +1453,8 @@ int graph_create_relation(graph_t *g, u64 from, u64 to, const u8 *rt, u16 rt_len
     u64 rtid_b = st_intern(g->st, rt, rt_len);             /* ref for the backward entry */
     adj_entry_t b = { from, DIR_BACKWARD, (u32)rtid_b, mtime };
     graph_add_edge(g, to, &b);
-    wru64(g->mf, from + E_MTIME, mtime);   /* a new relation marks the source entity modified */
+    comps_union(g, from, to);
+    set_mtime(g, from, E_MTIME, mtime);    /* a new relation marks the source entity modified */
     return 1;
 }
 
@@ -416,12 +1479,18 @@ int graph_add_observation(graph_t *g, u64 off, const u8 *obs, u16 len, u64 mtime
     memfile_t *mf = g->mf;
     u8 cnt = rdu8(mf, off + E_OBSCNT);
     if (cnt >= 2) return 0;
-    u64 oid = st_intern(g->st, obs, len);
+    u64 tx = gaux_root(g, GAUX_TEXT);
+    if (tx) text_remove(g, tx, off);
+    dups_remove(g, off);
+    u64 oid = st_intern_packed(g->st, obs, len);
     if (cnt == 0) wru32(mf, off + E_OBS0, (u32)oid);
     else          wru32(mf, off + E_OBS1, (u32)oid);
     wru8(mf, off + E_OBSCNT, (u8)(cnt + 1));
-    wru64(mf, off + E_OBSM, mtime);
-    wru64(mf, off + E_MTIME, mtime);
+    set_mtime(g, off, E_OBSM, mtime);
+    set_mtime(g, off, E_MTIME, mtime);
+    ref_add(g, (u32)oid, off, GRAPH_REF_OBS);
+    if (tx) text_add(g, tx, off);
+    dups_add(g, off);
     return 1;
 }
 
@@ -430,28 +1499,78 @@ int graph_remove_observation(graph_t *g, u64 off, const u8 *obs, u16 len, u64 mt
     u64 oid = st_find(g->st, obs, len);
     if (!oid) return 0;
     u32 o0 = rdu32(mf, off + E_OBS0), o1 = rdu32(mf, off + E_OBS1);
+    if (o0 != (u32)oid && o1 != (u32)oid) return 0;
+    u64 tx = gaux_root(g, GAUX_TEXT);
+    if (tx) text_remove(g, tx, off);
+    dups_remove(g, off);
     if (o0 == (u32)oid) {
         st_release(g->st, o0);
         wru32(mf, off + E_OBS0, o1);
         wru32(mf, off + E_OBS1, 0);
-    } else if (o1 == (u32)oid) {
+    } else {
         st_release(g->st, o1);
         wru32(mf, off + E_OBS1, 0);
-    } else {
-        return 0;
     }
+    ref_remove(g, (u32)oid, off, GRAPH_REF_OBS);   /* obs0/obs1 share a role: the shift keeps the ref */
     wru8(mf, off + E_OBSCNT, (u8)(rdu8(mf, off + E_OBSCNT) - 1));
-    wru64(mf, off + E_OBSM, mtime);
-    wru64(mf, off + E_MTIME, mtime);
+    set_mtime(g, off, E_OBSM, mtime);
+    set_mtime(g, off, E_MTIME, mtime);
+    if (tx) text_add(g, tx, off);
+    dups_add(g, off);
     return 1;
 }
 
+/* Train the strings file's symbol table on the current observations (first call
+ * only) and re-code every observation that shrinks by a quantum. Ids do not
+ * change, so entity records are untouched. Returns the number packed. */
+u32 graph_compress_observations(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0), n = 0;
+    if (count == 0) return 0;
+    u64 *ids = malloc((size_t)count * 2 * 8);
+    if (!ids) return 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        u32 o0 = rdu32(mf, e + E_OBS0), o1 = rdu32(mf, e + E_OBS1);
+        if (o0) ids[n++] = o0;
+        if (o1) ids[n++] = o1;
+    }
+    if (!st_has_dictionary(g->st)) st_train_dictionary(g->st, ids, n);
+    u32 packed = 0;
+    for (u32 i = 0; i < n; i++) packed += (u32)st_pack(g->st, ids[i]);
+    free(ids);
+    return packed;
+}
+
 /* ======================================================================
  * Scans / enumeration
  * ====================================================================== */
 
+const u8 *graph_entity_name_inline(graph_t *g, u64 off, u16 *len_out) {
+    if (rdu32(g->mf, off + E_VERSION) < 2) return NULL;
+    u8 l = rdu8(g->mf, off + E_NAME_LEN);
+    if (l == ENTITY_INLINE_NONE) return NULL;
+    if (len_out) *len_out = l;
+    return (const u8 *)memfile_ptr(g->mf, off + E_NAME_INL);
+}
+
+const u8 *graph_entity_type_inline(graph_t *g, u64 off, u16 *len_out) {
+    if (rdu32(g->mf, off + E_VERSION) < 2) return NULL;
+    u8 l = rdu8(g->mf, off + E_TYPE_LEN);
+    if (l == ENTITY_INLINE_NONE) return NULL;
+    if (len_out) *len_out = l;
+    return (const u8 *)memfile_ptr(g->mf, off + E_TYPE_INL);
+}
+
 const u8 *graph_entity_name(graph_t *g, u64 off, u16 *len_out) {
-    return st_get(g->st, rdu32(g->mf, off + E_NAME_ID), len_out);
+    const u8 *p = graph_entity_name_inline(g, off, len_out);
+    return p ? p : st_get(g->st, rdu32(g->mf, off + E_NAME_ID), len_out);
+}
+
+const u8 *graph_entity_type(graph_t *g, u64 off, u16 *len_out) {
+    const u8 *p = graph_entity_type_inline(g, off, len_out);
+    return p ? p : st_get(g->st, rdu32(g->mf, off + E_TYPE_ID), len_out);
 }
 
 u32 graph_list_entities(graph_t *g, u64 *out, u32 max) {
@@ -463,32 +1582,134 @@ u32 graph_list_entities(graph_t *g, u64 *out, u32 max) {
     return count;
 }
 
+/* ======================================================================
+ * Partitioned scans
+ *
+ * Full scans split their range (node log, or string slots for search) into
+ * contiguous parts run on the worker pool. Each part collects into its own
+ * buffer and the buffers are read back in part order, so results come out
+ * exactly as one serial pass leaves them. Callers hold the read lock: nothing
+ * a part touches moves or changes.
+ * ====================================================================== */
+
+#define SCAN_GRAIN 4096u   /* fewest items worth a part (and a thread) of their own */
+
+typedef struct { u64 *v; size_t n, cap; } scan_buf;
+
+static int sbuf_grow(scan_buf *b, size_t k) {
+    if (b->n + k <= b->cap) return 1;
+    size_t nc = b->cap ? b->cap * 2 : 64;
+    u64 *t = realloc(b->v, nc * 8);
+    if (!t) return 0;
+    b->v = t; b->cap = nc;
+    return 1;
+}
+static void sbuf_push(scan_buf *b, u64 x) { if (sbuf_grow(b, 1)) b->v[b->n++] = x; }
+static void sbuf_push2(scan_buf *b, u64 x, u64 y) { if (sbuf_grow(b, 2)) { b->v[b->n++] = x; b->v[b->n++] = y; } }
+
+typedef struct scan scan_t;
+struct scan {
+    graph_t  *g;
+    u32       count, nparts;   /* items in the range; 0 parts = sized by scan_run */
+    void    (*part)(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out);
+    void     *arg;
+    scan_buf *bufs;
+};
+
+static u32 scan_nparts(u32 count) {
+    u32 n = count / SCAN_GRAIN, w = pool_workers();
+    return n < 1 ? 1 : n > w ? w : n;
+}
+
+static void scan_part(void *ctx, u32 p) {
+    scan_t *s = ctx;
+    u32 lo = (u32)((u64)s->count * p / s->nparts), hi = (u32)((u64)s->count * (p + 1) / s->nparts);
+    s->part(s, p, lo, hi, &s->bufs[p]);
+}
+
+static int scan_run(scan_t *s) {
+    if (!s->nparts) s->nparts = scan_nparts(s->count);
+    if (!(s->bufs = calloc(s->nparts, sizeof *s->bufs))) return 0;
+    pool_run(s->nparts, scan_part, s);
+    return 1;
+}
+
+static void scan_free(scan_t *s) {
+    if (s->bufs) for (u32 p = 0; p < s->nparts; p++) free(s->bufs[p].v);
+    free(s->bufs);
+}
+
+/* run, then copy out the first `max` hits in part order; returns the total */
+static u32 scan_collect(scan_t *s, u64 *out, u32 max) {
+    u32 found = 0;
+    if (scan_run(s))
+        for (u32 p = 0; p < s->nparts; p++)
+            for (size_t i = 0; i < s->bufs[p].n; i++, found++)
+                if (found < max) out[found] = s->bufs[p].v[i];
+    scan_free(s);
+    return found;
+}
+
+static inline u32 log_count(graph_t *g) { return rdu32(g->mf, node_log_off(g) + 0); }
+
+static void by_type_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    (void)p;
+    memfile_t *mf = s->g->mf;
+    u64 log = node_log_off(s->g);
+    u32 tid = *(const u32 *)s->arg;
+    for (u32 i = lo; i < hi; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        if (rdu32(mf, e + E_TYPE_ID) == tid) sbuf_push(out, e);
+    }
+}
+
 u32 graph_entities_by_type(graph_t *g, const u8 *type, u16 len, u64 *out, u32 max) {
-    memfile_t *mf = g->mf;
     u64 tid = st_find(g->st, type, len);
     if (!tid) return 0;
-    u64 log = node_log_off(g);
-    u32 count = rdu32(mf, log + 0), found = 0;
-    for (u32 i = 0; i < count; i++) {
+    u64 root = gaux_root(g, GAUX_TYPES);
+    if (root) return rb_read(g->mf, root, (u32)tid, out, max);
+    u32 t = (u32)tid;
+    scan_t s = { .g = g, .count = log_count(g), .part = by_type_part, .arg = &t };
+    return scan_collect(&s, out, max);
+}
+
+static void orphaned_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    (void)p;
+    memfile_t *mf = s->g->mf;
+    u64 log = node_log_off(s->g);
+    for (u32 i = lo; i < hi; i++) {
         u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
-        if (rdu32(mf, e + E_TYPE_ID) == (u32)tid) { if (found < max) out[found] = e; found++; }
+        if (graph_edge_count(s->g, e) == 0) sbuf_push(out, e);
     }
-    return found;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    u64 x = *(const u64 *)a, y = *(const u64 *)b;
+    return (x > y) - (x < y);
 }
 
 u32 graph_orphaned(graph_t *g, u64 *out, u32 max) {
     memfile_t *mf = g->mf;
-    u64 log = node_log_off(g);
-    u32 count = rdu32(mf, log + 0), found = 0;
-    for (u32 i = 0; i < count; i++) {
-        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
-        if (graph_edge_count(g, e) == 0) { if (found < max) out[found] = e; found++; }
+    u64 root = conn_root(g, CONN_ORPHANS);
+    if (!root) {
+        scan_t s = { .g = g, .count = log_count(g), .part = orphaned_part };
+        return scan_collect(&s, out, max);
     }
-    return found;
+    u32 n = pmap_count(mf, root), cap = pmap_capacity(mf, root), k = 0;
+    if (!max || !n) return n;
+    u64 *v = malloc((size_t)n * 8);
+    if (!v) return 0;
+    for (u32 i = 0; i < cap && k < n; i++) if (pmap_at(mf, root, i, NULL, &v[k])) k++;
+    qsort(v, k, 8, cmp_u64);
+    memcpy(out, v, (size_t)(k < max ? k : max) * 8);
+    free(v);
+    return k;
 }
 
 u32 graph_relation_count(graph_t *g) {
     memfile_t *mf = g->mf;
+    u64 root = gaux_root(g, GAUX_RELTYPES);
+    if (root) return (u32)(pmap_get(mf, root, 0) / 2);
     u64 log = node_log_off(g);
     u32 count = rdu32(mf, log + 0);
     u64 edges = 0;
@@ -502,87 +1723,317 @@ static int cmp_u32(const void *a, const void *b) {
     return (x > y) - (x < y);
 }
 
+u32 graph_entity_type_counts(graph_t *g, u32 *ids, u32 *counts, u32 max) {
+    memfile_t *mf = g->mf;
+    u64 root = gaux_root(g, GAUX_TYPES);
+    type_count *tc;
+    u32 distinct = 0;
+    if (root) {
+        u32 cap = pmap_capacity(mf, root);
+        if (!(tc = malloc(((size_t)pmap_count(mf, root) + 1) * sizeof *tc))) return 0;
+        for (u32 i = 0; i < cap; i++) {
+            u32 k; u64 b;
+            if (pmap_at(mf, root, i, &k, &b)) tc[distinct++] = (type_count){ k, rdu32(mf, b + 0) };
+        }
+    } else {
+        u64 log = node_log_off(g);
+        u32 count = rdu32(mf, log + 0);
+        u32 *tmp = malloc(((size_t)count + 1) * sizeof(u32));
+        if (!tmp || !(tc = malloc(((size_t)count + 1) * sizeof *tc))) { free(tmp); return 0; }
+        for (u32 i = 0; i < count; i++)
+            tmp[i] = rdu32(mf, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8) + E_TYPE_ID);
+        if (count) qsort(tmp, count, sizeof(u32), cmp_u32);
+        for (u32 i = 0; i < count; i++) {
+            if (i == 0 || tmp[i] != tmp[i - 1]) tc[distinct++] = (type_count){ tmp[i], 0 };
+            tc[distinct - 1].n++;
+        }
+        free(tmp);
+    }
+    if (distinct) qsort(tc, distinct, sizeof *tc, cmp_type_count);
+    for (u32 i = 0; i < distinct && i < max; i++) { ids[i] = tc[i].id; if (counts) counts[i] = tc[i].n; }
+    free(tc);
+    return distinct;
+}
+
 u32 graph_entity_types(graph_t *g, u32 *out, u32 max) {
+    return graph_entity_type_counts(g, out, NULL, max);
+}
+
+u32 graph_relation_type_counts(graph_t *g, u32 *ids, u32 *counts, u32 max) {
     memfile_t *mf = g->mf;
-    u64 log = node_log_off(g);
-    u32 count = rdu32(mf, log + 0);
-    if (count == 0) return 0;
-    u32 *tmp = malloc((size_t)count * sizeof(u32));
-    for (u32 i = 0; i < count; i++)
-        tmp[i] = rdu32(mf, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8) + E_TYPE_ID);
-    qsort(tmp, count, sizeof(u32), cmp_u32);
+    u64 root = gaux_root(g, GAUX_RELTYPES);
+    type_count *tc;
     u32 distinct = 0;
-    for (u32 i = 0; i < count; i++)
-        if (i == 0 || tmp[i] != tmp[i - 1]) { if (distinct < max) out[distinct] = tmp[i]; distinct++; }
-    free(tmp);
+    if (root) {
+        u32 cap = pmap_capacity(mf, root);
+        if (!(tc = malloc(((size_t)pmap_count(mf, root) + 1) * sizeof *tc))) return 0;
+        for (u32 i = 0; i < cap; i++) {
+            u32 k; u64 n;
+            if (pmap_at(mf, root, i, &k, &n) && k) tc[distinct++] = (type_count){ k, (u32)(n / 2) };
+        }
+    } else {
+        u64 log = node_log_off(g);
+        u32 count = rdu32(mf, log + 0);
+        u64 total = 0, k = 0;
+        for (u32 i = 0; i < count; i++)
+            total += graph_edge_count(g, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8));
+        u32 *tmp = malloc(((size_t)total + 1) * sizeof(u32));
+        if (!tmp || !(tc = malloc(((size_t)total + 1) * sizeof *tc))) { free(tmp); return 0; }
+        for (u32 i = 0; i < count; i++) {
+            u64 adj = rdu64(mf, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8) + E_ADJ);
+            u32 ec = adj ? rdu32(mf, adj + 0) : 0;
+            for (u32 j = 0; j < ec; j++)
+                tmp[k++] = rdu32(mf, adj + ADJ_HEADER_SIZE + (u64)j * ADJ_ENTRY_SIZE + AE_RELTYPE);
+        }
+        if (total) qsort(tmp, total, sizeof(u32), cmp_u32);
+        for (u64 i = 0; i < total; i++) {
+            if (i == 0 || tmp[i] != tmp[i - 1]) tc[distinct++] = (type_count){ tmp[i], 0 };
+            tc[distinct - 1].n++;
+        }
+        for (u32 i = 0; i < distinct; i++) tc[i].n /= 2;
+        free(tmp);
+    }
+    if (distinct) qsort(tc, distinct, sizeof *tc, cmp_type_count);
+    for (u32 i = 0; i < distinct && i < max; i++) { ids[i] = tc[i].id; if (counts) counts[i] = tc[i].n; }
+    free(tc);
     return distinct;
 }
 
 u32 graph_relation_types(graph_t *g, u32 *out, u32 max) {
+    return graph_relation_type_counts(g, out, NULL, max);
+}
+
+/* ======================================================================
+ * Search (POSIX ERE over name + type + observations); full result set
+ * ====================================================================== */
+
+/* An ASCII range in brackets keeps its own bytes: folding an endpoint would
+ * change what it spans ([0-Z] -> [0-z]) or invert it ([Z-a] -> [z-a]). Its
+ * upper-case part gains a folded copy instead ([0-Z] -> [0-Za-z]), which is
+ * what REG_ICASE matches. 1 = a range was copied (*i, *o advanced). */
+static int fold_range(const char *pat, size_t n, size_t *i, char *out, size_t *o) {
+    size_t k = *i;
+    if (k + 2 >= n || pat[k + 1] != '-' || pat[k + 2] == ']' || pat[k + 2] == '[') return 0;
+    u8 lo = (u8)pat[k], hi = (u8)pat[k + 2];
+    if (lo >= 0x80 || hi >= 0x80) return 0;
+    memcpy(out + *o, pat + k, 3); *o += 3; *i += 3;
+    u8 a = lo > 'A' ? lo : 'A', z = hi < 'Z' ? hi : 'Z';
+    if (a <= z) { out[(*o)++] = (char)(a + 32); out[(*o)++] = '-'; out[(*o)++] = (char)(z + 32); }
+    return 1;
+}
+
+/* Case-insensitive mode folds the PATTERN with the string table's simple fold and
+ * matches it against folded text, so ICASE costs what an exact search costs.
+ * Escaped bytes pass through untouched (\W must not become \w), as do bracket
+ * class names, except [:upper:]: folded text has no upper case, so it becomes
+ * [:lower:] (same length), which is what REG_ICASE makes of it. ASCII ranges
+ * keep their endpoints (fold_range above). Everything else is folded per code
+ * point. The output can be up to twice the pattern's length. */
+static void fold_pattern(const char *pat, char *out) {
+    size_t n = strlen(pat), i = 0, o = 0;
+    int in_br = 0;
+    while (i < n) {
+        u8 c = (u8)pat[i];
+        if (!in_br && c == '\\' && i + 1 < n) { out[o++] = pat[i++]; out[o++] = pat[i++]; continue; }
+        if (!in_br && c == '[') {
+            out[o++] = pat[i++]; in_br = 1;
+            if (i < n && pat[i] == '^') out[o++] = pat[i++];
+            if (i < n && pat[i] == ']' && !fold_range(pat, n, &i, out, &o)) out[o++] = pat[i++];  /* leading ] is literal */
+            continue;
+        }
+        if (in_br && c == '[' && i + 1 < n && (pat[i + 1] == ':' || pat[i + 1] == '=' || pat[i + 1] == '.')) {
+            char d = pat[i + 1];
+            out[o++] = pat[i++]; out[o++] = pat[i++];
+            if (d == ':' && !strncmp(pat + i, "upper:]", 7)) { memcpy(out + o, "lower", 5); o += 5; i += 5; }
+            while (i < n && !(pat[i] == d && i + 1 < n && pat[i + 1] == ']')) out[o++] = pat[i++];
+            if (i < n) { out[o++] = pat[i++]; out[o++] = pat[i++]; }
+            continue;
+        }
+        if (in_br && c == ']') { out[o++] = pat[i++]; in_br = 0; continue; }
+        if (in_br && fold_range(pat, n, &i, out, &o)) continue;
+        size_t cl = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        if (i + cl > n) cl = n - i;
+        o += st_fold_utf8((const u8 *)pat + i, (u32)cl, (u8 *)out + o);
+        i += cl;
+    }
+    out[o] = 0;
+}
+
+typedef struct {
+    graph_t   *g;
+    rx_t      *re;        /* compiled once, shared through the pattern cache */
+    int        icase;
+    u8        *scratch;   /* fold buffer for strings without a persisted shadow */
+    const u32 *cand;      /* trigram candidates (ascending string ids); NULL = all */
+    u32        ncand;
+    char      *folded;    /* ICASE: the folded pattern */
+} searcher;
+
+static int is_cand(const searcher *sr, u32 id) {
+    if (!sr->cand) return 1;
+    u32 lo = 0, hi = sr->ncand;
+    while (lo < hi) { u32 mid = lo + (hi - lo) / 2; if (sr->cand[mid] < id) lo = mid + 1; else hi = mid; }
+    return lo < sr->ncand && sr->cand[lo] == id;
+}
+
+/* Match one string: `raw` is its bytes (inline or from the table), `id` its
+ * string id (0 = none). In ICASE mode short/inline text is folded on the spot;
+ * longer text uses the persisted shadow when there is one. */
+static int match_text(searcher *sr, u32 id, const u8 *raw, u16 len) {
+    if (!is_cand(sr, id)) return 0;
+    if (!sr->icase) return rx_match(sr->re, raw, len);
+    if (len > ENTITY_NAME_INLINE && id) {
+        u64 fid = st_fold(sr->g->st, id);
+        if (fid) { u16 fl; const u8 *f = st_get(sr->g->st, fid, &fl); return rx_match(sr->re, f, fl); }
+    }
+    u32 fl = st_fold_utf8(raw, len, sr->scratch);
+    return rx_match(sr->re, sr->scratch, (u16)fl);
+}
+static int match_id(searcher *sr, u32 id) {
+    if (!id || !is_cand(sr, id)) return 0;
+    u16 len; const u8 *s = st_get(sr->g->st, id, &len);
+    return match_text(sr, id, s, len);
+}
+
+/* Entity-first: four matches per entity, results in node-log order. Used only
+ * while a file has no reverse index (graph_open builds one). */
+static void search_entities_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    searcher *sr = (searcher *)s->arg + p;
+    graph_t *g = s->g;
     memfile_t *mf = g->mf;
     u64 log = node_log_off(g);
-    u32 count = rdu32(mf, log + 0);
-    u64 total = 0;
-    for (u32 i = 0; i < count; i++)
-        total += graph_edge_count(g, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8));
-    if (total == 0) return 0;
-    u32 *tmp = malloc((size_t)total * sizeof(u32));
-    u64 k = 0;
-    for (u32 i = 0; i < count; i++) {
+    for (u32 i = lo; i < hi; i++) {
         u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
-        u64 adj = rdu64(mf, e + E_ADJ);
-        if (!adj) continue;
-        u32 ec = rdu32(mf, adj + 0);
-        for (u32 j = 0; j < ec; j++)
-            tmp[k++] = rdu32(mf, adj + ADJ_HEADER_SIZE + (u64)j * ADJ_ENTRY_SIZE + AE_RELTYPE);
+        u16 nl, tl;
+        const u8 *nm = graph_entity_name(g, e, &nl), *ty;
+        if (match_text(sr, rdu32(mf, e + E_NAME_ID), nm, nl) ||
+            (ty = graph_entity_type(g, e, &tl), match_text(sr, rdu32(mf, e + E_TYPE_ID), ty, tl)) ||
+            match_id(sr, rdu32(mf, e + E_OBS0))   ||
+            match_id(sr, rdu32(mf, e + E_OBS1)))
+            sbuf_push(out, e);
+    }
+}
+
+/* String-first: each distinct referenced string (or trigram candidate) is
+ * matched once and its hits expand through the reverse index, so a type shared
+ * by thousands of entities costs one match. Parts split the slots (or the
+ * candidates); results ascend by offset. */
+static void search_strings_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    searcher *sr = (searcher *)s->arg + p;
+    memfile_t *mf = s->g->mf;
+    u64 root = refs_root(s->g);
+    for (u32 i = lo; i < hi; i++) {
+        u32 sid; u64 b;
+        if (sr->cand) { sid = sr->cand[i]; if (!(b = pmap_get(mf, root, sid))) continue; }
+        else if (!pmap_at(mf, root, i, &sid, &b)) continue;
+        if (!match_id(sr, sid)) continue;
+        u32 cnt = rdu32(mf, b + 0);
+        for (u32 k = 0; k < cnt; k++) sbuf_push(out, rdu64(mf, b + RB_HDR + (u64)k * 8) & ~(u64)GRAPH_REF_MASK);
+    }
+}
+
+static u32 search_strings_merge(scan_t *s, u64 *out, u32 max) {
+    size_t nh = 0;
+    for (u32 p = 0; p < s->nparts; p++) nh += s->bufs[p].n;
+    u64 *hits = nh ? malloc(nh * 8) : NULL;
+    if (nh && !hits) return 0;
+    nh = 0;
+    for (u32 p = 0; p < s->nparts; p++) {
+        if (s->bufs[p].n) memcpy(hits + nh, s->bufs[p].v, s->bufs[p].n * 8);
+        nh += s->bufs[p].n;
     }
-    qsort(tmp, total, sizeof(u32), cmp_u32);
-    u32 distinct = 0;
-    for (u64 i = 0; i < total; i++)
-        if (i == 0 || tmp[i] != tmp[i - 1]) { if (distinct < max) out[distinct] = tmp[i]; distinct++; }
-    free(tmp);
-    return distinct;
+    u32 found = 0;
+    if (nh) qsort(hits, nh, 8, cmp_u64);
+    for (size_t i = 0; i < nh; i++) {
+        if (i && hits[i] == hits[i - 1]) continue;
+        if (found < max) out[found] = hits[i];
+        found++;
+    }
+    free(hits);
+    return found;
 }
 
-/* ======================================================================
- * Search (POSIX ERE over name + type + observations); full result set
- * ====================================================================== */
+static void search_end(searcher *sr) {
+    rx_release(sr->re);
+    free(sr->folded); free(sr->scratch); free((void *)sr->cand);
+}
 
-static int match_id(graph_t *g, regex_t *re, u32 id) {
-    if (!id) return 0;
-    u16 len; const u8 *s = st_get(g->st, id, &len);
-    regmatch_t pm; pm.rm_so = 0; pm.rm_eo = (regoff_t)len;
-    return regexec(re, (const char *)s, 0, &pm, REG_STARTEND) == 0;
+/* Compile the pattern (folded under ICASE) and fetch its trigram candidates:
+ * only strings holding every trigram the pattern needs can match, so the
+ * matcher runs on those alone (without an index, on everything). 0 = invalid
+ * pattern or OOM, i.e. no matches. Pair with search_end. */
+static int search_begin(searcher *sr, graph_t *g, const char *pattern, u32 flags) {
+    memset(sr, 0, sizeof *sr);
+    sr->g = g;
+    sr->icase = (flags & GRAPH_SEARCH_ICASE) != 0;
+    const char *pat = pattern;
+    if (sr->icase) {
+        sr->folded = malloc(strlen(pattern) * 2 + 1);
+        sr->scratch = malloc(65536);
+        if (!sr->folded || !sr->scratch) { search_end(sr); return 0; }
+        fold_pattern(pattern, sr->folded);
+        pat = sr->folded;
+    }
+    sr->re = rx_acquire(pat);
+    if (!rx_valid(sr->re)) { search_end(sr); return 0; }
+    u32 *cand = NULL;
+    if (st_trigram_candidates(g->st, pat, &cand, &sr->ncand)) sr->cand = cand;
+    return 1;
 }
 
-u32 graph_search(graph_t *g, const char *pattern, u64 *out, u32 max) {
-    regex_t re;
-    if (regcomp(&re, pattern, REG_EXTENDED) != 0) return 0;   /* POSIX ERE, case-sensitive; invalid pattern -> no matches */
-    memfile_t *mf = g->mf;
-    u64 log = node_log_off(g);
-    u32 count = rdu32(mf, log + 0), found = 0;
-    for (u32 i = 0; i < count; i++) {
-        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
-        if (match_id(g, &re, rdu32(mf, e + E_NAME_ID)) ||
-            match_id(g, &re, rdu32(mf, e + E_TYPE_ID)) ||
-            match_id(g, &re, rdu32(mf, e + E_OBS0))   ||
-            match_id(g, &re, rdu32(mf, e + E_OBS1))) {
-            if (found < max) out[found] = e;
-            found++;
+u32 graph_search_ex(graph_t *g, const char *pattern, u32 flags, u64 *out, u32 max) {
+    searcher sr;
+    if (!search_begin(&sr, g, pattern, flags)) return 0;
+    int by_string = rdu64(g->mf, refs_root(g)) != 0;
+    scan_t s = { .g = g, .part = by_string ? search_strings_part : search_entities_part };
+    if (by_string) s.count = sr.cand ? sr.ncand : pmap_capacity(g->mf, refs_root(g));
+    else s.count = sr.cand && sr.ncand == 0 ? 0 : log_count(g);
+    /* one searcher per part: part 0 matches with the cached pattern, the rest
+     * with private clones (a DFA grows as it matches) and their own fold buffer */
+    u32 np = scan_nparts(s.count);
+    searcher *srs = malloc((size_t)np * sizeof *srs);
+    u32 found = 0;
+    if (srs) {
+        srs[0] = sr;
+        for (s.nparts = 1; s.nparts < np; s.nparts++) {
+            searcher *w = &srs[s.nparts];
+            *w = sr;
+            w->re = rx_clone(sr.re);
+            w->scratch = sr.icase ? malloc(65536) : NULL;
+            if (!w->re || (sr.icase && !w->scratch)) { rx_drop(w->re); free(w->scratch); break; }
         }
+        s.arg = srs;
+        if (by_string) { if (scan_run(&s)) found = search_strings_merge(&s, out, max); scan_free(&s); }
+        else found = scan_collect(&s, out, max);
+        for (u32 p = 1; p < s.nparts; p++) { rx_drop(srs[p].re); free(srs[p].scratch); }
+        free(srs);
     }
-    regfree(&re);
+    search_end(&sr);
     return found;
 }
 
+u32 graph_search(graph_t *g, const char *pattern, u64 *out, u32 max) {
+    return graph_search_ex(g, pattern, 0, out, max);   /* POSIX ERE, case-sensitive */
+}
+
+int graph_regex_indexable(const char *pattern) {
+    tq_arena *a = tq_arena_new();
+    if (!a) return 0;
+    tq_t *q = rq_build(a, pattern);
+    int r = q && q->tag != TQ_ALL;
+    tq_arena_free(a);
+    return r;
+}
+
 /* Validity of a search pattern under the SAME engine that matches it (POSIX ERE),
  * so the TS layer can surface "Invalid regex pattern" without a second, divergent
- * regex dialect (JS RegExp). Returns 1 iff regcomp(REG_EXTENDED) accepts it. */
+ * regex dialect (JS RegExp). Returns 1 iff regcomp(REG_EXTENDED) would accept it.
+ * The compiled pattern stays in the cache for the search that follows. */
 int graph_regex_valid(const char *pattern) {
-    regex_t re;
-    if (regcomp(&re, pattern, REG_EXTENDED) != 0) return 0;
-    regfree(&re);
-    return 1;
+    rx_t *re = rx_acquire(pattern);
+    int ok = rx_valid(re);
+    rx_release(re);
+    return ok;
 }
 
 /* ======================================================================
@@ -723,6 +2174,262 @@ u32 graph_find_path(graph_t *g, u64 from, u64 to, u32 max_depth, u32 direction,
                               out_path, max_path, &tr, &be, &fa);
 }
 
+/* One side of a bidirectional search: its own parent table (parent[root] =
+ * root; otherwise the next hop back toward this side's root) and a queue
+ * whose [head, tail) slice is the current frontier level. */
+typedef struct {
+    omap parent;
+    u64 *q; u32 qcap, head, tail, depth, dir;
+} path_side;
+
+static void path_side_init(path_side *s, u64 root, u32 dir) {
+    omap_init(&s->parent, 256);
+    omap_put(&s->parent, root, root);
+    s->qcap = 256; s->q = malloc(s->qcap * 8);
+    s->q[0] = root; s->head = 0; s->tail = 1; s->depth = 0; s->dir = dir;
+}
+
+/* Expand one full level of `a`. Returns 1 on meeting `b` (*meet set), -1 when
+ * the budget trips, 0 otherwise. `last` is the latest node `a` discovered. */
+static int path_side_expand(graph_t *g, path_side *a, path_side *b, u64 budget_bytes,
+                            u64 *bytes_used, u64 *meet, u64 *last) {
+    u32 end = a->tail;
+    int r = 0;
+    while (a->head < end && !r) {
+        u64 f = a->q[a->head++];
+        u32 ec = graph_edge_count(g, f);
+        if (!ec) continue;
+        adj_entry_t *es = malloc((size_t)ec * sizeof(adj_entry_t));
+        graph_read_edges(g, f, es, ec);
+        for (u32 k = 0; k < ec; k++) {
+            if (!dir_match(a->dir, es[k].direction)) continue;
+            u64 t = es[k].target_offset;
+            if (omap_has(&a->parent, t)) continue;
+            omap_put(&a->parent, t, f);
+            *last = t;
+            if (omap_has(&b->parent, t)) { *meet = t; r = 1; break; }   /* meet check first */
+            u16 nl; (void)graph_entity_name(g, t, &nl);
+            u16 rl; (void)st_get(g->st, es[k].rel_type_id, &rl);
+            *bytes_used += (u64)nl + (u64)rl + 28;
+            if (*bytes_used >= budget_bytes) { r = -1; break; }          /* then budget */
+            if (a->tail == a->qcap) { a->qcap *= 2; a->q = realloc(a->q, a->qcap * 8); }
+            a->q[a->tail++] = t;
+        }
+        free(es);
+    }
+    if (!r) a->depth++;
+    return r;
+}
+
+/* Bidirectional variant of graph_find_path_ex: same outputs and β-contract.
+ * A second BFS runs from `to` over the reversed direction (edges are stored on
+ * both endpoints, so BACKWARD entries at a node are its in-edges), and each
+ * round expands whichever frontier level is smaller — ties go to the `from`
+ * side. Every level is expanded whole, so the first node both sides have
+ * discovered lies on a shortest path; combined depth stays within max_depth.
+ * On a hub-heavy graph this visits about 2·b^(d/2) nodes instead of b^d.
+ *
+ * The best-effort path and `farthest` come from the `from` side alone (its
+ * latest discovery), so a partial path is still a walk starting at `from`.
+ * Discoveries on either side draw on the one byte budget. A side running
+ * out of frontier proves there is no path, so the search ends early. */
+u32 graph_find_path_bidi(graph_t *g, u64 from, u64 to, u32 max_depth, u32 direction,
+                         u64 budget_bytes, u64 *out_path, u32 max_path,
+                         int *target_reached, int *budget_exhausted, u64 *farthest) {
+    *target_reached = 0; *budget_exhausted = 0; *farthest = 0;
+    if (from == to) { if (max_path >= 1) out_path[0] = from; *target_reached = 1; return 1; }
+
+    u32 rdir = direction == DIR_FORWARD ? DIR_BACKWARD : direction == DIR_BACKWARD ? DIR_FORWARD : direction;
+    path_side fw, bw;
+    path_side_init(&fw, from, direction);
+    path_side_init(&bw, to, rdir);
+
+    u16 fl, tl; (void)graph_entity_name(g, from, &fl); (void)graph_entity_name(g, to, &tl);
+    u64 bytes_used = (u64)fl + (u64)tl + 56;
+    u64 meet = 0, blast = 0;
+    int r = 0;
+
+    while (!r && fw.head < fw.tail && bw.head < bw.tail && fw.depth + bw.depth < max_depth) {
+        if (fw.tail - fw.head <= bw.tail - bw.head)
+            r = path_side_expand(g, &fw, &bw, budget_bytes, &bytes_used, &meet, farthest);
+        else
+            r = path_side_expand(g, &bw, &fw, budget_bytes, &bytes_used, &meet, &blast);
+    }
+
+    u32 n = 0;
+    u64 endp = r == 1 ? meet : *farthest;
+    if (endp) {
+        u64 *rev = malloc((size_t)max_path * 8);
+        for (u64 cur = endp; cur != from && n < max_path; cur = omap_get(&fw.parent, cur)) rev[n++] = cur;
+        if (n < max_path) rev[n++] = from;
+        for (u32 i = 0; i < n; i++) out_path[i] = rev[n - 1 - i];
+        free(rev);
+        if (r == 1)
+            for (u64 cur = meet; cur != to && n < max_path; ) { cur = omap_get(&bw.parent, cur); out_path[n++] = cur; }
+    }
+    free(fw.q); free(bw.q); omap_free(&fw.parent); omap_free(&bw.parent);
+    *target_reached = r == 1; *budget_exhausted = r == -1;
+    if (r == 1) *farthest = to;   /* as graph_find_path_ex: last discovery on success */
+    return n;
+}
+
+/* Only the set's own adjacency is read: cost follows its degree, not the
+ * graph's edge count. Membership is an omap over the (deduplicated) set. */
+u32 graph_set_relations(graph_t *g, const u64 *set, u32 n, u32 direction, graph_rel_t *out, u32 max) {
+    omap in; omap_init(&in, n * 2 < 256 ? 256 : n * 2);
+    u32 found = 0, cap = 0;
+    adj_entry_t *es = NULL;
+    for (u32 i = 0; i < n; i++) {
+        u64 e = set[i];
+        if (!e || omap_has(&in, e)) continue;
+        omap_put(&in, e, 1);
+    }
+    omap done; omap_init(&done, 256);   /* the in-set entities already emitted, for duplicates in `set` */
+    for (u32 i = 0; i < n; i++) {
+        u64 e = set[i];
+        if (!e || omap_has(&done, e)) continue;
+        omap_put(&done, e, 1);
+        u32 ec = graph_edge_count(g, e);
+        if (!ec) continue;
+        if (ec > cap) {
+            adj_entry_t *t = realloc(es, (size_t)ec * sizeof *es);
+            if (!t) continue;
+            es = t; cap = ec;
+        }
+        ec = graph_read_edges(g, e, es, ec);
+        for (u32 k = 0; k < ec; k++) {
+            u32 d = es[k].direction;
+            u64 t = es[k].target_offset;
+            if (direction == DIR_BACKWARD ? d != DIR_BACKWARD : d != DIR_FORWARD) continue;
+            if (direction == DIR_ANY && !omap_has(&in, t)) continue;
+            if (found < max) {
+                graph_rel_t *r = &out[found];
+                r->from = d == DIR_FORWARD ? e : t;
+                r->to = d == DIR_FORWARD ? t : e;
+                r->mtime = es[k].mtime;
+                r->rel_type_id = es[k].rel_type_id;
+                r->pad = 0;
+            }
+            found++;
+        }
+    }
+    free(es);
+    omap_free(&done); omap_free(&in);
+    return found;
+}
+
+/* ---- zero-degree set and components: builds and lookups ---- */
+
+static int orphans_build(graph_t *g) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0), buckets = PMAP_INITIAL_BUCKETS;
+    u64 root = conn_slot(g, CONN_ORPHANS);
+    if (!root || !pmap_create(mf, root, buckets)) return 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        if (!graph_edge_count(g, e) && !pmap_put(mf, root, text_doc_id(e), e)) {
+            pmap_destroy(mf, root);   /* a partial set would be trusted; the next open rebuilds */
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int graph_has_components(graph_t *g) { return conn_root(g, CONN_FOREST) != 0; }
+
+static u32 uf_top(u32 *up, u32 x) { while (up[x] != x) x = up[x] = up[up[x]]; return x; }
+
+/* Union-find over the node log in memory, then one forest entry per entity
+ * that is not its component's root: paths of length one. */
+int graph_build_components(graph_t *g) {
+    memfile_t *mf = g->mf;
+    if (conn_root(g, CONN_FOREST)) return 1;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0), cap = 0, linked = 0;
+    u32 *up = malloc(((size_t)count + 1) * 4);
+    u64 *ents = malloc(((size_t)count + 1) * 8);
+    adj_entry_t *es = NULL;
+    omap idx; omap_init(&idx, count * 2 < 256 ? 256 : count * 2);
+    int ok = up && ents && idx.k && idx.v;
+    for (u32 i = 0; ok && i < count; i++) {
+        ents[i] = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        up[i] = i;
+        omap_put(&idx, ents[i], (u64)i + 1);
+    }
+    for (u32 i = 0; ok && i < count; i++) {
+        u32 ec = graph_edge_count(g, ents[i]);
+        if (ec > cap) {
+            adj_entry_t *t = realloc(es, (size_t)ec * sizeof *es);
+            if (!t) { ok = 0; break; }
+            es = t; cap = ec;
+        }
+        ec = graph_read_edges(g, ents[i], es, ec);
+        for (u32 k = 0; k < ec; k++) {
+            u64 j = es[k].direction == DIR_FORWARD ? omap_get(&idx, es[k].target_offset) : 0;
+            if (!j) continue;
+            u32 a = uf_top(up, i), b = uf_top(up, (u32)j - 1);
+            if (a != b) { up[a < b ? b : a] = a < b ? a : b; linked++; }
+        }
+    }
+    u64 root = ok ? conn_slot(g, CONN_FOREST) : 0;
+    u32 buckets = PMAP_INITIAL_BUCKETS;
+    while ((u64)buckets * 7 < (u64)linked * 2 * 10) buckets *= 2;
+    ok = root && pmap_create(mf, root, buckets);
+    for (u32 i = 0; ok && i < count; i++) {
+        u32 r = uf_top(up, i);
+        if (r != i) ok = pmap_put(mf, root, text_doc_id(ents[i]), ents[r])
+                      && pmap_put(mf, root, text_doc_id(ents[r]), ents[r] | 1u);
+    }
+    if (!ok && root) pmap_destroy(mf, root);
+    free(up); free(ents); free(es); omap_free(&idx);
+    return ok;
+}
+
+u64 graph_component(graph_t *g, u64 off) {
+    u64 root = conn_root(g, CONN_FOREST);
+    return root ? uf_find(g->mf, root, off) : 0;
+}
+
+typedef struct { u64 root, anchor; omap *seen; } outside_t;
+
+static void outside_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    (void)p;
+    memfile_t *mf = s->g->mf;
+    u64 log = node_log_off(s->g);
+    const outside_t *o = s->arg;
+    for (u32 i = lo; i < hi; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        int in = o->seen ? omap_has(o->seen, e) : o->anchor && uf_find(mf, o->root, e) == o->anchor;
+        if (!in) sbuf_push(out, e);
+    }
+}
+
+/* By component labels when the forest is current; otherwise a BFS from the
+ * anchor marks its component first (nothing is written either way). */
+u32 graph_outside_component(graph_t *g, u64 anchor, u64 *out, u32 max) {
+    outside_t o = { conn_root(g, CONN_FOREST), 0, NULL };
+    omap seen = { 0 };
+    if (o.root) {
+        o.anchor = anchor ? uf_find(g->mf, o.root, anchor) : 0;
+    } else {
+        omap_init(&seen, 256);
+        if (anchor) {
+            u32 cap = graph_entity_count(g) + 1;
+            u64 *reach = malloc((size_t)cap * 8);
+            u32 n = reach ? graph_neighbors(g, anchor, (u32)-1, DIR_ANY, reach, cap) : 0;
+            omap_put(&seen, anchor, 1);
+            for (u32 i = 0; i < n && i < cap; i++) omap_put(&seen, reach[i], 1);
+            free(reach);
+        }
+        o.seen = &seen;
+    }
+    scan_t s = { .g = g, .count = log_count(g), .part = outside_part, .arg = &o };
+    u32 n = scan_collect(&s, out, max);
+    if (o.seen) omap_free(&seen);
+    return n;
+}
+
 /* ======================================================================
  * Ranking: visit counting (pagerank/llmrank), MERW psi, random walk
  * ====================================================================== */
@@ -755,8 +2462,8 @@ double graph_get_psi(graph_t *g, u64 off) { return rdf64(g->mf, off + E_PSI); }
 /* migration: restore an entity's preserved fields exactly (logical rebuild). */
 void graph_set_entity_fields(graph_t *g, u64 off, u64 mtime, u64 obs_mtime,
                              u64 structural_visits, u64 walker_visits, double psi) {
-    wru64(g->mf, off + E_MTIME, mtime);
-    wru64(g->mf, off + E_OBSM, obs_mtime);
+    set_mtime(g, off, E_MTIME, mtime);
+    set_mtime(g, off, E_OBSM, obs_mtime);
     wru64(g->mf, off + E_SVIS, structural_visits);
     wru64(g->mf, off + E_WVIS, walker_visits);
     wrf64(g->mf, off + E_PSI, psi);
@@ -767,25 +2474,43 @@ void graph_set_totals(graph_t *g, u64 structural_total, u64 walker_total) {
     wru64(g->mf, g->header_offset + GH_WALKER_TOTAL, walker_total);
 }
 
-/* one MC complete-path walk (Avrachenkov Alg. 4): forward edges, damping, stop at dangling */
-static u32 structural_walk(graph_t *g, u64 start, double damping) {
-    u64 cur = start; u32 visits = 0;
+/* One MC complete-path walk (Avrachenkov Alg. 4) from start: forward edges,
+ * damping, stop at dangling. Visits are counted in place. */
+static u32 structural_walk(graph_t *g, u64 start, double damping, u64 *rng) {
+    u64 cur = start; u32 n = 0;
     for (;;) {
-        graph_inc_structural_visit(g, cur); visits++;
+        graph_inc_structural_visit(g, cur);
+        n++;
         u32 ec = graph_edge_count(g, cur);
         if (!ec) break;
         adj_entry_t *es = malloc((size_t)ec * sizeof(adj_entry_t));
         graph_read_edges(g, cur, es, ec);
         u32 fwd = 0;
         for (u32 k = 0; k < ec; k++) if (es[k].direction == DIR_FORWARD) fwd++;
-        if (fwd == 0 || rng_d(&g_rng) >= damping) { free(es); break; }
-        u32 pick = (u32)(rng_d(&g_rng) * fwd); if (pick >= fwd) pick = fwd - 1;
+        if (fwd == 0 || rng_d(rng) >= damping) { free(es); break; }
+        u32 pick = (u32)(rng_d(rng) * fwd); if (pick >= fwd) pick = fwd - 1;
         u32 seen = 0; u64 next = cur;
         for (u32 k = 0; k < ec; k++) if (es[k].direction == DIR_FORWARD) { if (seen == pick) { next = es[k].target_offset; break; } seen++; }
         free(es);
         cur = next;
     }
-    return visits;
+    return n;
+}
+
+/* The same walk over a CSR snapshot (positions instead of offsets), counting
+ * into visits[]. Same draws in the same order, so the same seed gives the
+ * same visits as the in-place walk. */
+static u32 csr_walk(const u32 *rowoff, const u32 *col, u32 start, double damping, u64 *rng, u32 *visits) {
+    u32 cur = start, n = 0;
+    for (;;) {
+        visits[cur]++;
+        n++;
+        u32 fwd = rowoff[cur + 1] - rowoff[cur];
+        if (fwd == 0 || rng_d(rng) >= damping) break;
+        u32 pick = (u32)(rng_d(rng) * fwd); if (pick >= fwd) pick = fwd - 1;
+        cur = col[rowoff[cur] + pick];
+    }
+    return n;
 }
 
 u32 graph_structural_sample(graph_t *g, u32 iterations, double damping) {
@@ -795,76 +2520,157 @@ u32 graph_structural_sample(graph_t *g, u32 iterations, double damping) {
     graph_list_entities(g, offs, n);
     u32 total = 0;
     for (u32 it = 0; it < iterations; it++)
-        for (u32 i = 0; i < n; i++) total += structural_walk(g, offs[i], damping);
+        for (u32 i = 0; i < n; i++) total += structural_walk(g, offs[i], damping, &g_rng);
     free(offs);
     return total;
 }
 
-u32 graph_compute_merw_psi(graph_t *g, double alpha, u32 max_iter, double tol) {
-    u32 n = graph_entity_count(g);
-    if (n == 0) return 0;
-    u64 *offs = malloc((size_t)n * 8);
-    graph_list_entities(g, offs, n);
-
-    omap idx; omap_init(&idx, n * 2 < 256 ? 256 : n * 2);
-    for (u32 i = 0; i < n; i++) omap_put(&idx, offs[i], i + 1);   /* index+1; 0 = absent */
-
-    /* CSR forward adjacency */
-    u32 *rowoff = malloc((size_t)(n + 1) * 4);
-    rowoff[0] = 0;
-    for (u32 i = 0; i < n; i++) {
-        u32 ec = graph_edge_count(g, offs[i]), d = 0;
-        if (ec) {
-            adj_entry_t *es = malloc((size_t)ec * sizeof(adj_entry_t));
-            graph_read_edges(g, offs[i], es, ec);
-            for (u32 k = 0; k < ec; k++) if (es[k].direction == DIR_FORWARD && omap_get(&idx, es[k].target_offset)) d++;
-            free(es);
+/* CSR forward adjacency of the n entities offs[] (idx: offset -> position+1),
+ * edges to entities outside the set left out. 0 when out of memory. */
+static int csr_forward(graph_t *g, const u64 *offs, u32 n, omap *idx, u32 **rowoff_out, u32 **col_out) {
+    u32 *rowoff = malloc((size_t)(n + 1) * 4), *col = NULL, cap = 0;
+    adj_entry_t *es = NULL;
+    int ok = rowoff != NULL;
+    if (ok) rowoff[0] = 0;
+    for (u32 i = 0; ok && i < n; i++) {
+        u32 ec = graph_edge_count(g, offs[i]);
+        if (ec > cap) {
+            adj_entry_t *t = realloc(es, (size_t)ec * sizeof *es);
+            if (!t) { ok = 0; break; }
+            es = t; cap = ec;
         }
+        ec = graph_read_edges(g, offs[i], es, ec);
+        u32 d = 0;
+        for (u32 k = 0; k < ec; k++) if (es[k].direction == DIR_FORWARD && omap_get(idx, es[k].target_offset)) d++;
         rowoff[i + 1] = rowoff[i] + d;
     }
-    u32 nnz = rowoff[n];
-    u32 *col = malloc((size_t)(nnz ? nnz : 1) * 4);
-    for (u32 i = 0; i < n; i++) {
-        u32 ec = graph_edge_count(g, offs[i]);
-        if (!ec) continue;
-        adj_entry_t *es = malloc((size_t)ec * sizeof(adj_entry_t));
-        graph_read_edges(g, offs[i], es, ec);
-        u32 w = rowoff[i];
+    if (ok) ok = (col = malloc((size_t)(rowoff[n] ? rowoff[n] : 1) * 4)) != NULL;
+    for (u32 i = 0; ok && i < n; i++) {
+        u32 ec = graph_read_edges(g, offs[i], es, cap), w = rowoff[i];
         for (u32 k = 0; k < ec; k++) if (es[k].direction == DIR_FORWARD) {
-            u64 j = omap_get(&idx, es[k].target_offset);
+            u64 j = omap_get(idx, es[k].target_offset);
             if (j) col[w++] = (u32)(j - 1);
         }
-        free(es);
     }
+    free(es);
+    if (!ok) { free(rowoff); free(col); return 0; }
+    *rowoff_out = rowoff; *col_out = col;
+    return 1;
+}
 
-    double *psi = malloc((size_t)n * 8), *nx = malloc((size_t)n * 8);
+/* MERW power iteration over a CSR adjacency of n nodes. psi[] comes in holding
+ * the stored values (the warm start; <= 0 = none) and leaves with the result. */
+static u32 merw_solve(const u32 *rowoff, const u32 *col, u32 n, double alpha, u32 max_iter, double tol, double *psi) {
+    double *cur = psi, *nx = malloc((size_t)n * 8);
+    if (!nx) return 0;
     double warm_sum = 0; u32 warm_cnt = 0;
-    for (u32 i = 0; i < n; i++) { double v = rdf64(g->mf, offs[i] + E_PSI); psi[i] = v; if (v > 0) { warm_sum += v; warm_cnt++; } }
-    if (warm_cnt) { double m = warm_sum / warm_cnt; for (u32 i = 0; i < n; i++) if (psi[i] <= 0) psi[i] = m; }
-    else { double u = 1.0 / __builtin_sqrt((double)n); for (u32 i = 0; i < n; i++) psi[i] = u; }
-    double nrm = 0; for (u32 i = 0; i < n; i++) nrm += psi[i] * psi[i]; nrm = __builtin_sqrt(nrm);
-    if (nrm > 0) for (u32 i = 0; i < n; i++) psi[i] /= nrm;
+    for (u32 i = 0; i < n; i++) { double v = cur[i]; if (v > 0) { warm_sum += v; warm_cnt++; } }
+    if (warm_cnt) { double m = warm_sum / warm_cnt; for (u32 i = 0; i < n; i++) if (cur[i] <= 0) cur[i] = m; }
+    else { double u = 1.0 / __builtin_sqrt((double)n); for (u32 i = 0; i < n; i++) cur[i] = u; }
+    double nrm = 0; for (u32 i = 0; i < n; i++) nrm += cur[i] * cur[i]; nrm = __builtin_sqrt(nrm);
+    if (nrm > 0) for (u32 i = 0; i < n; i++) cur[i] /= nrm;
 
     double teleport = (1.0 - alpha) / (double)n;
     u32 iter = 0;
     for (iter = 0; iter < max_iter; iter++) {
         for (u32 i = 0; i < n; i++) nx[i] = 0;
-        double psi_sum = 0; for (u32 i = 0; i < n; i++) psi_sum += psi[i];
+        double psi_sum = 0; for (u32 i = 0; i < n; i++) psi_sum += cur[i];
         double tc = teleport * psi_sum;
-        for (u32 i = 0; i < n; i++) { double val = alpha * psi[i]; for (u32 p = rowoff[i]; p < rowoff[i + 1]; p++) nx[col[p]] += val; }
+        for (u32 i = 0; i < n; i++) { double val = alpha * cur[i]; for (u32 p = rowoff[i]; p < rowoff[i + 1]; p++) nx[col[p]] += val; }
         for (u32 i = 0; i < n; i++) nx[i] += tc;
         double norm = 0; for (u32 i = 0; i < n; i++) norm += nx[i] * nx[i]; norm = __builtin_sqrt(norm);
         if (norm > 0) for (u32 i = 0; i < n; i++) nx[i] /= norm;
-        double diff = 0; for (u32 i = 0; i < n; i++) { double d = nx[i] - psi[i]; diff += d * d; } diff = __builtin_sqrt(diff);
-        double *t = psi; psi = nx; nx = t;
+        double diff = 0; for (u32 i = 0; i < n; i++) { double d = nx[i] - cur[i]; diff += d * d; } diff = __builtin_sqrt(diff);
+        double *t = cur; cur = nx; nx = t;
         if (diff < tol) { iter++; break; }
     }
-    for (u32 i = 0; i < n; i++) { if (psi[i] < 0) psi[i] = 0; wrf64(g->mf, offs[i] + E_PSI, psi[i]); }
+    for (u32 i = 0; i < n; i++) psi[i] = cur[i] < 0 ? 0 : cur[i];   /* cur may be the scratch buffer */
+
+    free(cur == psi ? nx : cur);
+    return iter;
+}
+
+u32 graph_compute_merw_psi(graph_t *g, double alpha, u32 max_iter, double tol) {
+    u32 n = graph_entity_count(g);
+    if (n == 0) return 0;
+    u64 *offs = malloc((size_t)n * 8);
+    graph_list_entities(g, offs, n);
+
+    omap idx; omap_init(&idx, n * 2 < 256 ? 256 : n * 2);
+    for (u32 i = 0; i < n; i++) omap_put(&idx, offs[i], i + 1);   /* index+1; 0 = absent */
+    double *psi = malloc((size_t)n * 8);
+    u32 *rowoff, *col, iter = 0;
+    if (psi && csr_forward(g, offs, n, &idx, &rowoff, &col)) {
+        for (u32 i = 0; i < n; i++) psi[i] = rdf64(g->mf, offs[i] + E_PSI);
+        iter = merw_solve(rowoff, col, n, alpha, max_iter, tol, psi);
+        for (u32 i = 0; i < n; i++) wrf64(g->mf, offs[i] + E_PSI, psi[i]);
+        free(rowoff); free(col);
+    }
 
-    free(offs); free(rowoff); free(col); free(psi); free(nx); omap_free(&idx);
+    free(offs); free(psi); omap_free(&idx);
     return iter;
 }
 
+u64 graph_rng_fork(void) { return rng_u64(&g_rng); }
+
+int graph_rank_snapshot(graph_t *g, graph_rank_t *r) {
+    memset(r, 0, sizeof *r);
+    u32 n = graph_entity_count(g);
+    if (n == 0) return 1;
+    r->offs = malloc((size_t)n * 8); r->names = malloc((size_t)n * 4);
+    r->visits = calloc(n, 4); r->psi = malloc((size_t)n * 8);
+    if (!r->offs || !r->names || !r->visits || !r->psi) { graph_rank_free(r); return 0; }
+    u32 m = graph_list_entities(g, r->offs, n);
+    r->n = n = m < n ? m : n;
+    omap idx; omap_init(&idx, n * 2 < 256 ? 256 : n * 2);
+    for (u32 i = 0; i < n; i++) {
+        omap_put(&idx, r->offs[i], i + 1);
+        r->names[i] = rdu32(g->mf, r->offs[i] + E_NAME_ID);
+        r->psi[i] = rdf64(g->mf, r->offs[i] + E_PSI);
+    }
+    int ok = csr_forward(g, r->offs, n, &idx, &r->rowoff, &r->col);
+    omap_free(&idx);
+    if (!ok) graph_rank_free(r);
+    return ok;
+}
+
+int graph_rank_compute(graph_rank_t *r, u32 iterations, double damping, double alpha, u32 max_iter, double tol,
+                       u64 seed) {
+    if (r->n == 0) return 1;
+    u64 rng = seed ? seed : 0x9e3779b97f4a7c15ull;
+    for (u32 it = 0; it < iterations; it++)
+        for (u32 i = 0; i < r->n; i++) r->total += csr_walk(r->rowoff, r->col, i, damping, &rng, r->visits);
+    r->iters = merw_solve(r->rowoff, r->col, r->n, alpha, max_iter, tol, r->psi);
+    return r->iters > 0 || max_iter == 0;
+}
+
+/* An offset can be freed and handed to a new entity while the snapshot is
+ * computed; the name id taken with the snapshot tells the two apart. */
+void graph_rank_apply(graph_t *g, const graph_rank_t *r) {
+    u32 n = graph_entity_count(g);
+    u64 *live = malloc(((size_t)n + 1) * 8);
+    if (!live) return;
+    u32 m = graph_list_entities(g, live, n);
+    if (m < n) n = m;
+    qsort(live, n, 8, cmp_u64);
+    u64 added = 0;
+    for (u32 i = 0; i < r->n; i++) {
+        if (!bsearch(&r->offs[i], live, n, 8, cmp_u64)) continue;                  /* deleted meanwhile */
+        if (rdu32(g->mf, r->offs[i] + E_NAME_ID) != r->names[i]) continue;          /* ... and reused */
+        wru64(g->mf, r->offs[i] + E_SVIS, rdu64(g->mf, r->offs[i] + E_SVIS) + r->visits[i]);
+        wrf64(g->mf, r->offs[i] + E_PSI, r->psi[i]);
+        added += r->visits[i];
+    }
+    u64 hp = g->header_offset + GH_STRUCTURAL_TOTAL;
+    wru64(g->mf, hp, rdu64(g->mf, hp) + added);
+    free(live);
+}
+
+void graph_rank_free(graph_rank_t *r) {
+    free(r->offs); free(r->names); free(r->rowoff); free(r->col); free(r->visits); free(r->psi);
+    memset(r, 0, sizeof *r);
+}
+
 u32 graph_random_walk(graph_t *g, u64 start, u32 depth, u32 direction, int merw_mode,
                       u64 seed, u64 *out_path, u32 max_path) {
     u64 st = seed ? seed : g_rng;
@@ -905,50 +2711,383 @@ u32 graph_random_walk(graph_t *g, u64 start, u32 depth, u32 direction, int merw_
     return plen;
 }
 
+/* ======================================================================
+ * Paged search
+ *
+ * Unranked pages walk the node log from the cursor and stop once the page is
+ * full, each string's verdict memoized so a shared type is matched once.
+ * Ranked pages must see every match, but keep only the best cursor + limit of
+ * them in a bounded heap. Keys are normalized so that "better" is always
+ * "smaller", ties going to the lower offset: a page boundary never splits a
+ * tie differently on the next call.
+ * ====================================================================== */
+
+typedef struct { u64 k1, k2, off; } rank_item;
+
+static inline int rank_lt(const rank_item *a, const rank_item *b) {
+    if (a->k1 != b->k1) return a->k1 < b->k1;
+    if (a->k2 != b->k2) return a->k2 < b->k2;
+    return a->off < b->off;
+}
+static int cmp_rank(const void *a, const void *b) {
+    return rank_lt(a, b) ? -1 : rank_lt(b, a) ? 1 : 0;
+}
+
+static rank_item rank_key(graph_t *g, u64 e, u32 rank) {
+    memfile_t *mf = g->mf;
+    rank_item it = { 0, 0, e };
+    switch (rank & GRAPH_RANK_KEY) {
+    case GRAPH_RANK_MTIME:      it.k1 = rdu64(mf, e + E_MTIME); break;
+    case GRAPH_RANK_OBS_MTIME:  it.k1 = rdu64(mf, e + E_OBSM); break;
+    case GRAPH_RANK_STRUCTURAL: it.k1 = rdu64(mf, e + E_SVIS); break;
+    case GRAPH_RANK_WALKER:     it.k1 = rdu64(mf, e + E_WVIS); it.k2 = rdu64(mf, e + E_SVIS); break;
+    }
+    if (!(rank & GRAPH_RANK_ASC)) { it.k1 = ~it.k1; it.k2 = ~it.k2; }
+    return it;
+}
+
+/* max-heap on rank_lt: the root is the worst item kept */
+static void heap_down(rank_item *h, u32 n, u32 i) {
+    for (;;) {
+        u32 l = 2 * i + 1, r = l + 1, w = i;
+        if (l < n && rank_lt(&h[w], &h[l])) w = l;
+        if (r < n && rank_lt(&h[w], &h[r])) w = r;
+        if (w == i) return;
+        rank_item t = h[i]; h[i] = h[w]; h[w] = t;
+        i = w;
+    }
+}
+static void heap_up(rank_item *h, u32 i) {
+    while (i && rank_lt(&h[(i - 1) / 2], &h[i])) {
+        u32 p = (i - 1) / 2;
+        rank_item t = h[i]; h[i] = h[p]; h[p] = t;
+        i = p;
+    }
+}
+
+static int memo_match(searcher *sr, omap *memo, u32 id, const u8 *raw, u16 len) {
+    if (!id) return match_text(sr, 0, raw, len);
+    u64 v = omap_get(memo, id);
+    if (v) return (int)v - 1;
+    int m = match_text(sr, id, raw, len);
+    omap_put(memo, id, (u64)m + 1);
+    return m;
+}
+static int memo_match_id(searcher *sr, omap *memo, u32 id) {
+    if (!id || !is_cand(sr, id)) return 0;
+    u16 len; const u8 *s = st_get(sr->g->st, id, &len);
+    return memo_match(sr, memo, id, s, len);
+}
+
+static u32 page_unranked(searcher *sr, u32 cursor, u32 limit, u64 *out, u32 *next) {
+    graph_t *g = sr->g;
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 count = rdu32(mf, log + 0), n = 0, i = cursor;
+    if (sr->cand && sr->ncand == 0) i = count;
+    omap memo; omap_init(&memo, 256);
+    for (; i < count && n < limit; i++) {
+        u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
+        u16 nl, tl;
+        const u8 *nm = graph_entity_name(g, e, &nl), *ty;
+        if (memo_match(sr, &memo, rdu32(mf, e + E_NAME_ID), nm, nl) ||
+            (ty = graph_entity_type(g, e, &tl), memo_match(sr, &memo, rdu32(mf, e + E_TYPE_ID), ty, tl)) ||
+            memo_match_id(sr, &memo, rdu32(mf, e + E_OBS0)) ||
+            memo_match_id(sr, &memo, rdu32(mf, e + E_OBS1)))
+            out[n++] = e;
+    }
+    omap_free(&memo);
+    *next = i < count ? i : 0;
+    return n;
+}
+
+static u32 page_ranked(graph_t *g, const u64 *m, u32 nm, u32 rank, u32 cursor, u32 limit,
+                       u64 *out, u32 *next) {
+    if (cursor >= nm) return 0;
+    u32 k = limit > nm - cursor ? nm : cursor + limit;
+    rank_item *h = malloc((size_t)k * sizeof *h);
+    if (!h) return 0;
+    u32 hn = 0;
+    for (u32 i = 0; i < nm; i++) {
+        rank_item it = rank_key(g, m[i], rank);
+        if (hn < k) { h[hn] = it; heap_up(h, hn++); }
+        else if (rank_lt(&it, &h[0])) { h[0] = it; heap_down(h, hn, 0); }
+    }
+    qsort(h, hn, sizeof *h, cmp_rank);
+    for (u32 i = cursor; i < k; i++) out[i - cursor] = h[i].off;
+    *next = k < nm ? k : 0;
+    free(h);
+    return k - cursor;
+}
+
+/* Name order comes from the name tree rather than a heap: walk it from the
+ * matching end and keep the matches, stopping once the page is full. */
+static int cmp_off(const void *a, const void *b) { u64 x = *(const u64 *)a, y = *(const u64 *)b; return (x > y) - (x < y); }
+
+static u32 page_by_name(graph_t *g, const u64 *matches, u32 nm, u32 rank, u32 cursor, u32 limit,
+                        u64 *out, u32 *next) {
+    u64 root = gaux_root(g, GAUX_NAMES);
+    if (!root || cursor >= nm) return 0;
+    u64 *m = malloc((size_t)nm * 8);
+    if (!m) return 0;
+    memcpy(m, matches, (size_t)nm * 8);
+    qsort(m, nm, 8, cmp_off);
+    u32 k = limit > nm - cursor ? nm : cursor + limit, seen = 0;
+    int asc = (rank & GRAPH_RANK_ASC) != 0;
+    btree_t t = name_tree(g, root);
+    bt_iter it;
+    u64 e;
+    bt_at(&t, asc ? 0 : bt_count(&t) - 1, &it);
+    while (seen < k && bt_get(&t, &it, NULL, &e)) {
+        if (bsearch(&e, m, nm, 8, cmp_off)) { if (seen >= cursor) out[seen - cursor] = e; seen++; }
+        if (asc) bt_next(&t, &it); else bt_prev(&t, &it);
+    }
+    *next = seen < nm ? seen : 0;
+    free(m);
+    return seen > cursor ? seen - cursor : 0;
+}
+
+u32 graph_search_page_ex(graph_t *g, const char *pattern, u32 flags, u32 rank, u32 cursor, u32 limit,
+                         u64 *out, u32 *next, u32 *total, u64 **matches) {
+    *next = 0; *total = 0;
+    if (matches) *matches = NULL;
+    u32 n = 0;
+    if (!(rank & GRAPH_RANK_KEY)) {
+        searcher sr;
+        if (limit && search_begin(&sr, g, pattern, flags)) {
+            n = page_unranked(&sr, cursor, limit, out, next);
+            search_end(&sr);
+        }
+        if (!matches) return n;
+    } else if (!limit && !matches) {
+        return 0;
+    }
+    u32 cap = graph_entity_count(g) + 1;
+    u64 *m = malloc((size_t)cap * 8);
+    if (!m) return 0;
+    u32 nm = graph_search_ex(g, pattern, flags, m, cap);
+    if (nm > cap) nm = cap;
+    *total = nm;
+    if ((rank & GRAPH_RANK_KEY) && limit)
+        n = (rank & GRAPH_RANK_KEY) == GRAPH_RANK_NAME
+            ? page_by_name(g, m, nm, rank, cursor, limit, out, next)
+            : page_ranked(g, m, nm, rank, cursor, limit, out, next);
+    if (matches) { *matches = m; return n; }
+    free(m);
+    return n;
+}
+
+u32 graph_search_page(graph_t *g, const char *pattern, u32 flags, u32 rank, u32 cursor, u32 limit,
+                      u64 *out, u32 *next, u32 *total) {
+    return graph_search_page_ex(g, pattern, flags, rank, cursor, limit, out, next, total, NULL);
+}
+
+/* A result set in rank order: the page keys, ties to the lower offset, or
+ * name order (reversed unless asc) through the name sort. */
+int graph_rank_sort(graph_t *g, u64 *offs, u32 n, u32 rank) {
+    if ((rank & GRAPH_RANK_KEY) == GRAPH_RANK_NAME) {
+        if (!name_sort(g, offs, NULL, n)) return 0;
+        if (!(rank & GRAPH_RANK_ASC))
+            for (u32 i = 0, j = n ? n - 1 : 0; i < j; i++, j--) { u64 t = offs[i]; offs[i] = offs[j]; offs[j] = t; }
+        return 1;
+    }
+    rank_item *it = malloc(((size_t)n + 1) * sizeof *it);
+    if (!it) return 0;
+    for (u32 i = 0; i < n; i++) it[i] = rank_key(g, offs[i], rank);
+    qsort(it, n, sizeof *it, cmp_rank);
+    for (u32 i = 0; i < n; i++) offs[i] = it[i].off;
+    free(it);
+    return 1;
+}
+
+/* ======================================================================
+ * JSON result pages
+ *
+ * The server's paginateItems, natively: {"items":[...],"nextCursor":c,
+ * "totalCount":n} with items appended while the text, measured in UTF-16
+ * units as JS measures it (the wrapper counted with a null cursor), stays
+ * within the budget; an oversized first item goes out alone. Items are
+ * written as JSON.stringify writes the server's Entity / Neighbor objects.
+ * ====================================================================== */
+
+typedef struct { char *p; size_t n, cap; int oom; } jbuf;
+
+static void jb_put(jbuf *b, const void *s, size_t len) {
+    if (b->oom) return;
+    if (b->n + len + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (b->n + len + 1 > cap) cap *= 2;
+        char *p = realloc(b->p, cap);
+        if (!p) { b->oom = 1; return; }
+        b->p = p; b->cap = cap;
+    }
+    memcpy(b->p + b->n, s, len);
+    b->n += len;
+    b->p[b->n] = 0;
+}
+static void jb_lit(jbuf *b, const char *s) { jb_put(b, s, strlen(s)); }
+static void jb_u64(jbuf *b, u64 v) {
+    char t[24]; int i = 24;
+    do { t[--i] = (char)('0' + v % 10); v /= 10; } while (v);
+    jb_put(b, t + i, (size_t)(24 - i));
+}
+/* a JSON string: quotes, backslashes and controls escaped, the rest as is */
+static void jb_str(jbuf *b, const u8 *s, u32 len) {
+    static const char hex[] = "0123456789abcdef";
+    jb_put(b, "\"", 1);
+    u32 run = 0;
+    for (u32 i = 0; i < len; i++) {
+        u8 c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        jb_put(b, s + run, i - run);
+        run = i + 1;
+        char e[6] = { '\\', (char)c, 0 };
+        size_t el = 2;
+        switch (c) {
+        case '"': case '\\': break;
+        case '\b': e[1] = 'b'; break;
+        case '\f': e[1] = 'f'; break;
+        case '\n': e[1] = 'n'; break;
+        case '\r': e[1] = 'r'; break;
+        case '\t': e[1] = 't'; break;
+        default: e[1] = 'u'; e[2] = '0'; e[3] = '0'; e[4] = hex[c >> 4]; e[5] = hex[c & 15]; el = 6;
+        }
+        jb_put(b, e, el);
+    }
+    jb_put(b, s + run, len - run);
+    jb_put(b, "\"", 1);
+}
+
+/* UTF-16 length of UTF-8 text: a unit per sequence, two for 4-byte ones */
+static size_t utf16_len(const char *s, size_t n) {
+    size_t u = 0;
+    for (size_t i = 0; i < n; i++) {
+        u8 c = (u8)s[i];
+        if ((c & 0xC0) != 0x80) u += c >= 0xF0 ? 2 : 1;
+    }
+    return u;
+}
+
+static void json_item(graph_t *g, jbuf *b, u64 e) {
+    u16 l;
+    const u8 *p = graph_entity_name(g, e, &l);
+    jb_lit(b, "{\"name\":");
+    jb_str(b, p, l);
+    p = graph_entity_type(g, e, &l);
+    jb_lit(b, ",\"entityType\":");
+    jb_str(b, p, l);
+    jb_lit(b, ",\"observations\":[");
+    u32 o[2] = { rdu32(g->mf, e + E_OBS0), rdu32(g->mf, e + E_OBS1) };
+    for (u32 k = 0; k < 2 && o[k]; k++) {
+        if (k) jb_put(b, ",", 1);
+        p = st_get(g->st, o[k], &l);
+        jb_str(b, p, l);
+    }
+    jb_put(b, "]", 1);
+    u64 m = rdu64(g->mf, e + E_MTIME), om = rdu64(g->mf, e + E_OBSM);
+    if (m) { jb_lit(b, ",\"mtime\":"); jb_u64(b, m); }
+    if (om) { jb_lit(b, ",\"obsMtime\":"); jb_u64(b, om); }
+    jb_put(b, "}", 1);
+}
+
+char *graph_json_page(graph_t *g, const u64 *offs, u32 n, u32 cursor, u32 max_chars,
+                      u32 *next, size_t *len) {
+    jbuf b = { 0 };
+    jb_lit(&b, "{\"items\":[],\"nextCursor\":null,\"totalCount\":");
+    jb_u64(&b, n);
+    size_t chars = utf16_len(b.p ? b.p : "", b.n) + 1, shown = 0;
+    b.n = 0;
+    jb_lit(&b, "{\"items\":[");
+    u32 i = cursor;
+    for (; i < n && !b.oom; i++) {
+        size_t at = b.n;
+        if (shown) jb_put(&b, ",", 1);
+        json_item(g, &b, offs[i]);
+        size_t add = utf16_len(b.p + at, b.n - at);
+        if (chars + add > max_chars && shown) { b.n = at; break; }
+        chars += add;
+        if (chars > max_chars) { i++; break; }           /* forward progress: an oversized first item alone */
+        shown++;
+    }
+    *next = i < n ? i : 0;
+    jb_lit(&b, "],\"nextCursor\":");
+    if (*next) jb_u64(&b, *next); else jb_lit(&b, "null");
+    jb_lit(&b, ",\"totalCount\":");
+    jb_u64(&b, n);
+    jb_put(&b, "}", 1);
+    if (b.oom) { free(b.p); return NULL; }
+    *len = b.n;
+    return b.p;
+}
+
 /* ======================================================================
  * validate_graph: integrity audit (observation limits + dangling edges)
  * ====================================================================== */
 
-u32 graph_validate_obs(graph_t *g, u64 *off, u8 *count, u8 *oversize, u32 max) {
+static void validate_obs_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    (void)p;
+    graph_t *g = s->g;
     memfile_t *mf = g->mf;
     u64 log = node_log_off(g);
-    u32 n = rdu32(mf, log + 0), found = 0;
-    for (u32 i = 0; i < n; i++) {
+    for (u32 i = lo; i < hi; i++) {
         u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
         u8 oc = rdu8(mf, e + E_OBSCNT);
         u32 o0 = rdu32(mf, e + E_OBS0), o1 = rdu32(mf, e + E_OBS1);
-        u8 ov = 0; u16 l;
-        if (o0) { (void)st_get(g->st, o0, &l); if (l > 140) ov |= 1; }
-        if (o1) { (void)st_get(g->st, o1, &l); if (l > 140) ov |= 2; }
-        if (oc > 2 || ov) {
-            if (found < max) { off[found] = e; count[found] = oc; oversize[found] = ov; }
-            found++;
-        }
+        u8 ov = 0;
+        if (o0 && st_len(g->st, o0) > 140) ov |= 1;
+        if (o1 && st_len(g->st, o1) > 140) ov |= 2;
+        if (oc > 2 || ov) sbuf_push2(out, e, (u64)oc | (u64)ov << 8);
     }
+}
+
+u32 graph_validate_obs(graph_t *g, u64 *off, u8 *count, u8 *oversize, u32 max) {
+    scan_t s = { .g = g, .count = log_count(g), .part = validate_obs_part };
+    u32 found = 0;
+    if (scan_run(&s))
+        for (u32 p = 0; p < s.nparts; p++)
+            for (size_t i = 0; i + 1 < s.bufs[p].n; i += 2, found++)
+                if (found < max) {
+                    off[found] = s.bufs[p].v[i];
+                    count[found] = (u8)s.bufs[p].v[i + 1];
+                    oversize[found] = (u8)(s.bufs[p].v[i + 1] >> 8);
+                }
+    scan_free(&s);
     return found;
 }
 
-u32 graph_validate_dangling(graph_t *g, u64 *src, u64 *tgt, u32 max) {
+static void dangling_part(scan_t *s, u32 p, u32 lo, u32 hi, scan_buf *out) {
+    (void)p;
+    graph_t *g = s->g;
     memfile_t *mf = g->mf;
     u64 log = node_log_off(g);
-    u32 n = rdu32(mf, log + 0);
-    omap live; omap_init(&live, n * 2 < 256 ? 256 : n * 2);
-    for (u32 i = 0; i < n; i++)
-        omap_put(&live, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8), 1);
-    u32 found = 0;
-    for (u32 i = 0; i < n; i++) {
+    omap *live = s->arg;
+    for (u32 i = lo; i < hi; i++) {
         u64 e = rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8);
         u32 ec = graph_edge_count(g, e);
         if (!ec) continue;
         adj_entry_t *es = malloc((size_t)ec * sizeof(adj_entry_t));
+        if (!es) continue;
         graph_read_edges(g, e, es, ec);
         for (u32 k = 0; k < ec; k++)
-            if (!omap_has(&live, es[k].target_offset)) {
-                if (found < max) { src[found] = e; tgt[found] = es[k].target_offset; }
-                found++;
-            }
+            if (!omap_has(live, es[k].target_offset)) sbuf_push2(out, e, es[k].target_offset);
         free(es);
     }
+}
+
+u32 graph_validate_dangling(graph_t *g, u64 *src, u64 *tgt, u32 max) {
+    memfile_t *mf = g->mf;
+    u64 log = node_log_off(g);
+    u32 n = rdu32(mf, log + 0);
+    omap live; omap_init(&live, n * 2 < 256 ? 256 : n * 2);
+    for (u32 i = 0; i < n; i++)
+        omap_put(&live, rdu64(mf, log + NODE_LOG_HEADER_SIZE + (u64)i * 8), 1);
+    scan_t s = { .g = g, .count = n, .part = dangling_part, .arg = &live };
+    u32 found = 0;
+    if (scan_run(&s))
+        for (u32 p = 0; p < s.nparts; p++)
+            for (size_t i = 0; i + 1 < s.bufs[p].n; i += 2, found++)
+                if (found < max) { src[found] = s.bufs[p].v[i]; tgt[found] = s.bufs[p].v[i + 1]; }
+    scan_free(&s);
     omap_free(&live);
     return found;
 }
@@ -994,6 +3133,17 @@ graph_t *graph_open(const char *graph_path, stringtable_t *st, size_t initial_si
     } else {
         g->header_offset = sizeof(memfile_header_t);   /* the file's first allocation */
     }
+    /* Headers were always allocated a full 64-byte quantum, so older files have a
+     * zeroed refs slot here: build the reverse index once, in place. */
+    if (g->header_offset && !rdu64(g->mf, refs_root(g))) { refs_build(g); memfile_sync(g->mf); }
+    /* The fuzzy name index is built the same way, on the first open of any file without one. */
+    if (g->header_offset && !gaux_root(g, GAUX_FUZZY)) { fuzzy_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !gaux_root(g, GAUX_NAMES)) { names_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !gaux_root(g, GAUX_DUPS)) { dups_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !gaux_root(g, GAUX_TYPES)) { types_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !gaux_root(g, GAUX_RELTYPES)) { reltypes_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !conn_root(g, CONN_ORPHANS)) { orphans_build(g); memfile_sync(g->mf); }
+    if (g->header_offset && !gaux_root(g, GAUX_REL_MTIME)) { recent_build(g); memfile_sync(g->mf); }
     memfile_unlock(g->mf);
 
     if (g->header_offset == 0) { graph_close(g); return NULL; }
@@ -4,11 +4,13 @@
  * Layouts are the v2 graph schema (ported verbatim from graphfile.ts):
  *   EntityRecord: 72 bytes  (name_id, type_id, adj_offset, mtime, obsMtime,
  *                            obs_count, obs0_id, obs1_id, structural/walker visits, psi)
+ *                 + v2 tail: name/type bytes inline when short (entity.h)
  *   AdjEntry:     24 bytes  (target<<2|dir, relType_id, mtime); bidirectional storage
  *   NodeLog:      [count,capacity][u64 offsets...]
  *
  * v3 additions:
  *   - Graph header carries a PERSISTENT name index (name_id -> entity offset).
+ *   - ... and a reverse string index (string id -> entity refs with their role).
  *   - Graph SCHEMA version lives in the graph header, separate from the memfile
  *     FORMAT version (which memfile.c owns and pins to 3).
  *
@@ -22,7 +24,7 @@
 #include "stringtable.h"
 
 #define GRAPH_SCHEMA_VERSION 2u
-#define ENTITY_RECORD_SIZE   76u   /* [u32 version][72B body] — biscuit-style versioned record */
+#define ENTITY_RECORD_SIZE   124u  /* [u32 version][120B v2 body] — biscuit-style versioned record */
 #define ADJ_ENTRY_SIZE       24u
 #define ADJ_HEADER_SIZE      8u
 #define NODE_LOG_HEADER_SIZE 8u
@@ -70,6 +72,39 @@ u64  graph_create_entity(graph_t *g, const u8 *name, u16 name_len,
                          const u8 *type, u16 type_len, u64 mtime); /* offset (existing if dup) */
 int  graph_delete_entity(graph_t *g, u64 offset);              /* 1 if deleted, 0 if absent */
 void graph_read_entity(graph_t *g, u64 offset, entity_t *out);
+/* fuzzy name lookup: live entities whose case-folded name is within `maxd`
+ * (<= GRAPH_FUZZY_MAX_DIST) edits of the folded `name` — insertions, deletions,
+ * substitutions and adjacent transpositions of code points. Best `k` by
+ * distance, ties to the lower offset; dist[i] gets each distance. */
+#define GRAPH_FUZZY_MAX_DIST 2u
+u32  graph_fuzzy_lookup(graph_t *g, const u8 *name, u16 len, u32 maxd, u32 k, u64 *out, u32 *dist);
+/* near duplicates: each entity's folded name + observations carries a MinHash
+ * sketch, banded for LSH (minhash.h); similarity is the sketch estimate of the
+ * Jaccard similarity of their 4-byte shingles. Both 0 when the index is missing. */
+/* live entities whose text is within min_sim of the (folded) `text`: best `k`
+ * by similarity, ties to the lower offset; sim[i] gets each estimate */
+u32  graph_near_duplicates(graph_t *g, const u8 *text, u32 len, double min_sim, u32 k, u64 *out, double *sim);
+/* every cluster of entities chained by near-duplicate pairs: out[] grouped by
+ * cluster (cluster[i] numbers them from 0, by least offset; offsets ascend
+ * within one). Returns the true count (may exceed max). */
+u32  graph_duplicate_clusters(graph_t *g, double min_sim, u64 *out, u32 *cluster, u32 max);
+/* entity vectors: one client-supplied vector per entity (an embedding) under
+ * an HNSW index by cosine similarity (hnsw.h); deleting an entity drops its
+ * vector. All 0 when the index is missing or the dimension differs. */
+#define GRAPH_VEC_F32 0u
+#define GRAPH_VEC_F16 1u
+#define GRAPH_VEC_I8  2u
+/* create the index (dim <= 4096, a GRAPH_VEC_* format); 1 too if it already
+ * exists with that dim and format */
+int  graph_vector_index(graph_t *g, u32 dim, u32 format);
+int  graph_vector_info(graph_t *g, u32 *dim, u32 *format, u32 *count);
+int  graph_set_vector(graph_t *g, u64 off, const float *v, u32 dim);   /* 0 also for a zero vector */
+int  graph_clear_vector(graph_t *g, u64 off);                          /* 1 if it had one */
+int  graph_get_vector(graph_t *g, u64 off, float *out);                /* unit length, as stored */
+/* the best k entities for query q, by similarity descending (ties to the lower
+ * offset); with a type only entities of it. sim[i] = cosine similarity. */
+u32  graph_vector_search(graph_t *g, const float *q, u32 dim, const u8 *type, u16 type_len,
+                         u32 k, u64 *out, double *sim);
 
 /* relation ops (bidirectional edges) */
 int  graph_create_relation(graph_t *g, u64 from, u64 to, const u8 *rt, u16 rt_len, u64 mtime);
@@ -87,20 +122,96 @@ u32  graph_entity_count(graph_t *g);
 /* observations */
 int  graph_add_observation(graph_t *g, u64 off, const u8 *obs, u16 len, u64 mtime);
 int  graph_remove_observation(graph_t *g, u64 off, const u8 *obs, u16 len, u64 mtime);
+/* train the string table's symbol dictionary (once) + pack observations; returns #packed */
+u32  graph_compress_observations(graph_t *g);
 
 /* scans / enumeration */
+/* name/type bytes: inline from the record when they fit, else via the string table.
+ * The pointer is into an mmap — valid until the next alloc on either file — or,
+ * for text that shares a packed entry, into st_get's decode ring (stringtable.h). */
 const u8 *graph_entity_name(graph_t *g, u64 off, u16 *len_out);
+const u8 *graph_entity_type(graph_t *g, u64 off, u16 *len_out);
+/* the inline copy alone: NULL when the record has none (v1, or too long) */
+const u8 *graph_entity_name_inline(graph_t *g, u64 off, u16 *len_out);
+const u8 *graph_entity_type_inline(graph_t *g, u64 off, u16 *len_out);
 u32  graph_list_entities(graph_t *g, u64 *out, u32 max);
+/* by the persistent type index: offsets ascending, O(matches); returns the type's count */
 u32  graph_entities_by_type(graph_t *g, const u8 *type, u16 len, u64 *out, u32 max);
+/* entities without relations, offsets ascending (a maintained set) */
 u32  graph_orphaned(graph_t *g, u64 *out, u32 max);
-u32  graph_relation_count(graph_t *g);
+u32  graph_relation_count(graph_t *g);                       /* O(1) from the relation-type catalog */
 u32  graph_entity_types(graph_t *g, u32 *out, u32 max);     /* distinct type ids */
+/* distinct type ids ascending with their entity counts (counts may be NULL) */
+u32  graph_entity_type_counts(graph_t *g, u32 *ids, u32 *counts, u32 max);
 u32  graph_relation_types(graph_t *g, u32 *out, u32 max);   /* distinct relType ids */
+/* distinct relType ids ascending with their relation counts (counts may be NULL) */
+u32  graph_relation_type_counts(graph_t *g, u32 *ids, u32 *counts, u32 max);
 
-/* search: POSIX ERE over name + type + observations; returns all matches */
+/* string reverse index: refs are entity_offset | role, ascending (offsets are 32-aligned) */
+#define GRAPH_REF_NAME 1u
+#define GRAPH_REF_TYPE 2u
+#define GRAPH_REF_OBS  4u
+#define GRAPH_REF_MASK 31u
+/* refs to string `sid` from live entities; returns the true count (may exceed max) */
+u32  graph_string_refs(graph_t *g, u32 sid, u64 *out, u32 max);
+
+/* search: POSIX ERE over name + type + observations; returns all matches.
+ * Each distinct string is matched once (via the reverse index); order is by offset. */
+#define GRAPH_SEARCH_ICASE 1u   /* match folded pattern against case-folded text (string-table shadows) */
 u32  graph_search(graph_t *g, const char *pattern, u64 *out, u32 max);
+u32  graph_search_ex(graph_t *g, const char *pattern, u32 flags, u64 *out, u32 max);
+/* Paged search: at most `limit` results starting at `cursor`; *next = the
+ * cursor of the following page, 0 when this one is the last.
+ *   unranked (GRAPH_RANK_NONE): node-log order; the cursor is a node-log
+ *     position and the scan stops once the page is full. *total is not counted.
+ *   ranked: the cursor is a rank position; every match is visited but only the
+ *     best cursor + limit are kept. *total = all matches. Ties go to the lower offset. */
+#define GRAPH_RANK_NONE       0u
+#define GRAPH_RANK_MTIME      1u
+#define GRAPH_RANK_OBS_MTIME  2u
+#define GRAPH_RANK_STRUCTURAL 3u   /* pagerank: structural visits */
+#define GRAPH_RANK_WALKER     4u   /* llmrank: walker visits, then structural */
+#define GRAPH_RANK_NAME       5u   /* name order (below); walks the name tree instead */
+#define GRAPH_RANK_KEY        0xffu
+#define GRAPH_RANK_ASC        0x100u  /* default is descending */
+u32  graph_search_page(graph_t *g, const char *pattern, u32 flags, u32 rank, u32 cursor, u32 limit,
+                       u64 *out, u32 *next, u32 *total);
+/* as graph_search_page, and *matches = every match (malloc'd, *total of them;
+ * the caller frees it), taken from the same pass on ranked pages. An unranked
+ * page then runs a full search besides its early-stopping scan, and *total
+ * counts that. *matches is NULL on OOM. */
+u32  graph_search_page_ex(graph_t *g, const char *pattern, u32 flags, u32 rank, u32 cursor, u32 limit,
+                          u64 *out, u32 *next, u32 *total, u64 **matches);
+/* sort n entity offsets in place by a rank (the same order and ties as ranked
+ * pages; GRAPH_RANK_NAME included), reading only those records. 0 on OOM. */
+int  graph_rank_sort(graph_t *g, u64 *offs, u32 n, u32 rank);
+/* the page of offs[cursor..n) the server's paginateItems would emit, as JSON
+ * text: {"items":[...],"nextCursor":c|null,"totalCount":n}, each item an entity
+ * {name, entityType, observations, mtime?, obsMtime?}, items added while
+ * the text stays within max_chars UTF-16 units (at least one). *next = the
+ * following cursor, 0 on the last page. malloc'd (NUL-terminated); NULL on OOM. */
+char *graph_json_page(graph_t *g, const u64 *offs, u32 n, u32 cursor, u32 max_chars,
+                      u32 *next, size_t *len);
+/* full-text: BM25 over each entity's folded name + observations (textindex.h).
+ * The index is built on demand and then kept current by the mutators. Search
+ * returns the best k by score (descending, ties to the lower offset); 0 when
+ * no index exists. */
+int  graph_build_text_index(graph_t *g);      /* no-op if built; 0 on failure */
+int  graph_has_text_index(graph_t *g);
+u32  graph_text_search(graph_t *g, const u8 *query, u32 len, u32 k, u64 *out, double *scores);
+/* name order: live entities by case-folded name (code-point order), then raw
+ * name, then offset — a B+tree kept current by create/delete (btree.h).
+ * Positions are ranks in that order; all return 0 when the tree is missing. */
+int  graph_has_name_index(graph_t *g);
+u32  graph_name_rank(graph_t *g, const u8 *name, u16 len);    /* rank of the first name >= folded `name` */
+/* names starting with the folded prefix: *first = rank of the first; returns how many */
+u32  graph_name_prefix(graph_t *g, const u8 *prefix, u16 len, u32 *first);
+/* up to `max` entities from rank `pos`, walking up (or down, when desc) */
+u32  graph_names_at(graph_t *g, u32 pos, u32 max, int desc, u64 *out);
 /* validity of a pattern under the SAME POSIX ERE engine used to match (1 = valid) */
 int  graph_regex_valid(const char *pattern);
+/* 1 iff the pattern yields trigrams, i.e. an indexed search need not scan everything */
+int  graph_regex_indexable(const char *pattern);
 
 /* traversal */
 u32  graph_neighbors(graph_t *g, u64 start, u32 depth, u32 direction, u64 *out, u32 max);
@@ -111,6 +222,39 @@ u32  graph_find_path(graph_t *g, u64 from, u64 to, u32 max_depth, u32 direction,
 u32  graph_find_path_ex(graph_t *g, u64 from, u64 to, u32 max_depth, u32 direction,
                         u64 budget_bytes, u64 *out_path, u32 max_path,
                         int *target_reached, int *budget_exhausted, u64 *farthest);
+/* same contract, searched from both ends (the smaller frontier level expands
+ * each round); farthest is the deepest node on the `from` side. */
+u32  graph_find_path_bidi(graph_t *g, u64 from, u64 to, u32 max_depth, u32 direction,
+                          u64 budget_bytes, u64 *out_path, u32 max_path,
+                          int *target_reached, int *budget_exhausted, u64 *farthest);
+
+/* connected components, edges undirected: union-find labels kept as relations
+ * are created and dropped when one is removed (it may split a component).
+ * graph_build_components relabels (exclusive lock; no-op while current). */
+int  graph_has_components(graph_t *g);
+int  graph_build_components(graph_t *g);
+u64  graph_component(graph_t *g, u64 off);   /* representative entity; 0 without labels */
+/* entities outside anchor's component (all of them for anchor 0), in node log
+ * order; by labels when current, else by a BFS from anchor. Returns the total. */
+u32  graph_outside_component(graph_t *g, u64 anchor, u64 *out, u32 max);
+
+/* relations touching an entity set, each once: DIR_FORWARD = out of the set,
+ * DIR_BACKWARD = into it, DIR_ANY = both ends in it (the induced subgraph).
+ * Grouped by set member in the given order, then adjacency order; returns the
+ * total (may exceed max). At most the sum of the members' edge counts. */
+typedef struct { u64 from, to, mtime; u32 rel_type_id, pad; } graph_rel_t;
+u32  graph_set_relations(graph_t *g, const u64 *set, u32 n, u32 direction, graph_rel_t *out, u32 max);
+
+/* recency: B+trees on entity mtime, entity obsMtime and relation mtime, kept
+ * by the mutators. Newest first unless asc; positions count the entries with
+ * a timestamp >= since, *total = how many there are (both O(log n)).
+ * key: GRAPH_RANK_MTIME or GRAPH_RANK_OBS_MTIME, | GRAPH_RANK_ASC. */
+u32  graph_changed_since(graph_t *g, u32 key, u64 since, u32 pos, u32 max, u64 *out, u32 *total);
+/* relation entries are (instant, from, to): every type linking the pair at
+ * that instant comes out together, never split across calls unless one entry
+ * alone exceeds max. entry[i] (may be NULL) = out[i]'s entry position. */
+u32  graph_relations_since(graph_t *g, u64 since, int asc, u32 pos, u32 max,
+                           graph_rel_t *out, u32 *entry, u32 *total);
 
 /* validate_graph: integrity audit */
 u32  graph_validate_obs(graph_t *g, u64 *off, u8 *count, u8 *oversize, u32 max);  /* >2 obs or >140-byte obs */
@@ -132,6 +276,26 @@ void graph_set_entity_fields(graph_t *g, u64 off, u64 mtime, u64 obs_mtime,
 void graph_set_totals(graph_t *g, u64 structural_total, u64 walker_total);
 u32    graph_structural_sample(graph_t *g, u32 iterations, double damping);  /* MC pagerank; total visits */
 u32    graph_compute_merw_psi(graph_t *g, double alpha, u32 max_iter, double tol);  /* iters run */
+/* The two above, split so the long part can run off-thread without a lock:
+ * graph_rank_snapshot (shared lock; one pass over records and adjacency) copies
+ * the entities, their name ids and the forward adjacency into r;
+ * graph_rank_compute then walks and solves on r alone, touching no file, with
+ * its own generator from seed (e.g. graph_rng_fork()); graph_rank_apply
+ * (exclusive lock) adds the sampled visits and stores psi for the entities
+ * still live under the same name id. snapshot/compute return 0 when out of
+ * memory. */
+typedef struct {
+    u32 n; u64 *offs; u32 *names;                 /* snapshot: entities, their name ids */
+    u32 *rowoff, *col;                            /* snapshot: forward adjacency by position */
+    u32 *visits; double *psi;                     /* per entity; psi holds the stored values until computed */
+    u32 total, iters;                             /* visits sampled, MERW iterations */
+} graph_rank_t;
+u64    graph_rng_fork(void);   /* next draw of the global generator, as a seed */
+int    graph_rank_snapshot(graph_t *g, graph_rank_t *r);
+int    graph_rank_compute(graph_rank_t *r, u32 iterations, double damping, double alpha, u32 max_iter, double tol,
+                          u64 seed);
+void   graph_rank_apply(graph_t *g, const graph_rank_t *r);
+void   graph_rank_free(graph_rank_t *r);
 /* random walk; mode: 1=merw (weighted by psi), 0=uniform; seed 0 = use global rng. Returns path node count. */
 u32    graph_random_walk(graph_t *g, u64 start, u32 depth, u32 direction, int merw_mode,
                          u64 seed, u64 *out_path, u32 max_path);
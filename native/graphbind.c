@@ -11,10 +11,24 @@
 #include <fcntl.h>
 #include <sys/file.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "stringtable.h"
 #include "graph.h"
 
-typedef struct { stringtable_t *st; graph_t *g; } Store;
+/* JS strings of string-table ids, made once per process: a direct-mapped
+ * table of STR_CACHE slots, the ids here and the strings in a JS array held
+ * by `cache`. Emptied whenever the table's free generation moves, since a
+ * freed id may come back naming other text. Long strings are not kept. */
+#define STR_CACHE 1024u
+#define STR_CACHE_MAX 256u
+typedef struct {
+    stringtable_t *st; graph_t *g;
+    napi_ref cache; u32 cache_gen; u64 cache_ids[STR_CACHE];
+    /* Async work runs on libuv threads next to the JS thread. flock(2) is per
+     * open file, so it can't keep them apart: rw does, in-process, and the
+     * readers sharing it share one flock (first takes it, last drops it). */
+    pthread_rwlock_t rw; pthread_mutex_t mu; u32 readers; int writer;
+} Store;
 
 #define NCALL(call) do { if ((call) != napi_ok) { napi_throw_error(env, NULL, "napi: " #call); return NULL; } } while (0)
 
@@ -46,9 +60,70 @@ static char *getStrA(napi_env env, napi_value v, u16 *len_out) {
 static Store *unwrap(napi_env env, napi_value v) { Store *s = NULL; napi_get_value_external(env, v, (void **)&s); return s; }
 
 static void store_finalize(napi_env env, void *data, void *hint) {
-    (void)env; (void)hint;
+    (void)hint;
     Store *s = (Store *)data;
-    if (s) { if (s->g) graph_close(s->g); if (s->st) st_close(s->st); free(s); }
+    if (s) {
+        if (s->cache) napi_delete_reference(env, s->cache);
+        if (s->g) graph_close(s->g);
+        if (s->st) st_close(s->st);
+        pthread_rwlock_destroy(&s->rw); pthread_mutex_destroy(&s->mu); free(s);
+    }
+}
+
+/* the string with table id `id` ("" for 0), from the cache when it is there */
+static napi_value str_id(napi_env env, Store *s, u64 id) {
+    napi_value arr = NULL, v;
+    if (!s->cache) {
+        if (napi_create_array_with_length(env, STR_CACHE, &arr) != napi_ok
+            || napi_create_reference(env, arr, 1, &s->cache) != napi_ok) { arr = NULL; s->cache = NULL; }
+    } else if (napi_get_reference_value(env, s->cache, &arr) != napi_ok) arr = NULL;
+    u32 gen = st_generation(s->st), slot = (u32)(id >> 5) & (STR_CACHE - 1);   /* ids are 32-byte aligned */
+    if (gen != s->cache_gen) { memset(s->cache_ids, 0, sizeof s->cache_ids); s->cache_gen = gen; }
+    if (arr && id && s->cache_ids[slot] == id && napi_get_element(env, arr, slot, &v) == napi_ok) return v;
+    u16 l = 0; const u8 *p = id ? st_get(s->st, id, &l) : NULL;
+    napi_create_string_utf8(env, p ? (const char *)p : "", p ? l : 0, &v);
+    if (arr && id && l <= STR_CACHE_MAX && napi_set_element(env, arr, slot, v) == napi_ok) s->cache_ids[slot] = id;
+    return v;
+}
+
+/* an entity's name (type when `type`): the record's inline bytes when it has
+ * them, so short names skip the table; otherwise str_id on the table id */
+static napi_value ent_str(napi_env env, Store *s, u64 off, u32 id, int type) {
+    u16 l = 0;
+    const u8 *p = type ? graph_entity_type_inline(s->g, off, &l) : graph_entity_name_inline(s->g, off, &l);
+    if (!p) return str_id(env, s, id);
+    napi_value v; napi_create_string_utf8(env, (const char *)p, l, &v);
+    return v;
+}
+
+/* ---- locking: any thread; not reentrant. Taking the file locks remaps both
+ * files to pick up growth by other processes, which is safe exactly then:
+ * nothing else in-process is reading, and nobody can grow them meanwhile. */
+static void files_lock(Store *s, int ex) {
+    if (!s->g) return;
+    if (ex) { memfile_lock_exclusive(s->g->mf); st_lock_exclusive(s->st); }
+    else    { memfile_lock_shared(s->g->mf); st_lock_shared(s->st); }
+    memfile_refresh(s->g->mf); memfile_refresh(s->st->mf);
+}
+static void files_unlock(Store *s) { if (s->g) { st_unlock(s->st); memfile_unlock(s->g->mf); } }
+
+static void store_lock_shared(Store *s) {
+    pthread_rwlock_rdlock(&s->rw);
+    pthread_mutex_lock(&s->mu);
+    if (s->readers++ == 0) files_lock(s, 0);
+    pthread_mutex_unlock(&s->mu);
+}
+static void store_lock_exclusive(Store *s) {
+    pthread_rwlock_wrlock(&s->rw);
+    files_lock(s, 1);
+    s->writer = 1;
+}
+static void store_unlock(Store *s) {
+    pthread_mutex_lock(&s->mu);
+    if (s->writer) { s->writer = 0; files_unlock(s); }
+    else if (s->readers && --s->readers == 0) files_unlock(s);
+    pthread_mutex_unlock(&s->mu);
+    pthread_rwlock_unlock(&s->rw);
 }
 
 /* ---- args helper ---- */
@@ -63,19 +138,42 @@ static napi_value n_open(napi_env env, napi_callback_info info) {
     getStr(env, argv[1], sp, sizeof sp);
     uint32_t initial = getU32(env, argv[2]);
     Store *s = calloc(1, sizeof(Store));
+    if (!s) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    pthread_rwlock_init(&s->rw, NULL); pthread_mutex_init(&s->mu, NULL);
     s->st = st_open(sp, initial);
     s->g  = s->st ? graph_open(gp, s->st, initial) : NULL;
-    if (!s->st || !s->g) { if (s->g) graph_close(s->g); if (s->st) st_close(s->st); free(s);
+    if (!s->st || !s->g) { if (s->g) graph_close(s->g); if (s->st) st_close(s->st);
+        pthread_rwlock_destroy(&s->rw); pthread_mutex_destroy(&s->mu); free(s);
         napi_throw_error(env, NULL, "graph store open failed"); return NULL; }
     napi_value ext; NCALL(napi_create_external(env, s, store_finalize, NULL, &ext));
     return ext;
 }
-static napi_value n_close(napi_env env, napi_callback_info info) { ARGS(1); STORE; if (s) { if (s->g) graph_close(s->g); if (s->st) st_close(s->st); s->g = NULL; s->st = NULL; } return NULL; }
+/* close waits out an async snapshot or apply in progress; work that reaches
+ * either after it finds no graph */
+static napi_value n_close(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE;
+    if (s) {
+        pthread_rwlock_wrlock(&s->rw);
+        if (s->g) graph_close(s->g);
+        if (s->st) st_close(s->st);
+        s->g = NULL; s->st = NULL;
+        pthread_rwlock_unlock(&s->rw);
+    }
+    return NULL;
+}
 static napi_value n_sync(napi_env env, napi_callback_info info)  { ARGS(1); STORE; graph_sync(s->g); st_sync(s->st); return NULL; }
-static napi_value n_lock_sh(napi_env env, napi_callback_info info){ ARGS(1); STORE; memfile_lock_shared(s->g->mf); st_lock_shared(s->st); return NULL; }
-static napi_value n_lock_ex(napi_env env, napi_callback_info info){ ARGS(1); STORE; memfile_lock_exclusive(s->g->mf); st_lock_exclusive(s->st); return NULL; }
-static napi_value n_unlock(napi_env env, napi_callback_info info) { ARGS(1); STORE; st_unlock(s->st); memfile_unlock(s->g->mf); return NULL; }
-static napi_value n_refresh(napi_env env, napi_callback_info info){ ARGS(1); STORE; memfile_refresh(s->g->mf); memfile_refresh(s->st->mf); return NULL; }
+static napi_value n_lock_sh(napi_env env, napi_callback_info info){ ARGS(1); STORE; store_lock_shared(s); return NULL; }
+static napi_value n_lock_ex(napi_env env, napi_callback_info info){ ARGS(1); STORE; store_lock_exclusive(s); return NULL; }
+static napi_value n_unlock(napi_env env, napi_callback_info info) { ARGS(1); STORE; store_unlock(s); return NULL; }
+/* Locking already remaps; this stays for callers that hold the files some other
+ * way. Skipped while async work shares the lock (it must not move under them). */
+static napi_value n_refresh(napi_env env, napi_callback_info info){
+    ARGS(1); STORE;
+    pthread_mutex_lock(&s->mu);
+    if (s->readers <= 1) { memfile_refresh(s->g->mf); memfile_refresh(s->st->mf); }
+    pthread_mutex_unlock(&s->mu);
+    return NULL;
+}
 
 /* ---- entity ops ---- */
 static napi_value n_lookup(napi_env env, napi_callback_info info) {
@@ -83,6 +181,21 @@ static napi_value n_lookup(napi_env env, napi_callback_info info) {
     napi_value r = mkU64(env, graph_lookup(s->g, (const u8 *)nm, l));
     free(nm); return r;
 }
+/* (handle, name, maxDist, k) -> [{offset, distance}], nearest first */
+static napi_value n_fuzzy_lookup(napi_env env, napi_callback_info info) {
+    ARGS(4); STORE; u16 l; char *nm = getStrA(env, argv[1], &l);
+    u32 maxd = getU32(env, argv[2]), k = getU32(env, argv[3]);
+    u64 *out = malloc(((size_t)k + 1) * 8); u32 *dist = malloc(((size_t)k + 1) * 4);
+    u32 n = nm && out && dist ? graph_fuzzy_lookup(s->g, (const u8 *)nm, l, maxd, k, out, dist) : 0;
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0; i < n; i++) {
+        napi_value o; napi_create_object(env, &o);
+        napi_set_named_property(env, o, "offset", mkU64(env, out[i]));
+        napi_set_named_property(env, o, "distance", mkU32(env, dist[i]));
+        napi_set_element(env, arr, i, o);
+    }
+    free(nm); free(out); free(dist); return arr;
+}
 static napi_value n_create_entity(napi_env env, napi_callback_info info) {
     ARGS(4); STORE;
     u16 nl, tl; char *nm = getStrA(env, argv[1], &nl), *ty = getStrA(env, argv[2], &tl);
@@ -100,8 +213,8 @@ static napi_value n_read_entity(napi_env env, napi_callback_info info) {
     entity_t e; graph_read_entity(s->g, off, &e);
     napi_value o; NCALL(napi_create_object(env, &o));
     u16 l; const u8 *p;
-    p = st_get(s->st, e.name_id, &l); napi_value nm; napi_create_string_utf8(env, (const char *)p, l, &nm); napi_set_named_property(env, o, "name", nm);
-    p = st_get(s->st, e.type_id, &l); napi_value ty; napi_create_string_utf8(env, (const char *)p, l, &ty); napi_set_named_property(env, o, "type", ty);
+    napi_set_named_property(env, o, "name", ent_str(env, s, off, e.name_id, 0));
+    napi_set_named_property(env, o, "type", ent_str(env, s, off, e.type_id, 1));
     napi_value obs; napi_create_array(env, &obs); u32 oi = 0;
     if (e.obs0_id) { p = st_get(s->st, e.obs0_id, &l); napi_value s0; napi_create_string_utf8(env, (const char *)p, l, &s0); napi_set_element(env, obs, oi++, s0); }
     if (e.obs1_id) { p = st_get(s->st, e.obs1_id, &l); napi_value s1; napi_create_string_utf8(env, (const char *)p, l, &s1); napi_set_element(env, obs, oi++, s1); }
@@ -113,6 +226,84 @@ static napi_value n_read_entity(napi_env env, napi_callback_info info) {
     napi_set_named_property(env, o, "psi", mkF64(env, e.psi));
     return o;
 }
+
+/* Column mask of read_entities (must match READ_* in src/store.ts). */
+#define READ_NAME   0x01u
+#define READ_TYPE   0x02u
+#define READ_OBS    0x04u   /* both observation slots, plus the obs presence bits */
+#define READ_TIMES  0x08u   /* mtime, obsMtime */
+#define READ_VISITS 0x10u   /* structuralVisits, walkerVisits */
+#define READ_PSI    0x20u
+
+/* a fresh n-element typed array set as o[key]; its storage in *data */
+static int column(napi_env env, napi_value o, const char *key, napi_typedarray_type t, size_t n, size_t w, void **data) {
+    napi_value ab, arr;
+    if (napi_create_arraybuffer(env, n * w, data, &ab) != napi_ok
+        || napi_create_typedarray(env, t, n, ab, 0, &arr) != napi_ok) return 0;
+    return napi_set_named_property(env, o, key, arr) == napi_ok;
+}
+
+/* read_entities(h, offsets[], fields) -> columns of the READ_* fields asked for
+ * { count, text: Uint8Array, spans: Uint32Array, obs: Uint8Array, mtime, obsMtime,
+ *   structuralVisits, walkerVisits, psi: Float64Array }
+ * Strings are UTF-8 in one text buffer: entity i's string slots (name, type,
+ * obs0, obs1, those asked for) are k consecutive spans, slot j of entity i
+ * running text[spans[i*k+j] .. spans[i*k+j+1]). obs[i] has bit 0/1 set when
+ * observation slot 0/1 holds one (an empty slot reads as ""). */
+static napi_value n_read_entities(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; u32 n = 0, f = getU32(env, argv[2]);
+    napi_get_array_length(env, argv[1], &n);
+    u32 k = !!(f & READ_NAME) + !!(f & READ_TYPE) + (f & READ_OBS ? 2 : 0);
+    u64 *v = malloc(((size_t)n + 1) * 8);
+    if (!v) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    size_t bytes = 0;
+    for (u32 i = 0; i < n; i++) {
+        napi_value e; napi_get_element(env, argv[1], i, &e); v[i] = getU64(env, e);
+        entity_t r; u16 l = 0; graph_read_entity(s->g, v[i], &r);
+        if ((f & READ_NAME) && graph_entity_name(s->g, v[i], &l)) bytes += l;
+        if ((f & READ_TYPE) && graph_entity_type(s->g, v[i], &l)) bytes += l;
+        if (f & READ_OBS) {
+            if (r.obs0_id && st_get(s->st, r.obs0_id, &l)) bytes += l;
+            if (r.obs1_id && st_get(s->st, r.obs1_id, &l)) bytes += l;
+        }
+    }
+
+    napi_value o; void *text = NULL, *spans = NULL, *obs = NULL;
+    double *mt = NULL, *omt = NULL, *sv = NULL, *wv = NULL, *psi = NULL;
+    int ok = napi_create_object(env, &o) == napi_ok
+          && column(env, o, "text", napi_uint8_array, bytes, 1, &text)
+          && column(env, o, "spans", napi_uint32_array, (size_t)n * k + 1, 4, &spans)
+          && (!(f & READ_OBS) || column(env, o, "obs", napi_uint8_array, n, 1, &obs))
+          && (!(f & READ_TIMES) || (column(env, o, "mtime", napi_float64_array, n, 8, (void **)&mt)
+                                    && column(env, o, "obsMtime", napi_float64_array, n, 8, (void **)&omt)))
+          && (!(f & READ_VISITS) || (column(env, o, "structuralVisits", napi_float64_array, n, 8, (void **)&sv)
+                                     && column(env, o, "walkerVisits", napi_float64_array, n, 8, (void **)&wv)))
+          && (!(f & READ_PSI) || column(env, o, "psi", napi_float64_array, n, 8, (void **)&psi));
+    if (!ok) { free(v); napi_throw_error(env, NULL, "napi: entity columns"); return NULL; }
+
+    /* nothing allocates from here on, so the record pointers stay valid */
+    u8 *t = text; u32 *sp = spans, at = 0, j = 0;
+    for (u32 i = 0; i < n; i++) {
+        entity_t r; u16 l = 0; const u8 *p; graph_read_entity(s->g, v[i], &r);
+        /* bytes == 0 can leave text NULL: copy only non-empty strings */
+#define PUT(p_, l_) do { sp[j++] = at; if ((p_) && (l_)) { memcpy(t + at, (p_), (l_)); at += (l_); } } while (0)
+        if (f & READ_NAME) { p = graph_entity_name(s->g, v[i], &l); PUT(p, l); }
+        if (f & READ_TYPE) { p = graph_entity_type(s->g, v[i], &l); PUT(p, l); }
+        if (f & READ_OBS) {
+            p = r.obs0_id ? st_get(s->st, r.obs0_id, &l) : NULL; PUT(p, l);
+            p = r.obs1_id ? st_get(s->st, r.obs1_id, &l) : NULL; PUT(p, l);
+            ((u8 *)obs)[i] = (r.obs0_id ? 1 : 0) | (r.obs1_id ? 2 : 0);
+        }
+#undef PUT
+        if (mt) { mt[i] = (double)r.mtime; omt[i] = (double)r.obs_mtime; }
+        if (sv) { sv[i] = (double)r.structural_visits; wv[i] = (double)r.walker_visits; }
+        if (psi) psi[i] = r.psi;
+    }
+    sp[j] = at;
+    free(v);
+    napi_set_named_property(env, o, "count", mkU32(env, n));
+    return o;
+}
 static napi_value n_add_obs(napi_env env, napi_callback_info info) {
     ARGS(4); STORE; char ob[4096]; u16 l = getStr(env, argv[2], ob, sizeof ob);
     napi_value r; napi_get_boolean(env, graph_add_observation(s->g, getU64(env, argv[1]), (const u8 *)ob, l, getU64(env, argv[3])), &r); return r;
@@ -122,6 +313,20 @@ static napi_value n_remove_obs(napi_env env, napi_callback_info info) {
     napi_value r; napi_get_boolean(env, graph_remove_observation(s->g, getU64(env, argv[1]), (const u8 *)ob, l, getU64(env, argv[3])), &r); return r;
 }
 
+static napi_value n_compress_obs(napi_env env, napi_callback_info info) { ARGS(1); STORE; return mkU32(env, graph_compress_observations(s->g)); }
+static napi_value n_build_folds(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, st_build_folds(s->st) != 0, &r); return r;
+}
+static napi_value n_has_folds(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, st_has_folds(s->st) != 0, &r); return r;
+}
+static napi_value n_build_trigrams(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, st_build_trigrams(s->st) != 0, &r); return r;
+}
+static napi_value n_has_trigrams(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, st_has_trigrams(s->st) != 0, &r); return r;
+}
+
 /* ---- relations ---- */
 static napi_value n_create_relation(napi_env env, napi_callback_info info) {
     ARGS(5); STORE; char rt[4096]; u16 l = getStr(env, argv[3], rt, sizeof rt);
@@ -143,9 +348,7 @@ static napi_value n_edges(napi_env env, napi_callback_info info) {
         napi_value o; napi_create_object(env, &o);
         napi_set_named_property(env, o, "target", mkU64(env, es[i].target_offset));
         napi_set_named_property(env, o, "direction", mkU32(env, es[i].direction));
-        u16 l; const u8 *p = st_get(s->st, es[i].rel_type_id, &l);
-        napi_value rt; napi_create_string_utf8(env, (const char *)p, l, &rt);
-        napi_set_named_property(env, o, "relType", rt);
+        napi_set_named_property(env, o, "relType", str_id(env, s, es[i].rel_type_id));
         napi_set_named_property(env, o, "mtime", mkU64(env, es[i].mtime));
         napi_set_element(env, arr, i, o);
     }
@@ -160,19 +363,112 @@ static napi_value u64arr(napi_env env, u64 *buf, u32 n) {
     return arr;
 }
 
+static int cmp_u64v(const void *a, const void *b) { u64 x = *(const u64 *)a, y = *(const u64 *)b; return (x > y) - (x < y); }
+/* index of x in the sorted, distinct v[0..n) (x is known present) */
+static u32 u64_index(const u64 *v, u32 n, u64 x) {
+    u32 lo = 0, hi = n;
+    while (lo < hi) { u32 m = lo + (hi - lo) / 2; if (v[m] < x) lo = m + 1; else hi = m; }
+    return lo;
+}
+/* sort v[0..n) and drop repeats; returns the distinct count */
+static u32 u64_distinct(u64 *v, u32 n) {
+    if (n) qsort(v, n, 8, cmp_u64v);
+    u32 d = 0;
+    for (u32 i = 0; i < n; i++) if (!d || v[i] != v[d - 1]) v[d++] = v[i];
+    return d;
+}
+
+/* m relations -> { names, types, rels: Uint32Array, mtime: Float64Array }
+ * Packed: relation i is names[rels[3i]] -> names[rels[3i+1]] typed types[rels[3i+2]],
+ * mtime[i] (0 = unset). Each name and type string is made once. Frees rs. */
+static napi_value n_packed_relations(napi_env env, Store *s, graph_rel_t *rs, u32 m) {
+    u64 *nodes = malloc(((size_t)m * 2 + 1) * 8), *types = malloc(((size_t)m + 1) * 8);
+    if (!nodes || !types) { free(rs); free(nodes); free(types); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    for (u32 i = 0; i < m; i++) { nodes[2 * i] = rs[i].from; nodes[2 * i + 1] = rs[i].to; types[i] = rs[i].rel_type_id; }
+    u32 nn = u64_distinct(nodes, 2 * m), nt = u64_distinct(types, m);
+
+    napi_value o, names, tys, ab, packed, mt; void *pd, *md;
+    napi_create_object(env, &o);
+    napi_create_array_with_length(env, nn, &names);
+    for (u32 i = 0; i < nn; i++) {
+        entity_t e; graph_read_entity(s->g, nodes[i], &e);
+        napi_set_element(env, names, i, ent_str(env, s, nodes[i], e.name_id, 0));
+    }
+    napi_create_array_with_length(env, nt, &tys);
+    for (u32 i = 0; i < nt; i++) napi_set_element(env, tys, i, str_id(env, s, types[i]));
+    napi_value mab;
+    int ok = napi_create_arraybuffer(env, (size_t)m * 12, &pd, &ab) == napi_ok
+          && napi_create_typedarray(env, napi_uint32_array, (size_t)m * 3, ab, 0, &packed) == napi_ok
+          && napi_create_arraybuffer(env, (size_t)m * 8, &md, &mab) == napi_ok
+          && napi_create_typedarray(env, napi_float64_array, m, mab, 0, &mt) == napi_ok;
+    for (u32 i = 0; ok && i < m; i++) {
+        ((u32 *)pd)[3 * i] = u64_index(nodes, nn, rs[i].from);
+        ((u32 *)pd)[3 * i + 1] = u64_index(nodes, nn, rs[i].to);
+        ((u32 *)pd)[3 * i + 2] = u64_index(types, nt, rs[i].rel_type_id);
+        ((double *)md)[i] = (double)rs[i].mtime;
+    }
+    free(rs); free(nodes); free(types);
+    if (!ok) { napi_throw_error(env, NULL, "napi: packed relations"); return NULL; }
+    napi_set_named_property(env, o, "names", names);
+    napi_set_named_property(env, o, "types", tys);
+    napi_set_named_property(env, o, "rels", packed);
+    napi_set_named_property(env, o, "mtime", mt);
+    return o;
+}
+
+/* set_relations(h, offsets[], direction) -> packed relations (above) */
+static napi_value n_set_relations(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; u32 n = 0, cap = 0, dir = getU32(env, argv[2]);
+    napi_get_array_length(env, argv[1], &n);
+    u64 *set = malloc(((size_t)n + 1) * 8);
+    if (!set) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    for (u32 i = 0; i < n; i++) {
+        napi_value e; napi_get_element(env, argv[1], i, &e);
+        set[i] = getU64(env, e);
+        if (set[i]) cap += graph_edge_count(s->g, set[i]);
+    }
+    graph_rel_t *rs = malloc(((size_t)cap + 1) * sizeof *rs);
+    if (!rs) { free(set); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    u32 m = graph_set_relations(s->g, set, n, dir, rs, cap);
+    free(set);
+    return n_packed_relations(env, s, rs, m < cap ? m : cap);
+}
+
+/* relations_since(h, since, asc, pos, max) -> packed relations + { entry: Uint32Array, total } */
+static napi_value n_relations_since(napi_env env, napi_callback_info info) {
+    ARGS(5); STORE; u32 max = getU32(env, argv[4]), total = 0;
+    graph_rel_t *rs = malloc(((size_t)max + 1) * sizeof *rs);
+    u32 *entry = malloc(((size_t)max + 1) * 4);
+    if (!rs || !entry) { free(rs); free(entry); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    u32 m = graph_relations_since(s->g, getU64(env, argv[1]), getU32(env, argv[2]) != 0, getU32(env, argv[3]),
+                                  max, rs, entry, &total);
+    napi_value o = n_packed_relations(env, s, rs, m), ab, ent; void *ed;
+    if (!o) { free(entry); return NULL; }
+    int ok = napi_create_arraybuffer(env, (size_t)m * 4, &ed, &ab) == napi_ok
+          && napi_create_typedarray(env, napi_uint32_array, m, ab, 0, &ent) == napi_ok;
+    if (ok) memcpy(ed, entry, (size_t)m * 4);
+    free(entry);
+    if (!ok) { napi_throw_error(env, NULL, "napi: relation entries"); return NULL; }
+    napi_set_named_property(env, o, "entry", ent);
+    napi_set_named_property(env, o, "total", mkU32(env, total));
+    return o;
+}
+
 /* ---- traversal / search / scans (full result sets; TS paginates) ---- */
 static napi_value n_neighbors(napi_env env, napi_callback_info info) {
     ARGS(4); STORE; u32 cap = graph_entity_count(s->g) + 1; u64 *out = malloc((size_t)cap * 8);
     u32 n = graph_neighbors(s->g, getU64(env, argv[1]), getU32(env, argv[2]), getU32(env, argv[3]), out, cap);
     napi_value r = u64arr(env, out, n < cap ? n : cap); free(out); return r;
 }
-/* find_path(h, from, to, maxDepth, direction, budgetBytes)
- *   -> { path:[offset], targetReached, budgetExhausted, farthest } */
+/* find_path(h, from, to, maxDepth, direction, budgetBytes, bidi)
+ *   -> { path:[offset], targetReached, budgetExhausted, farthest }
+ * bidi (optional; undefined -> 0) searches from both ends, same contract. */
 static napi_value n_find_path(napi_env env, napi_callback_info info) {
-    ARGS(6); STORE; u32 cap = graph_entity_count(s->g) + 2; u64 *out = malloc((size_t)cap * 8);
+    ARGS(7); STORE; u32 cap = graph_entity_count(s->g) + 2; u64 *out = malloc((size_t)cap * 8);
     int tr = 0, be = 0; u64 fa = 0;
-    u32 n = graph_find_path_ex(s->g, getU64(env, argv[1]), getU64(env, argv[2]), getU32(env, argv[3]),
-                               getU32(env, argv[4]), getU64(env, argv[5]), out, cap, &tr, &be, &fa);
+    u32 n = (getU32(env, argv[6]) ? graph_find_path_bidi : graph_find_path_ex)(
+        s->g, getU64(env, argv[1]), getU64(env, argv[2]), getU32(env, argv[3]),
+        getU32(env, argv[4]), getU64(env, argv[5]), out, cap, &tr, &be, &fa);
     if (n > cap) n = cap;
     napi_value o; napi_create_object(env, &o);
     napi_set_named_property(env, o, "path", u64arr(env, out, n));
@@ -183,20 +479,221 @@ static napi_value n_find_path(napi_env env, napi_callback_info info) {
     free(out); return o;
 }
 static napi_value n_search(napi_env env, napi_callback_info info) {
-    ARGS(2); STORE; char pat[8192]; getStr(env, argv[1], pat, sizeof pat);
+    ARGS(3); STORE; char pat[8192]; getStr(env, argv[1], pat, sizeof pat);
+    u32 flags = getU32(env, argv[2]);                 /* optional GRAPH_SEARCH_* bits; undefined -> 0 */
     u32 cap = graph_entity_count(s->g) + 1; u64 *out = malloc((size_t)cap * 8);
-    u32 n = graph_search(s->g, pat, out, cap);
+    u32 n = graph_search_ex(s->g, pat, flags, out, cap);
     napi_value r = u64arr(env, out, n < cap ? n : cap); free(out); return r;
 }
+/* search_page(h, pattern, flags, rank, cursor, limit, direction)
+ *   -> { offsets:[offset], next: cursor | null, total, relations }
+ * relations: packed (as set_relations) among all matches, from the same pass. */
+static napi_value n_search_page(napi_env env, napi_callback_info info) {
+    ARGS(7); STORE; char pat[8192]; getStr(env, argv[1], pat, sizeof pat);
+    u32 limit = getU32(env, argv[5]), next = 0, total = 0, cap = 0;
+    u64 *out = malloc(((size_t)limit + 1) * 8), *m = NULL;
+    u32 n = out ? graph_search_page_ex(s->g, pat, getU32(env, argv[2]), getU32(env, argv[3]), getU32(env, argv[4]),
+                                       limit, out, &next, &total, &m) : 0;
+    if (!m) { free(out); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    for (u32 i = 0; i < total; i++) cap += graph_edge_count(s->g, m[i]);
+    graph_rel_t *rs = malloc(((size_t)cap + 1) * sizeof *rs);
+    if (!rs) { free(out); free(m); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    u32 k = graph_set_relations(s->g, m, total, getU32(env, argv[6]), rs, cap);
+    free(m);
+    napi_value rels = n_packed_relations(env, s, rs, k < cap ? k : cap);
+    if (!rels) { free(out); return NULL; }
+    napi_value o, nx; napi_create_object(env, &o);
+    napi_set_named_property(env, o, "offsets", u64arr(env, out, n));
+    if (next) nx = mkU32(env, next); else napi_get_null(env, &nx);
+    napi_set_named_property(env, o, "next", nx);
+    napi_set_named_property(env, o, "total", mkU32(env, total));
+    napi_set_named_property(env, o, "relations", rels);
+    free(out); return o;
+}
+static napi_value n_build_text(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, graph_build_text_index(s->g) != 0, &r); return r;
+}
+static napi_value n_has_text(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, graph_has_text_index(s->g) != 0, &r); return r;
+}
+/* text_search(h, query, k) -> [{ offset, score }], best first */
+static napi_value n_text_search(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; u16 l; char *q = getStrA(env, argv[1], &l);
+    u32 k = getU32(env, argv[2]);
+    u64 *out = malloc(((size_t)k + 1) * 8); double *sc = malloc(((size_t)k + 1) * sizeof(double));
+    u32 n = q && out && sc ? graph_text_search(s->g, (const u8 *)q, l, k, out, sc) : 0;
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0; i < n; i++) {
+        napi_value o; napi_create_object(env, &o);
+        napi_set_named_property(env, o, "offset", mkU64(env, out[i]));
+        napi_set_named_property(env, o, "score", mkF64(env, sc[i]));
+        napi_set_element(env, arr, i, o);
+    }
+    free(q); free(out); free(sc); return arr;
+}
+/* ---- near duplicates ---- */
+/* (handle, text, minSimilarity, k) -> [{offset, similarity}] */
+static napi_value n_near_duplicates(napi_env env, napi_callback_info info) {
+    ARGS(4); STORE; u16 l; char *t = getStrA(env, argv[1], &l);
+    double min = getF64(env, argv[2]); u32 k = getU32(env, argv[3]);
+    u64 *out = malloc(((size_t)k + 1) * 8); double *sim = malloc(((size_t)k + 1) * sizeof(double));
+    u32 n = t && out && sim ? graph_near_duplicates(s->g, (const u8 *)t, l, min, k, out, sim) : 0;
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0; i < n; i++) {
+        napi_value o; napi_create_object(env, &o);
+        napi_set_named_property(env, o, "offset", mkU64(env, out[i]));
+        napi_set_named_property(env, o, "similarity", mkF64(env, sim[i]));
+        napi_set_element(env, arr, i, o);
+    }
+    free(t); free(out); free(sim); return arr;
+}
+/* (handle, minSimilarity) -> [[offset]], one array per cluster */
+static napi_value n_duplicate_clusters(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; u32 cap = graph_entity_count(s->g) + 1;
+    u64 *out = malloc((size_t)cap * 8); u32 *cl = malloc((size_t)cap * 4);
+    u32 n = out && cl ? graph_duplicate_clusters(s->g, getF64(env, argv[1]), out, cl, cap) : 0;
+    if (n > cap) n = cap;
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0, j; i < n; i = j) {
+        for (j = i; j < n && cl[j] == cl[i]; j++) {}
+        napi_set_element(env, arr, cl[i], u64arr(env, out + i, j - i));
+    }
+    free(out); free(cl); return arr;
+}
+/* ---- entity vectors ---- */
+/* a Float32Array arg's elements (JS memory, valid for this call); NULL if not one */
+static const float *getF32s(napi_env env, napi_value v, u32 *n) {
+    bool is = false; napi_typedarray_type t; size_t len = 0; void *data = NULL;
+    *n = 0;
+    if (napi_is_typedarray(env, v, &is) != napi_ok || !is) return NULL;
+    if (napi_get_typedarray_info(env, v, &t, &len, &data, NULL, NULL) != napi_ok || t != napi_float32_array) return NULL;
+    *n = (u32)len;
+    return data;
+}
+/* (handle, dim, format) -> bool: creates the index, or checks an existing one matches */
+static napi_value n_vector_index(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; napi_value r;
+    napi_get_boolean(env, graph_vector_index(s->g, getU32(env, argv[1]), getU32(env, argv[2])) != 0, &r); return r;
+}
+/* (handle) -> {dim, format, count} | null */
+static napi_value n_vector_info(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; u32 dim, fmt, cnt; napi_value o;
+    if (!graph_vector_info(s->g, &dim, &fmt, &cnt)) { napi_get_null(env, &o); return o; }
+    napi_create_object(env, &o);
+    napi_set_named_property(env, o, "dim", mkU32(env, dim));
+    napi_set_named_property(env, o, "format", mkU32(env, fmt));
+    napi_set_named_property(env, o, "count", mkU32(env, cnt));
+    return o;
+}
+/* (handle, offset, Float32Array) -> bool */
+static napi_value n_set_vector(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; u32 n; const float *v = getF32s(env, argv[2], &n); napi_value r;
+    napi_get_boolean(env, v && graph_set_vector(s->g, getU64(env, argv[1]), v, n), &r); return r;
+}
+static napi_value n_clear_vector(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; napi_value r;
+    napi_get_boolean(env, graph_clear_vector(s->g, getU64(env, argv[1])) != 0, &r); return r;
+}
+/* (handle, offset) -> Float32Array (unit length) | null */
+static napi_value n_get_vector(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; u32 dim, fmt, cnt; napi_value ab, r; void *data;
+    if (!graph_vector_info(s->g, &dim, &fmt, &cnt)) { napi_get_null(env, &r); return r; }
+    NCALL(napi_create_arraybuffer(env, (size_t)dim * 4, &data, &ab));
+    if (!graph_get_vector(s->g, getU64(env, argv[1]), data)) { napi_get_null(env, &r); return r; }
+    NCALL(napi_create_typedarray(env, napi_float32_array, dim, ab, 0, &r));
+    return r;
+}
+/* (handle, Float32Array, k, entityType | null) -> [{offset, similarity}] */
+static napi_value n_vector_search(napi_env env, napi_callback_info info) {
+    ARGS(4); STORE; u32 n, k = getU32(env, argv[2]); u16 tl = 0; char *ty = NULL;
+    const float *q = getF32s(env, argv[1], &n);
+    napi_valuetype vt; napi_typeof(env, argv[3], &vt);
+    if (vt == napi_string) ty = getStrA(env, argv[3], &tl);
+    u64 *out = malloc(((size_t)k + 1) * 8); double *sim = malloc(((size_t)k + 1) * sizeof(double));
+    u32 m = q && out && sim && (vt != napi_string || ty) ? graph_vector_search(s->g, q, n, (const u8 *)ty, tl, k, out, sim) : 0;
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0; i < m; i++) {
+        napi_value o; napi_create_object(env, &o);
+        napi_set_named_property(env, o, "offset", mkU64(env, out[i]));
+        napi_set_named_property(env, o, "similarity", mkF64(env, sim[i]));
+        napi_set_element(env, arr, i, o);
+    }
+    free(ty); free(out); free(sim); return arr;
+}
+/* ---- name order ---- */
+static napi_value n_has_name_index(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, graph_has_name_index(s->g) != 0, &r); return r;
+}
+static napi_value n_name_rank(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; u16 l; char *nm = getStrA(env, argv[1], &l);
+    napi_value r = mkU32(env, nm ? graph_name_rank(s->g, (const u8 *)nm, l) : 0);
+    free(nm); return r;
+}
+/* (handle, prefix) -> {first, count}: the rank range of names starting with it */
+static napi_value n_name_prefix(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; u16 l; char *p = getStrA(env, argv[1], &l);
+    u32 first = 0, count = p ? graph_name_prefix(s->g, (const u8 *)p, l, &first) : 0;
+    napi_value o; napi_create_object(env, &o);
+    napi_set_named_property(env, o, "first", mkU32(env, first));
+    napi_set_named_property(env, o, "count", mkU32(env, count));
+    free(p); return o;
+}
+/* (handle, pos, max, desc) -> [offset] */
+/* rank_sort(h, offsets[], rank) -> [bigint] the same offsets in rank order */
+static napi_value n_rank_sort(napi_env env, napi_callback_info info) {
+    ARGS(3); STORE; u32 n = 0;
+    napi_get_array_length(env, argv[1], &n);
+    u64 *v = malloc(((size_t)n + 1) * 8);
+    if (!v) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    for (u32 i = 0; i < n; i++) { napi_value e; napi_get_element(env, argv[1], i, &e); v[i] = getU64(env, e); }
+    if (!graph_rank_sort(s->g, v, n, getU32(env, argv[2]))) { free(v); napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    napi_value r = u64arr(env, v, n); free(v); return r;
+}
+/* json_page(h, offsets[], rank, cursor, maxChars) -> the page's JSON text.
+ * The offsets are put in rank order first unless rank is 0 (as given). */
+static napi_value n_json_page(napi_env env, napi_callback_info info) {
+    ARGS(5); STORE; u32 n = 0, rank = getU32(env, argv[2]), next;
+    napi_get_array_length(env, argv[1], &n);
+    u64 *v = malloc(((size_t)n + 1) * 8);
+    if (!v) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    for (u32 i = 0; i < n; i++) { napi_value e; napi_get_element(env, argv[1], i, &e); v[i] = getU64(env, e); }
+    size_t len = 0;
+    char *js = !rank || graph_rank_sort(s->g, v, n, rank)
+             ? graph_json_page(s->g, v, n, getU32(env, argv[3]), getU32(env, argv[4]), &next, &len) : NULL;
+    free(v);
+    if (!js) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    napi_value r; napi_create_string_utf8(env, js, len, &r);
+    free(js); return r;
+}
+/* changed_since(h, key, since, pos, max) -> { offsets: [bigint], total } */
+static napi_value n_changed_since(napi_env env, napi_callback_info info) {
+    ARGS(5); STORE; u32 max = getU32(env, argv[4]), total = 0;
+    u64 *out = malloc(((size_t)max + 1) * 8);
+    u32 n = out ? graph_changed_since(s->g, getU32(env, argv[1]), getU64(env, argv[2]), getU32(env, argv[3]), max, out, &total) : 0;
+    napi_value o; napi_create_object(env, &o);
+    napi_set_named_property(env, o, "offsets", u64arr(env, out, n));
+    napi_set_named_property(env, o, "total", mkU32(env, total));
+    free(out); return o;
+}
+static napi_value n_names_at(napi_env env, napi_callback_info info) {
+    ARGS(4); STORE; u32 pos = getU32(env, argv[1]), max = getU32(env, argv[2]);
+    u64 *out = malloc(((size_t)max + 1) * 8);
+    u32 n = out ? graph_names_at(s->g, pos, max, getU32(env, argv[3]) != 0, out) : 0;
+    napi_value r = u64arr(env, out, n); free(out); return r;
+}
 /* Pattern validity under the C POSIX ERE engine — the same dialect that matches, so
  * the TS layer keeps its "Invalid regex pattern" contract without JS RegExp. */
 static napi_value n_regex_valid(napi_env env, napi_callback_info info) {
     ARGS(1); char pat[8192]; getStr(env, argv[0], pat, sizeof pat);
     napi_value r; napi_get_boolean(env, graph_regex_valid(pat) != 0, &r); return r;
 }
+static napi_value n_regex_indexable(napi_env env, napi_callback_info info) {
+    ARGS(1); char pat[8192]; getStr(env, argv[0], pat, sizeof pat);
+    napi_value r; napi_get_boolean(env, graph_regex_indexable(pat) != 0, &r); return r;
+}
 static napi_value n_by_type(napi_env env, napi_callback_info info) {
     ARGS(2); STORE; char ty[4096]; u16 l = getStr(env, argv[1], ty, sizeof ty);
-    u32 cap = graph_entity_count(s->g) + 1; u64 *out = malloc((size_t)cap * 8);
+    u32 cap = graph_entities_by_type(s->g, (const u8 *)ty, l, NULL, 0) + 1; u64 *out = malloc((size_t)cap * 8);
     u32 n = graph_entities_by_type(s->g, (const u8 *)ty, l, out, cap);
     napi_value r = u64arr(env, out, n < cap ? n : cap); free(out); return r;
 }
@@ -205,6 +702,18 @@ static napi_value n_orphaned(napi_env env, napi_callback_info info) {
     u32 n = graph_orphaned(s->g, out, cap);
     napi_value r = u64arr(env, out, n < cap ? n : cap); free(out); return r;
 }
+static napi_value n_build_components(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, graph_build_components(s->g) != 0, &r); return r;
+}
+static napi_value n_has_components(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; napi_value r; napi_get_boolean(env, graph_has_components(s->g) != 0, &r); return r;
+}
+/* outside_component(h, anchor) -> [bigint] entities not connected to anchor (all for 0n) */
+static napi_value n_outside_component(napi_env env, napi_callback_info info) {
+    ARGS(2); STORE; u32 cap = graph_entity_count(s->g) + 1; u64 *out = malloc((size_t)cap * 8);
+    u32 n = graph_outside_component(s->g, getU64(env, argv[1]), out, cap);
+    napi_value r = u64arr(env, out, n < cap ? n : cap); free(out); return r;
+}
 static napi_value n_list_entities(napi_env env, napi_callback_info info) {
     ARGS(1); STORE; u32 cap = graph_entity_count(s->g) + 1; u64 *out = malloc((size_t)cap * 8);
     u32 n = graph_list_entities(s->g, out, cap);
@@ -213,22 +722,48 @@ static napi_value n_list_entities(napi_env env, napi_callback_info info) {
 /* distinct type ids -> [string] */
 static napi_value n_str_of_ids(napi_env env, Store *s, u32 *ids, u32 n) {
     napi_value arr; napi_create_array(env, &arr);
-    for (u32 i = 0; i < n; i++) { u16 l; const u8 *p = st_get(s->st, ids[i], &l); napi_value v; napi_create_string_utf8(env, (const char *)p, l, &v); napi_set_element(env, arr, i, v); }
+    for (u32 i = 0; i < n; i++) napi_set_element(env, arr, i, str_id(env, s, ids[i]));
     return arr;
 }
 static napi_value n_entity_types(napi_env env, napi_callback_info info) {
-    ARGS(1); STORE; u32 cap = graph_entity_count(s->g) + 1; u32 *out = malloc((size_t)cap * 4);
+    ARGS(1); STORE; u32 cap = graph_entity_types(s->g, NULL, 0) + 1; u32 *out = malloc((size_t)cap * 4);
     u32 n = graph_entity_types(s->g, out, cap); napi_value r = n_str_of_ids(env, s, out, n < cap ? n : cap); free(out); return r;
 }
+/* [{type, count}] from parallel id/count arrays */
+static napi_value n_type_counts(napi_env env, Store *s, u32 *ids, u32 *cnt, u32 n) {
+    napi_value arr; napi_create_array(env, &arr);
+    for (u32 i = 0; i < n; i++) {
+        napi_value o;
+        napi_create_object(env, &o);
+        napi_set_named_property(env, o, "type", str_id(env, s, ids[i]));
+        napi_set_named_property(env, o, "count", mkU32(env, cnt[i]));
+        napi_set_element(env, arr, i, o);
+    }
+    return arr;
+}
+/* (handle) -> [{type, count}], by type id */
+static napi_value n_entity_type_counts(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; u32 cap = graph_entity_types(s->g, NULL, 0) + 1;
+    u32 *ids = malloc((size_t)cap * 4), *cnt = malloc((size_t)cap * 4);
+    u32 n = ids && cnt ? graph_entity_type_counts(s->g, ids, cnt, cap) : 0;
+    napi_value r = n_type_counts(env, s, ids, cnt, n < cap ? n : cap); free(ids); free(cnt); return r;
+}
 static napi_value n_relation_types(napi_env env, napi_callback_info info) {
-    ARGS(1); STORE; u32 cap = graph_relation_count(s->g) * 2 + 8; u32 *out = malloc((size_t)cap * 4);
+    ARGS(1); STORE; u32 cap = graph_relation_types(s->g, NULL, 0) + 1; u32 *out = malloc((size_t)cap * 4);
     u32 n = graph_relation_types(s->g, out, cap); napi_value r = n_str_of_ids(env, s, out, n < cap ? n : cap); free(out); return r;
 }
+/* (handle) -> [{type, count}] of relation types, by type id */
+static napi_value n_relation_type_counts(napi_env env, napi_callback_info info) {
+    ARGS(1); STORE; u32 cap = graph_relation_types(s->g, NULL, 0) + 1;
+    u32 *ids = malloc((size_t)cap * 4), *cnt = malloc((size_t)cap * 4);
+    u32 n = ids && cnt ? graph_relation_type_counts(s->g, ids, cnt, cap) : 0;
+    napi_value r = n_type_counts(env, s, ids, cnt, n < cap ? n : cap); free(ids); free(cnt); return r;
+}
 static napi_value n_entity_count(napi_env env, napi_callback_info info) { ARGS(1); STORE; return mkU32(env, graph_entity_count(s->g)); }
 static napi_value n_relation_count(napi_env env, napi_callback_info info){ ARGS(1); STORE; return mkU32(env, graph_relation_count(s->g)); }
 static napi_value n_entity_name(napi_env env, napi_callback_info info) {
-    ARGS(2); STORE; u16 l; const u8 *p = graph_entity_name(s->g, getU64(env, argv[1]), &l);
-    napi_value v; napi_create_string_utf8(env, (const char *)p, l, &v); return v;
+    ARGS(2); STORE; u64 off = getU64(env, argv[1]); entity_t e; graph_read_entity(s->g, off, &e);
+    return ent_str(env, s, off, e.name_id, 0);
 }
 
 /* ---- ranking ---- */
@@ -239,6 +774,63 @@ static napi_value n_walker_total(napi_env env, napi_callback_info info)    { ARG
 static napi_value n_structural_rank(napi_env env, napi_callback_info info) { ARGS(2); STORE; return mkF64(env, graph_structural_rank(s->g, getU64(env, argv[1]))); }
 static napi_value n_walker_rank(napi_env env, napi_callback_info info)     { ARGS(2); STORE; return mkF64(env, graph_walker_rank(s->g, getU64(env, argv[1]))); }
 static napi_value n_get_psi(napi_env env, napi_callback_info info)         { ARGS(2); STORE; return mkF64(env, graph_get_psi(s->g, getU64(env, argv[1]))); }
+
+/* resample_async(h, iterations, damping, alpha, maxIter, tol) -> Promise<{ visits, iterations }>
+ * Structural sampling + MERW psi on a libuv worker. Only the snapshot (shared
+ * lock) and the apply (exclusive) hold the store; the walks and the solve run
+ * on the snapshot with no lock, so JS-thread writes never wait out the compute. */
+typedef struct {
+    Store *s; napi_ref keep; napi_async_work work; napi_deferred done;
+    u32 iterations, max_iter; double damping, alpha, tol; u64 seed;
+    graph_rank_t r; int ok;
+} resample_job;
+
+static void resample_execute(napi_env env, void *data) {
+    (void)env; resample_job *j = data; Store *s = j->s;
+    store_lock_shared(s);
+    j->ok = s->g && graph_rank_snapshot(s->g, &j->r);
+    store_unlock(s);
+    if (!j->ok || !(j->ok = graph_rank_compute(&j->r, j->iterations, j->damping, j->alpha, j->max_iter, j->tol, j->seed)))
+        return;
+    store_lock_exclusive(s);
+    if ((j->ok = s->g != NULL)) graph_rank_apply(s->g, &j->r);   /* flushed by the next synced write or close */
+    store_unlock(s);
+}
+static void resample_complete(napi_env env, napi_status status, void *data) {
+    resample_job *j = data; napi_value v;
+    if (status == napi_ok && j->ok) {
+        napi_create_object(env, &v);
+        napi_set_named_property(env, v, "visits", mkU32(env, j->r.total));
+        napi_set_named_property(env, v, "iterations", mkU32(env, j->r.iters));
+        napi_resolve_deferred(env, j->done, v);
+    } else {
+        napi_value msg; napi_create_string_utf8(env, "resample failed (store closed or out of memory)", NAPI_AUTO_LENGTH, &msg);
+        napi_create_error(env, NULL, msg, &v);
+        napi_reject_deferred(env, j->done, v);
+    }
+    graph_rank_free(&j->r);
+    napi_delete_reference(env, j->keep);
+    napi_delete_async_work(env, j->work);
+    free(j);
+}
+static napi_value n_resample_async(napi_env env, napi_callback_info info) {
+    ARGS(6); STORE;
+    resample_job *j = calloc(1, sizeof *j);
+    if (!j) { napi_throw_error(env, NULL, "out of memory"); return NULL; }
+    j->s = s; j->iterations = getU32(env, argv[1]); j->damping = getF64(env, argv[2]);
+    j->alpha = getF64(env, argv[3]); j->max_iter = getU32(env, argv[4]); j->tol = getF64(env, argv[5]);
+    j->seed = graph_rng_fork();
+    napi_value p, name;
+    napi_create_string_utf8(env, "graphstore.resample", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_reference(env, argv[0], 1, &j->keep) != napi_ok) { free(j); napi_throw_error(env, NULL, "napi: resample"); return NULL; }
+    if (napi_create_promise(env, &j->done, &p) != napi_ok
+        || napi_create_async_work(env, NULL, name, resample_execute, resample_complete, j, &j->work) != napi_ok
+        || napi_queue_async_work(env, j->work) != napi_ok) {
+        napi_delete_reference(env, j->keep); free(j);
+        napi_throw_error(env, NULL, "napi: resample"); return NULL;
+    }
+    return p;
+}
 static napi_value n_structural_sample(napi_env env, napi_callback_info info){ ARGS(3); STORE; return mkU32(env, graph_structural_sample(s->g, getU32(env, argv[1]), getF64(env, argv[2]))); }
 static napi_value n_merw(napi_env env, napi_callback_info info)            { ARGS(4); STORE; return mkU32(env, graph_compute_merw_psi(s->g, getF64(env, argv[1]), getU32(env, argv[2]), getF64(env, argv[3]))); }
 static napi_value n_seed(napi_env env, napi_callback_info info)            { ARGS(2); (void)unwrap(env, argv[0]); graph_seed_rng(getU64(env, argv[1])); return NULL; }
@@ -307,19 +899,35 @@ static napi_value n_unlock_path(napi_env env, napi_callback_info info) {
 NAPI_MODULE_INIT() {
     EXPORT("open", n_open); EXPORT("close", n_close); EXPORT("sync", n_sync);
     EXPORT("lockShared", n_lock_sh); EXPORT("lockExclusive", n_lock_ex); EXPORT("unlock", n_unlock); EXPORT("refresh", n_refresh);
-    EXPORT("lookup", n_lookup); EXPORT("createEntity", n_create_entity); EXPORT("deleteEntity", n_delete_entity);
-    EXPORT("readEntity", n_read_entity); EXPORT("entityName", n_entity_name);
+    EXPORT("lookup", n_lookup); EXPORT("fuzzyLookup", n_fuzzy_lookup);
+    EXPORT("nearDuplicates", n_near_duplicates); EXPORT("duplicateClusters", n_duplicate_clusters); EXPORT("createEntity", n_create_entity); EXPORT("deleteEntity", n_delete_entity);
+    EXPORT("readEntity", n_read_entity); EXPORT("readEntities", n_read_entities); EXPORT("entityName", n_entity_name);
     EXPORT("addObservation", n_add_obs); EXPORT("removeObservation", n_remove_obs);
+    EXPORT("compressObservations", n_compress_obs);
+    EXPORT("buildFoldIndex", n_build_folds); EXPORT("hasFoldIndex", n_has_folds);
+    EXPORT("buildTrigramIndex", n_build_trigrams); EXPORT("hasTrigramIndex", n_has_trigrams);
     EXPORT("createRelation", n_create_relation); EXPORT("deleteRelation", n_delete_relation); EXPORT("edges", n_edges);
+    EXPORT("setRelations", n_set_relations); EXPORT("relationsSince", n_relations_since);
     EXPORT("neighbors", n_neighbors); EXPORT("findPath", n_find_path); EXPORT("search", n_search);
-    EXPORT("regexValid", n_regex_valid);
+    EXPORT("searchPage", n_search_page);
+    EXPORT("buildTextIndex", n_build_text); EXPORT("hasTextIndex", n_has_text); EXPORT("textSearch", n_text_search);
+    EXPORT("vectorIndex", n_vector_index); EXPORT("vectorInfo", n_vector_info);
+    EXPORT("setVector", n_set_vector); EXPORT("clearVector", n_clear_vector); EXPORT("getVector", n_get_vector);
+    EXPORT("vectorSearch", n_vector_search);
+    EXPORT("hasNameIndex", n_has_name_index); EXPORT("nameRank", n_name_rank);
+    EXPORT("namePrefix", n_name_prefix); EXPORT("namesAt", n_names_at); EXPORT("changedSince", n_changed_since); EXPORT("rankSort", n_rank_sort); EXPORT("jsonPage", n_json_page);
+    EXPORT("regexValid", n_regex_valid); EXPORT("regexIndexable", n_regex_indexable);
     EXPORT("entitiesByType", n_by_type); EXPORT("orphaned", n_orphaned); EXPORT("listEntities", n_list_entities);
+    EXPORT("buildComponents", n_build_components); EXPORT("hasComponents", n_has_components);
+    EXPORT("outsideComponent", n_outside_component);
     EXPORT("entityTypes", n_entity_types); EXPORT("relationTypes", n_relation_types);
+    EXPORT("entityTypeCounts", n_entity_type_counts); EXPORT("relationTypeCounts", n_relation_type_counts);
     EXPORT("entityCount", n_entity_count); EXPORT("relationCount", n_relation_count);
     EXPORT("incWalkerVisit", n_inc_walker); EXPORT("incStructuralVisit", n_inc_structural);
     EXPORT("structuralTotal", n_structural_total); EXPORT("walkerTotal", n_walker_total);
     EXPORT("structuralRank", n_structural_rank); EXPORT("walkerRank", n_walker_rank); EXPORT("getPsi", n_get_psi);
-    EXPORT("structuralSample", n_structural_sample); EXPORT("computeMerwPsi", n_merw); EXPORT("seedRng", n_seed);
+    EXPORT("structuralSample", n_structural_sample); EXPORT("computeMerwPsi", n_merw);
+    EXPORT("resampleAsync", n_resample_async); EXPORT("seedRng", n_seed);
     EXPORT("randomWalk", n_random_walk);
     EXPORT("validateObs", n_validate_obs); EXPORT("validateDangling", n_validate_dangling);
     EXPORT("setEntityFields", n_set_entity_fields); EXPORT("setTotals", n_set_totals);
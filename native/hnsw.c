@@ -0,0 +1,619 @@
+#include "hnsw.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pmap.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* header fields */
+#define HH_DIM      0u
+#define HH_FORMAT   4u
+#define HH_COUNT    8u
+#define HH_TOP      12u     /* level of the entry node */
+#define HH_ENTRY    16u     /* 0 while empty */
+#define HH_NODES    24u
+#define HH_DEAD     32u
+#define HH_NDEAD    40u
+#define HH_SIZE     48u
+
+/* node fields */
+#define HN_ID       0u
+#define HN_LEVEL    4u
+#define HN_STEP     8u
+#define HN_DEAD     12u
+#define HN_NEXT     16u
+#define HN_VEC      24u
+
+static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline float rdf32(memfile_t *mf, u64 o) { float v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
+static inline void wrf32(memfile_t *mf, u64 o, float v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+
+static inline u64 mix64(u64 x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* ---- layout ---- */
+
+typedef struct {
+    memfile_t *mf;
+    u64 hdr;
+    u32 dim, fmt;
+    u64 vb;                 /* vector bytes, 8-aligned */
+} ix_t;
+
+static inline u32 elem_size(u32 fmt) { return fmt == HNSW_F32 ? 4 : fmt == HNSW_F16 ? 2 : 1; }
+
+static ix_t ix_of(memfile_t *mf, u64 root) {
+    ix_t x = { mf, rdu64(mf, root), 0, 0, 0 };
+    x.dim = rdu32(mf, x.hdr + HH_DIM);
+    x.fmt = rdu32(mf, x.hdr + HH_FORMAT);
+    x.vb = ((u64)x.dim * elem_size(x.fmt) + 7) & ~7ull;
+    return x;
+}
+
+/* offset of a node's level-l list; one past the last level is the node size */
+static inline u64 list_at(const ix_t *x, u32 l) {
+    return HN_VEC + x->vb + (l ? 8 + HNSW_M0 * 8 + (u64)(l - 1) * (8 + HNSW_M * 8) : 0);
+}
+static inline u64 node_size(const ix_t *x, u32 level) { return list_at(x, level + 1); }
+static inline u32 list_cap(u32 l) { return l ? HNSW_M : HNSW_M0; }
+
+static inline u32 node_level(const ix_t *x, u64 n) { return rdu32(x->mf, n + HN_LEVEL); }
+static inline int node_dead(const ix_t *x, u64 n) { return rdu32(x->mf, n + HN_DEAD) != 0; }
+static inline u32 links(const ix_t *x, u64 n, u32 l) { return rdu32(x->mf, n + list_at(x, l)); }
+static inline u64 link(const ix_t *x, u64 n, u32 l, u32 i) { return rdu64(x->mf, n + list_at(x, l) + 8 + (u64)i * 8); }
+static void set_links(const ix_t *x, u64 n, u32 l, const u64 *to, u32 c) {
+    u64 lo = n + list_at(x, l);
+    wru32(x->mf, lo, c);
+    if (c) memcpy(memfile_ptr(x->mf, lo + 8), to, (size_t)c * 8);
+}
+
+/* ---- encoding ---- */
+
+/* float16: normals only — parts under 2^-14 of a unit vector flush to zero */
+static u16 f2h(float f) {
+    u32 b;
+    memcpy(&b, &f, 4);
+    u32 sign = (b >> 16) & 0x8000u, a = b & 0x7fffffffu;
+    if (a < 0x38800000u) return (u16)sign;
+    if (a >= 0x477ff000u) return (u16)(sign | 0x7bffu);
+    a += 0x0fffu + ((a >> 13) & 1u);                 /* round to nearest even */
+    return (u16)(sign | ((a >> 13) - (112u << 10)));
+}
+static float h2f(u16 h) {
+    u32 a = h & 0x7fffu, b = (u32)(h & 0x8000u) << 16;
+    if (a >= 0x0400u) b |= (a << 13) + (112u << 23);
+    float f;
+    memcpy(&f, &b, 4);
+    return f;
+}
+
+/* v at unit length, encoded into out (x->vb bytes); *step = the int8 step.
+ * 0 for a zero or non-finite vector. */
+static int encode(const ix_t *x, const float *v, u8 *out, float *step) {
+    double ss = 0;
+    for (u32 i = 0; i < x->dim; i++) ss += (double)v[i] * v[i];
+    if (!(ss > 0) || !isfinite(ss)) return 0;
+    float inv = (float)(1.0 / sqrt(ss)), big = 0;
+    memset(out, 0, x->vb);
+    *step = 1;
+    if (x->fmt == HNSW_F32) {
+        for (u32 i = 0; i < x->dim; i++) { float f = v[i] * inv; memcpy(out + (size_t)i * 4, &f, 4); }
+    } else if (x->fmt == HNSW_F16) {
+        for (u32 i = 0; i < x->dim; i++) { u16 h = f2h(v[i] * inv); memcpy(out + (size_t)i * 2, &h, 2); }
+    } else {
+        for (u32 i = 0; i < x->dim; i++) if (fabsf(v[i] * inv) > big) big = fabsf(v[i] * inv);
+        *step = big / 127;
+        for (u32 i = 0; i < x->dim; i++) out[i] = (u8)(int8_t)lrintf(v[i] * inv / *step);
+    }
+    return 1;
+}
+
+static void decode(const ix_t *x, const u8 *in, float step, float *out) {
+    for (u32 i = 0; i < x->dim; i++) {
+        if (x->fmt == HNSW_F32) memcpy(out + i, in + (size_t)i * 4, 4);
+        else if (x->fmt == HNSW_F16) { u16 h; memcpy(&h, in + (size_t)i * 2, 2); out[i] = h2f(h); }
+        else out[i] = (float)(int8_t)in[i] * step;
+    }
+}
+
+/* ---- distance kernels ---- */
+
+static float dot_f32(const u8 *a, const u8 *b, u32 n) {
+    u32 i = 0;
+    float s = 0;
+#if defined(__SSE2__)
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps((const float *)(a + 4 * i)), _mm_loadu_ps((const float *)(b + 4 * i))));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps((const float *)(a + 4 * i + 16)), _mm_loadu_ps((const float *)(b + 4 * i + 16))));
+    }
+    float t[4];
+    _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+    s = (t[0] + t[1]) + (t[2] + t[3]);
+#endif
+    for (; i < n; i++) { float p, q; memcpy(&p, a + 4 * i, 4); memcpy(&q, b + 4 * i, 4); s += p * q; }
+    return s;
+}
+
+#if defined(__SSE2__)
+/* four float16s, zero-extended into 32-bit lanes, as floats (h2f) */
+static inline __m128 h2f4(__m128i h) {
+    __m128i a = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    __m128i bits = _mm_add_epi32(_mm_slli_epi32(a, 13), _mm_set1_epi32(112 << 23));
+    __m128i normal = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x03ff));
+    return _mm_castsi128_ps(_mm_or_si128(sign, _mm_and_si128(bits, normal)));
+}
+#endif
+
+static float dot_f16(const u8 *a, const u8 *b, u32 n) {
+    u32 i = 0;
+    float s = 0;
+#if defined(__SSE2__)
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    __m128i z = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(a + 2 * i)), q = _mm_loadu_si128((const __m128i *)(b + 2 * i));
+        s0 = _mm_add_ps(s0, _mm_mul_ps(h2f4(_mm_unpacklo_epi16(p, z)), h2f4(_mm_unpacklo_epi16(q, z))));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(h2f4(_mm_unpackhi_epi16(p, z)), h2f4(_mm_unpackhi_epi16(q, z))));
+    }
+    float t[4];
+    _mm_storeu_ps(t, _mm_add_ps(s0, s1));
+    s = (t[0] + t[1]) + (t[2] + t[3]);
+#endif
+    for (; i < n; i++) { u16 p, q; memcpy(&p, a + 2 * i, 2); memcpy(&q, b + 2 * i, 2); s += h2f(p) * h2f(q); }
+    return s;
+}
+
+/* sum of products of two int8 vectors; |sum| <= 127^2 * HNSW_MAX_DIM fits */
+static int32_t dot_i8(const u8 *a, const u8 *b, u32 n) {
+    u32 i = 0;
+    int32_t s = 0;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128(), z = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(a + i)), q = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i ps = _mm_cmpgt_epi8(z, p), qs = _mm_cmpgt_epi8(z, q);      /* sign bytes: widen to int16 */
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(p, ps), _mm_unpacklo_epi8(q, qs)));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(p, ps), _mm_unpackhi_epi8(q, qs)));
+    }
+    int32_t t[4];
+    _mm_storeu_si128((__m128i *)t, acc);
+    s = t[0] + t[1] + t[2] + t[3];
+#endif
+    for (; i < n; i++) s += (int32_t)(int8_t)a[i] * (int8_t)b[i];
+    return s;
+}
+
+static float dist(const ix_t *x, const u8 *a, float sa, const u8 *b, float sb) {
+    if (x->fmt == HNSW_F32) return 1 - dot_f32(a, b, x->dim);
+    if (x->fmt == HNSW_F16) return 1 - dot_f16(a, b, x->dim);
+    return 1 - sa * sb * (float)dot_i8(a, b, x->dim);
+}
+
+/* query (encoded) to node */
+typedef struct { const u8 *v; float step; } query_t;
+
+static inline float qdist(const ix_t *x, const query_t *q, u64 n) {
+    return dist(x, q->v, q->step, memfile_ptr(x->mf, n + HN_VEC), rdf32(x->mf, n + HN_STEP));
+}
+static inline float ndist(const ix_t *x, u64 a, u64 b) {
+    return dist(x, memfile_ptr(x->mf, a + HN_VEC), rdf32(x->mf, a + HN_STEP),
+                memfile_ptr(x->mf, b + HN_VEC), rdf32(x->mf, b + HN_STEP));
+}
+
+/* ---- search scaffolding: heaps and a visited set (heap memory, not the file) ---- */
+
+typedef struct { float d; u64 n; } cand_t;
+typedef struct { cand_t *a; u32 n, cap; } heap_t;   /* min-heap by d */
+
+static int hpush(heap_t *h, float d, u64 n) {
+    if (h->n == h->cap) {
+        u32 cap = h->cap ? h->cap * 2 : 64;
+        cand_t *a = realloc(h->a, (size_t)cap * sizeof *a);
+        if (!a) return 0;
+        h->a = a; h->cap = cap;
+    }
+    u32 i = h->n++;
+    while (i && h->a[(i - 1) / 2].d > d) { h->a[i] = h->a[(i - 1) / 2]; i = (i - 1) / 2; }
+    h->a[i] = (cand_t){ d, n };
+    return 1;
+}
+static cand_t hpop(heap_t *h) {
+    cand_t top = h->a[0], last = h->a[--h->n];
+    u32 i = 0;
+    for (;;) {
+        u32 c = 2 * i + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && h->a[c + 1].d < h->a[c].d) c++;
+        if (h->a[c].d >= last.d) break;
+        h->a[i] = h->a[c]; i = c;
+    }
+    if (h->n) h->a[i] = last;
+    return top;
+}
+
+typedef struct { u64 *s; u32 mask, n; } seen_t;
+
+static inline u32 seen_hash(u64 n, u32 mask) { return (u32)(((n >> 5) * 0x9e3779b97f4a7c15ull) >> 32) & mask; }
+/* 1 if n was not yet seen (and now is); an OOM counts as seen, ending the walk early */
+static int seen_add(seen_t *v, u64 n) {
+    if ((v->n + 1) * 2 > v->mask + 1) {
+        u32 cap = v->mask ? (v->mask + 1) * 2 : 256;
+        u64 *s = calloc(cap, 8);
+        if (!s) return 0;
+        for (u32 i = 0; v->mask && i <= v->mask; i++)
+            if (v->s[i]) { u32 j = seen_hash(v->s[i], cap - 1); while (s[j]) j = (j + 1) & (cap - 1); s[j] = v->s[i]; }
+        free(v->s);
+        v->s = s; v->mask = cap - 1;
+    }
+    u32 j = seen_hash(n, v->mask);
+    for (; v->s[j]; j = (j + 1) & v->mask) if (v->s[j] == n) return 0;
+    v->s[j] = n; v->n++;
+    return 1;
+}
+
+typedef struct { hnsw_accept_fn fn; void *ctx; } filter_t;
+
+static inline int keeps(const ix_t *x, u64 n, const filter_t *f) {
+    return !node_dead(x, n) && (!f || !f->fn || f->fn(f->ctx, rdu32(x->mf, n + HN_ID)));
+}
+
+static int cand_cmp(const void *a, const void *b) {
+    const cand_t *p = a, *q = b;
+    if (p->d != q->d) return p->d < q->d ? -1 : 1;
+    return (p->n > q->n) - (p->n < q->n);
+}
+
+/* Greedy descent on one upper level: move to a nearer neighbour until none is. */
+static u64 greedy(const ix_t *x, const query_t *q, u64 at, float *d, u32 l) {
+    for (u64 from = 0; from != at;) {
+        from = at;
+        u32 c = links(x, from, l);
+        for (u32 i = 0; i < c; i++) {
+            u64 n = link(x, from, l, i);
+            float e = qdist(x, q, n);
+            if (e < *d) { *d = e; at = n; }
+        }
+    }
+    return at;
+}
+
+/* The paper's SEARCH-LAYER: the ef nearest kept nodes to q on level l that
+ * the walk from eps reaches. Nodes that are not kept are expanded like any
+ * other but never enter the results, and so never tighten the bound. Returns
+ * them nearest first (malloc'd, *n of them; NULL with *n 0 when none). */
+static cand_t *search_layer(const ix_t *x, const query_t *q, const cand_t *eps, u32 neps, u32 ef, u32 l,
+                            const filter_t *f, u32 *n) {
+    heap_t todo = { 0 }, best = { 0 };       /* best is a max-heap: d negated */
+    seen_t seen = { 0 };
+    for (u32 i = 0; i < neps; i++) {
+        if (!seen_add(&seen, eps[i].n) || !hpush(&todo, eps[i].d, eps[i].n)) continue;
+        if (keeps(x, eps[i].n, f)) hpush(&best, -eps[i].d, eps[i].n);
+    }
+    while (best.n > ef) hpop(&best);
+    while (todo.n) {
+        cand_t c = hpop(&todo);
+        if (best.n == ef && c.d > -best.a[0].d) break;
+        u32 k = links(x, c.n, l);
+        for (u32 i = 0; i < k; i++) {
+            u64 m = link(x, c.n, l, i);
+            if (!seen_add(&seen, m)) continue;
+            float d = qdist(x, q, m);
+            if (best.n == ef && d >= -best.a[0].d) continue;
+            if (!hpush(&todo, d, m)) continue;
+            if (!keeps(x, m, f)) continue;
+            hpush(&best, -d, m);
+            if (best.n > ef) hpop(&best);
+        }
+    }
+    free(todo.a); free(seen.s);
+    for (u32 i = 0; i < best.n; i++) best.a[i].d = -best.a[i].d;
+    *n = best.n;
+    if (!best.n) { free(best.a); return NULL; }
+    qsort(best.a, best.n, sizeof *best.a, cand_cmp);
+    return best.a;
+}
+
+/* The paper's neighbour heuristic: walking the candidates (sorted, nearest
+ * the base first), keep one only if it is nearer the base than any already
+ * kept, so links spread across directions rather than bunch in one cluster. */
+static u32 select_links(const ix_t *x, const cand_t *c, u32 n, u32 m, u64 *out) {
+    u32 k = 0;
+    for (u32 i = 0; i < n && k < m; i++) {
+        int diverse = 1;
+        for (u32 j = 0; j < k && diverse; j++) diverse = ndist(x, c[i].n, out[j]) >= c[i].d;
+        if (diverse) out[k++] = c[i].n;
+    }
+    return k;
+}
+
+/* re-pick node b's level-l links from c[0..n) (any order; duplicates and b
+ * itself dropped) */
+static void relink(const ix_t *x, u64 b, u32 l, cand_t *c, u32 n) {
+    u64 keep[HNSW_M0];
+    u32 m = 0;
+    for (u32 i = 0; i < n; i++) if (c[i].n != b) { c[i].d = ndist(x, b, c[i].n); c[m++] = c[i]; }
+    qsort(c, m, sizeof *c, cand_cmp);
+    u32 u = 0;
+    for (u32 i = 0; i < m; i++) if (!u || c[u - 1].n != c[i].n) c[u++] = c[i];
+    set_links(x, b, l, keep, select_links(x, c, u, list_cap(l), keep));
+}
+
+/* add a link b -> n on level l, re-pruning b when its list is full */
+static void link_back(const ix_t *x, u64 b, u32 l, u64 n) {
+    u32 c = links(x, b, l);
+    if (c < list_cap(l)) {
+        wru64(x->mf, b + list_at(x, l) + 8 + (u64)c * 8, n);
+        wru32(x->mf, b + list_at(x, l), c + 1);
+        return;
+    }
+    cand_t all[HNSW_M0 + 1];
+    for (u32 i = 0; i < c; i++) all[i].n = link(x, b, l, i);
+    all[c].n = n;
+    relink(x, b, l, all, c + 1);
+}
+
+/* a node's top level, drawn from its id: P(level >= l) = HNSW_M^-l */
+static u32 draw_level(u32 id) {
+    double u = (double)((mix64(id + 0x9e3779b97f4a7c15ull) >> 11) + 1) * 0x1.0p-53;    /* (0, 1] */
+    double l = -log(u) / log((double)HNSW_M);
+    return l >= HNSW_MAX_LEVEL ? HNSW_MAX_LEVEL : (u32)l;
+}
+
+/* ---- lifecycle ---- */
+
+int hnsw_create(memfile_t *mf, u64 root, u32 dim, u32 format) {
+    if (!dim || dim > HNSW_MAX_DIM || format > HNSW_I8) return 0;
+    u64 hdr = memfile_alloc(mf, HH_SIZE);
+    if (!hdr) return 0;
+    memset(memfile_ptr(mf, hdr), 0, HH_SIZE);
+    wru32(mf, hdr + HH_DIM, dim);
+    wru32(mf, hdr + HH_FORMAT, format);
+    wru64(mf, root, hdr);
+    if (pmap_create(mf, hdr + HH_NODES, PMAP_INITIAL_BUCKETS)) return 1;
+    memfile_free(mf, hdr, HH_SIZE);
+    wru64(mf, root, 0);
+    return 0;
+}
+
+static void free_dead(const ix_t *x) {
+    for (u64 n = rdu64(x->mf, x->hdr + HH_DEAD), next; n; n = next) {
+        next = rdu64(x->mf, n + HN_NEXT);
+        memfile_free(x->mf, n, node_size(x, node_level(x, n)));
+    }
+    wru64(x->mf, x->hdr + HH_DEAD, 0);
+    wru32(x->mf, x->hdr + HH_NDEAD, 0);
+}
+
+void hnsw_destroy(memfile_t *mf, u64 root) {
+    ix_t x = ix_of(mf, root);
+    if (!x.hdr) return;
+    u64 nodes = x.hdr + HH_NODES;
+    u32 cap = pmap_capacity(mf, nodes);
+    for (u32 i = 0; i < cap; i++) {
+        u64 n;
+        if (pmap_at(mf, nodes, i, NULL, &n)) memfile_free(mf, n, node_size(&x, node_level(&x, n)));
+    }
+    pmap_destroy(mf, nodes);
+    free_dead(&x);
+    memfile_free(mf, x.hdr, HH_SIZE);
+    wru64(mf, root, 0);
+}
+
+u32 hnsw_dim(memfile_t *mf, u64 root) { return rdu32(mf, rdu64(mf, root) + HH_DIM); }
+u32 hnsw_format(memfile_t *mf, u64 root) { return rdu32(mf, rdu64(mf, root) + HH_FORMAT); }
+u32 hnsw_count(memfile_t *mf, u64 root) { return rdu32(mf, rdu64(mf, root) + HH_COUNT); }
+
+/* FreshDiskANN's delete consolidation: each live node with dead links trades
+ * them for those nodes' live links and re-prunes; then the dead are freed. A
+ * dead entry hands over to the live node of the highest level. */
+static void consolidate(const ix_t *x) {
+    u64 nodes = x->hdr + HH_NODES, top_node = 0;
+    u32 cap = pmap_capacity(x->mf, nodes), top = 0;
+    cand_t *c = malloc((HNSW_M0 + HNSW_M0 * HNSW_M0) * sizeof *c);
+    if (!c) return;
+    for (u32 s = 0; s < cap; s++) {
+        u64 p;
+        if (!pmap_at(x->mf, nodes, s, NULL, &p)) continue;
+        u32 lv = node_level(x, p);
+        if (!top_node || lv > top) { top_node = p; top = lv; }
+        for (u32 l = 0; l <= lv; l++) {
+            u32 k = links(x, p, l), m = 0, dead = 0;
+            for (u32 i = 0; i < k; i++) {
+                u64 n = link(x, p, l, i);
+                if (!node_dead(x, n)) { c[m++].n = n; continue; }
+                dead = 1;
+                u32 dk = links(x, n, l);
+                for (u32 j = 0; j < dk; j++) { u64 o = link(x, n, l, j); if (!node_dead(x, o)) c[m++].n = o; }
+            }
+            if (dead) relink(x, p, l, c, m);
+        }
+    }
+    free(c);
+    u64 entry = rdu64(x->mf, x->hdr + HH_ENTRY);
+    if (entry && node_dead(x, entry)) {
+        wru64(x->mf, x->hdr + HH_ENTRY, top_node);
+        wru32(x->mf, x->hdr + HH_TOP, top);
+    }
+    free_dead(x);
+}
+
+int hnsw_remove(memfile_t *mf, u64 root, u32 id) {
+    ix_t x = ix_of(mf, root);
+    u64 n = pmap_get(mf, x.hdr + HH_NODES, id);
+    if (!n) return 0;
+    pmap_del(mf, x.hdr + HH_NODES, id);
+    wru32(mf, n + HN_DEAD, 1);
+    wru64(mf, n + HN_NEXT, rdu64(mf, x.hdr + HH_DEAD));
+    wru64(mf, x.hdr + HH_DEAD, n);
+    u32 live = rdu32(mf, x.hdr + HH_COUNT) - 1, dead = rdu32(mf, x.hdr + HH_NDEAD) + 1;
+    wru32(mf, x.hdr + HH_COUNT, live);
+    wru32(mf, x.hdr + HH_NDEAD, dead);
+    if (!live) {
+        free_dead(&x);
+        wru64(mf, x.hdr + HH_ENTRY, 0);
+        wru32(mf, x.hdr + HH_TOP, 0);
+    } else if (dead > live / 4 + 16) {
+        consolidate(&x);
+    }
+    return 1;
+}
+
+int hnsw_put(memfile_t *mf, u64 root, u32 id, const float *v) {
+    ix_t x = ix_of(mf, root);
+    u8 *qv = malloc(x.vb);
+    float step;
+    if (!qv || !encode(&x, v, qv, &step)) { free(qv); return 0; }
+    hnsw_remove(mf, root, id);
+
+    u32 level = draw_level(id);
+    u64 node = memfile_alloc(mf, node_size(&x, level));
+    if (!node) { free(qv); return 0; }
+    memset(memfile_ptr(mf, node), 0, node_size(&x, level));
+    wru32(mf, node + HN_ID, id);
+    wru32(mf, node + HN_LEVEL, level);
+    wrf32(mf, node + HN_STEP, step);
+    memcpy(memfile_ptr(mf, node + HN_VEC), qv, x.vb);
+    if (!pmap_put(mf, x.hdr + HH_NODES, id, node)) { memfile_free(mf, node, node_size(&x, level)); free(qv); return 0; }
+    wru32(mf, x.hdr + HH_COUNT, rdu32(mf, x.hdr + HH_COUNT) + 1);
+
+    /* no allocation below: only node links change */
+    u64 ep = rdu64(mf, x.hdr + HH_ENTRY);
+    u32 top = rdu32(mf, x.hdr + HH_TOP);
+    if (ep) {
+        query_t q = { qv, step };
+        cand_t first = { qdist(&x, &q, ep), ep }, *eps = &first, *w;
+        u32 neps = 1, nw;
+        for (u32 l = top; l > level; l--) first.n = greedy(&x, &q, first.n, &first.d, l);
+        for (u32 l = level < top ? level : top;; l--) {
+            u64 to[HNSW_M];
+            w = search_layer(&x, &q, eps, neps, HNSW_EF_BUILD, l, NULL, &nw);
+            u32 k = select_links(&x, w, nw, HNSW_M, to);
+            set_links(&x, node, l, to, k);
+            for (u32 i = 0; i < k; i++) link_back(&x, to[i], l, node);
+            if (w) { if (eps != &first) free(eps); eps = w; neps = nw; }
+            if (l == 0) break;
+        }
+        if (eps != &first) free(eps);
+    }
+    if (!ep || level > top) {
+        wru64(mf, x.hdr + HH_ENTRY, node);
+        wru32(mf, x.hdr + HH_TOP, level);
+    }
+    free(qv);
+    return 1;
+}
+
+int hnsw_get(memfile_t *mf, u64 root, u32 id, float *out) {
+    ix_t x = ix_of(mf, root);
+    u64 n = pmap_get(mf, x.hdr + HH_NODES, id);
+    if (n) decode(&x, memfile_ptr(mf, n + HN_VEC), rdf32(mf, n + HN_STEP), out);
+    return n != 0;
+}
+
+/* ---- queries ---- */
+
+static int by_dist_id(const cand_t *a, const cand_t *b) {
+    return a->d != b->d ? (a->d < b->d ? -1 : 1) : (a->n > b->n) - (a->n < b->n);
+}
+static int res_cmp(const void *a, const void *b) { return by_dist_id(a, b); }
+
+u32 hnsw_search(memfile_t *mf, u64 root, const float *v, u32 k, u32 ef,
+                hnsw_accept_fn accept, void *ctx, u32 *out, double *sim) {
+    ix_t x = ix_of(mf, root);
+    u64 ep = rdu64(mf, x.hdr + HH_ENTRY);
+    if (!k || !ep) return 0;
+    u8 *qv = malloc(x.vb);
+    float step;
+    if (!qv || !encode(&x, v, qv, &step)) { free(qv); return 0; }
+    query_t q = { qv, step };
+    filter_t f = { accept, ctx };
+    cand_t first = { qdist(&x, &q, ep), ep };
+    for (u32 l = rdu32(mf, x.hdr + HH_TOP); l > 0; l--) first.n = greedy(&x, &q, first.n, &first.d, l);
+    if (ef < k) ef = k;
+    if (ef < HNSW_EF_SEARCH) ef = HNSW_EF_SEARCH;
+    u32 n;
+    cand_t *w = search_layer(&x, &q, &first, 1, ef, 0, &f, &n);
+    /* equal distances: to the lower id, not the lower node */
+    for (u32 i = 0; i < n; i++) w[i].n = rdu32(mf, w[i].n + HN_ID);
+    if (n) qsort(w, n, sizeof *w, res_cmp);
+    if (n > k) n = k;
+    for (u32 i = 0; i < n; i++) { out[i] = (u32)w[i].n; sim[i] = 1.0 - w[i].d; }
+    free(w); free(qv);
+    return n;
+}
+
+u32 hnsw_rank(memfile_t *mf, u64 root, const float *v, const u32 *ids, u32 n, u32 k,
+              u32 *out, double *sim) {
+    ix_t x = ix_of(mf, root);
+    u8 *qv = malloc(x.vb);
+    cand_t *best = malloc(((size_t)k + 1) * sizeof *best);
+    float step;
+    u32 m = 0;
+    if (!k || !qv || !best || !encode(&x, v, qv, &step)) { free(qv); free(best); return 0; }
+    query_t q = { qv, step };
+    for (u32 i = 0; i < n; i++) {
+        u64 node = pmap_get(mf, x.hdr + HH_NODES, ids[i]);
+        if (!node) continue;
+        cand_t c = { qdist(&x, &q, node), ids[i] };
+        if (m == k && by_dist_id(&c, &best[m - 1]) >= 0) continue;
+        u32 j = m < k ? m++ : m - 1;
+        while (j > 0 && by_dist_id(&c, &best[j - 1]) < 0) { best[j] = best[j - 1]; j--; }
+        best[j] = c;
+    }
+    for (u32 i = 0; i < m; i++) { out[i] = (u32)best[i].n; sim[i] = 1.0 - best[i].d; }
+    free(qv); free(best);
+    return m;
+}
+
+/* ---- audit ---- */
+
+static int u64_cmp(const void *a, const void *b) { u64 x = *(const u64 *)a, y = *(const u64 *)b; return (x > y) - (x < y); }
+
+int hnsw_check(memfile_t *mf, u64 root) {
+    ix_t x = ix_of(mf, root);
+    u64 nodes = x.hdr + HH_NODES, entry = rdu64(mf, x.hdr + HH_ENTRY);
+    u32 live = rdu32(mf, x.hdr + HH_COUNT), ndead = rdu32(mf, x.hdr + HH_NDEAD), cap = pmap_capacity(mf, nodes);
+    if (pmap_count(mf, nodes) != live || (!live && (entry || ndead))) return 0;
+    u64 *dead = malloc(((size_t)ndead + 1) * 8);
+    u32 nd = 0;
+    int ok = dead != NULL;
+    for (u64 n = rdu64(mf, x.hdr + HH_DEAD); n && ok; n = rdu64(mf, n + HN_NEXT)) {
+        ok = nd < ndead && node_dead(&x, n);
+        if (ok) dead[nd++] = n;
+    }
+    ok = ok && nd == ndead;
+    if (ok) qsort(dead, nd, 8, u64_cmp);
+    if (ok && entry) ok = node_level(&x, entry) == rdu32(mf, x.hdr + HH_TOP);
+    for (u32 s = 0; s < cap && ok; s++) {
+        u32 id;
+        u64 p;
+        if (!pmap_at(mf, nodes, s, &id, &p)) continue;
+        u32 lv = node_level(&x, p);
+        ok = rdu32(mf, p + HN_ID) == id && !node_dead(&x, p) && lv <= HNSW_MAX_LEVEL && lv <= rdu32(mf, x.hdr + HH_TOP);
+        for (u32 l = 0; l <= lv && ok; l++) {
+            u32 c = links(&x, p, l);
+            ok = c <= list_cap(l);
+            for (u32 i = 0; i < c && ok; i++) {
+                u64 n = link(&x, p, l, i);
+                int known = n && n != p && node_level(&x, n) >= l &&
+                    (node_dead(&x, n) ? bsearch(&n, dead, nd, 8, u64_cmp) != NULL
+                                      : pmap_get(mf, nodes, rdu32(mf, n + HN_ID)) == n);
+                ok = known;
+            }
+        }
+    }
+    free(dead);
+    return ok;
+}
@@ -0,0 +1,73 @@
+/*
+ * Approximate nearest neighbours by cosine similarity: an HNSW graph
+ * (Malkov & Yashunin) over fixed-dimension vectors in a v3 MemoryFile.
+ *
+ * Vectors are scaled to unit length on the way in and stored in one of three
+ * formats chosen at creation: float32, float16 (normals only; tinier parts
+ * flush to zero) or int8 with a per-vector step. A query is encoded the same
+ * way, so every distance is one kernel over two stored vectors — SSE2 where
+ * the compiler targets it, scalar otherwise. Distance is 1 - dot product.
+ *
+ * Each node draws its top level from its id (levels thin out by HNSW_M) and
+ * links to at most HNSW_M neighbours per level, HNSW_M0 on level 0, chosen by
+ * the paper's diversity heuristic. Removal marks the node dead: searches still
+ * walk through it but never return it. Once the dead outnumber a quarter of the
+ * live, every live node swaps its dead links for the dead nodes' own live
+ * links, re-prunes, and the dead are freed.
+ *
+ *   header: [u32 dim][u32 format][u32 count][u32 top][u64 entry][u64 node pmap]
+ *           [u64 dead][u32 ndead][u32 pad]                        (48 bytes)
+ *   node:   [u32 id][u32 level][f32 step][u32 dead][u64 next dead][vector]
+ *           then per level 0..level: [u32 n][u32 pad][u64 node * cap]
+ * The pmap maps each live id to its node; dead nodes chain from the header.
+ * As with pmap.h, `root` is the offset of the u64 slot holding the header.
+ * Callers hold the file's exclusive lock for put/remove.
+ */
+#ifndef HNSW_H
+#define HNSW_H
+
+#include "memoryfile.h"
+
+#define HNSW_F32        0u
+#define HNSW_F16        1u
+#define HNSW_I8         2u
+#define HNSW_MAX_DIM    4096u
+#define HNSW_M          16u
+#define HNSW_M0         (2 * HNSW_M)
+#define HNSW_MAX_LEVEL  15u
+#define HNSW_EF_BUILD   100u    /* candidate list while linking a new node */
+#define HNSW_EF_SEARCH  64u     /* least candidate list of a query */
+
+/* 1 to keep id in a search's results */
+typedef int (*hnsw_accept_fn)(void *ctx, u32 id);
+
+/* allocate an empty index and store its header offset at `root`; 0 on bad
+ * arguments or failure */
+int  hnsw_create(memfile_t *mf, u64 root, u32 dim, u32 format);
+/* free every node and zero `root` */
+void hnsw_destroy(memfile_t *mf, u64 root);
+u32  hnsw_dim(memfile_t *mf, u64 root);
+u32  hnsw_format(memfile_t *mf, u64 root);
+u32  hnsw_count(memfile_t *mf, u64 root);     /* live vectors */
+
+/* set id's vector (dim floats), replacing any it had; 0 for a zero or
+ * non-finite vector, or on OOM */
+int  hnsw_put(memfile_t *mf, u64 root, u32 id, const float *v);
+int  hnsw_remove(memfile_t *mf, u64 root, u32 id);           /* 1 if it had one */
+/* id's stored vector, decoded (unit length); 0 if it has none */
+int  hnsw_get(memfile_t *mf, u64 root, u32 id, float *out);
+
+/* The best k live ids for query v, nearest first (ties to the lower id):
+ * ids[i] and sim[i] = 1 - distance. ef widens the candidate list (at least
+ * max(k, HNSW_EF_SEARCH)); a non-NULL accept drops ids from the results
+ * without cutting the walk. Returns how many, 0 for a zero query. */
+u32  hnsw_search(memfile_t *mf, u64 root, const float *v, u32 k, u32 ef,
+                 hnsw_accept_fn accept, void *ctx, u32 *out, double *sim);
+/* the same, exactly, over just the given ids (those without a vector skipped) */
+u32  hnsw_rank(memfile_t *mf, u64 root, const float *v, const u32 *ids, u32 n, u32 k,
+               u32 *out, double *sim);
+
+/* structural audit: the pmap, levels, link targets and dead chain agree */
+int  hnsw_check(memfile_t *mf, u64 root);
+
+#endif /* HNSW_H */
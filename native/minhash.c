@@ -0,0 +1,216 @@
+#include "minhash.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "pmap.h"
+#include "trigram.h"
+
+#define MH_SKETCHES  0u     /* header fields */
+#define MH_INDEX     8u
+#define MH_HDR_SIZE  16u
+#define MH_SIG_SIZE  (MH_HASHES * 4u)
+
+static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
+
+static inline u64 mix64(u64 x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+void mh_sketch(const u8 *s, u32 len, u32 *sig) {
+    /* slot i hashes a shingle as the top half of mul[i] * h + add[i]: one 64-bit
+     * mix per shingle, then a multiply-add per slot */
+    u64 mul[MH_HASHES], add[MH_HASHES];
+    for (u32 i = 0; i < MH_HASHES; i++) {
+        mul[i] = mix64(0x9e3779b97f4a7c15ull * (2 * i + 1)) | 1;
+        add[i] = mix64(0x9e3779b97f4a7c15ull * (2 * i + 2));
+        sig[i] = 0xffffffffu;
+    }
+    u32 w = len < MH_SHINGLE ? len : MH_SHINGLE, last = len - w;
+    for (u32 at = 0; at <= last; at++) {
+        u64 x = (u64)w << 56;
+        if (w) memcpy(&x, s + at, w);                /* little-endian: the length byte stays clear */
+        u64 h = mix64(x);
+        for (u32 i = 0; i < MH_HASHES; i++) {
+            u32 v = (u32)((mul[i] * h + add[i]) >> 32);
+            if (v < sig[i]) sig[i] = v;
+        }
+    }
+}
+
+void mh_bands(const u32 *sig, u32 *keys) {
+    for (u32 b = 0; b < MH_BANDS; b++) {
+        u32 h = 2166136261u ^ (b * 0x9e3779b9u);     /* FNV-1a, a key space per band */
+        for (u32 r = 0; r < MH_ROWS; r++)
+            for (u32 k = 0; k < 4; k++) { h ^= (sig[b * MH_ROWS + r] >> (8 * k)) & 0xffu; h *= 16777619u; }
+        keys[b] = h;
+    }
+}
+
+double mh_similarity(const u32 *a, const u32 *b) {
+    u32 same = 0;
+    for (u32 i = 0; i < MH_HASHES; i++) same += a[i] == b[i];
+    return (double)same / MH_HASHES;
+}
+
+int mh_build(memfile_t *mf, u64 root, const u32 *ids, const u32 *sigs, size_t n) {
+    u64 *pairs = malloc((n * MH_BANDS + 1) * 8);
+    u64 hdr = pairs ? memfile_alloc(mf, MH_HDR_SIZE) : 0;
+    if (!hdr) { free(pairs); return 0; }
+    memset(memfile_ptr(mf, hdr), 0, MH_HDR_SIZE);
+    wru64(mf, root, hdr);
+    u32 buckets = PMAP_INITIAL_BUCKETS;
+    while ((u64)buckets * 7 < (u64)n * 10) buckets *= 2;
+    int ok = pmap_create(mf, hdr + MH_SKETCHES, buckets);
+    for (size_t i = 0; i < n && ok; i++) {
+        u64 b = memfile_alloc(mf, MH_SIG_SIZE);
+        if (!b) { ok = 0; break; }
+        memcpy(memfile_ptr(mf, b), sigs + i * MH_HASHES, MH_SIG_SIZE);
+        if (!pmap_put(mf, hdr + MH_SKETCHES, ids[i], b)) { memfile_free(mf, b, MH_SIG_SIZE); ok = 0; break; }
+        u32 keys[MH_BANDS];
+        mh_bands(sigs + i * MH_HASHES, keys);
+        for (u32 k = 0; k < MH_BANDS; k++) pairs[i * MH_BANDS + k] = (u64)keys[k] << 32 | ids[i];
+    }
+    ok = ok && tri_index_build(mf, hdr + MH_INDEX, pairs, n * MH_BANDS);
+    free(pairs);
+    if (!ok) mh_destroy(mf, root);
+    return ok;
+}
+
+void mh_destroy(memfile_t *mf, u64 root) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr) return;
+    u64 sroot = hdr + MH_SKETCHES;
+    if (rdu64(mf, sroot)) {
+        u32 cap = pmap_capacity(mf, sroot);
+        for (u32 i = 0; i < cap; i++) {
+            u64 b;
+            if (pmap_at(mf, sroot, i, NULL, &b)) memfile_free(mf, b, MH_SIG_SIZE);
+        }
+        pmap_destroy(mf, sroot);
+    }
+    if (rdu64(mf, hdr + MH_INDEX)) tri_index_destroy(mf, hdr + MH_INDEX);
+    memfile_free(mf, hdr, MH_HDR_SIZE);
+    wru64(mf, root, 0);
+}
+
+int mh_add(memfile_t *mf, u64 root, u32 id, const u32 *sig) {
+    u64 hdr = rdu64(mf, root);
+    u64 b = memfile_alloc(mf, MH_SIG_SIZE);
+    if (!b) return 0;
+    memcpy(memfile_ptr(mf, b), sig, MH_SIG_SIZE);
+    if (!pmap_put(mf, hdr + MH_SKETCHES, id, b)) { memfile_free(mf, b, MH_SIG_SIZE); return 0; }
+    u32 keys[MH_BANDS];
+    mh_bands(sig, keys);
+    for (u32 k = 0; k < MH_BANDS; k++) if (!tri_post(mf, hdr + MH_INDEX, keys[k], id)) return 0;
+    return 1;
+}
+
+int mh_get(memfile_t *mf, u64 root, u32 id, u32 *sig) {
+    u64 b = pmap_get(mf, rdu64(mf, root) + MH_SKETCHES, id);
+    if (b) memcpy(sig, memfile_ptr(mf, b), MH_SIG_SIZE);
+    return b != 0;
+}
+
+void mh_remove(memfile_t *mf, u64 root, u32 id) {
+    u64 hdr = rdu64(mf, root);
+    u32 sig[MH_HASHES], keys[MH_BANDS];
+    if (!mh_get(mf, root, id, sig)) return;
+    mh_bands(sig, keys);
+    for (u32 k = 0; k < MH_BANDS; k++) tri_unpost(mf, hdr + MH_INDEX, keys[k], id);
+    memfile_free(mf, pmap_get(mf, hdr + MH_SKETCHES, id), MH_SIG_SIZE);
+    pmap_del(mf, hdr + MH_SKETCHES, id);
+}
+
+static int cmp_u32(const void *a, const void *b) { u32 x = *(const u32 *)a, y = *(const u32 *)b; return (x > y) - (x < y); }
+
+u32 mh_candidates(memfile_t *mf, u64 root, const u32 *sig, u32 **ids) {
+    u64 iroot = rdu64(mf, root) + MH_INDEX;
+    u32 keys[MH_BANDS], total = 0, n = 0, m = 0;
+    mh_bands(sig, keys);
+    for (u32 k = 0; k < MH_BANDS; k++) { u32 c; tri_postings_at(mf, iroot, keys[k], &c); total += c; }
+    if (!(*ids = malloc(((size_t)total + 1) * 4))) return 0;
+    for (u32 k = 0; k < MH_BANDS; k++) {
+        u32 c;
+        const u8 *p = tri_postings_at(mf, iroot, keys[k], &c);
+        if (c) memcpy(*ids + n, p, (size_t)c * 4);
+        n += c;
+    }
+    qsort(*ids, n, 4, cmp_u32);
+    for (u32 i = 0; i < n; i++) if (m == 0 || (*ids)[m - 1] != (*ids)[i]) (*ids)[m++] = (*ids)[i];
+    return m;
+}
+
+/* union-find over dense positions; the root of a set is its least position */
+static u32 uf_find(u32 *parent, u32 x) {
+    while (parent[x] != x) { parent[x] = parent[parent[x]]; x = parent[x]; }
+    return x;
+}
+static void uf_union(u32 *parent, u32 a, u32 b) {
+    a = uf_find(parent, a); b = uf_find(parent, b);
+    if (a < b) parent[b] = a; else if (b < a) parent[a] = b;
+}
+
+static u32 dense_of(const u32 *all, u32 n, u32 id) {
+    u32 lo = 0, hi = n;
+    while (lo < hi) { u32 mid = (lo + hi) / 2; if (all[mid] < id) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+
+u32 mh_clusters(memfile_t *mf, u64 root, double min_sim, u32 **ids, u32 **cluster) {
+    u64 hdr = rdu64(mf, root), sroot = hdr + MH_SKETCHES, iroot = hdr + MH_INDEX;
+    u32 n = pmap_count(mf, sroot), cap = pmap_capacity(mf, sroot), m = 0, nc = 0;
+    u32 *all = malloc(((size_t)n + 1) * 4), *parent = malloc(((size_t)n + 1) * 4);
+    u32 *size = calloc((size_t)n + 1, 4), *sigs = malloc(((size_t)n + 1) * MH_SIG_SIZE), *dense = NULL;
+    *ids = *cluster = NULL;
+    if (!all || !parent || !size || !sigs) goto out;
+    for (u32 i = 0, j = 0; i < cap; i++) if (pmap_at(mf, sroot, i, &all[j], NULL)) j++;
+    qsort(all, n, 4, cmp_u32);
+    for (u32 i = 0; i < n; i++) { parent[i] = i; mh_get(mf, root, all[i], sigs + (size_t)i * MH_HASHES); }
+
+    /* Pairs within each band bucket: all of them in a small bucket, a sliding
+     * window in a big one (ids linked to a neighbour still join its cluster).
+     * A pair already in one set is not compared again. */
+    u32 bcap = pmap_capacity(mf, iroot);
+    for (u32 s = 0; s < bcap; s++) {
+        u32 key, c;
+        if (!pmap_at(mf, iroot, s, &key, NULL)) continue;
+        const u8 *p = tri_postings_at(mf, iroot, key, &c);
+        if (c < 2) continue;
+        u32 *d = realloc(dense, (size_t)c * 4 * 2);
+        if (!d) goto out;
+        dense = d;
+        memcpy(d + c, p, (size_t)c * 4);
+        for (u32 j = 0; j < c; j++) d[j] = dense_of(all, n, d[c + j]);
+        for (u32 j = 1; j < c; j++)
+            for (u32 i = j > MH_WINDOW ? j - MH_WINDOW : 0; i < j; i++)
+                if (uf_find(parent, d[i]) != uf_find(parent, d[j])
+                    && mh_similarity(sigs + (size_t)d[i] * MH_HASHES, sigs + (size_t)d[j] * MH_HASHES) >= min_sim)
+                    uf_union(parent, d[i], d[j]);
+    }
+
+    /* number clusters by their least id (their root), lay members out by cluster */
+    for (u32 i = 0; i < n; i++) size[uf_find(parent, i)]++;
+    u32 *num = realloc(dense, ((size_t)n + 1) * 4 * 2), *start;
+    if (!num) goto out;
+    dense = num;
+    start = num + n + 1;
+    for (u32 i = 0; i < n; i++)
+        if (parent[i] == i && size[i] > 1) { num[i] = nc; start[nc++] = m; m += size[i]; }
+    if (!m || !(*ids = malloc((size_t)m * 4)) || !(*cluster = malloc((size_t)m * 4))) {
+        free(*ids); *ids = NULL; m = 0;
+        goto out;
+    }
+    for (u32 i = 0; i < n; i++) {
+        u32 r = uf_find(parent, i);
+        if (size[r] < 2) continue;
+        u32 at = start[num[r]]++;
+        (*ids)[at] = all[i];
+        (*cluster)[at] = num[r];
+    }
+out:
+    free(all); free(parent); free(size); free(sigs); free(dense);
+    return m;
+}
@@ -0,0 +1,61 @@
+/*
+ * Near-duplicate text by MinHash with LSH banding.
+ *
+ * A text's shingles are its overlapping MH_SHINGLE-byte windows (a shorter text
+ * is one shingle). Its sketch keeps, for each of MH_HASHES hash functions, the
+ * least hash over the shingles; the share of slots on which two sketches agree
+ * estimates the Jaccard similarity of their shingle sets.
+ *
+ * The sketch is cut into MH_BANDS bands of MH_ROWS slots and the text is posted
+ * under a hash of each band. Texts of similarity s share a band with
+ * probability 1 - (1 - s^MH_ROWS)^MH_BANDS: about 0.64 at s = 0.5, 0.99 at 0.7.
+ * Sketches disagreeing on fewer than MH_BANDS slots always share one, so above
+ * an estimate of 1 - MH_BANDS / MH_HASHES (0.75) a lookup misses nothing.
+ *
+ * Header (the block a root slot points at): [u64 sketch pmap][u64 band index]
+ *   sketches: pmap from the caller's u32 id to a block of MH_HASHES u32s
+ *   bands:    the trigram index layout (trigram.h), band hash -> ascending ids
+ * Text is given case-folded. Callers hold the file's exclusive lock for
+ * add/remove.
+ */
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include <stddef.h>
+#include "memoryfile.h"
+
+#define MH_SHINGLE   4u
+#define MH_HASHES    64u
+#define MH_BANDS     16u
+#define MH_ROWS      (MH_HASHES / MH_BANDS)
+#define MH_WINDOW    64u     /* a big bucket compares each id with this many before it */
+
+/* sketch of s into sig[MH_HASHES] */
+void   mh_sketch(const u8 *s, u32 len, u32 *sig);
+/* the band keys of a sketch into keys[MH_BANDS] */
+void   mh_bands(const u32 *sig, u32 *keys);
+/* estimated Jaccard similarity: agreeing slots / MH_HASHES */
+double mh_similarity(const u32 *a, const u32 *b);
+
+/* allocate an index from n sketches (sigs: n * MH_HASHES, one per id) and store
+ * its header offset at `root`; 0 on failure */
+int  mh_build(memfile_t *mf, u64 root, const u32 *ids, const u32 *sigs, size_t n);
+/* free every block and zero `root` */
+void mh_destroy(memfile_t *mf, u64 root);
+int  mh_add(memfile_t *mf, u64 root, u32 id, const u32 *sig);
+void mh_remove(memfile_t *mf, u64 root, u32 id);    /* by the stored sketch */
+/* stored sketch of id into sig; 0 if absent */
+int  mh_get(memfile_t *mf, u64 root, u32 id, u32 *sig);
+
+/* Ids sharing a band with sig: *ids (malloc'd, ascending, distinct; caller
+ * frees) gets every one; returns the count, 0 with *ids NULL on OOM. */
+u32  mh_candidates(memfile_t *mf, u64 root, const u32 *sig, u32 **ids);
+
+/* Clusters of near duplicates: ids linked by a chain of pairs that share a band
+ * and reach min_sim. *ids (malloc'd) lists every id in a cluster of two or more,
+ * cluster by cluster — ordered by their least id, ascending within — and
+ * (*cluster)[i] numbers the cluster of (*ids)[i] from 0. Returns the number of
+ * ids, 0 with both NULL when none (or on OOM). */
+u32  mh_clusters(memfile_t *mf, u64 root, double min_sim, u32 **ids, u32 **cluster);
+
+#endif /* MINHASH_H */
@@ -135,6 +135,23 @@ int main(int argc, char **argv) {
         }
     }
 
+    /* Observation-text corpus for the string-compression trade-off: English-like
+     * sentences interned raw now, packed with a trained symbol table later. */
+    static const char *words[] = { "the", "agent", "noted", "that", "memory", "graph", "entity", "relation",
+        "observation", "about", "project", "uses", "with", "from", "which", "between", "document", "chunk",
+        "search", "results", "should", "include", "when", "each", "user", "prefers", "and", "for", "of", "to" };
+    const size_t NT = 4096;
+    u64 *tid = malloc(NT * sizeof *tid);
+    u64 raw_bytes = 0;
+    for (size_t i = 0; i < NT; i++) {
+        char tx[160]; int l = 0;
+        while (l < 100) l += snprintf(tx + l, sizeof tx - (size_t)l, "%s ", words[xs() % 30]);
+        l += snprintf(tx + l, sizeof tx - (size_t)l, "(%zu)", i);
+        tid[i] = st_intern(st, (const u8 *)tx, (u16)l);
+        raw_bytes += (10u + (u64)l + 31u) & ~31ull;
+    }
+    u8 txbuf[256];
+
     /* Precompute input pools so the timed regions contain ONLY the op (no per-iter
      * snprintf/rng inside timing), which lets us batch cleanly. */
     size_t *idx  = malloc(POOL * sizeof *idx);
@@ -171,6 +188,16 @@ int main(int argc, char **argv) {
     ADAPT("structural_sample", graph_structural_sample(g, 1, 0.85));
     ADAPT("compute_merw_psi",  graph_compute_merw_psi(g, 0.85, 100, 1e-8));
 
+    /* st_get + copy-out (what readEntity does per observation), raw vs packed */
+    u16 tl;
+    ADAPT("st_get_text_raw",   { const u8 *p = st_get(st, tid[idx[_k] % NT], &tl); memcpy(txbuf, p, tl); sink += txbuf[0]; });
+    u64 live0 = st->mf->header->allocated - st->mf->header->free_bytes;
+    st_train_dictionary(st, tid, (u32)NT);          /* the table itself counts against the saving */
+    for (size_t i = 0; i < NT; i++) st_pack(st, tid[i]);
+    u64 live1 = st->mf->header->allocated - st->mf->header->free_bytes;
+    u64 packed_bytes = raw_bytes + live1 - live0;
+    ADAPT("st_get_text_packed", { const u8 *p = st_get(st, tid[idx[_k] % NT], &tl); memcpy(txbuf, p, tl); sink += txbuf[0]; });
+
     /* Mutating ops: non-stationary (each call grows the graph), so they can't be
      * batch-sampled i.i.d. Keep a fixed single-op timed count; report distribution. */
     const size_t KM = 2000;
@@ -185,13 +212,15 @@ int main(int argc, char **argv) {
         samp[i] = (double)(t1 - t0); }
     emit_op("create_relation", samp, KM);
 
-    printf("\n  }\n}\n");
+    printf("\n  },\n  \"compression\": {\"text_strings\": %zu, \"raw_bytes\": %llu, \"packed_bytes\": %llu, \"ratio\": %.2f}\n}\n",
+           NT, (unsigned long long)raw_bytes, (unsigned long long)packed_bytes,
+           packed_bytes ? (double)raw_bytes / (double)packed_bytes : 0.0);
 
     for (u32 k = 0; k < POOL; k++) free(pat[k]);
     for (size_t i = 0; i < N; i++) free(names[i]);
     for (int t = 0; t < 20; t++) free(tynames[t]);
     free(idx); free(idx2); free(tpix); free(seed); free(pat); free(names); free(nlen);
-    free(samp); free(out); free(off); free(noff);
+    free(samp); free(out); free(off); free(noff); free(tid);
     graph_close(g); st_close(st);
     return 0;
 }
@@ -0,0 +1,134 @@
+#include "pmap.h"
+
+#include <string.h>
+
+static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
+
+static inline u32 hash32(u32 x) {
+    x ^= x >> 16; x *= 0x7feb352du; x ^= x >> 15; x *= 0x846ca68bu; x ^= x >> 16; return x;
+}
+static inline u64 bpos(u64 blk, u32 slot) { return blk + 8 + (u64)slot * PMAP_BUCKET_SIZE; }
+
+int pmap_create(memfile_t *mf, u64 root, u32 buckets) {
+    u64 size = 8 + (u64)buckets * PMAP_BUCKET_SIZE;
+    u64 blk = memfile_alloc(mf, size);
+    if (!blk) return 0;
+    memset(memfile_ptr(mf, blk), 0, size);
+    wru32(mf, blk + 0, buckets);
+    wru64(mf, root, blk);
+    return 1;
+}
+
+void pmap_destroy(memfile_t *mf, u64 root) {
+    u64 blk = rdu64(mf, root);
+    if (!blk) return;
+    memfile_free(mf, blk, 8 + (u64)rdu32(mf, blk + 0) * PMAP_BUCKET_SIZE);
+    wru64(mf, root, 0);
+}
+
+u64 pmap_get(memfile_t *mf, u64 root, u32 key) {
+    u64 blk = rdu64(mf, root);
+    if (!blk) return 0;
+    u32 bc = rdu32(mf, blk + 0);
+    for (u32 i = 0, s = hash32(key) % bc; i < bc; i++, s = (s + 1) % bc) {
+        u64 b = bpos(blk, s);
+        u64 v = rdu64(mf, b + 8);
+        if (v == 0) return 0;
+        if (rdu32(mf, b + 0) == key) return v;
+    }
+    return 0;
+}
+
+static int grow(memfile_t *mf, u64 root, u32 new_bc) {
+    u64 old = rdu64(mf, root);
+    u32 old_bc = rdu32(mf, old + 0), cnt = rdu32(mf, old + 4);
+    u64 size = 8 + (u64)new_bc * PMAP_BUCKET_SIZE;
+    u64 blk = memfile_alloc(mf, size);
+    if (!blk) return 0;
+    memset(memfile_ptr(mf, blk), 0, size);
+    wru32(mf, blk + 0, new_bc);
+    wru32(mf, blk + 4, cnt);
+    for (u32 i = 0; i < old_bc; i++) {
+        u64 ob = bpos(old, i);
+        u64 v = rdu64(mf, ob + 8);
+        if (!v) continue;
+        u32 k = rdu32(mf, ob + 0);
+        u32 s = hash32(k) % new_bc;
+        while (rdu64(mf, bpos(blk, s) + 8)) s = (s + 1) % new_bc;
+        wru32(mf, bpos(blk, s) + 0, k);
+        wru64(mf, bpos(blk, s) + 8, v);
+    }
+    wru64(mf, root, blk);
+    memfile_free(mf, old, 8 + (u64)old_bc * PMAP_BUCKET_SIZE);
+    return 1;
+}
+
+int pmap_put(memfile_t *mf, u64 root, u32 key, u64 val) {
+    u64 blk = rdu64(mf, root);
+    if (!blk || !val) return 0;
+    u32 bc = rdu32(mf, blk + 0);
+    for (u32 i = 0, s = hash32(key) % bc; i < bc; i++, s = (s + 1) % bc) {
+        u64 b = bpos(blk, s);
+        if (rdu64(mf, b + 8) == 0) {
+            wru32(mf, b + 0, key);
+            wru64(mf, b + 8, val);
+            u32 cnt = rdu32(mf, blk + 4) + 1;
+            wru32(mf, blk + 4, cnt);
+            if ((u64)cnt * 10 > (u64)bc * 7) grow(mf, root, bc * 2);   /* stays correct if growth fails */
+            return 1;
+        }
+        if (rdu32(mf, b + 0) == key) { wru64(mf, b + 8, val); return 1; }
+    }
+    return 0;
+}
+
+/* circular-probe relocation test (Knuth backward-shift deletion) */
+static int needs_reloc(u32 natural, u32 empty, u32 current) {
+    if (natural <= current) return natural <= empty && empty < current;
+    return natural <= empty || empty < current;
+}
+
+int pmap_del(memfile_t *mf, u64 root, u32 key) {
+    u64 blk = rdu64(mf, root);
+    if (!blk) return 0;
+    u32 bc = rdu32(mf, blk + 0);
+    for (u32 i = 0, s = hash32(key) % bc; i < bc; i++, s = (s + 1) % bc) {
+        u64 b = bpos(blk, s);
+        if (rdu64(mf, b + 8) == 0) return 0;
+        if (rdu32(mf, b + 0) != key) continue;
+        wru64(mf, b + 8, 0);
+        wru32(mf, blk + 4, rdu32(mf, blk + 4) - 1);
+        u32 removed = s;
+        for (u32 t = (s + 1) % bc; ; t = (t + 1) % bc) {
+            u64 tb = bpos(blk, t);
+            u64 v = rdu64(mf, tb + 8);
+            if (!v) break;
+            u32 k = rdu32(mf, tb + 0);
+            if (needs_reloc(hash32(k) % bc, removed, t)) {
+                u64 rb = bpos(blk, removed);
+                wru32(mf, rb + 0, k);
+                wru64(mf, rb + 8, v);
+                wru64(mf, tb + 8, 0);
+                removed = t;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+u32 pmap_count(memfile_t *mf, u64 root)    { u64 b = rdu64(mf, root); return b ? rdu32(mf, b + 4) : 0; }
+u32 pmap_capacity(memfile_t *mf, u64 root) { u64 b = rdu64(mf, root); return b ? rdu32(mf, b + 0) : 0; }
+
+int pmap_at(memfile_t *mf, u64 root, u32 slot, u32 *key, u64 *val) {
+    u64 blk = rdu64(mf, root);
+    u64 b = bpos(blk, slot);
+    u64 v = rdu64(mf, b + 8);
+    if (!v) return 0;
+    if (key) *key = rdu32(mf, b + 0);
+    if (val) *val = v;
+    return 1;
+}
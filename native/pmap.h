@@ -0,0 +1,35 @@
+/*
+ * Persistent u32 -> u64 hash map over a v3 MemoryFile (open addressing, linear
+ * probing, backward-shift deletion — the same scheme as the graph name index).
+ *
+ * Block: [u32 bucket_count][u32 count][bucket{u32 key, u32 pad, u64 val}...]
+ *   val == 0 marks an empty bucket, so 0 is not a storable value.
+ *
+ * The block relocates when it grows, so every call takes `root`: the memfile
+ * offset of the u64 field that holds the block offset (a header/aux slot).
+ * Callers hold the file's exclusive lock for put/del, as with every other
+ * mutation.
+ */
+#ifndef PMAP_H
+#define PMAP_H
+
+#include "memoryfile.h"
+
+#define PMAP_BUCKET_SIZE     16u
+#define PMAP_INITIAL_BUCKETS 1024u
+
+/* allocate an empty map and store its block offset at `root`; 0 on failure */
+int  pmap_create(memfile_t *mf, u64 root, u32 buckets);
+/* free the block and zero `root` */
+void pmap_destroy(memfile_t *mf, u64 root);
+
+u64  pmap_get(memfile_t *mf, u64 root, u32 key);              /* 0 if absent */
+int  pmap_put(memfile_t *mf, u64 root, u32 key, u64 val);     /* insert or replace; 0 on failure */
+int  pmap_del(memfile_t *mf, u64 root, u32 key);              /* 1 if removed */
+u32  pmap_count(memfile_t *mf, u64 root);
+
+/* slot-order iteration: for (u32 i = 0; i < pmap_capacity(..); i++) pmap_at(.., i, &k, &v) */
+u32  pmap_capacity(memfile_t *mf, u64 root);
+int  pmap_at(memfile_t *mf, u64 root, u32 slot, u32 *key, u64 *val);   /* 1 if occupied */
+
+#endif /* PMAP_H */
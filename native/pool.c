@@ -0,0 +1,90 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+static pthread_mutex_t g_job = PTHREAD_MUTEX_INITIALIZER;   /* held for a whole job */
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;    /* guards everything below */
+static pthread_cond_t  g_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  g_done = PTHREAD_COND_INITIALIZER;
+
+static u32     g_want;                /* pool_set_workers; 0 = online CPUs */
+static u32     g_threads;             /* started so far (excluding callers) */
+static u64     g_gen;                 /* bumped per job; wakes the workers */
+static pool_fn g_fn;
+static void   *g_ctx;
+static u32     g_next, g_nparts, g_pending;
+
+static u32 online_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n > (long)POOL_MAX_WORKERS ? POOL_MAX_WORKERS : (u32)n;
+}
+
+u32 pool_workers(void) {
+    pthread_mutex_lock(&g_mu);
+    u32 w = g_want;
+    pthread_mutex_unlock(&g_mu);
+    return w ? w : online_cpus();
+}
+
+void pool_set_workers(u32 n) {
+    pthread_mutex_lock(&g_mu);
+    g_want = n > POOL_MAX_WORKERS ? POOL_MAX_WORKERS : n;
+    pthread_mutex_unlock(&g_mu);
+}
+
+/* take parts of the current job until none are left; called with g_mu held */
+static void drain(void) {
+    while (g_next < g_nparts) {
+        u32 p = g_next++;
+        pool_fn fn = g_fn; void *ctx = g_ctx;
+        pthread_mutex_unlock(&g_mu);
+        fn(ctx, p);
+        pthread_mutex_lock(&g_mu);
+        if (--g_pending == 0) pthread_cond_signal(&g_done);
+    }
+}
+
+static void *worker(void *arg) {
+    (void)arg;
+    u64 seen = 0;
+    pthread_mutex_lock(&g_mu);
+    for (;;) {
+        while (g_gen == seen) pthread_cond_wait(&g_go, &g_mu);
+        seen = g_gen;
+        drain();
+    }
+    return NULL;
+}
+
+/* start threads up to `n`; a failed start just leaves fewer hands */
+static void grow(u32 n) {
+    while (g_threads < n) {
+        pthread_t t;
+        pthread_attr_t at;
+        pthread_attr_init(&at);
+        pthread_attr_setdetachstate(&at, PTHREAD_CREATE_DETACHED);
+        int rc = pthread_create(&t, &at, worker, NULL);
+        pthread_attr_destroy(&at);
+        if (rc) break;
+        g_threads++;
+    }
+}
+
+void pool_run(u32 nparts, pool_fn fn, void *ctx) {
+    u32 w = nparts > 1 ? pool_workers() : 1;
+    if (w <= 1 || pthread_mutex_trylock(&g_job) != 0) {
+        for (u32 p = 0; p < nparts; p++) fn(ctx, p);
+        return;
+    }
+    pthread_mutex_lock(&g_mu);
+    grow((nparts < w ? nparts : w) - 1);
+    g_fn = fn; g_ctx = ctx;
+    g_next = 0; g_nparts = nparts; g_pending = nparts;
+    g_gen++;
+    pthread_cond_broadcast(&g_go);
+    drain();
+    while (g_pending) pthread_cond_wait(&g_done, &g_mu);
+    pthread_mutex_unlock(&g_mu);
+    pthread_mutex_unlock(&g_job);
+}
@@ -0,0 +1,25 @@
+/*
+ * Process-wide worker pool for the store's full scans.
+ *
+ * pool_run(n, fn, ctx) calls fn(ctx, p) once for every part p in [0, n) and
+ * returns when all have finished; the calling thread works parts too. Threads
+ * start on first use and then sleep between jobs. One job runs at a time: a
+ * caller that finds the pool busy (another reader, or a scan nested in a part)
+ * runs its parts itself, so pool_run never blocks on the pool.
+ *
+ * Parts must only read shared state — the scans run under the read lock.
+ */
+#ifndef POOL_H
+#define POOL_H
+
+#include "memoryfile.h"
+
+#define POOL_MAX_WORKERS 32u
+
+typedef void (*pool_fn)(void *ctx, u32 part);
+
+u32  pool_workers(void);             /* threads a job may use, caller included */
+void pool_set_workers(u32 n);        /* 0 = online CPUs (the default); 1 = serial */
+void pool_run(u32 nparts, pool_fn fn, void *ctx);
+
+#endif /* POOL_H */
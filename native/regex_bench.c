@@ -0,0 +1,134 @@
+/*
+ * Benchmark: lazy-DFA matcher + pattern cache vs. the regcomp/regexec path
+ * graph_search used before it, on the query set of bench/search-bench.ts.
+ *
+ *   baseline: per query, regcomp twice (regexValid, then the search) and
+ *             regexec(REG_STARTEND) over every string
+ *   dfa:      rx_acquire (a cache hit after the first call) and rx_match
+ *             over every string
+ *
+ * The corpus is synthetic and seeded: entity-like names, types and
+ * observation sentences over a vocabulary that hits each query. Both kernels
+ * must agree on the match count for every query (MISMATCH otherwise).
+ *
+ *   make bench-regex              # -O2 -march=native, NO sanitizers
+ *   /tmp/mf_test_bench_regex [N] [seed]
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <regex.h>
+#include "regex_dfa.h"
+
+static u64 rng;
+static inline u64 xs(void) { u64 x = rng; x ^= x << 13; x ^= x >> 7; x ^= x << 17; return rng = x; }
+
+static u64 now_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) { u64 x = *(const u64 *)a, y = *(const u64 *)b; return (x > y) - (x < y); }
+
+typedef struct { char *s; u32 len; } text;
+
+static u32 scan_regexec(const char *pat, const text *t, size_t n) {
+    regex_t re, chk;
+    if (regcomp(&chk, pat, REG_EXTENDED) != 0) return 0;   /* regexValid */
+    regfree(&chk);
+    if (regcomp(&re, pat, REG_EXTENDED) != 0) return 0;
+    u32 hits = 0;
+    for (size_t i = 0; i < n; i++) {
+        regmatch_t pm; pm.rm_so = 0; pm.rm_eo = (regoff_t)t[i].len;
+        hits += regexec(&re, t[i].s, 0, &pm, REG_STARTEND) == 0;
+    }
+    regfree(&re);
+    return hits;
+}
+
+static u32 scan_dfa(const char *pat, const text *t, size_t n) {
+    rx_t *chk = rx_acquire(pat);                            /* regexValid */
+    int ok = rx_valid(chk);
+    rx_release(chk);
+    if (!ok) return 0;
+    rx_t *re = rx_acquire(pat);
+    u32 hits = 0;
+    for (size_t i = 0; i < n; i++) hits += (u32)rx_match(re, (const u8 *)t[i].s, t[i].len);
+    rx_release(re);
+    return hits;
+}
+
+#define ITERATIONS 50
+#define WARMUP     5
+
+static u64 median_ns(u32 (*scan)(const char *, const text *, size_t), const char *pat, const text *t, size_t n, u32 *count) {
+    u64 runs[ITERATIONS];
+    for (int w = 0; w < WARMUP; w++) *count = scan(pat, t, n);
+    for (int r = 0; r < ITERATIONS; r++) {
+        u64 t0 = now_ns();
+        *count = scan(pat, t, n);
+        runs[r] = now_ns() - t0;
+    }
+    qsort(runs, ITERATIONS, sizeof runs[0], cmp_u64);
+    return runs[ITERATIONS / 2];
+}
+
+int main(int argc, char **argv) {
+    size_t N = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000;
+    rng       = (argc > 2) ? strtoull(argv[2], NULL, 10) : 0x9e3779b97f4a7c15ull;
+
+    static const char *words[] = { "the", "agent", "noted", "that", "memory", "graph", "pagerank", "StringTable",
+        "lock", "observation", "concurrent", "rebuildNameIndex", "Self", "colour", "color", "example.com", "foo",
+        "bar", "memoryfile", "graphfile", "abc", "uses", "with", "from", "which", "between", "search", "results" };
+    static const char *names[] = { "Self", "Lev", "Claude", "Project", "Server", "Index" };
+    const size_t NW = sizeof words / sizeof words[0], NN = sizeof names / sizeof names[0];
+
+    /* name, type and two observations per entity, like the search corpus */
+    size_t NT = N * 4;
+    text *t = malloc(NT * sizeof *t);
+    for (size_t i = 0; i < N; i++) {
+        char buf[256]; int l;
+        l = (xs() % 8 == 0) ? snprintf(buf, sizeof buf, "%s", names[xs() % NN])
+                            : snprintf(buf, sizeof buf, "%s-%zu", names[xs() % NN], i);
+        t[4 * i] = (text){ strdup(buf), (u32)l };
+        l = snprintf(buf, sizeof buf, "type-%zu", i % 20);
+        t[4 * i + 1] = (text){ strdup(buf), (u32)l };
+        for (int k = 2; k < 4; k++) {
+            l = 0;
+            while (l < 120) l += snprintf(buf + l, sizeof buf - (size_t)l, "%s ", words[xs() % NW]);
+            t[4 * i + k] = (text){ strdup(buf), (u32)l };
+        }
+    }
+
+    static const char *queries[] = {
+        "memory", "graph", "pagerank", "StringTable", "lock", "observation", "concurrent", "rebuildNameIndex",
+        "^Self$", "^Lev$", "^Claude$",
+        "memory|graph", "foo|bar|baz|qux",
+        "memory.*concurrent", "foo.bar", "(memory|graph)file", "colou?r", "\\.com", "\\bSelf\\b",
+        ".*", "a.c",
+    };
+    const size_t NQ = sizeof queries / sizeof queries[0];
+
+    printf("%zu strings (%zu entities)\n\n", NT, N);
+    printf("Query                              matches    regexec us      dfa us      speedup    match\n");
+    printf("-----------------------------------------------------------------------------------------------\n");
+    double sum = 0; int mismatches = 0;
+    for (size_t q = 0; q < NQ; q++) {
+        u32 cb = 0, cd = 0;
+        u64 b = median_ns(scan_regexec, queries[q], t, NT, &cb);
+        u64 d = median_ns(scan_dfa, queries[q], t, NT, &cd);
+        double sp = d ? (double)b / (double)d : 0.0;
+        sum += sp; mismatches += cb != cd;
+        printf("%-32s %10u   %11.1f  %11.1f   %9.2fx   %s\n", queries[q], cb, (double)b / 1000.0, (double)d / 1000.0,
+               sp, cb == cd ? "OK" : "MISMATCH");
+    }
+    printf("\navg speedup over %zu queries: %.2fx\n", NQ, sum / (double)NQ);
+
+    for (size_t i = 0; i < NT; i++) free(t[i].s);
+    free(t);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,761 @@
+#include "regex_dfa.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "regex_query.h"   /* rq_literals: required factors for the prefilter */
+
+/* ======================================================================
+ * Limits: anything past these is handed to regcomp rather than expanded
+ * ====================================================================== */
+
+#define RX_MAX_NODES   16384u
+#define RX_MAX_INST    16384u
+#define RX_MAX_DEPTH   512
+#define RX_MAX_STATES  2048u   /* DFA states kept before the state cache is flushed */
+#define RX_MAX_KERNEL  (1u << 18)
+#define RX_MAX_LITS    8u      /* prefilter alternatives; more and it stops paying */
+
+/* ======================================================================
+ * Parse: glibc ERE (C / single-byte locale) -> AST
+ *
+ * The parser is also the validity check for everything it accepts: its
+ * rejections mirror regcomp's error paths (REG_EBRACK, REG_ERANGE,
+ * REG_BADRPT, ...), so most patterns never reach regcomp at all — which
+ * matters because regcomp can spin on nested empty loops like ((\`)*|\b)**.
+ * Constructs it does not model are deferred to regcomp instead.
+ * ====================================================================== */
+
+enum { N_EMPTY, N_CLASS, N_CAT, N_ALT, N_REP, N_ASSERT };
+enum { A_BOL, A_EOL, A_BOT, A_EOT, A_WORDB, A_NWORDB, A_WBEG, A_WEND };
+
+typedef struct { u8 kind, arg; u16 cls; int a, b, min, max; } rx_node;
+typedef struct { u64 w[4]; } bset;
+
+typedef struct {
+    const u8 *p, *end;
+    rx_node  *nodes; u32 nn;
+    bset     *cls;   u32 ncls, capcls;
+    int       depth, bail, bad, words, lines;
+} parser;
+
+/* stop parsing: bad = regcomp would reject the pattern, else defer to it */
+static int fail(parser *ps, int bad) { ps->bail = 1; ps->bad |= bad; return 0; }
+
+static inline void bs_set(bset *s, u32 c) { s->w[c >> 6] |= 1ull << (c & 63); }
+static inline int  bs_has(const bset *s, u32 c) { return (int)(s->w[c >> 6] >> (c & 63)) & 1; }
+static inline int  is_word(u32 c) { return c == '_' || isalnum((int)c); }
+
+static int node(parser *ps, u8 kind, int a, int b) {
+    if (ps->nn >= RX_MAX_NODES) return fail(ps, 0);
+    rx_node *n = &ps->nodes[ps->nn];
+    memset(n, 0, sizeof *n);
+    n->kind = kind; n->a = a; n->b = b;
+    return (int)ps->nn++;
+}
+
+/* intern a byte set (deduped) and wrap it in a class node */
+static int class_node(parser *ps, const bset *s) {
+    u32 i;
+    for (i = 0; i < ps->ncls; i++) if (!memcmp(&ps->cls[i], s, sizeof *s)) break;
+    if (i == ps->ncls) {
+        if (ps->ncls == ps->capcls) {
+            u32 nc = ps->capcls ? ps->capcls * 2 : 16;
+            bset *t = nc <= 65535 ? realloc(ps->cls, nc * sizeof(bset)) : NULL;
+            if (!t) return fail(ps, 0);
+            ps->cls = t; ps->capcls = nc;
+        }
+        ps->cls[ps->ncls++] = *s;
+    }
+    int n = node(ps, N_CLASS, 0, 0);
+    if (!ps->bail) ps->nodes[n].cls = (u16)i;
+    return n;
+}
+
+static int byte_node(parser *ps, u8 c) { bset s = {{0}}; bs_set(&s, c); return class_node(ps, &s); }
+
+static int assert_node(parser *ps, u8 kind) {
+    int n = node(ps, N_ASSERT, 0, 0);
+    if (!ps->bail) ps->nodes[n].arg = kind;
+    if (kind >= A_WORDB) ps->words = 1;
+    if (kind == A_BOL || kind == A_EOL) ps->lines = 1;
+    return n;
+}
+
+static int named_class(const char *name, size_t len, bset *s) {
+    static const struct { const char *n; int (*f)(int); } tab[] = {
+        { "alpha", isalpha }, { "upper", isupper }, { "lower", islower }, { "digit", isdigit },
+        { "xdigit", isxdigit }, { "space", isspace }, { "print", isprint }, { "punct", ispunct },
+        { "graph", isgraph }, { "cntrl", iscntrl }, { "blank", isblank }, { "alnum", isalnum },
+    };
+    for (size_t i = 0; i < sizeof tab / sizeof tab[0]; i++)
+        if (strlen(tab[i].n) == len && !memcmp(tab[i].n, name, len)) {
+            for (u32 c = 0; c < 256; c++) if (tab[i].f((int)c)) bs_set(s, c);
+            return 1;
+        }
+    return 0;
+}
+
+enum { BE_FAIL, BE_BYTE, BE_CLASS, BE_EQUIV };
+
+/* One bracket element at ps->p: a byte (*c), a [:class:] merged into *s, or
+ * a one-byte [=equivalence=] (*c; not a range endpoint). BE_FAIL has called
+ * fail(). */
+static int bracket_elem(parser *ps, bset *s, u8 *c) {
+    const u8 *p = ps->p;
+    if (p + 1 < ps->end && p[0] == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.')) {
+        u8 d = p[1];
+        const u8 *q = p + 2;
+        while (q + 1 < ps->end && !(q[0] == d && q[1] == ']')) q++;
+        if (q + 1 >= ps->end) return fail(ps, 1);              /* REG_EBRACK */
+        size_t len = (size_t)(q - (p + 2));
+        ps->p = q + 2;
+        if (d == ':') return named_class((const char *)p + 2, len, s) ? BE_CLASS : fail(ps, 1);
+        if (len != 1) return fail(ps, 0);                       /* multi-char collating element */
+        *c = p[2];
+        return d == '=' ? BE_EQUIV : BE_BYTE;
+    }
+    *c = *p;
+    ps->p = p + 1;
+    return BE_BYTE;
+}
+
+static int parse_bracket(parser *ps) {
+    bset s = {{0}};
+    int neg = 0, first = 1;
+    if (ps->p < ps->end && *ps->p == '^') { neg = 1; ps->p++; }
+    for (;;) {
+        if (ps->p >= ps->end) return fail(ps, 1);                               /* REG_EBRACK */
+        if (*ps->p == ']' && !first) { ps->p++; break; }
+        /* past the first element a bare '-' may only come right before ']' */
+        if (!first && *ps->p == '-' && (ps->p + 1 >= ps->end || ps->p[1] != ']')) return fail(ps, 1);
+        first = 0;
+        u8 lo, hi;
+        int k = bracket_elem(ps, &s, &lo);
+        if (k == BE_FAIL) return 0;
+        if (k == BE_CLASS) continue;
+        if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']') {
+            if (k == BE_EQUIV) return fail(ps, 1);                              /* REG_ERANGE */
+            ps->p++;
+            k = bracket_elem(ps, &s, &hi);
+            if (k == BE_FAIL) return 0;
+            if (k != BE_BYTE) return fail(ps, 1);
+            if (lo >= 0x80 || hi >= 0x80) return fail(ps, 0);                   /* collation order */
+            if (lo > hi) return fail(ps, 1);
+            for (u32 x = lo; x <= hi; x++) bs_set(&s, x);
+        } else {
+            bs_set(&s, lo);
+        }
+    }
+    if (neg) for (int i = 0; i < 4; i++) s.w[i] = ~s.w[i];
+    return class_node(ps, &s);
+}
+
+static int parse_alt(parser *ps);
+
+/* Next interval byte at p (width in *w), -1 at the end. regcomp reads the
+ * interval token by token, so the escapes \0 and \, also count as '0' and ','. */
+static int iv_byte(const parser *ps, const u8 *p, int *w) {
+    if (p >= ps->end) return -1;
+    *w = 1;
+    if (*p == '\\' && p + 1 < ps->end && (p[1] == '0' || p[1] == ',')) { *w = 2; return p[1]; }
+    return *p;
+}
+
+/* interval after '{': digits[,[digits]]} ; max -1 = unbounded */
+static int parse_interval(parser *ps, int *min, int *max) {
+    const u8 *p = ps->p;
+    int lo = -1, hi, c, w;
+    while ((c = iv_byte(ps, p, &w)) >= 0 && isdigit(c)) { lo = (lo < 0 ? 0 : lo) * 10 + (c - '0'); if (lo > 0x7fff) return 0; p += w; }
+    if (c == ',') {
+        p += w;
+        if (lo < 0) lo = 0;
+        hi = -1;
+        while ((c = iv_byte(ps, p, &w)) >= 0 && isdigit(c)) { hi = (hi < 0 ? 0 : hi) * 10 + (c - '0'); if (hi > 0x7fff) return 0; p += w; }
+    } else {
+        if (lo < 0) return 0;
+        hi = lo;
+    }
+    if (c != '}' || (hi >= 0 && hi < lo)) return 0;
+    ps->p = p + 1;
+    *min = lo; *max = hi;
+    return 1;
+}
+
+static int parse_atom(parser *ps, int *is_assert) {
+    u8 c = *ps->p++;
+    *is_assert = 0;
+    switch (c) {
+    case '(': {
+        if (++ps->depth > RX_MAX_DEPTH) return fail(ps, 0);
+        int n = parse_alt(ps);
+        ps->depth--;
+        if (ps->bail) return 0;
+        if (ps->p >= ps->end || *ps->p != ')') return fail(ps, 1);           /* REG_EPAREN */
+        ps->p++;
+        return n;
+    }
+    case '[': return parse_bracket(ps);
+    case '.': { bset s; memset(&s, 0xff, sizeof s); s.w[0] &= ~1ull; return class_node(ps, &s); }   /* not NUL */
+    case '^': *is_assert = 1; return assert_node(ps, A_BOL);
+    case '$': *is_assert = 1; return assert_node(ps, A_EOL);
+    case '*': case '+': case '?': case '{': return fail(ps, 1);          /* REG_BADRPT */
+    case '\\': {
+        if (ps->p >= ps->end) return fail(ps, 1);                           /* REG_EESCAPE */
+        u8 e = *ps->p++;
+        bset s = {{0}};
+        switch (e) {
+        case 'w': case 'W':
+            for (u32 x = 0; x < 256; x++) if (is_word(x) == (e == 'w')) bs_set(&s, x);
+            return class_node(ps, &s);
+        case 's': case 'S':
+            for (u32 x = 0; x < 256; x++) if ((isspace((int)x) != 0) == (e == 's')) bs_set(&s, x);
+            return class_node(ps, &s);
+        case 'b':  *is_assert = 1; return assert_node(ps, A_WORDB);
+        case 'B':  *is_assert = 1; return assert_node(ps, A_NWORDB);
+        case '<':  *is_assert = 1; return assert_node(ps, A_WBEG);
+        case '>':  *is_assert = 1; return assert_node(ps, A_WEND);
+        case '`':  *is_assert = 1; return assert_node(ps, A_BOT);
+        case '\'': *is_assert = 1; return assert_node(ps, A_EOT);
+        default:
+            if (e >= '1' && e <= '9') return fail(ps, 0);                   /* back-reference: not regular */
+            return byte_node(ps, e);
+        }
+    }
+    default:
+        return byte_node(ps, c);   /* includes an unmatched top-level ')' */
+    }
+}
+
+static int parse_piece(parser *ps) {
+    int is_assert, n = parse_atom(ps, &is_assert);
+    while (!ps->bail && ps->p < ps->end) {
+        int min, max;
+        u8 c = *ps->p;
+        if (c == '*')      { min = 0; max = -1; ps->p++; }
+        else if (c == '+') { min = 1; max = -1; ps->p++; }
+        else if (c == '?') { min = 0; max = 1;  ps->p++; }
+        else if (c == '{') { ps->p++; if (!parse_interval(ps, &min, &max)) return fail(ps, 1); }   /* REG_BADBR, REG_EBRACE */
+        else break;
+        if (is_assert) return fail(ps, 1);   /* a quantified anchor: REG_BADRPT */
+        if (min == 0 && max == 0) { n = node(ps, N_EMPTY, 0, 0); continue; }
+        int r = node(ps, N_REP, n, 0);
+        if (ps->bail) return 0;
+        ps->nodes[r].min = min; ps->nodes[r].max = max;
+        n = r;
+    }
+    return n;
+}
+
+static int parse_concat(parser *ps) {
+    int n = -1;
+    while (!ps->bail && ps->p < ps->end && *ps->p != '|' && !(*ps->p == ')' && ps->depth > 0)) {
+        int k = parse_piece(ps);
+        n = n < 0 ? k : node(ps, N_CAT, n, k);
+    }
+    return n < 0 ? node(ps, N_EMPTY, 0, 0) : n;
+}
+
+static int parse_alt(parser *ps) {
+    int n = parse_concat(ps);
+    while (!ps->bail && ps->p < ps->end && *ps->p == '|') {
+        ps->p++;
+        int k = parse_concat(ps);
+        n = node(ps, N_ALT, n, k);
+    }
+    return n;
+}
+
+/* ======================================================================
+ * Compile: AST -> Thompson program
+ * ====================================================================== */
+
+enum { I_CLASS, I_SPLIT, I_JMP, I_ASSERT, I_MATCH };
+typedef struct { u8 op, arg; u16 cls; u32 x, y; } rx_inst;
+
+typedef struct {
+    rx_inst *ins; u32 n;
+    int      over;
+} emitter;
+
+static u32 emit(emitter *em, u8 op) {
+    if (em->n >= RX_MAX_INST) { em->over = 1; return 0; }
+    rx_inst *i = &em->ins[em->n];
+    memset(i, 0, sizeof *i);
+    i->op = op; i->x = em->n + 1;
+    return em->n++;
+}
+
+static void gen(emitter *em, const parser *ps, int ni) {
+    if (em->over) return;
+    const rx_node *nd = &ps->nodes[ni];
+    switch (nd->kind) {
+    case N_EMPTY: return;
+    case N_CLASS: { u32 i = emit(em, I_CLASS); if (!em->over) em->ins[i].cls = nd->cls; return; }
+    case N_ASSERT: { u32 i = emit(em, I_ASSERT); if (!em->over) em->ins[i].arg = nd->arg; return; }
+    case N_CAT: gen(em, ps, nd->a); gen(em, ps, nd->b); return;
+    case N_ALT: {
+        u32 s = emit(em, I_SPLIT);
+        gen(em, ps, nd->a);
+        u32 j = emit(em, I_JMP);
+        if (em->over) return;
+        em->ins[s].y = em->n;
+        gen(em, ps, nd->b);
+        if (!em->over) em->ins[j].x = em->n;
+        return;
+    }
+    case N_REP: {
+        for (int k = 0; k < nd->min && !em->over; k++) gen(em, ps, nd->a);
+        if (nd->max < 0) {                                   /* a* */
+            u32 s = emit(em, I_SPLIT);
+            gen(em, ps, nd->a);
+            u32 j = emit(em, I_JMP);
+            if (em->over) return;
+            em->ins[j].x = s;
+            em->ins[s].y = em->n;
+            return;
+        }
+        u32 opt = (u32)(nd->max - nd->min), first = em->n;   /* (a(a(a)?)?)? */
+        for (u32 k = 0; k < opt && !em->over; k++) { emit(em, I_SPLIT); gen(em, ps, nd->a); }
+        if (em->over) return;
+        for (u32 pc = first; pc < em->n; pc++)
+            if (em->ins[pc].op == I_SPLIT && em->ins[pc].y == 0) em->ins[pc].y = em->n;
+        return;
+    }
+    }
+}
+
+/* ======================================================================
+ * Lazy DFA
+ *
+ * A state is the set of program counters reached right after a byte (its
+ * kernel) plus what the assertions need from the left: "at text start",
+ * "previous byte was a word byte", "previous byte was a newline". The epsilon
+ * closure is taken on the NEXT step, once the byte to the right is known, so
+ * \b \> $ resolve exactly. Every closure re-seeds the start pc (unanchored
+ * search) unless the pattern can only start at offset 0. Transitions are per
+ * byte class, plus one column for end of text.
+ *
+ * glibc's own DFA gives ^ and $ a line meaning even without REG_NEWLINE, but
+ * only inside a match: ^ holds after a newline the same match consumed (not
+ * where a match merely starts), and $ holds before a newline the match goes on
+ * to consume (not where it ends). The closure reproduces that per thread: a
+ * seeded thread is "weak" (its ^ needs text start) and a thread past such a $
+ * is "pending" (it may consume the newline but not accept).
+ * ====================================================================== */
+
+#define F_BOT 1u   /* state flags */
+#define F_PW  2u
+#define F_PNL 4u
+
+#define M_WEAK    1u   /* closure thread modes */
+#define M_PENDING 2u
+
+#define T_UNKNOWN (-1)
+#define T_MATCH   (-2)
+#define T_DEAD    (-3)
+
+typedef struct {
+    rx_inst *ins; u32 nins;
+    bset    *cls; u32 ncls;
+    int      words, lines, anchored;
+    u8       bytemap[256]; u32 nbc;       /* byte -> byte class */
+    u8       rep[256];                    /* a representative byte per class */
+    /* state cache */
+    u32     *kern;  u32 nkern;            /* kernel pool */
+    u32     *koff, *klen; u8 *kflag;      /* per state */
+    int     *trans;                       /* nstates x (nbc + 1) */
+    u32      nstates;
+    u32     *htab;  u32 hcap;             /* open addressing, state index + 1 */
+    int      start;                       /* initial state, -1 until built */
+    /* scratch */
+    u32     *stack, *mark, gen; u8 *modes; u32 *buf;
+} rx_dfa;
+
+static u32 khash(const u32 *k, u32 n, u8 f) {
+    u32 h = 2166136261u ^ f;
+    for (u32 i = 0; i < n; i++) { h ^= k[i]; h *= 16777619u; }
+    return h;
+}
+
+static void dfa_flush(rx_dfa *d) {
+    d->nstates = 0; d->nkern = 0; d->start = -1;
+    memset(d->htab, 0, (size_t)d->hcap * sizeof(u32));
+}
+
+static int cmp_u32k(const void *a, const void *b) { u32 x = *(const u32 *)a, y = *(const u32 *)b; return (x > y) - (x < y); }
+
+/* find or add the state (kernel, flags); sets *flushed if the cache had to be
+ * emptied first, i.e. the caller's source state is gone */
+static int dfa_state(rx_dfa *d, u32 *k, u32 n, u8 f, int *flushed) {
+    u32 h = khash(k, n, f), m = d->hcap - 1;
+    for (u32 i = h & m; d->htab[i]; i = (i + 1) & m) {
+        u32 s = d->htab[i] - 1;
+        if (d->kflag[s] == f && d->klen[s] == n && (!n || !memcmp(d->kern + d->koff[s], k, (size_t)n * 4))) return (int)s;
+    }
+    if (d->nstates == RX_MAX_STATES || d->nkern + n > RX_MAX_KERNEL) { dfa_flush(d); *flushed = 1; }
+    u32 s = d->nstates++;
+    if (n) memcpy(d->kern + d->nkern, k, (size_t)n * 4);
+    d->koff[s] = d->nkern; d->klen[s] = n; d->kflag[s] = f;
+    d->nkern += n;
+    for (u32 c = 0; c <= d->nbc; c++) d->trans[(size_t)s * (d->nbc + 1) + c] = T_UNKNOWN;
+    u32 i = h & m;
+    while (d->htab[i]) i = (i + 1) & m;
+    d->htab[i] = s + 1;
+    return (int)s;
+}
+
+/* Step from state s over byte class bc (nbc = end of text). */
+static int dfa_step(rx_dfa *d, int s, u32 bc) {
+    int *slot = &d->trans[(size_t)s * (d->nbc + 1) + bc];
+    int eot = bc == d->nbc;
+    u32 c = eot ? 0 : d->rep[bc];
+    u8 sf = d->kflag[s];
+    int bot = (sf & F_BOT) != 0, pw = (sf & F_PW) != 0, pnl = (sf & F_PNL) != 0;
+    int nw = !eot && is_word(c), nl = !eot && c == '\n';
+    if (++d->gen == 0) { memset(d->mark, 0, (size_t)d->nins * 4); d->gen = 1; }
+    u32 sp = 0, nb = 0;
+    const u32 *k = d->kern + d->koff[s];
+    for (u32 i = 0; i < d->klen[s]; i++) d->stack[sp++] = k[i] << 2;
+    if (!d->anchored || bot) d->stack[sp++] = (0u << 2) | M_WEAK;
+    while (sp) {
+        u32 e = d->stack[--sp], pc = e >> 2, m = e & 3u;
+        if (d->mark[pc] != d->gen) { d->mark[pc] = d->gen; d->modes[pc] = 0; }
+        u8 seen = d->modes[pc];
+        int dominated = 0;
+        for (u32 v = 0; v < 4; v++) if ((seen >> v & 1) && (v & ~m) == 0) dominated = 1;
+        if (dominated) continue;
+        d->modes[pc] = (u8)(seen | 1u << m);
+        const rx_inst *in = &d->ins[pc];
+        u32 nx = in->x << 2 | m;
+        switch (in->op) {
+        case I_MATCH:  if (!(m & M_PENDING)) return *slot = T_MATCH; break;
+        case I_JMP:    d->stack[sp++] = nx; break;
+        case I_SPLIT:  d->stack[sp++] = in->y << 2 | m; d->stack[sp++] = nx; break;
+        case I_CLASS:  if (!eot && bs_has(&d->cls[in->cls], c)) d->buf[nb++] = in->x; break;
+        case I_ASSERT:
+            switch (in->arg) {
+            case A_BOL:    if (bot || (pnl && !(m & M_WEAK))) d->stack[sp++] = nx; break;
+            case A_EOL:    if (eot) d->stack[sp++] = nx; else if (nl) d->stack[sp++] = nx | M_PENDING; break;
+            case A_BOT:    if (bot) d->stack[sp++] = nx; break;
+            case A_EOT:    if (eot) d->stack[sp++] = nx; break;
+            case A_WORDB:  if (pw != nw) d->stack[sp++] = nx; break;
+            case A_NWORDB: if (pw == nw) d->stack[sp++] = nx; break;
+            case A_WBEG:   if (!pw && nw) d->stack[sp++] = nx; break;
+            case A_WEND:   if (pw && !nw) d->stack[sp++] = nx; break;
+            }
+            break;
+        }
+    }
+    if (eot || (nb == 0 && d->anchored)) return *slot = T_DEAD;
+    qsort(d->buf, nb, 4, cmp_u32k);
+    u32 u = 0;
+    for (u32 i = 0; i < nb; i++) if (!u || d->buf[i] != d->buf[u - 1]) d->buf[u++] = d->buf[i];
+    int flushed = 0;
+    u8 f = (u8)((d->words && nw ? F_PW : 0) | (d->lines && nl ? F_PNL : 0));
+    int t = dfa_state(d, d->buf, u, f, &flushed);
+    if (!flushed) *slot = t;
+    return t;
+}
+
+static int dfa_match(rx_dfa *d, const u8 *s, u32 len) {
+    if (d->start < 0) { int fl = 0; d->start = dfa_state(d, NULL, 0, F_BOT, &fl); }
+    int st = d->start;
+    u32 w = d->nbc + 1;
+    for (u32 i = 0; i < len; i++) {
+        u32 bc = d->bytemap[s[i]];
+        int t = d->trans[(size_t)st * w + bc];
+        if (t == T_UNKNOWN) t = dfa_step(d, st, bc);
+        if (t == T_MATCH) return 1;
+        if (t == T_DEAD) return 0;
+        st = t;
+    }
+    int t = d->trans[(size_t)st * w + d->nbc];
+    if (t == T_UNKNOWN) t = dfa_step(d, st, d->nbc);
+    return t == T_MATCH;
+}
+
+/* bytes that no class (nor \w / newline, when assertions look at them) tells
+ * apart share a column: refine one partition of 0..255 by every set in turn */
+static void dfa_byte_classes(rx_dfa *d) {
+    u8 map[256] = {0};
+    u16 remap[512];
+    u32 n = 1;
+    for (u32 i = 0; i < d->ncls + 2; i++) {
+        if ((i == d->ncls && !d->words) || (i == d->ncls + 1 && !d->lines)) continue;
+        memset(remap, 0xff, sizeof remap);
+        u32 m = 0;
+        for (u32 c = 0; c < 256; c++) {
+            u32 in = i < d->ncls ? (u32)bs_has(&d->cls[i], c) : i == d->ncls ? (u32)is_word(c) : (u32)(c == '\n');
+            u32 key = (u32)map[c] * 2 + in;
+            if (remap[key] == 0xffff) remap[key] = (u16)m++;
+            map[c] = (u8)remap[key];
+        }
+        n = m;
+    }
+    memcpy(d->bytemap, map, sizeof map);
+    for (u32 c = 256; c-- > 0; ) d->rep[map[c]] = (u8)c;
+    d->nbc = n;
+}
+
+/* can a match start anywhere but offset 0? (reach a consuming/matching pc from
+ * the start without passing ^) — conservative: other assertions pass */
+static int dfa_anchored(const rx_dfa *d) {
+    u32 *st = malloc((size_t)d->nins * 2 * 4 + 4), sp = 0;
+    u8 *seen = calloc(d->nins, 1);
+    int anchored = 1;
+    if (!st || !seen) { free(st); free(seen); return 0; }
+    st[sp++] = 0;
+    while (sp && anchored) {
+        u32 pc = st[--sp];
+        if (seen[pc]) continue;
+        seen[pc] = 1;
+        const rx_inst *in = &d->ins[pc];
+        if (in->op == I_MATCH || in->op == I_CLASS) anchored = 0;
+        else if (in->op == I_JMP) st[sp++] = in->x;
+        else if (in->op == I_SPLIT) { st[sp++] = in->x; st[sp++] = in->y; }
+        else if (in->arg != A_BOL && in->arg != A_BOT) st[sp++] = in->x;
+    }
+    free(st); free(seen);
+    return anchored;
+}
+
+static void dfa_free(rx_dfa *d) {
+    if (!d) return;
+    free(d->ins); free(d->cls); free(d->kern); free(d->koff); free(d->klen); free(d->kflag);
+    free(d->trans); free(d->htab); free(d->stack); free(d->mark); free(d->modes); free(d->buf);
+    free(d);
+}
+
+/* NULL with *bad set when regcomp would reject the pattern; NULL alone means
+ * "not modelled here, ask regcomp" */
+static rx_dfa *dfa_compile(const char *pattern, int *bad) {
+    parser ps = { .p = (const u8 *)pattern, .end = (const u8 *)pattern + strlen(pattern) };
+    *bad = 0;
+    ps.nodes = malloc(RX_MAX_NODES * sizeof(rx_node));
+    if (!ps.nodes) return NULL;
+    int root = parse_alt(&ps);
+    if (ps.p != ps.end) ps.bail = 1;
+    *bad = ps.bad;
+    emitter em = { .ins = malloc(RX_MAX_INST * sizeof(rx_inst)) };
+    if (!em.ins) ps.bail = 1;
+    if (!ps.bail) { gen(&em, &ps, root); emit(&em, I_MATCH); }
+    free(ps.nodes);
+    rx_dfa *d = NULL;
+    if (ps.bail || em.over || !(d = calloc(1, sizeof *d))) { free(em.ins); free(ps.cls); return NULL; }
+    d->ins = em.ins; d->nins = em.n;
+    d->cls = ps.cls; d->ncls = ps.ncls;
+    d->words = ps.words; d->lines = ps.lines;
+    d->anchored = dfa_anchored(d);
+    dfa_byte_classes(d);
+    d->hcap = RX_MAX_STATES * 2;
+    d->kern  = malloc(RX_MAX_KERNEL * sizeof(u32));
+    d->koff  = malloc(RX_MAX_STATES * sizeof(u32));
+    d->klen  = malloc(RX_MAX_STATES * sizeof(u32));
+    d->kflag = malloc(RX_MAX_STATES);
+    d->trans = malloc((size_t)RX_MAX_STATES * (d->nbc + 1) * sizeof(int));
+    d->htab  = calloc(d->hcap, sizeof(u32));
+    d->stack = malloc(((size_t)d->nins * 9 + 2) * sizeof(u32));   /* <= 4 modes x 2 pushes per pc */
+    d->mark  = calloc(d->nins, sizeof(u32));
+    d->modes = malloc(d->nins);
+    d->buf   = malloc((size_t)d->nins * sizeof(u32));
+    if (!d->kern || !d->koff || !d->klen || !d->kflag || !d->trans || !d->htab || !d->stack || !d->mark || !d->modes || !d->buf) {
+        dfa_free(d); return NULL;
+    }
+    d->start = -1;
+    return d;
+}
+
+/* ======================================================================
+ * Compiled-pattern cache (LRU, process-wide)
+ * ====================================================================== */
+
+typedef struct { const u8 *p; u32 len; } rx_lit;
+
+struct rx {
+    char    *src;
+    u32      hash;
+    u32      refs;
+    int      cached;        /* in the LRU list; 0 = private (rx_clone, or a busy entry's copy) */
+    int      valid;
+    int      has_re;        /* regcomp ran (the DFA could not decide alone) */
+    regex_t  re;
+    rx_dfa  *dfa;           /* NULL: match with re */
+    rx_lit   lit[RX_MAX_LITS];
+    u32      nlit;          /* every match contains one of lit[]; 0 = no prefilter */
+    u8      *litbuf;
+    rx_t    *prev, *next;   /* LRU list, head = most recent */
+};
+
+/* ======================================================================
+ * Literal prefilter
+ *
+ * Most agent queries are literals or carry a long one (Project.*Alpha), and
+ * most strings do not contain it. regex_query's analysis yields a set of
+ * factors one of which every match contains; a string holding none of them is
+ * rejected by a vectorized substring scan before the DFA or regexec sees it.
+ * ====================================================================== */
+
+static void rx_literals(rx_t *r) {
+    tq_arena *a = tq_arena_new();
+    u8 **l; u32 *ll, n, total = 0;
+    if (!a) return;
+    if (rq_literals(a, r->src, RX_MAX_LITS, &l, &ll, &n)) {
+        for (u32 k = 0; k < n; k++) total += ll[k];
+        if ((r->litbuf = malloc(total))) {
+            u8 *o = r->litbuf;
+            for (u32 k = 0; k < n; k++) { memcpy(o, l[k], ll[k]); r->lit[k] = (rx_lit){ o, ll[k] }; o += ll[k]; }
+            r->nlit = n;
+        }
+    }
+    tq_arena_free(a);
+}
+
+/* 1 iff some literal occurs in s. With SSE2, each 16-byte block is tested for
+ * every literal's first AND last byte at every offset, and only those offsets
+ * are compared in full; the tail (and non-SSE2 builds) use memmem. */
+static int lit_scan(const rx_t *r, const u8 *s, u32 len) {
+    u32 i = 0;
+#if defined(__SSE2__)
+    __m128i first[RX_MAX_LITS], last[RX_MAX_LITS];
+    u32 maxl = 0;
+    for (u32 k = 0; k < r->nlit; k++) {
+        first[k] = _mm_set1_epi8((char)r->lit[k].p[0]);
+        last[k]  = _mm_set1_epi8((char)r->lit[k].p[r->lit[k].len - 1]);
+        if (r->lit[k].len > maxl) maxl = r->lit[k].len;
+    }
+    for (; (u64)i + 15 + maxl <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        for (u32 k = 0; k < r->nlit; k++) {
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + i + r->lit[k].len - 1));
+            u32 m = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first[k]), _mm_cmpeq_epi8(b, last[k])));
+            for (; m; m &= m - 1)
+                if (!memcmp(s + i + (u32)__builtin_ctz(m), r->lit[k].p, r->lit[k].len)) return 1;
+        }
+    }
+#endif
+    for (u32 k = 0; k < r->nlit; k++)
+        if (memmem(s + i, len - i, r->lit[k].p, r->lit[k].len)) return 1;
+    return 0;
+}
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static rx_t *g_head, *g_tail;
+static u32   g_count;
+
+static u32 src_hash(const char *s) { u32 h = 2166136261u; while (*s) { h ^= (u8)*s++; h *= 16777619u; } return h; }
+
+static void lru_unlink(rx_t *r) {
+    if (r->prev) r->prev->next = r->next; else g_head = r->next;
+    if (r->next) r->next->prev = r->prev; else g_tail = r->prev;
+    r->prev = r->next = NULL;
+}
+static void lru_push(rx_t *r) {
+    r->prev = NULL; r->next = g_head;
+    if (g_head) g_head->prev = r; else g_tail = r;
+    g_head = r;
+}
+
+static void rx_free(rx_t *r) {
+    if (r->has_re && r->valid) regfree(&r->re);
+    dfa_free(r->dfa);
+    free(r->litbuf);
+    free(r->src);
+    free(r);
+}
+
+/* evict least-recently-used entries nobody holds, down to `keep` */
+static void lru_trim(u32 keep) {
+    for (rx_t *r = g_tail; r && g_count > keep; ) {
+        rx_t *p = r->prev;
+        if (!r->refs) { lru_unlink(r); rx_free(r); g_count--; }
+        r = p;
+    }
+}
+
+static rx_t *rx_compile(const char *pattern, u32 h) {
+    rx_t *r = calloc(1, sizeof *r);
+    if (!r || !(r->src = strdup(pattern))) { free(r); return NULL; }
+    r->hash = h;
+    int bad = 0;
+    if (MB_CUR_MAX == 1) r->dfa = dfa_compile(pattern, &bad);
+    if (r->dfa || bad) r->valid = !bad;
+    else { r->has_re = 1; r->valid = regcomp(&r->re, pattern, REG_EXTENDED | REG_NOSUB) == 0; }
+    if (r->valid) rx_literals(r);
+    return r;
+}
+
+/* An entry someone holds is matching (its DFA growing) on that holder's
+ * thread, so a second caller gets a private compile instead of sharing it. */
+rx_t *rx_acquire(const char *pattern) {
+    u32 h = src_hash(pattern);
+    pthread_mutex_lock(&g_lock);
+    for (rx_t *r = g_head; r; r = r->next)
+        if (r->hash == h && !strcmp(r->src, pattern)) {
+            lru_unlink(r); lru_push(r);
+            if (r->refs) break;
+            r->refs = 1;
+            pthread_mutex_unlock(&g_lock);
+            return r;
+        }
+    pthread_mutex_unlock(&g_lock);
+    rx_t *n = rx_compile(pattern, h);            /* compile outside the lock */
+    if (!n) return NULL;
+    pthread_mutex_lock(&g_lock);
+    for (rx_t *r = g_head; r; r = r->next)       /* held, or lost a race: keep the first */
+        if (r->hash == h && !strcmp(r->src, pattern)) {
+            if (r->refs) { pthread_mutex_unlock(&g_lock); return n; }
+            lru_unlink(r); lru_push(r); r->refs = 1;
+            pthread_mutex_unlock(&g_lock);
+            rx_free(n);
+            return r;
+        }
+    n->refs = 1; n->cached = 1;
+    lru_push(n); g_count++;
+    lru_trim(RX_CACHE_MAX);
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+void rx_release(rx_t *rx) {
+    if (!rx) return;
+    if (!rx->cached) { rx_free(rx); return; }
+    pthread_mutex_lock(&g_lock);
+    rx->refs--;
+    lru_trim(RX_CACHE_MAX);
+    pthread_mutex_unlock(&g_lock);
+}
+
+rx_t *rx_clone(const rx_t *rx) { return rx ? rx_compile(rx->src, rx->hash) : NULL; }
+void rx_drop(rx_t *rx) { if (rx) rx_free(rx); }
+
+int rx_valid(const rx_t *rx)  { return rx && rx->valid; }
+int rx_is_dfa(const rx_t *rx) { return rx && rx->dfa != NULL; }
+u32 rx_prefilter(const rx_t *rx) { return rx ? rx->nlit : 0; }
+
+int rx_match(rx_t *rx, const u8 *s, u32 len) {
+    if (!rx->valid) return 0;
+    /* an anchored DFA gives up within a few bytes; scanning would cost more */
+    if (rx->nlit && !(rx->dfa && rx->dfa->anchored) && !lit_scan(rx, s, len)) return 0;
+    if (rx->dfa) return dfa_match(rx->dfa, s, len);
+    regmatch_t pm; pm.rm_so = 0; pm.rm_eo = (regoff_t)len;
+    return regexec(&rx->re, (const char *)s, 0, &pm, REG_STARTEND) == 0;
+}
+
+u32 rx_cache_size(void) {
+    pthread_mutex_lock(&g_lock);
+    u32 n = g_count;
+    pthread_mutex_unlock(&g_lock);
+    return n;
+}
+
+void rx_cache_clear(void) {
+    pthread_mutex_lock(&g_lock);
+    lru_trim(0);
+    pthread_mutex_unlock(&g_lock);
+}
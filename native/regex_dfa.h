@@ -0,0 +1,51 @@
+/*
+ * POSIX ERE matcher for graph_search: Thompson NFA + lazily built DFA, behind a
+ * process-wide LRU cache of compiled patterns keyed by source string.
+ *
+ * Dialect is exactly what graph_search has always run — glibc
+ * regcomp(REG_EXTENDED) including its GNU escapes (\w \s \b \< \` ...) —
+ * and so is validity: the parser rejects what regcomp rejects. What the DFA
+ * does not model (back-references, multibyte locales, huge intervals) is
+ * handed to regcomp/regexec. Everything else compiles and matches in time
+ * linear in the text: no backtracking, so a hostile pattern cannot pin the
+ * read lock.
+ *
+ * Strings lacking every required literal of the pattern (regex_query.h) are
+ * rejected by a SIMD substring scan before any matcher runs.
+ *
+ * Only "does it match anywhere" is answered — search never needs positions.
+ * An entry's DFA is extended while matching, so one rx_t is matched by one
+ * thread at a time: rx_acquire hands a cached entry to one holder, and a
+ * caller finding it held gets a private compile (as rx_clone) instead. The
+ * cache itself is locked.
+ */
+#ifndef REGEX_DFA_H
+#define REGEX_DFA_H
+
+#include "memoryfile.h"
+
+#define RX_CACHE_MAX 64u       /* compiled patterns kept (LRU) */
+
+typedef struct rx rx_t;
+
+/* Compiled pattern from the cache (compiled on a miss); NULL only on OOM.
+ * Invalid patterns are cached too, as rx_valid() == 0. The result is the
+ * caller's alone until rx_release: an entry already held elsewhere is not
+ * shared, a private copy is returned (and freed by rx_release). */
+rx_t *rx_acquire(const char *pattern);
+void  rx_release(rx_t *rx);
+
+/* Private, uncached compile of the same pattern for another thread to match
+ * with; its DFA warms independently. NULL on OOM. Free with rx_drop. */
+rx_t *rx_clone(const rx_t *rx);
+void  rx_drop(rx_t *rx);
+
+int   rx_valid(const rx_t *rx);
+int   rx_is_dfa(const rx_t *rx);                       /* 0 = matched via regexec */
+u32   rx_prefilter(const rx_t *rx);                    /* required literals checked first (0 = none) */
+int   rx_match(rx_t *rx, const u8 *s, u32 len);       /* 1 iff the pattern matches somewhere in s */
+
+u32   rx_cache_size(void);
+void  rx_cache_clear(void);                            /* drops unreferenced entries */
+
+#endif /* REGEX_DFA_H */
@@ -0,0 +1,414 @@
+#include "regex_query.h"
+
+#include <string.h>
+#include "stringtable.h"   /* st_fold_utf8: literals fold exactly as indexed text does */
+
+#define SS_LIMIT      256u    /* exact/prefix/suffix sets collapse to "open" past this */
+#define EXACT_MAXLEN  64u     /* longer exact members are demoted into the match query */
+#define AFFIX_LEN     2u      /* prefix/suffix only ever feed boundary trigrams */
+#define REP_LIMIT     16u     /* x{n}: model at most this many copies, the rest as x* */
+#define PATTERN_MAX   4096u   /* longer patterns are not analyzed (scan) */
+
+/* Bounded set of byte strings; NULL = open (unbounded or unknown). */
+typedef struct { u32 n; u8 **p; u32 *len; } ss_t;
+
+/* Cox's per-node facts: can it match ""; the finite set of its matches; sets
+ * every match starts / ends with; and a trigram query every match satisfies.
+ * `req` is a set every match contains one member of as a substring (the best
+ * required literal factor seen so far; NULL = none). */
+typedef struct {
+    int   emptyable;
+    ss_t *exact, *prefix, *suffix;
+    tq_t *match;
+    ss_t *req;
+} info_t;
+
+typedef struct {
+    tq_arena  *a;
+    const u8  *s;
+    size_t     pos, n;
+    int        depth;
+    int        fold;    /* literals as indexed (case-folded) or byte-exact */
+    int        fail;    /* parse error or OOM: the caller falls back to TQ_ALL */
+} rp;
+
+static void *A(rp *r, size_t n) { void *p = tq_alloc(r->a, n ? n : 1); if (!p) r->fail = 1; return p; }
+
+/* ---- string sets ---- */
+
+static ss_t *ss_alloc(rp *r, u32 cap) {
+    ss_t *s = A(r, sizeof(ss_t));
+    if (!s) return NULL;
+    s->p = A(r, (size_t)cap * sizeof(u8 *)); s->len = A(r, (size_t)cap * 4);
+    return (s->p && s->len) ? s : NULL;
+}
+
+static int ss_has(const ss_t *s, const u8 *b, u32 len) {
+    for (u32 i = 0; i < s->n; i++) if (s->len[i] == len && memcmp(s->p[i], b, len) == 0) return 1;
+    return 0;
+}
+
+/* add a copy of b unless present */
+static void ss_add(rp *r, ss_t *s, const u8 *b, u32 len) {
+    if (ss_has(s, b, len)) return;
+    u8 *c = A(r, len);
+    if (!c) return;
+    memcpy(c, b, len);
+    s->p[s->n] = c; s->len[s->n] = len; s->n++;
+}
+
+static ss_t *ss_one(rp *r, const u8 *b, u32 len) {
+    ss_t *s = ss_alloc(r, 1);
+    if (s) ss_add(r, s, b, len);
+    return s;
+}
+
+static ss_t *ss_cross(rp *r, const ss_t *x, const ss_t *y) {
+    if (!x || !y || (u64)x->n * y->n > SS_LIMIT) return NULL;
+    ss_t *o = ss_alloc(r, x->n * y->n);
+    if (!o) return NULL;
+    u8 buf[2 * EXACT_MAXLEN + 8], *tmp;
+    for (u32 i = 0; i < x->n; i++) for (u32 j = 0; j < y->n; j++) {
+        u32 l = x->len[i] + y->len[j];
+        tmp = l <= sizeof buf ? buf : A(r, l);
+        if (!tmp) return NULL;
+        memcpy(tmp, x->p[i], x->len[i]); memcpy(tmp + x->len[i], y->p[j], y->len[j]);
+        ss_add(r, o, tmp, l);
+    }
+    return o;
+}
+
+static ss_t *ss_union(rp *r, const ss_t *x, const ss_t *y) {
+    if (!x || !y) return NULL;
+    ss_t *o = ss_alloc(r, x->n + y->n);
+    if (!o) return NULL;
+    for (u32 i = 0; i < x->n; i++) ss_add(r, o, x->p[i], x->len[i]);
+    for (u32 i = 0; i < y->n; i++) ss_add(r, o, y->p[i], y->len[i]);
+    return o->n > SS_LIMIT ? NULL : o;
+}
+
+/* keep only the first (front) or last AFFIX_LEN bytes of every member */
+static ss_t *ss_trim(rp *r, const ss_t *x, int front) {
+    if (!x) return NULL;
+    ss_t *o = ss_alloc(r, x->n);
+    if (!o) return NULL;
+    for (u32 i = 0; i < x->n; i++) {
+        u32 l = x->len[i] < AFFIX_LEN ? x->len[i] : AFFIX_LEN;
+        ss_add(r, o, front ? x->p[i] : x->p[i] + x->len[i] - l, l);
+    }
+    return o;
+}
+
+/* How useful a set is as a substring prefilter: 0 if it has an empty member
+ * (then it rules nothing out), else longer shortest member first, fewer
+ * members on a tie. */
+static u32 ss_score(const ss_t *s) {
+    if (!s || !s->n || s->n > 255) return 0;
+    u32 minl = ~0u;
+    for (u32 i = 0; i < s->n; i++) if (s->len[i] < minl) minl = s->len[i];
+    return minl ? minl * 256 + (256 - s->n) : 0;
+}
+static ss_t *ss_best(ss_t *x, ss_t *y) { return ss_score(y) > ss_score(x) ? y : x; }
+
+/* ---- trigram queries from sets ---- */
+
+/* OR over members of AND(member's trigrams); a member too short to have any
+ * trigram means the set constrains nothing. */
+static tq_t *tq_exact(rp *r, const ss_t *e) {
+    if (!e) return tq_all(r->a);
+    tq_t **br = A(r, (size_t)e->n * sizeof(tq_t *));
+    if (!br) return tq_all(r->a);
+    for (u32 i = 0; i < e->n; i++) {
+        if (e->len[i] < 3) return tq_all(r->a);
+        u32 k = e->len[i] - 2;
+        tq_t **t = A(r, (size_t)k * sizeof(tq_t *));
+        if (!t) return tq_all(r->a);
+        for (u32 j = 0; j < k; j++) t[j] = tq_tri(r->a, tri_pack(e->p[i] + j));
+        br[i] = tq_and(r->a, t, k);
+    }
+    return tq_or(r->a, br, e->n);
+}
+
+/* trigrams spanning the seam between every (suffix of x, prefix of y) pair */
+static tq_t *boundary(rp *r, const ss_t *xs, const ss_t *yp) {
+    if (!xs || !yp || (u64)xs->n * yp->n > SS_LIMIT) return tq_all(r->a);
+    tq_t **br = A(r, (size_t)xs->n * yp->n * sizeof(tq_t *));
+    if (!br) return tq_all(r->a);
+    u32 m = 0;
+    for (u32 i = 0; i < xs->n; i++) for (u32 j = 0; j < yp->n; j++) {
+        u8 c[2 * AFFIX_LEN + 2 * EXACT_MAXLEN];
+        u32 sl = xs->len[i] < AFFIX_LEN ? xs->len[i] : AFFIX_LEN;
+        u32 pl = yp->len[j] < AFFIX_LEN ? yp->len[j] : AFFIX_LEN;
+        memcpy(c, xs->p[i] + xs->len[i] - sl, sl); memcpy(c + sl, yp->p[j], pl);
+        tq_t *t[2]; u32 k = 0;
+        for (u32 q = 0; q + 3 <= sl + pl; q++) if (q < sl) t[k++] = tq_tri(r->a, tri_pack(c + q));
+        br[m++] = tq_and(r->a, t, k);
+    }
+    return tq_or(r->a, br, m);
+}
+
+/* ---- info combinators ---- */
+
+static info_t i_open(rp *r)   { return (info_t){ 0, NULL, NULL, NULL, tq_all(r->a), NULL }; }
+static info_t i_star(rp *r)   { return (info_t){ 1, NULL, NULL, NULL, tq_all(r->a), NULL }; }
+static info_t i_empty(rp *r)  {
+    ss_t *e = ss_one(r, (const u8 *)"", 0);
+    return (info_t){ 1, e, e, e, tq_all(r->a), NULL };
+}
+static info_t i_bytes(rp *r, const u8 *b, u32 len) {
+    ss_t *e = ss_one(r, b, len);
+    return (info_t){ 0, e, e, e, tq_all(r->a), e };
+}
+
+/* bound the sets: demote long exact sets into `match`, keep affixes short */
+static info_t simplify(rp *r, info_t x) {
+    if (x.exact) {
+        u32 maxl = 0;
+        for (u32 i = 0; i < x.exact->n; i++) if (x.exact->len[i] > maxl) maxl = x.exact->len[i];
+        if (maxl > EXACT_MAXLEN) {
+            x.match = tq_and2(r->a, x.match, tq_exact(r, x.exact));
+            x.exact = NULL;
+        }
+    }
+    if (!x.exact) { x.prefix = ss_trim(r, x.prefix, 1); x.suffix = ss_trim(r, x.suffix, 0); }
+    return x;
+}
+
+static info_t i_concat(rp *r, info_t x, info_t y) {
+    info_t o;
+    o.emptyable = x.emptyable && y.emptyable;
+    o.exact = (x.exact && y.exact) ? ss_cross(r, x.exact, y.exact) : NULL;
+
+    if (x.exact) {                                     /* every match starts x-exact . y-prefix */
+        o.prefix = y.prefix ? ss_cross(r, x.exact, y.prefix) : NULL;
+        if (!o.prefix) o.prefix = x.prefix;
+    } else {
+        o.prefix = x.prefix;
+        if (x.emptyable && o.prefix) o.prefix = ss_union(r, o.prefix, y.prefix);
+    }
+    if (y.exact) {
+        o.suffix = x.suffix ? ss_cross(r, x.suffix, y.exact) : NULL;
+        if (!o.suffix) o.suffix = y.suffix;
+    } else {
+        o.suffix = y.suffix;
+        if (y.emptyable && o.suffix) o.suffix = ss_union(r, o.suffix, x.suffix);
+    }
+
+    o.req = o.exact ? o.exact : ss_best(x.req, y.req);
+
+    tq_t *parts[5] = { x.match, y.match, boundary(r, x.suffix, y.prefix), NULL, NULL };
+    u32 np = 3;
+    if (!o.exact) {                                    /* exactness lost: keep what it implied */
+        parts[np++] = tq_exact(r, x.exact);
+        parts[np++] = tq_exact(r, y.exact);
+    }
+    o.match = tq_and(r->a, parts, np);
+    return simplify(r, o);
+}
+
+static info_t i_alt(rp *r, info_t x, info_t y) {
+    info_t o;
+    o.emptyable = x.emptyable || y.emptyable;
+    o.exact  = (x.exact && y.exact) ? ss_union(r, x.exact, y.exact) : NULL;
+    o.prefix = ss_union(r, x.prefix, y.prefix);
+    o.suffix = ss_union(r, x.suffix, y.suffix);
+    o.req    = o.exact ? o.exact : ss_union(r, x.req, y.req);
+    if (o.exact) o.match = tq_or2(r->a, x.match, y.match);
+    else o.match = tq_or2(r->a, tq_and2(r->a, x.match, tq_exact(r, x.exact)),
+                                tq_and2(r->a, y.match, tq_exact(r, y.exact)));
+    return simplify(r, o);
+}
+
+/* x{min,max}; max < 0 = unbounded */
+static info_t i_repeat(rp *r, info_t x, long min, long max) {
+    if (min == 0 && max == 0) return i_empty(r);
+    if (min == 0 && max == 1) return i_alt(r, x, i_empty(r));
+    if (min == 0) return i_star(r);
+    long k = min < (long)REP_LIMIT ? min : (long)REP_LIMIT;
+    info_t acc = x;
+    for (long i = 1; i < k; i++) acc = i_concat(r, acc, x);
+    if (max == min && min <= (long)REP_LIMIT) return acc;
+    info_t o = i_concat(r, acc, i_star(r));
+    o.suffix = x.suffix ? ss_trim(r, x.suffix, 0) : NULL;   /* the last copy is still an x */
+    return o;
+}
+
+/* ---- parser (glibc ERE) ---- */
+
+static info_t parse_alt(rp *r);
+
+static int peek(rp *r) { return r->pos < r->n ? r->s[r->pos] : -1; }
+
+/* length of a complete UTF-8 sequence at s[pos], 0 if malformed */
+static u32 utf8_len(rp *r) {
+    u8 b = r->s[r->pos];
+    u32 n = (b >= 0xF0 && b < 0xF8) ? 4 : (b >= 0xE0) ? 3 : (b >= 0xC2) ? 2 : 0;
+    if (!n || r->pos + n > r->n) return 0;
+    for (u32 k = 1; k < n; k++) if ((r->s[r->pos + k] & 0xC0) != 0x80) return 0;
+    return n;
+}
+
+static info_t literal(rp *r, const u8 *b, u32 len) {
+    if (!r->fold) return i_bytes(r, b, len);
+    u8 f[4];
+    u32 fl = st_fold_utf8(b, len, f);
+    return i_bytes(r, f, fl);
+}
+
+/* [...]: enumerable ASCII members become a one-byte set; negation, named
+ * classes other than digit, collating elements and non-ASCII make it open. */
+static info_t bracket(rp *r) {
+    r->pos++;
+    int neg = 0, open = 0;
+    u8 seen[128] = { 0 };
+    if (peek(r) == '^') { neg = 1; r->pos++; }
+    for (size_t first = r->pos;;) {
+        int c = peek(r);
+        if (c < 0) { r->fail = 1; return i_open(r); }
+        if (c == ']' && r->pos > first) { r->pos++; break; }   /* a leading ] is a member (and may start a range) */
+        if (c == '[' && r->pos + 1 < r->n && strchr(":=.", r->s[r->pos + 1])) {
+            u8 d = r->s[r->pos + 1];
+            size_t st = r->pos + 2, e = st;
+            while (e + 1 < r->n && !(r->s[e] == d && r->s[e + 1] == ']')) e++;
+            if (e + 1 >= r->n) { r->fail = 1; return i_open(r); }
+            if (d == ':' && e - st == 5 && memcmp(r->s + st, "digit", 5) == 0) for (u8 k = '0'; k <= '9'; k++) seen[k] = 1;
+            else open = 1;
+            r->pos = e + 2;
+            continue;
+        }
+        r->pos++;
+        if (c >= 0x80) { open = 1; continue; }
+        int hi = c;
+        if (peek(r) == '-' && r->pos + 1 < r->n && r->s[r->pos + 1] != ']') {
+            int d = r->s[r->pos + 1];
+            r->pos += 2;
+            if (d == '[' || d >= 0x80 || d < c) { open = 1; continue; }
+            hi = d;
+        }
+        for (int k = c; k <= hi; k++) seen[k] = 1;
+    }
+    if (neg || open) return i_open(r);
+    ss_t *s = ss_alloc(r, 128);
+    if (!s) return i_open(r);
+    for (int k = 0; k < 128; k++) if (seen[k]) { u8 f = (u8)(r->fold && k >= 'A' && k <= 'Z' ? k + 32 : k); ss_add(r, s, &f, 1); }
+    if (s->n == 0) return i_open(r);
+    return (info_t){ 0, s, s, s, tq_all(r->a), s };
+}
+
+/* one atom; *mb is set for a multi-byte literal (its quantifiers need care) */
+static info_t parse_atom(rp *r, int *mb) {
+    *mb = 0;
+    int c = peek(r);
+    switch (c) {
+    case '(': {
+        r->pos++; r->depth++;
+        info_t in = parse_alt(r);
+        if (peek(r) != ')') { r->fail = 1; return i_open(r); }
+        r->pos++; r->depth--;
+        return in;
+    }
+    case '^': case '$': r->pos++; return i_empty(r);
+    case '.': r->pos++; return i_open(r);
+    case '[': return bracket(r);
+    case '*': case '+': case '?': case '{': r->fail = 1; return i_open(r);
+    case '\\': {
+        if (r->pos + 1 >= r->n) { r->fail = 1; return i_open(r); }
+        u8 e = r->s[r->pos + 1];
+        if (e < 0x80) {
+            r->pos += 2;
+            if (strchr("wWsS", e)) return i_open(r);
+            if (strchr("bB<>`'", e)) return i_empty(r);
+            if (e >= '1' && e <= '9') return i_star(r);          /* backreference: may be "" */
+            return literal(r, &e, 1);
+        }
+        r->pos++;                                              /* \<multibyte>: the char itself */
+        break;
+    }
+    default: break;
+    }
+    if (r->s[r->pos] < 0x80) { u8 b = r->s[r->pos++]; return literal(r, &b, 1); }
+    u32 l = utf8_len(r);
+    if (!l) { r->pos++; return i_open(r); }                    /* stray byte: folding would move it */
+    const u8 *b = r->s + r->pos;
+    r->pos += l;
+    *mb = 1;
+    return literal(r, b, l);
+}
+
+static int parse_num(rp *r, long *v) {
+    size_t st = r->pos; long x = 0;
+    while (r->pos < r->n && r->s[r->pos] >= '0' && r->s[r->pos] <= '9' && x < 100000) x = x * 10 + (r->s[r->pos++] - '0');
+    *v = x;
+    return r->pos > st;
+}
+
+static info_t parse_repeat(rp *r) {
+    int mb;
+    info_t x = parse_atom(r, &mb);
+    for (;;) {
+        int c = peek(r);
+        long min, max;
+        if (c == '*') { min = 0; max = -1; }
+        else if (c == '+') { min = 1; max = -1; }
+        else if (c == '?') { min = 0; max = 1; }
+        else if (c == '{') {
+            r->pos++;
+            int hmin = parse_num(r, &min);
+            if (!hmin) min = 0;
+            max = min;
+            if (peek(r) == ',') { r->pos++; if (!parse_num(r, &max)) max = -1; }
+            else if (!hmin) { r->fail = 1; return x; }
+            if (peek(r) != '}' || (max >= 0 && max < min)) { r->fail = 1; return x; }
+        } else return x;
+        r->pos++;
+        if (mb) {
+            /* Byte-wise locales repeat only the LAST byte of a multi-byte char,
+             * UTF-8 locales the whole char; only "starts with it" holds for both. */
+            x = (info_t){ min == 0, NULL, min > 0 ? ss_trim(r, x.prefix, 1) : NULL, NULL, tq_all(r->a), NULL };
+            mb = 0;
+        } else {
+            x = i_repeat(r, x, min, max);
+        }
+    }
+}
+
+static info_t parse_concat(rp *r) {
+    info_t acc = i_empty(r);
+    for (;;) {
+        int c = peek(r);
+        if (c < 0 || c == '|' || (c == ')' && r->depth > 0) || r->fail) return acc;
+        if (c == ')') { r->pos++; acc = i_concat(r, acc, literal(r, (const u8 *)")", 1)); continue; }
+        acc = i_concat(r, acc, parse_repeat(r));
+    }
+}
+
+static info_t parse_alt(rp *r) {
+    info_t acc = parse_concat(r);
+    while (!r->fail && peek(r) == '|') {
+        r->pos++;
+        acc = i_alt(r, acc, parse_concat(r));
+    }
+    return acc;
+}
+
+tq_t *rq_build(tq_arena *a, const char *pattern) {
+    rp r = { .a = a, .s = (const u8 *)pattern, .n = strlen(pattern), .fold = 1 };
+    if (r.n > PATTERN_MAX) return tq_all(a);
+    info_t in = parse_alt(&r);
+    if (r.fail || r.pos != r.n || !in.match) return tq_all(a);
+    tq_t *q = in.match;
+    if (in.exact) {                                    /* a complete description beats the rest */
+        tq_t *e = tq_exact(&r, in.exact);
+        if (e && e->tag != TQ_ALL) q = e;
+    }
+    return r.fail ? tq_all(a) : q;
+}
+
+int rq_literals(tq_arena *a, const char *pattern, u32 max, u8 ***lits, u32 **lens, u32 *n) {
+    rp r = { .a = a, .s = (const u8 *)pattern, .n = strlen(pattern) };
+    if (r.n > PATTERN_MAX) return 0;
+    info_t in = parse_alt(&r);
+    if (r.fail || r.pos != r.n || !ss_score(in.req) || in.req->n > max) return 0;
+    *lits = in.req->p; *lens = in.req->len; *n = in.req->n;
+    return 1;
+}
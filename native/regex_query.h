@@ -0,0 +1,26 @@
+/*
+ * POSIX ERE -> trigram query (Russ Cox, "Regular Expression Matching with a
+ * Trigram Index", 2012), for the dialect graph_search actually runs: glibc
+ * regcomp(REG_EXTENDED) including its GNU escapes (\w \s \b \< ...).
+ *
+ * The query is a necessary condition over the trigrams of CASE-FOLDED text:
+ * every string the pattern matches (case-sensitively, or after folding both
+ * sides) has all the trigrams one branch of the query demands. Anything the
+ * analysis does not model — a construct it cannot parse, non-ASCII inside a
+ * bracket, '.', quantified multi-byte characters — only loses precision, never
+ * soundness; an unparseable pattern yields TQ_ALL (scan everything).
+ */
+#ifndef REGEX_QUERY_H
+#define REGEX_QUERY_H
+
+#include "trigram.h"
+
+tq_t *rq_build(tq_arena *a, const char *pattern);   /* NULL only on OOM */
+
+/* Required literal factors, byte-exact (no folding): every string the pattern
+ * matches contains at least one of lits[0..n) as a substring. Returns 0 when
+ * there is no usable set of at most `max` non-empty literals. The literals live
+ * in the arena. */
+int rq_literals(tq_arena *a, const char *pattern, u32 max, u8 ***lits, u32 **lens, u32 *n);
+
+#endif /* REGEX_QUERY_H */
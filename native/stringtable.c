@@ -2,15 +2,42 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "pmap.h"
+#include "trigram.h"
+#include "regex_query.h"
 
 #define ENT_HEADER       10u   /* u32 refcount + u32 hash + u16 len */
-#define OUR_HEADER_SIZE  16u   /* u64 hash_index_offset + u32 entry_count + u32 pad */
+#define OUR_HEADER_SIZE  24u   /* u64 hash_index_offset + u32 entry_count + u32 free_gen + u64 aux_dir_offset */
 #define INITIAL_BUCKETS  4096u
+#define ST_QUANTUM       32u   /* memfile allocation granularity */
+
+/* Packed (symbol-coded) entries: refcount's high bit flags them; the payload is
+ * [u16 raw_len][codes], and the entry's u16 len is the STORED length, so sized
+ * frees and the index stay untouched. The hash is always of the raw bytes. */
+#define ST_PACKED        0x80000000u
+#define RC_MASK          0x7FFFFFFFu
+
+/* Aux directory: [u64 slots[ST_AUX_SLOTS]], allocated on first use. The header's
+ * physical block is one 32-byte quantum and bytes 16.. were never written before
+ * the directory existed, so older files read aux_dir_offset == 0 (all absent). */
+#define ST_AUX_SLOTS     8u
+#define AUX_DICT         0u
+#define AUX_FOLD         1u    /* pmap: id -> id of its case-folded shadow (self if already folded) */
+#define AUX_TRIGRAM      2u    /* pmap: trigram of folded text -> postings of string ids (trigram.h) */
+
+/* Symbol table block: [u32 nsym][u32 pad][u8 len[256]][u64 sym[256]] */
+#define DICT_NSYM        0
+#define DICT_LEN         8
+#define DICT_SYM         (8 + 256)
+#define DICT_SIZE        (8 + 256 + 256 * 8)
+#define SYM_ESCAPE       255u   /* code 255 = next byte is a literal */
+#define SYM_MAX          255u
 
 /* ---- aliasing-safe field access via memfile offsets (never cache across alloc) ---- */
 static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
 static inline u16 rdu16(memfile_t *mf, u64 o) { u16 v; memcpy(&v, memfile_ptr(mf, o), 2); return v; }
 static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline u8  rdu8 (memfile_t *mf, u64 o) { return *(const u8 *)memfile_ptr(mf, o); }
 static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
 static inline void wru16(memfile_t *mf, u64 o, u16 v) { memcpy(memfile_ptr(mf, o), &v, 2); }
 static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
@@ -25,10 +52,152 @@ static u32 fnv1a(const u8 *d, u16 len) {
 static inline u64 hash_index_off(stringtable_t *st) { return rdu64(st->mf, st->header_offset + 0); }
 static inline u32 entry_count(stringtable_t *st)     { return rdu32(st->mf, st->header_offset + 8); }
 static inline void set_entry_count(stringtable_t *st, u32 c) { wru32(st->mf, st->header_offset + 8, c); }
+static inline u32 free_gen(stringtable_t *st)        { return rdu32(st->mf, st->header_offset + 12); }
+static inline void bump_free_gen(stringtable_t *st)  { wru32(st->mf, st->header_offset + 12, free_gen(st) + 1); }
 static inline u64 bucket_pos(u64 idx, u32 slot)      { return idx + 8 + (u64)slot * 8; }
+static inline u64 quant(u64 n) { return (n + ST_QUANTUM - 1) & ~(u64)(ST_QUANTUM - 1); }
+
+static inline u32 ent_rc(memfile_t *mf, u64 e)     { return rdu32(mf, e + 0) & RC_MASK; }
+static inline int ent_packed(memfile_t *mf, u64 e) { return (rdu32(mf, e + 0) & ST_PACKED) != 0; }
 
 static void st_rehash(stringtable_t *st, u32 new_bc);
 
+/* ---- aux directory ---- */
+static u64 aux_get(stringtable_t *st, u32 slot) {
+    u64 dir = rdu64(st->mf, st->header_offset + 16);
+    return dir ? rdu64(st->mf, dir + (u64)slot * 8) : 0;
+}
+/* Offset of a slot's u64 (allocating the directory on first use); 0 on failure.
+ * The directory never moves, so this is a stable pmap root. */
+static u64 aux_slot(stringtable_t *st, u32 slot) {
+    memfile_t *mf = st->mf;
+    u64 dir = rdu64(mf, st->header_offset + 16);
+    if (!dir) {
+        dir = memfile_alloc(mf, ST_AUX_SLOTS * 8);
+        if (!dir) return 0;
+        memset(memfile_ptr(mf, dir), 0, ST_AUX_SLOTS * 8);
+        wru64(mf, st->header_offset + 16, dir);
+    }
+    return dir + (u64)slot * 8;
+}
+static int aux_set(stringtable_t *st, u32 slot, u64 v) {
+    u64 pos = aux_slot(st, slot);
+    if (!pos) return -1;
+    wru64(st->mf, pos, v);
+    return 0;
+}
+/* root for a pmap-valued slot, or 0 when that structure does not exist */
+static u64 aux_root(stringtable_t *st, u32 slot) {
+    u64 dir = rdu64(st->mf, st->header_offset + 16);
+    return (dir && rdu64(st->mf, dir + (u64)slot * 8)) ? dir + (u64)slot * 8 : 0;
+}
+
+/* ======================================================================
+ * Symbol-table compression (FSST-style): up to 255 symbols of 1..8 bytes,
+ * greedy longest-match encoding, code 255 escapes one literal byte. The table
+ * is trained once and immutable afterwards, so packed entries never need
+ * re-encoding and dedup can compare raw bytes against a streaming decode.
+ * ====================================================================== */
+
+/* In-process encoder, rebuilt when the persisted table changes. For each first
+ * byte, the candidate codes ordered longest-first. */
+typedef struct {
+    u64 dict_off;
+    u8  nsym;
+    u8  len[256];
+    u64 sym[256];
+    u16 first[257];      /* codes for first byte b: order[first[b] .. first[b+1]) */
+    u8  order[256];
+} st_enc_t;
+
+static st_enc_t *encoder(stringtable_t *st) {
+    u64 d = aux_get(st, AUX_DICT);
+    if (!d) return NULL;
+    st_enc_t *e = st->enc;
+    if (e && e->dict_off == d) return e;
+    if (!e) { e = calloc(1, sizeof *e); if (!e) return NULL; st->enc = e; }
+    memfile_t *mf = st->mf;
+    e->dict_off = d;
+    e->nsym = (u8)rdu32(mf, d + DICT_NSYM);
+    memcpy(e->len, memfile_ptr(mf, d + DICT_LEN), 256);
+    memcpy(e->sym, memfile_ptr(mf, d + DICT_SYM), 256 * 8);
+    u16 cnt[256] = {0};
+    for (u32 c = 0; c < e->nsym; c++) cnt[e->sym[c] & 0xFF]++;
+    e->first[0] = 0;
+    for (u32 b = 0; b < 256; b++) e->first[b + 1] = (u16)(e->first[b] + cnt[b]);
+    u16 fill[256]; memcpy(fill, e->first, sizeof fill);
+    for (u32 l = 8; l >= 1; l--)
+        for (u32 c = 0; c < e->nsym; c++)
+            if (e->len[c] == l) e->order[fill[e->sym[c] & 0xFF]++] = (u8)c;
+    return e;
+}
+
+static inline int sym_match(const st_enc_t *e, u32 c, const u8 *p, u32 rem) {
+    u32 l = e->len[c];
+    if (l > rem) return 0;
+    u64 v = 0; memcpy(&v, p, l);
+    return v == e->sym[c];
+}
+
+/* Encode src into out (capacity >= 2*len); returns the number of code bytes. */
+static u32 sym_encode(const st_enc_t *e, const u8 *src, u32 len, u8 *out) {
+    u32 i = 0, n = 0;
+    while (i < len) {
+        u8 b = src[i]; int hit = 0;
+        for (u32 k = e->first[b]; k < e->first[b + 1]; k++) {
+            u32 c = e->order[k];
+            if (sym_match(e, c, src + i, len - i)) { out[n++] = (u8)c; i += e->len[c]; hit = 1; break; }
+        }
+        if (!hit) { out[n++] = SYM_ESCAPE; out[n++] = b; i++; }
+    }
+    return n;
+}
+
+/* Decode n codes using the persisted table at `d`; out needs raw_len + 8 bytes
+ * (symbols are copied as whole u64 words). Returns bytes produced. */
+static u32 sym_decode(memfile_t *mf, u64 d, const u8 *codes, u32 n, u8 *out) {
+    const u8 *lens = (const u8 *)memfile_ptr(mf, d + DICT_LEN);
+    const u8 *syms = (const u8 *)memfile_ptr(mf, d + DICT_SYM);
+    u32 o = 0;
+    for (u32 i = 0; i < n; i++) {
+        u8 c = codes[i];
+        if (c == SYM_ESCAPE) { if (++i < n) out[o++] = codes[i]; continue; }
+        memcpy(out + o, syms + (u64)c * 8, 8);
+        o += lens[c];
+    }
+    return o;
+}
+
+/* Per-thread decode ring: st_get on a packed entry (any id, names included)
+ * returns one of these, so a caller may hold up to ST_RING decoded strings at
+ * once (e.g. name + type + obs0 + obs1). */
+#define ST_RING 4u
+static _Thread_local struct { u8 *buf; u32 cap; } st_ring[ST_RING];
+static _Thread_local u32 st_ring_next;
+
+static u8 *ring_buf(u32 need) {
+    u32 k = st_ring_next++ % ST_RING;
+    if (st_ring[k].cap < need) {
+        u8 *nb = realloc(st_ring[k].buf, need);
+        if (!nb) return NULL;
+        st_ring[k].buf = nb; st_ring[k].cap = need;
+    }
+    return st_ring[k].buf;
+}
+
+/* Raw-byte equality for an index candidate (raw or packed). */
+static int ent_equals(stringtable_t *st, u64 eoff, const u8 *data, u16 len) {
+    memfile_t *mf = st->mf;
+    u16 elen = rdu16(mf, eoff + 8);
+    if (!ent_packed(mf, eoff))
+        return elen == len && (len == 0 || memcmp(memfile_ptr(mf, eoff + 10), data, len) == 0);
+    if (rdu16(mf, eoff + 10) != len) return 0;
+    u8 *tmp = ring_buf((u32)len + 8);
+    if (!tmp) return 0;
+    sym_decode(mf, aux_get(st, AUX_DICT), (const u8 *)memfile_ptr(mf, eoff + 12), (u32)elen - 2, tmp);
+    return memcmp(tmp, data, len) == 0;
+}
+
 /* ---- init ---- */
 static u64 st_init(stringtable_t *st) {
     memfile_t *mf = st->mf;
@@ -40,6 +209,8 @@ static u64 st_init(stringtable_t *st) {
     wru32(mf, idx + 0, INITIAL_BUCKETS);   /* bucket_count */
     wru64(mf, hdr + 0, idx);               /* hash_index_offset */
     wru32(mf, hdr + 8, 0);                 /* entry_count */
+    wru32(mf, hdr + 12, 0);                /* free_gen */
+    wru64(mf, hdr + 16, 0);                /* aux_dir_offset: nothing optional yet */
     return hdr;
 }
 
@@ -63,8 +234,106 @@ stringtable_t *st_open(const char *path, size_t initial_size) {
     return st;
 }
 
+/* ======================================================================
+ * Case folding: Unicode simple case folding (CaseFolding.txt C+S) for Latin-1,
+ * Latin Extended-A, Greek and Cyrillic; everything else, and malformed UTF-8,
+ * passes through byte-for-byte. Folding never lengthens a string and is
+ * idempotent, so a shadow's own shadow is itself.
+ * ====================================================================== */
+
+static u32 fold_cp(u32 c) {
+    if (c < 0x80) return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+    if (c < 0x100) {
+        if (c == 0xB5) return 0x3BC;                                   /* micro -> mu */
+        return (c >= 0xC0 && c <= 0xDE && c != 0xD7) ? c + 32 : c;
+    }
+    if (c < 0x180) {
+        if (c == 0x130 || c == 0x131 || c == 0x138 || c == 0x149) return c;
+        if (c == 0x178) return 0xFF;
+        if (c == 0x17F) return 's';
+        if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) return (c & 1) ? c + 1 : c;
+        return (c & 1) ? c : c + 1;
+    }
+    if (c >= 0x370 && c < 0x400) {
+        if (c >= 0x391 && c <= 0x3AB && c != 0x3A2) return c + 32;
+        if (c == 0x386) return 0x3AC;
+        if (c >= 0x388 && c <= 0x38A) return c + 37;
+        if (c == 0x38C) return 0x3CC;
+        if (c == 0x38E || c == 0x38F) return c + 63;
+        if (c == 0x3C2) return 0x3C3;                                  /* final sigma */
+        return c;
+    }
+    if (c >= 0x400 && c < 0x530) {
+        if (c < 0x410) return c + 80;
+        if (c < 0x430) return c + 32;
+        if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) || (c >= 0x4D0 && c <= 0x52F))
+            return (c & 1) ? c : c + 1;
+        if (c == 0x4C0) return 0x4CF;
+        if (c >= 0x4C1 && c <= 0x4CE) return (c & 1) ? c + 1 : c;
+        return c;
+    }
+    if (c == 0x212A) return 'k';                                       /* Kelvin sign */
+    if (c == 0x212B) return 0xE5;                                      /* Angstrom sign */
+    return c;
+}
+
+u32 st_fold_utf8(const u8 *s, u32 len, u8 *out) {
+    u32 i = 0, o = 0;
+    while (i < len) {
+        u8 b = s[i];
+        if (b < 0x80) { out[o++] = (b >= 'A' && b <= 'Z') ? (u8)(b + 32) : b; i++; continue; }
+        u32 n = (b >= 0xF0 && b < 0xF8) ? 4 : (b >= 0xE0) ? 3 : (b >= 0xC2) ? 2 : 0;
+        u32 c = n == 2 ? (b & 0x1Fu) : n == 3 ? (b & 0x0Fu) : (b & 0x07u);
+        int ok = n && i + n <= len;
+        for (u32 k = 1; ok && k < n; k++) { if ((s[i + k] & 0xC0) != 0x80) ok = 0; else c = (c << 6) | (s[i + k] & 0x3Fu); }
+        if (!ok || (n == 3 && c < 0x800) || (n == 4 && c < 0x10000)) { out[o++] = b; i++; continue; }
+        u32 f = fold_cp(c);
+        if (f < 0x80)       { out[o++] = (u8)f; }
+        else if (f < 0x800) { out[o++] = (u8)(0xC0 | (f >> 6)); out[o++] = (u8)(0x80 | (f & 0x3F)); }
+        else if (f < 0x10000) { out[o++] = (u8)(0xE0 | (f >> 12)); out[o++] = (u8)(0x80 | ((f >> 6) & 0x3F)); out[o++] = (u8)(0x80 | (f & 0x3F)); }
+        else { out[o++] = (u8)(0xF0 | (f >> 18)); out[o++] = (u8)(0x80 | ((f >> 12) & 0x3F));
+               out[o++] = (u8)(0x80 | ((f >> 6) & 0x3F)); out[o++] = (u8)(0x80 | (f & 0x3F)); }
+        i += n;
+    }
+    return o;
+}
+
+static u64 intern(stringtable_t *st, const u8 *data, u16 len, int pack);
+
+/* Give `id` its shadow entry in the fold map (one ref on the shadow unless it is
+ * `id` itself). Interning a new shadow re-enters here and self-maps. */
+static void fold_track(stringtable_t *st, u64 root, u64 id) {
+    memfile_t *mf = st->mf;
+    if (pmap_get(mf, root, (u32)id)) return;
+    u16 len; const u8 *p = st_get(st, id, &len);
+    u8 *f = malloc(len ? len : 1);
+    if (!f) return;
+    u32 fl = st_fold_utf8(p, len, f);
+    u64 fid = id;
+    if (fl != len || memcmp(f, p, len) != 0) fid = intern(st, f, (u16)fl, ent_packed(mf, id));
+    free(f);
+    if (fid) pmap_put(mf, root, (u32)id, fid);
+}
+
+/* Post (add) or unpost one entry under the trigrams of its folded text. On
+ * failure the index is dropped, as a failed build is: an entry posted under
+ * only some trigrams would be missed by the searches that trust it, and the
+ * next st_build_trigrams rebuilds it whole. */
+static void tri_track(stringtable_t *st, u64 root, u64 id, int add) {
+    u16 len; const u8 *p = st_get(st, id, &len);
+    if (len < 3) return;
+    u8 *f = malloc(len);
+    int ok = f != NULL;
+    if (ok) {
+        u32 fl = st_fold_utf8(p, len, f);
+        ok = add ? tri_index_add(st->mf, root, (u32)id, f, fl) : tri_index_remove(st->mf, root, (u32)id, f, fl);
+        free(f);
+    }
+    if (!ok) tri_index_destroy(st->mf, root);
+}
+
 /* ---- intern / find ---- */
-u64 st_intern(stringtable_t *st, const u8 *data, u16 len) {
+static u64 intern(stringtable_t *st, const u8 *data, u16 len, int pack) {
     memfile_t *mf = st->mf;
     u32 hash = fnv1a(data, len);
     u64 idx = hash_index_off(st);
@@ -76,32 +345,44 @@ u64 st_intern(stringtable_t *st, const u8 *data, u16 len) {
         u64 eoff = rdu64(mf, bucket_pos(idx, slot));
 
         if (eoff == 0) {                         /* empty -> new entry */
-            u64 noff = memfile_alloc(mf, ENT_HEADER + len);
-            if (!noff) return 0;
-            wru32(mf, noff + 0, 1);              /* refcount */
+            u8 *codes = NULL; u32 nc = 0;
+            st_enc_t *e = pack ? encoder(st) : NULL;
+            if (e && len && (codes = malloc((size_t)len * 2))) {
+                nc = sym_encode(e, data, len, codes);
+                if (quant(ENT_HEADER + 2 + nc) >= quant(ENT_HEADER + len)) { free(codes); codes = NULL; }
+            }
+            u16 slen = codes ? (u16)(2 + nc) : len;
+            u64 noff = memfile_alloc(mf, ENT_HEADER + slen);
+            if (!noff) { free(codes); return 0; }
+            wru32(mf, noff + 0, codes ? (1u | ST_PACKED) : 1u);   /* refcount */
             wru32(mf, noff + 4, hash);
-            wru16(mf, noff + 8, len);
-            if (len) memcpy(memfile_ptr(mf, noff + 10), data, len);
+            wru16(mf, noff + 8, slen);
+            if (codes) { wru16(mf, noff + 10, len); memcpy(memfile_ptr(mf, noff + 12), codes, nc); free(codes); }
+            else if (len) memcpy(memfile_ptr(mf, noff + 10), data, len);
 
             idx = hash_index_off(st);            /* re-fetch (offset stable pre-rehash) */
             wru64(mf, bucket_pos(idx, slot), noff);
             u32 cnt = entry_count(st) + 1;
             set_entry_count(st, cnt);
             if ((u64)cnt * 10 > (u64)bc * 7) st_rehash(st, bc * 2);
+            u64 troot = aux_root(st, AUX_TRIGRAM);
+            if (troot) tri_track(st, troot, noff, 1);
+            u64 froot = aux_root(st, AUX_FOLD);
+            if (froot) fold_track(st, froot, noff);   /* once built, shadows stay current */
             return noff;
         }
 
-        if (rdu32(mf, eoff + 4) == hash) {       /* hash hit -> compare */
-            u16 elen = rdu16(mf, eoff + 8);
-            if (elen == len && (len == 0 || memcmp(memfile_ptr(mf, eoff + 10), data, len) == 0)) {
-                wru32(mf, eoff + 0, rdu32(mf, eoff + 0) + 1);  /* refcount++ */
-                return eoff;
-            }
+        if (rdu32(mf, eoff + 4) == hash && ent_equals(st, eoff, data, len)) {   /* hash hit -> compare */
+            wru32(mf, eoff + 0, rdu32(mf, eoff + 0) + 1);  /* refcount++ (flag bit untouched) */
+            return eoff;
         }
     }
     return 0;  /* index full — should not happen with rehashing */
 }
 
+u64 st_intern(stringtable_t *st, const u8 *data, u16 len)        { return intern(st, data, len, 0); }
+u64 st_intern_packed(stringtable_t *st, const u8 *data, u16 len) { return intern(st, data, len, 1); }
+
 u64 st_find(stringtable_t *st, const u8 *data, u16 len) {
     memfile_t *mf = st->mf;
     u32 hash = fnv1a(data, len);
@@ -113,11 +394,7 @@ u64 st_find(stringtable_t *st, const u8 *data, u16 len) {
         u32 slot = (bucket + i) % bc;
         u64 eoff = rdu64(mf, bucket_pos(idx, slot));
         if (eoff == 0) return 0;
-        if (rdu32(mf, eoff + 4) == hash) {
-            u16 elen = rdu16(mf, eoff + 8);
-            if (elen == len && (len == 0 || memcmp(memfile_ptr(mf, eoff + 10), data, len) == 0))
-                return eoff;
-        }
+        if (rdu32(mf, eoff + 4) == hash && ent_equals(st, eoff, data, len)) return eoff;
     }
     return 0;
 }
@@ -166,12 +443,21 @@ void st_release(stringtable_t *st, u64 id) {
     if (!id) return;
     memfile_t *mf = st->mf;
     u32 rc = rdu32(mf, id + 0);
-    if (rc <= 1) {
+    if ((rc & RC_MASK) <= 1) {
+        u64 troot = aux_root(st, AUX_TRIGRAM);
+        if (troot) tri_track(st, troot, id, 0);  /* while the text is still readable */
         u32 hash = rdu32(mf, id + 4);
         u16 len = rdu16(mf, id + 8);
         index_remove(st, id, hash);
         memfile_free(mf, id, ENT_HEADER + len);   /* sized free */
         set_entry_count(st, entry_count(st) - 1);
+        bump_free_gen(st);
+        u64 froot = aux_root(st, AUX_FOLD);
+        if (froot) {
+            u64 fid = pmap_get(mf, froot, (u32)id);
+            pmap_del(mf, froot, (u32)id);
+            if (fid && fid != id) st_release(st, fid);   /* drop our ref on the shadow */
+        }
     } else {
         wru32(mf, id + 0, rc - 1);
     }
@@ -203,11 +489,220 @@ static void st_rehash(stringtable_t *st, u32 new_bc) {
 
 /* ---- read / stats ---- */
 const u8 *st_get(stringtable_t *st, u64 id, u16 *len_out) {
-    if (len_out) *len_out = rdu16(st->mf, id + 8);
-    return (const u8 *)memfile_ptr(st->mf, id + 10);
+    memfile_t *mf = st->mf;
+    if (!ent_packed(mf, id)) {
+        if (len_out) *len_out = rdu16(mf, id + 8);
+        return (const u8 *)memfile_ptr(mf, id + 10);
+    }
+    u16 raw = rdu16(mf, id + 10);
+    u8 *out = ring_buf((u32)raw + 8);
+    if (!out) { if (len_out) *len_out = 0; return (const u8 *)""; }
+    sym_decode(mf, aux_get(st, AUX_DICT), (const u8 *)memfile_ptr(mf, id + 12), (u32)rdu16(mf, id + 8) - 2, out);
+    if (len_out) *len_out = raw;
+    return out;
+}
+u16 st_len(stringtable_t *st, u64 id) {
+    return ent_packed(st->mf, id) ? rdu16(st->mf, id + 10) : rdu16(st->mf, id + 8);
+}
+u32 st_refcount(stringtable_t *st, u64 id) { return ent_rc(st->mf, id); }
+int st_is_packed(stringtable_t *st, u64 id) { return ent_packed(st->mf, id); }
+int st_has_dictionary(stringtable_t *st)   { return aux_get(st, AUX_DICT) != 0; }
+
+/* ---- compression: train the symbol table ----
+ * FSST's bottom-up construction: start empty; each round greedily encodes the
+ * sample with the current table, counts every emitted symbol (single bytes
+ * included) and every adjacent pair whose concatenation fits in 8 bytes, then
+ * keeps the 255 candidates with the highest gain = count * length. */
+#define TRAIN_ROUNDS  5
+#define TRAIN_SAMPLE  (256u * 1024u)
+#define CAND_BITS     18
+#define CAND_CAP      (1u << CAND_BITS)
+
+typedef struct { u64 sym; u8 len; u64 gain; } cand_t;
+
+static void cand_add(cand_t *t, u32 *n, u64 sym, u8 len, u64 gain) {
+    u64 h = (sym ^ ((u64)len << 59)) * 0x9e3779b97f4a7c15ull;
+    for (u32 i = (u32)(h >> (64 - CAND_BITS)), k = 0; k < CAND_CAP; i = (i + 1) & (CAND_CAP - 1), k++) {
+        if (t[i].len == 0) {
+            if ((u64)*n * 10 > (u64)CAND_CAP * 7) return;   /* saturated: drop rare tail */
+            t[i].sym = sym; t[i].len = len; t[i].gain = gain; (*n)++; return;
+        }
+        if (t[i].sym == sym && t[i].len == len) { t[i].gain += gain; return; }
+    }
+}
+static int cand_cmp(const void *a, const void *b) {
+    const cand_t *x = a, *y = b;
+    if (x->gain != y->gain) return x->gain < y->gain ? 1 : -1;
+    if (x->len != y->len) return x->len < y->len ? 1 : -1;
+    return (x->sym > y->sym) - (x->sym < y->sym);
+}
+
+int st_train_dictionary(stringtable_t *st, const u64 *ids, u32 n) {
+    if (aux_get(st, AUX_DICT) || n == 0) return 0;      /* trained once; immutable */
+
+    /* sample: raw bytes of the given strings, length-prefixed by an offsets array */
+    u8 *buf = malloc(TRAIN_SAMPLE); u32 *bnd = malloc(((size_t)n + 1) * 4);
+    cand_t *cand = calloc(CAND_CAP, sizeof *cand);
+    st_enc_t *e = calloc(1, sizeof *e);
+    if (!buf || !bnd || !cand || !e) { free(buf); free(bnd); free(cand); free(e); return 0; }
+    u32 used = 0, ns = 0; bnd[0] = 0;
+    for (u32 i = 0; i < n && used < TRAIN_SAMPLE; i++) {
+        u16 l; const u8 *p = st_get(st, ids[i], &l);
+        if (used + l > TRAIN_SAMPLE) l = (u16)(TRAIN_SAMPLE - used);
+        memcpy(buf + used, p, l); used += l; bnd[++ns] = used;
+    }
+
+    u32 *cnt1 = malloc(512 * 4);                       /* codes 0..254 + pseudo 256+byte */
+    for (int round = 0; round < TRAIN_ROUNDS; round++) {
+        memset(cand, 0, (size_t)CAND_CAP * sizeof *cand);
+        memset(cnt1, 0, 512 * 4);
+        u32 nc = 0;
+        for (u32 si = 0; si < ns; si++) {
+            const u8 *p = buf + bnd[si]; u32 len = bnd[si + 1] - bnd[si], i = 0;
+            u64 psym = 0; u32 plen = 0;
+            while (i < len) {
+                u32 code = 256u + p[i], l = 1;
+                for (u32 k = e->first[p[i]]; k < e->first[p[i] + 1]; k++) {
+                    u32 c = e->order[k];
+                    if (sym_match(e, c, p + i, len - i)) { code = c; l = e->len[c]; break; }
+                }
+                cnt1[code]++;
+                u64 sym = 0; memcpy(&sym, p + i, l);
+                if (plen && plen + l <= 8) cand_add(cand, &nc, psym | (sym << (plen * 8)), (u8)(plen + l), plen + l);
+                psym = sym; plen = l; i += l;
+            }
+        }
+        for (u32 c = 0; c < 512; c++) {
+            if (!cnt1[c]) continue;
+            u64 sym; u8 l;
+            if (c >= 256) { sym = c - 256; l = 1; } else { sym = e->sym[c]; l = e->len[c]; }
+            cand_add(cand, &nc, sym, l, (u64)cnt1[c] * l);
+        }
+        /* compact + rank */
+        u32 k = 0;
+        for (u32 i = 0; i < CAND_CAP; i++) if (cand[i].len) cand[k++] = cand[i];
+        qsort(cand, k, sizeof *cand, cand_cmp);
+        memset(e, 0, sizeof *e);
+        e->nsym = (u8)(k < SYM_MAX ? k : SYM_MAX);
+        for (u32 c = 0; c < e->nsym; c++) { e->sym[c] = cand[c].sym; e->len[c] = cand[c].len; }
+        u16 cnt[256] = {0};
+        for (u32 c = 0; c < e->nsym; c++) cnt[e->sym[c] & 0xFF]++;
+        for (u32 b = 0; b < 256; b++) e->first[b + 1] = (u16)(e->first[b] + cnt[b]);
+        u16 fill[256]; memcpy(fill, e->first, sizeof fill);
+        for (u32 l = 8; l >= 1; l--)
+            for (u32 c = 0; c < e->nsym; c++)
+                if (e->len[c] == l) e->order[fill[e->sym[c] & 0xFF]++] = (u8)c;
+    }
+    free(cnt1); free(buf); free(bnd); free(cand);
+
+    memfile_t *mf = st->mf;
+    u64 d = memfile_alloc(mf, DICT_SIZE);
+    int ok = d != 0;
+    if (ok) {
+        memset(memfile_ptr(mf, d), 0, DICT_SIZE);
+        wru32(mf, d + DICT_NSYM, e->nsym);
+        memcpy(memfile_ptr(mf, d + DICT_LEN), e->len, 256);
+        memcpy(memfile_ptr(mf, d + DICT_SYM), e->sym, 256 * 8);
+        if (aux_set(st, AUX_DICT, d) != 0) { memfile_free(mf, d, DICT_SIZE); ok = 0; }
+    }
+    free(e);
+    return ok ? 1 : 0;
+}
+
+/* ---- case-fold shadows ---- */
+int st_build_folds(stringtable_t *st) {
+    memfile_t *mf = st->mf;
+    if (aux_root(st, AUX_FOLD)) return 1;
+    u32 n = entry_count(st);
+    u64 *ids = malloc(((size_t)n + 1) * 8);
+    if (!ids) return 0;
+    u64 idx = hash_index_off(st);
+    u32 bc = rdu32(mf, idx + 0), k = 0;
+    for (u32 i = 0; i < bc && k < n; i++) { u64 e = rdu64(mf, bucket_pos(idx, i)); if (e) ids[k++] = e; }
+    u64 root = aux_slot(st, AUX_FOLD);
+    u32 want = PMAP_INITIAL_BUCKETS;
+    while ((u64)want * 7 < (u64)n * 2 * 10) want *= 2;      /* room for shadows too */
+    if (!root || !pmap_create(mf, root, want)) { free(ids); return 0; }
+    for (u32 i = 0; i < k; i++) fold_track(st, root, ids[i]);
+    free(ids);
+    return 1;
+}
+int st_has_folds(stringtable_t *st) { return aux_root(st, AUX_FOLD) != 0; }
+u64 st_fold(stringtable_t *st, u64 id) {
+    u64 root = aux_root(st, AUX_FOLD);
+    return root ? pmap_get(st->mf, root, (u32)id) : 0;
+}
+
+/* ---- trigram index ---- */
+int st_build_trigrams(stringtable_t *st) {
+    memfile_t *mf = st->mf;
+    if (aux_root(st, AUX_TRIGRAM)) return 1;
+    u64 idx = hash_index_off(st);
+    u32 bc = rdu32(mf, idx + 0);
+    size_t np = 0, cap = 1u << 16;
+    u64 *pairs = malloc(cap * 8);
+    u8 *f = malloc(65536);
+    u32 *tris = malloc(65536 * 4);
+    int ok = pairs && f && tris;
+    for (u32 i = 0; ok && i < bc; i++) {
+        u64 e = rdu64(mf, bucket_pos(idx, i));
+        if (!e) continue;
+        u16 len; const u8 *p = st_get(st, e, &len);
+        u32 k = tri_collect(f, st_fold_utf8(p, len, f), tris);
+        if (np + k > cap) {
+            while (np + k > cap) cap *= 2;
+            u64 *np2 = realloc(pairs, cap * 8);
+            if (!np2) { ok = 0; break; }
+            pairs = np2;
+        }
+        for (u32 j = 0; j < k; j++) pairs[np++] = ((u64)tris[j] << 32) | (u32)e;
+    }
+    free(f); free(tris);
+    u64 root = ok ? aux_slot(st, AUX_TRIGRAM) : 0;
+    if (root && !tri_index_build(mf, root, pairs, np)) { tri_index_destroy(mf, root); root = 0; }
+    free(pairs);
+    return root != 0;
+}
+int st_has_trigrams(stringtable_t *st) { return aux_root(st, AUX_TRIGRAM) != 0; }
+
+int st_trigram_candidates(stringtable_t *st, const char *pattern, u32 **ids, u32 *n) {
+    u64 root = aux_root(st, AUX_TRIGRAM);
+    if (!root) return 0;
+    tq_arena *a = tq_arena_new();
+    if (!a) return 0;
+    tq_t *q = rq_build(a, pattern);
+    int r = q ? tri_eval(st->mf, root, q, ids, n) : 0;
+    tq_arena_free(a);
+    return r;
+}
+
+/* ---- compression: pack an existing entry in place ---- */
+int st_pack(stringtable_t *st, u64 id) {
+    memfile_t *mf = st->mf;
+    if (!id || ent_packed(mf, id)) return 0;
+    st_enc_t *e = encoder(st);
+    u16 len = rdu16(mf, id + 8);
+    if (!e || !len) return 0;
+    u8 *raw = malloc(len), *codes = malloc((size_t)len * 2);
+    if (!raw || !codes) { free(raw); free(codes); return 0; }
+    memcpy(raw, memfile_ptr(mf, id + 10), len);
+    u32 nc = sym_encode(e, raw, len, codes);
+    u64 oldq = quant(ENT_HEADER + len), newq = quant(ENT_HEADER + 2 + nc);
+    int packed = 0;
+    if (newq < oldq) {
+        wru32(mf, id + 0, rdu32(mf, id + 0) | ST_PACKED);
+        wru16(mf, id + 8, (u16)(2 + nc));
+        wru16(mf, id + 10, len);
+        memcpy(memfile_ptr(mf, id + 12), codes, nc);
+        memfile_free(mf, id + newq, oldq - newq);   /* id stays put; the tail goes back */
+        packed = 1;
+    }
+    free(raw); free(codes);
+    return packed;
 }
-u32 st_refcount(stringtable_t *st, u64 id) { return rdu32(st->mf, id + 0); }
+
 u32 st_count(stringtable_t *st)            { return entry_count(st); }
+u32 st_generation(stringtable_t *st)       { return free_gen(st); }
 
 /* ---- lifecycle / concurrency ---- */
 void st_sync(stringtable_t *st)  { memfile_sync(st->mf); }
@@ -218,5 +713,6 @@ int  st_unlock(stringtable_t *st)         { return memfile_unlock(st->mf); }
 void st_close(stringtable_t *st) {
     if (!st) return;
     if (st->mf) { memfile_close(st->mf); free(st->mf); }
+    free(st->enc);
     free(st);
 }
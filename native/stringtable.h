@@ -4,7 +4,15 @@
  * Entry layout (allocated via memfile_alloc): [u32 refcount][u32 hash][u16 len][u8 data[len]]
  *   String ID = the entry offset (v3 has no per-alloc header, so id == alloc offset directly).
  * Hash index: [u32 bucket_count][u32 _pad][u64 buckets[bucket_count]], linear probing.
- * Our header block (first allocation): [u64 hash_index_offset][u32 entry_count][u32 _pad].
+ * Our header block (first allocation): [u64 hash_index_offset][u32 entry_count][u32 free_gen]
+ *   [u64 aux_dir_offset] -> optional structures (symbol table, fold map, trigram
+ *   index), 0 = none. free_gen counts frees, so an id whose generation is
+ *   unchanged still names the same string.
+ *
+ * Packed entries (refcount high bit set): [..][u16 stored_len][u16 raw_len][codes],
+ *   coded with the file's FSST-style symbol table. Only callers that opt in
+ *   (st_intern_packed — observation text) get them, and only when coding saves
+ *   at least one allocation quantum. st_get decodes them transparently.
  */
 #ifndef STRINGTABLE_H
 #define STRINGTABLE_H
@@ -14,6 +22,7 @@
 typedef struct {
     memfile_t *mf;
     u64 header_offset;   /* our header block (the file's first allocation) */
+    void *enc;           /* in-process encoder for the persisted symbol table (lazy) */
 } stringtable_t;
 
 stringtable_t *st_open(const char *path, size_t initial_size);
@@ -22,6 +31,9 @@ void st_sync(stringtable_t *st);
 
 /* Intern: dedup + refcount++. Returns id (offset); 0 on failure. */
 u64  st_intern(stringtable_t *st, const u8 *data, u16 len);
+/* Intern as compressible text: stored symbol-coded when a dictionary exists and
+ * it saves space. Dedups against raw and packed entries alike. */
+u64  st_intern_packed(stringtable_t *st, const u8 *data, u16 len);
 /* Look up without interning / bumping. Returns id, or 0 if absent. */
 u64  st_find(stringtable_t *st, const u8 *data, u16 len);
 /* refcount++ on an existing id. */
@@ -30,10 +42,46 @@ void st_addref(stringtable_t *st, u64 id);
 void st_release(stringtable_t *st, u64 id);
 
 /* Zero-copy read: returns a pointer into the mmap + length. Valid until the next
- * allocation/remap on this table. */
+ * allocation/remap on this table. Packed entries decode into a per-thread ring
+ * of 4 buffers instead, valid until 4 more packed reads on the same thread.
+ * Any id can be packed: a name or type interned with st_intern dedups onto a
+ * packed observation of the same text. So a caller may hold at most 4 st_get
+ * results at once (fewer if it calls something that reads strings meanwhile);
+ * anything that keeps more, e.g. to sort, copies the bytes. */
 const u8 *st_get(stringtable_t *st, u64 id, u16 *len_out);
+/* Raw length without decoding. */
+u16  st_len(stringtable_t *st, u64 id);
 u32  st_refcount(stringtable_t *st, u64 id);
 u32  st_count(stringtable_t *st);
+/* Bumped whenever an entry is freed (its id may then be reused for another
+ * string); caches of id -> text hold while it is unchanged. Persisted, so a
+ * free by another process shows after its lock is released. */
+u32  st_generation(stringtable_t *st);
+
+/* Case folding (Unicode simple fold; never lengthens: out needs len bytes). */
+u32  st_fold_utf8(const u8 *s, u32 len, u8 *out);
+/* Case-fold shadows: build once (lazily, by the first caller that wants them);
+ * from then on intern/release keep every id mapped to the id of its folded form
+ * (itself when already folded; the shadow is a refcounted string like any other). */
+int  st_build_folds(stringtable_t *st);
+int  st_has_folds(stringtable_t *st);
+u64  st_fold(stringtable_t *st, u64 id);      /* shadow id; 0 if not built / unknown */
+
+/* Trigram index (trigram.h) over every entry's folded text: build once, then
+ * kept current by intern/release. Candidates: 0 = no index or the pattern has
+ * no usable trigrams (scan everything); 1 = *ids (malloc'd, ascending) holds
+ * every string id the POSIX ERE `pattern` can match. */
+int  st_build_trigrams(stringtable_t *st);
+int  st_has_trigrams(stringtable_t *st);
+int  st_trigram_candidates(stringtable_t *st, const char *pattern, u32 **ids, u32 *n);
+
+/* Compression. Train once from a sample of ids (1 on success, 0 if already
+ * trained or out of space); pack re-codes one raw entry in place — same id —
+ * returning its quantized tail to the allocator (1 if it was packed). */
+int  st_train_dictionary(stringtable_t *st, const u64 *ids, u32 n);
+int  st_has_dictionary(stringtable_t *st);
+int  st_pack(stringtable_t *st, u64 id);
+int  st_is_packed(stringtable_t *st, u64 id);
 
 /* Concurrency passthrough (strings file has its own fd/flock). */
 int  st_lock_shared(stringtable_t *st);
@@ -0,0 +1,160 @@
+/*
+ * btree.c validation: fuzz insert/delete against a sorted-array model, audit
+ * the structure (bt_check) as it grows and shrinks, and compare ranks, seeks
+ * and both scan directions. Bulk load and the tie-breaking callback too.
+ * Standalone (no N-API). Run under ASan+UBSan.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "memoryfile.h"
+#include "btree.h"
+
+static u64 rs = 0x5eed0b7eeull;
+static u64 xs(void) { u64 x = rs; x ^= x << 13; x ^= x >> 7; x ^= x << 17; return rs = x; }
+
+static int fails = 0;
+#define CHECK(c, m) do { if (!(c)) { printf("  FAIL: %s\n", m); fails++; } else printf("  ok:   %s\n", m); } while (0)
+
+typedef struct { u64 k, v; } P;
+static P *model;
+static size_t nm;
+static int vdesc;                      /* tie order of the tree under test: by value, descending when set */
+
+static int pcmp(P a, P b) {
+    if (a.k != b.k) return a.k < b.k ? -1 : 1;
+    int c = (a.v > b.v) - (a.v < b.v);
+    return vdesc ? -c : c;
+}
+static size_t mlower(P p) {
+    size_t lo = 0, hi = nm;
+    while (lo < hi) { size_t mid = (lo + hi) / 2; if (pcmp(model[mid], p) < 0) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+static int m_insert(P p) {
+    size_t i = mlower(p);
+    if (i < nm && pcmp(model[i], p) == 0) return 2;
+    memmove(model + i + 1, model + i, (nm - i) * sizeof *model);
+    model[i] = p; nm++;
+    return 1;
+}
+static int m_delete(P p) {
+    size_t i = mlower(p);
+    if (i >= nm || pcmp(model[i], p) != 0) return 0;
+    memmove(model + i, model + i + 1, (nm - i - 1) * sizeof *model);
+    nm--;
+    return 1;
+}
+
+static int desc_cmp(void *ctx, u64 a, u64 b) { (void)ctx; return (a < b) - (a > b); }
+
+static P probe_at;
+static int probe(void *ctx, u64 k, u64 v) { (void)ctx; return pcmp(probe_at, (P){ k, v }); }
+
+/* every pair in order from rank 0, and backwards from the last */
+static int scan_matches(const btree_t *t) {
+    bt_iter it;
+    u64 k, v;
+    size_t i = 0;
+    if (bt_count(t) != nm) return 0;
+    if (nm && !bt_at(t, 0, &it)) return 0;
+    for (; nm && bt_get(t, &it, &k, &v); bt_next(t, &it), i++)
+        if (i >= nm || k != model[i].k || v != model[i].v) return 0;
+    if (i != nm) return 0;
+    if (nm && !bt_at(t, nm - 1, &it)) return 0;
+    for (i = nm; nm && bt_get(t, &it, &k, &v); bt_prev(t, &it))
+        if (i == 0 || k != model[--i].k || v != model[i].v) return 0;
+    return i == 0 && !bt_at(t, nm, &it);
+}
+
+/* random ranks and seeks agree with the model */
+static int seeks_match(const btree_t *t) {
+    for (int q = 0; q < 64; q++) {
+        probe_at = (P){ xs() % 80, xs() % 2000 };
+        if (bt_lower(t, probe, NULL) != mlower(probe_at)) return 0;
+        if (!nm) continue;
+        size_t pos = xs() % nm;
+        bt_iter it; u64 k, v;
+        if (!bt_at(t, pos, &it) || !bt_get(t, &it, &k, &v) || k != model[pos].k || v != model[pos].v) return 0;
+    }
+    return 1;
+}
+
+static size_t fuzz(const btree_t *t, size_t iters, u32 insert_pct, size_t *bad) {
+    size_t audits = 0;
+    for (size_t i = 0; i < iters; i++) {
+        P p = { xs() % 64, xs() % 2000 };
+        if (xs() % 100 < insert_pct) { if (bt_insert(t, p.k, p.v) != m_insert(p)) (*bad)++; }
+        else if (nm && xs() % 2) {
+            P q = model[xs() % nm];
+            if (bt_delete(t, q.k, q.v) != m_delete(q)) (*bad)++;
+        } else if (bt_delete(t, p.k, p.v) != m_delete(p)) (*bad)++;
+        if ((i & 0x3FF) == 0) { audits++; if (!bt_check(t) || !scan_matches(t) || !seeks_match(t)) (*bad)++; }
+    }
+    return audits;
+}
+
+int main(void) {
+    const char *p = "/tmp/btree_test.dat";
+    unlink(p);
+    memfile_t *mf = memfile_open(p, 1u << 16);
+    if (!mf) { printf("open failed\n"); return 2; }
+    u64 slots = memfile_alloc(mf, 32);
+    memset(memfile_ptr(mf, slots), 0, 32);
+    u64 base = mf->header->allocated;
+    model = malloc(70000 * sizeof *model);
+
+    btree_t t = { mf, slots, NULL, NULL };
+    CHECK(bt_create(&t) && bt_count(&t) == 0 && bt_check(&t), "empty tree");
+    bt_iter it;
+    CHECK(!bt_at(&t, 0, &it) && !bt_get(&t, &it, NULL, NULL), "empty tree: no rank 0, iterator at end");
+
+    size_t bad = 0, audits;
+    audits = fuzz(&t, 60000, 60, &bad);
+    printf("  fuzz: audits=%zu live=%zu\n", audits, nm);
+    CHECK(bad == 0, "mixed fuzz == sorted model (inserts, deletes, audits, ranks, both scans)");
+
+    bad = 0;
+    while (nm < 40000) { P q = { xs() % 64, xs() % 2000 }; if (bt_insert(&t, q.k, q.v) != m_insert(q)) bad++; }
+    CHECK(bad == 0 && bt_check(&t) && scan_matches(&t) && seeks_match(&t), "grown to 40k pairs: audit, scans, seeks");
+    audits = fuzz(&t, 120000, 10, &bad);
+    CHECK(bad == 0 && nm < 1000 && bt_check(&t) && scan_matches(&t), "drained by a delete-heavy fuzz: nodes merge, the top gives way");
+    while (nm) { P q = model[xs() % nm]; if (!bt_delete(&t, q.k, q.v) || !m_delete(q)) bad++; }
+    CHECK(bad == 0 && bt_count(&t) == 0 && bt_check(&t), "emptied pair by pair");
+
+    /* bulk load: the same pairs as an insert-built tree, then mutable as usual */
+    while (nm < 30000) { P q = { xs() % 64, xs() % 2000 }; m_insert(q); }
+    u64 *k = malloc(nm * 8), *v = malloc(nm * 8);
+    for (size_t i = 0; i < nm; i++) { k[i] = model[i].k; v[i] = model[i].v; }
+    bt_destroy(&t);
+    CHECK(bt_build(&t, k, v, nm) && bt_check(&t) && scan_matches(&t) && seeks_match(&t), "bulk load == model");
+    bad = 0;
+    fuzz(&t, 40000, 50, &bad);
+    CHECK(bad == 0 && bt_check(&t) && scan_matches(&t), "bulk-loaded tree takes inserts and deletes");
+    bt_destroy(&t);
+    CHECK(bt_build(&t, k, v, 0) && bt_count(&t) == 0 && bt_check(&t), "bulk load of nothing is an empty tree");
+    bt_destroy(&t);
+    free(k); free(v);
+
+    /* tie order from the callback: equal keys, values descending */
+    nm = 0; vdesc = 1;
+    btree_t d = { mf, slots + 8, desc_cmp, NULL };
+    bad = 0;
+    CHECK(bt_create(&d), "callback-ordered tree created");
+    fuzz(&d, 40000, 60, &bad);
+    CHECK(bad == 0 && bt_check(&d) && scan_matches(&d) && seeks_match(&d), "ties ordered by the callback == model");
+    bt_destroy(&d);
+
+    CHECK(mf->header->free_bytes == mf->header->allocated - base && !*(u64 *)memfile_ptr(mf, slots),
+          "destroy hands every node back to the allocator");
+
+    free(model);
+    memfile_close(mf); free(mf);
+    unlink(p);
+    printf(fails ? "\nFAILED (%d)\n" : "\nALL PASS\n", fails);
+    return fails ? 1 : 0;
+}
@@ -5,15 +5,17 @@
 
 int main(void) {
     int ok = 1;
-    printf("sizeof(Entity)=%zu (expect 72)\n", sizeof(Entity));
-    printf("entity_bufsize(1)=%zu (expect 76)\n", entity_bufsize(1));
-    if (sizeof(Entity) != 72) ok = 0;
-    if (entity_bufsize(1) != 76) ok = 0;
+    printf("sizeof(Entity)=%zu (expect 120)\n", sizeof(Entity));
+    printf("entity_bufsize(1)=%zu (expect 76) entity_bufsize(2)=%zu (expect 124)\n",
+           entity_bufsize(1), entity_bufsize(2));
+    if (sizeof(Entity) != 120) ok = 0;
+    if (entity_bufsize(1) != 76 || entity_bufsize(2) != 124) ok = 0;
 
     Entity e; memset(&e, 0, sizeof(e));
     e.name_id = 42; e.type_id = 7; e.adj_offset = 0x1234; e.mtime = 999;
     e.obs_count = 2; e.obs0_id = 11; e.obs1_id = 12;
     e.structural_visits = 5; e.walker_visits = 9; e.psi = 3.14159;
+    e.name_len = 3; memcpy(e.name_inline, "abc", 3); e.type_len = ENTITY_INLINE_NONE;
 
     u8 buf[128];
     entity_write(&e, buf);
@@ -23,10 +25,23 @@ int main(void) {
     int rc = entity_read(buf, &r);
     printf("read rc=%d stored_ver=%u name_id=%u psi=%g walker=%llu obs1=%u\n",
            rc, stored_ver, r.name_id, r.psi, (unsigned long long)r.walker_visits, r.obs1_id);
-    if (rc != 0 || stored_ver != 1) ok = 0;
+    if (rc != 0 || stored_ver != 2) ok = 0;
     if (r.name_id != 42 || r.type_id != 7 || r.adj_offset != 0x1234 || r.mtime != 999) ok = 0;
     if (r.obs_count != 2 || r.obs0_id != 11 || r.obs1_id != 12) ok = 0;
     if (r.structural_visits != 5 || r.walker_visits != 9 || r.psi != 3.14159) ok = 0;
+    if (r.name_len != 3 || memcmp(r.name_inline, "abc", 3) != 0 || r.type_len != ENTITY_INLINE_NONE) ok = 0;
+
+    /* a v1 record (no inline tail) upgrades through the 1->2 lens */
+    Entity_v1 v1; memset(&v1, 0, sizeof(v1));
+    v1.name_id = 77; v1.obs1_id = 13; v1.psi = 0.5;
+    u8 buf1[128]; memset(buf1, 0xAB, sizeof buf1);
+    *(u32 *)buf1 = 1; memcpy(buf1 + sizeof(u32), &v1, sizeof(v1));
+    Entity u;
+    rc = entity_read(buf1, &u);
+    printf("v1 read rc=%d name_id=%u obs1=%u psi=%g name_len=%u type_len=%u\n",
+           rc, u.name_id, u.obs1_id, u.psi, u.name_len, u.type_len);
+    if (rc != 0 || u.name_id != 77 || u.obs1_id != 13 || u.psi != 0.5) ok = 0;
+    if (u.name_len != ENTITY_INLINE_NONE || u.type_len != ENTITY_INLINE_NONE) ok = 0;
 
     printf(ok ? "\nALL PASS\n" : "\nFAILED\n");
     return ok ? 0 : 1;
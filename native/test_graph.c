@@ -8,11 +8,19 @@
 #define _GNU_SOURCE
 #endif
 #include <stdio.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
 #include <unistd.h>
+#include <regex.h>
 #include "stringtable.h"
 #include "graph.h"
+#include "pool.h"
+#include "textindex.h"
+#include "fuzzy.h"
+#include "minhash.h"
 
 static int fails = 0;
 #define CHECK(c, m) do { if (!(c)) { printf("  FAIL: %s\n", m); fails++; } else printf("  ok:   %s\n", m); } while (0)
@@ -50,9 +58,54 @@ static int cmp_u64t(const void *a, const void *b) { u64 x = *(const u64 *)a, y =
 
 static int count_alive(void) { int c = 0; for (int i = 0; i < NENT; i++) if (ents[i].alive) c++; return c; }
 
+/* the name order's model: folded name, then raw name, then offset */
+static int cmp_name_model(const void *pa, const void *pb) {
+    u64 a = *(const u64 *)pa, b = *(const u64 *)pb;
+    u16 al, bl;
+    const u8 *ra = graph_entity_name(gr, a, &al), *rb = graph_entity_name(gr, b, &bl);
+    u8 fa[256], fb[256];
+    u32 fal = st_fold_utf8(ra, al, fa), fbl = st_fold_utf8(rb, bl, fb);
+    int c = memcmp(fa, fb, fal < fbl ? fal : fbl);
+    if (!c) c = (fal > fbl) - (fal < fbl);
+    if (!c) c = memcmp(ra, rb, al < bl ? al : bl);
+    if (!c) c = (al > bl) - (al < bl);
+    return c ? c : (a > b) - (a < b);
+}
+
+/* every live entity by name, both directions; then the prefix ranges and rank seeks of `prefixes` */
+static int names_match_model(const char *const *prefixes, u32 np) {
+    u32 n = graph_entity_count(gr);
+    u64 *all = malloc(((size_t)n + 1) * 8), *got = malloc(((size_t)n + 1) * 8);
+    graph_list_entities(gr, all, n);
+    qsort(all, n, 8, cmp_name_model);
+    int ok = graph_names_at(gr, 0, n + 1, 0, got) == n && !memcmp(all, got, (size_t)n * 8);
+    if (n) {
+        ok = ok && graph_names_at(gr, n - 1, n + 1, 1, got) == n;
+        for (u32 i = 0; i < n && ok; i++) ok = got[i] == all[n - 1 - i];
+    }
+    for (u32 q = 0; q < np && ok; q++) {
+        u8 fp[64], f[256];
+        u32 pl = st_fold_utf8((const u8 *)prefixes[q], (u32)strlen(prefixes[q]), fp), lower = n, first = n, cnt = 0;
+        for (u32 i = 0; i < n; i++) {
+            u16 nl; const u8 *nm = graph_entity_name(gr, all[i], &nl);
+            u32 fl = st_fold_utf8(nm, nl, f);
+            int c = memcmp(f, fp, fl < pl ? fl : pl);
+            if (lower == n && (c > 0 || (c == 0 && fl >= pl))) lower = i;
+            if (c == 0 && fl >= pl) { if (!cnt) first = i; cnt++; }
+        }
+        u32 gf;
+        ok = graph_name_rank(gr, (const u8 *)prefixes[q], (u16)strlen(prefixes[q])) == lower
+          && graph_name_prefix(gr, (const u8 *)prefixes[q], (u16)strlen(prefixes[q]), &gf) == cnt && (!cnt || gf == first);
+        if (!ok) printf("  mismatch: names prefix %s\n", prefixes[q]);
+    }
+    free(all); free(got);
+    return ok;
+}
+
 static int validate(void) {
     int bad = 0;
     if ((int)graph_entity_count(gr) != count_alive()) bad++;
+    if (!names_match_model(NULL, 0)) bad++;
     for (int i = 0; i < NENT; i++) {
         u64 found = graph_lookup(gr, (const u8 *)ents[i].name, (u16)strlen(ents[i].name));
         if (ents[i].alive) { if (found != ents[i].off) bad++; }
@@ -61,6 +114,350 @@ static int validate(void) {
     return bad;
 }
 
+/* brute-force BM25 (k1 = TI_K1, b = TI_B) over ASCII docs: the model for graph_text_search */
+static u32 words_of(const char *s, char w[][TI_WORD_MAX + 1], u32 max) {
+    u32 n = 0;
+    for (const char *p = s; *p && n < max;) {
+        while (*p && !isalnum((unsigned char)*p)) p++;
+        u32 l = 0;
+        for (; isalnum((unsigned char)*p); p++) if (l < TI_WORD_MAX) w[n][l++] = (char)tolower((unsigned char)*p);
+        if (l) w[n++][l] = 0;
+    }
+    return n;
+}
+static void bm25_model(char **docs, u32 n, const char *query, double *score) {
+    static char qw[16][TI_WORD_MAX + 1], dw[64][TI_WORD_MAX + 1];
+    u32 nq = words_of(query, qw, 16), *tf = calloc((size_t)n * 16, sizeof(u32)), *dl = calloc(n, sizeof(u32)), nd = 0;
+    double total = 0, df[16] = { 0 };
+    for (u32 d = 0; d < n; d++) {
+        dl[d] = words_of(docs[d], dw, 64);
+        total += dl[d]; nd += dl[d] > 0;
+        for (u32 j = 0; j < dl[d]; j++) for (u32 q = 0; q < nq; q++) tf[d * 16 + q] += strcmp(dw[j], qw[q]) == 0;
+    }
+    for (u32 q = 0; q < nq; q++) {
+        int dup = 0;
+        for (u32 r = 0; r < q; r++) dup |= strcmp(qw[r], qw[q]) == 0;
+        for (u32 d = 0; d < n && !dup; d++) df[q] += tf[d * 16 + q] > 0;
+    }
+    for (u32 d = 0; d < n; d++) {
+        score[d] = 0;
+        for (u32 q = 0; q < nq; q++) {
+            double t = tf[d * 16 + q];
+            if (!df[q] || !t) continue;
+            double idf = log(1.0 + (nd - df[q] + 0.5) / (df[q] + 0.5));
+            score[d] += idf * t * (TI_K1 + 1) / (t + TI_K1 * (1 - TI_B + TI_B * dl[d] / (total / nd)));
+        }
+    }
+    free(tf); free(dl);
+}
+/* graph_text_search(query, k) is a valid top-k of the model: scores match, order holds, nothing better left out */
+static int text_matches_model(const char *query, u32 k, char **docs, const u64 *offs, u32 n) {
+    double *ms = malloc((size_t)n * sizeof(double)), *sc = malloc((size_t)k * sizeof(double));
+    u64 *out = malloc((size_t)k * 8);
+    bm25_model(docs, n, query, ms);
+    u32 got = graph_text_search(gr, (const u8 *)query, (u32)strlen(query), k, out, sc), pos = 0;
+    int ok = 1;
+    for (u32 d = 0; d < n; d++) pos += ms[d] > 0;
+    if (got != (pos < k ? pos : k)) ok = 0;
+    for (u32 i = 0; i < got && ok; i++) {
+        u32 d = 0;
+        while (d < n && offs[d] != out[i]) d++;
+        if (d == n || fabs(ms[d] - sc[i]) > 1e-9 || (i && (sc[i] > sc[i - 1] || (sc[i] == sc[i - 1] && out[i] < out[i - 1])))) ok = 0;
+        else ms[d] = -1;                               /* returned */
+    }
+    for (u32 d = 0; d < n && ok && got; d++) if (ms[d] > sc[got - 1] + 1e-9) ok = 0;
+    if (!ok) printf("  mismatch: text %s got=%u pos=%u\n", query, got, pos);
+    free(ms); free(sc); free(out);
+    return ok;
+}
+
+/* graph_fuzzy_lookup(query, maxd, k) == brute-force distances over every live
+ * entity: the k nearest by (distance, offset), distances included */
+static int fuzzy_matches_model(const char *query, u32 maxd, u32 k) {
+    u32 cap = graph_entity_count(gr) + 1, m = 0, ql = (u32)strlen(query);
+    u64 *all = malloc((size_t)cap * 8), *key = malloc((size_t)cap * 8), *out = malloc((size_t)k * 8);
+    u32 *dist = malloc((size_t)k * 4), n = graph_list_entities(gr, all, cap);
+    u8 q[64], f[256];
+    u32 fq = st_fold_utf8((const u8 *)query, ql, q);
+    for (u32 i = 0; i < n; i++) {
+        u16 nl; const u8 *nm = graph_entity_name(gr, all[i], &nl);
+        u32 d = fz_distance(q, fq, f, st_fold_utf8(nm, nl, f), maxd);
+        if (d <= maxd) key[m++] = (u64)d << 40 | all[i] >> 5;   /* offsets fit in 40 bits here */
+    }
+    qsort(key, m, 8, cmp_u64t);
+    u32 got = graph_fuzzy_lookup(gr, (const u8 *)query, (u16)ql, maxd, k, out, dist);
+    int ok = got == (m < k ? m : k);
+    for (u32 i = 0; i < got && ok; i++) ok = out[i] == (key[i] & 0xffffffffffull) << 5 && dist[i] == key[i] >> 40;
+    if (!ok) printf("  mismatch: fuzzy %s d=%u got=%u want=%u\n", query, maxd, got, m < k ? m : k);
+    free(all); free(key); free(out); free(dist);
+    return ok;
+}
+
+/* a doc's sketch as the graph takes it: folded, then MinHashed */
+static void doc_sketch(const char *doc, u32 *sig) {
+    u8 f[512];
+    mh_sketch(f, st_fold_utf8((const u8 *)doc, (u32)strlen(doc), f), sig);
+}
+
+/* graph_near_duplicates(query, min, k) against the sketches of every doc: each
+ * hit is a doc at >= min with its estimate, best first (ties by offset). Above
+ * 1 - MH_BANDS / MH_HASHES a pair always shares a band, so it is the exact top-k. */
+static int dups_match_model(const char *query, double min, u32 k, char **docs, const u64 *offs, u32 n) {
+    u32 qs[MH_HASHES], ds[MH_HASHES], want = 0;
+    double *ms = malloc(((size_t)n + 1) * sizeof(double)), *sim = malloc((size_t)k * sizeof(double));
+    u64 *out = malloc((size_t)k * 8);
+    doc_sketch(query, qs);
+    for (u32 d = 0; d < n; d++) { doc_sketch(docs[d], ds); ms[d] = mh_similarity(qs, ds); want += ms[d] >= min; }
+    u32 got = graph_near_duplicates(gr, (const u8 *)query, (u32)strlen(query), min, k, out, sim);
+    int ok = got <= k && got <= want;
+    for (u32 i = 0; i < got && ok; i++) {
+        u32 d = 0;
+        while (d < n && offs[d] != out[i]) d++;
+        if (d == n || ms[d] != sim[i] || sim[i] < min || (i && (sim[i] > sim[i - 1] || (sim[i] == sim[i - 1] && out[i] < out[i - 1])))) ok = 0;
+        else ms[d] = -1;                               /* returned */
+    }
+    if (ok && min > 1.0 - (double)MH_BANDS / MH_HASHES) {
+        ok = got == (want < k ? want : k);
+        for (u32 d = 0; d < n && ok && got; d++) if (ms[d] > sim[got - 1]) ok = 0;
+    }
+    if (!ok) printf("  mismatch: dups %s min=%.2f got=%u want=%u\n", query, min, got, want);
+    free(ms); free(sim); free(out);
+    return ok;
+}
+
+/* an entity's text as the graph joins it: name, then each observation */
+static void entity_doc(u64 off, char *buf) {
+    entity_t e;
+    u16 l;
+    const u8 *nm = graph_entity_name(gr, off, &l);
+    int n = snprintf(buf, 512, "%.*s", (int)l, (const char *)nm);
+    graph_read_entity(gr, off, &e);
+    u32 os[2] = { e.obs0_id, e.obs1_id };
+    for (u32 k = 0; k < 2; k++) {
+        if (!os[k]) continue;
+        const u8 *ob = st_get(st, os[k], &l);
+        n += snprintf(buf + n, 512 - n, " %.*s", (int)l, (const char *)ob);
+    }
+}
+
+static u32 uf_root(u32 *p, u32 x) { while (p[x] != x) x = p[x] = p[p[x]]; return x; }
+
+/* graph_duplicate_clusters(min) == the components of the pairs at >= min among
+ * the docs (min above 1 - MH_BANDS / MH_HASHES: every such pair is found) */
+static int clusters_match_model(double min, char **docs, const u64 *offs, u32 n) {
+    u32 *sig = malloc(((size_t)n + 1) * MH_HASHES * 4), *p = malloc(((size_t)n + 1) * 4), *cl = malloc(((size_t)n + 1) * 4);
+    u64 *out = malloc(((size_t)n + 1) * 8);
+    u32 *size = calloc((size_t)n + 1, 4), m = 0;
+    for (u32 d = 0; d < n; d++) { doc_sketch(docs[d], sig + (size_t)d * MH_HASHES); p[d] = d; }
+    for (u32 a = 0; a < n; a++)
+        for (u32 b = a + 1; b < n; b++)
+            if (mh_similarity(sig + (size_t)a * MH_HASHES, sig + (size_t)b * MH_HASHES) >= min) {
+                u32 ra = uf_root(p, a), rb = uf_root(p, b);
+                if (ra != rb) p[ra > rb ? ra : rb] = ra < rb ? ra : rb;
+            }
+    /* model layout: by cluster (least offset first), offsets ascending within */
+    u64 *least = malloc(((size_t)n + 1) * 8), *key = malloc(((size_t)n + 1) * 8);
+    for (u32 d = 0; d < n; d++) least[d] = ~0ull;
+    for (u32 d = 0; d < n; d++) {
+        u32 r = uf_root(p, d);
+        size[r]++;
+        if (offs[d] < least[r]) least[r] = offs[d];
+    }
+    for (u32 d = 0; d < n; d++) if (size[uf_root(p, d)] > 1) key[m++] = least[uf_root(p, d)] >> 5 << 32 | offs[d] >> 5;
+    qsort(key, m, 8, cmp_u64t);
+    u32 got = graph_duplicate_clusters(gr, min, out, cl, n + 1);
+    int ok = got == m;
+    for (u32 i = 0; i < got && ok; i++) {
+        ok = out[i] == (key[i] & 0xffffffffull) << 5
+          && cl[i] == (i ? cl[i - 1] + (key[i] >> 32 != key[i - 1] >> 32) : 0);
+    }
+    if (!ok) printf("  mismatch: clusters min=%.2f got=%u want=%u\n", min, got, m);
+    free(sig); free(p); free(cl); free(out); free(size); free(least); free(key);
+    return ok;
+}
+
+/* `name` with up to two random edits (delete, insert, substitute, transpose) and
+ * random upper-casing into buf */
+static void typo(const char *name, char *buf) {
+    size_t l = strlen(name);
+    memcpy(buf, name, l + 1);
+    for (u32 e = (u32)(xs() % 3); e > 0; e--) {
+        size_t p = l ? xs() % l : 0;
+        switch (xs() % 4) {
+        case 0: if (l) { memmove(buf + p, buf + p + 1, l - p); l--; } break;
+        case 1: memmove(buf + p + 1, buf + p, l - p + 1); buf[p] = (char)('0' + xs() % 10); l++; break;
+        case 2: if (l) buf[p] = (char)('a' + xs() % 26); break;
+        default: if (p + 1 < l) { char t = buf[p]; buf[p] = buf[p + 1]; buf[p + 1] = t; }
+        }
+    }
+    for (size_t i = 0; i < l; i++) if (xs() % 4 == 0) buf[i] = (char)toupper((unsigned char)buf[i]);
+}
+
+/* each live fuzz entity's text (name + observations) into docs/offs; returns count */
+static u32 fuzz_docs(char **docs, u64 *offs) {
+    u32 n = 0;
+    for (int i = 0; i < NENT; i++) {
+        if (!ents[i].alive) continue;
+        docs[n] = malloc(64);
+        int l = snprintf(docs[n], 64, "%s", ents[i].name);
+        for (u32 k = 0; k < obsn[i]; k++) l += snprintf(docs[n] + l, 64 - l, " o-%d-%u", i, k);
+        offs[n++] = ents[i].off;
+    }
+    return n;
+}
+
+#define VDIM 12
+
+/* a fixed vector per fuzz entity: one of 8 directions plus noise */
+static void ent_vector(int i, float *v) {
+    u64 h = (u64)(i + 1) * 0x9e3779b97f4a7c15ull;
+    for (u32 d = 0; d < VDIM; d++) {
+        h ^= h >> 29; h *= 0xbf58476d1ce4e5b9ull;
+        v[d] = (float)((h >> 40) & 0xffff) / 65536.0f - 0.5f + (d == (u32)(i % 8) ? 1.5f : 0.0f);
+    }
+}
+static double vcos(const float *a, const float *b) {
+    double ab = 0, aa = 0, bb = 0;
+    for (u32 d = 0; d < VDIM; d++) { ab += (double)a[d] * b[d]; aa += (double)a[d] * a[d]; bb += (double)b[d] * b[d]; }
+    return ab / sqrt(aa * bb);
+}
+static int ent_at(u64 off) { for (int i = 0; i < NENT; i++) if (ents[i].alive && ents[i].off == off) return i; return -1; }
+
+/* graph_vector_search against cosine over every live fuzz entity: each hit's
+ * similarity is its own, of the type when one is given, and the similarities
+ * are the model's top k — exactly with a type (its refs are ranked), while
+ * without one *hits counts the model's top k found */
+static int vectors_match_model(const float *q, u32 k, const char *type, u32 *hits) {
+    u64 want[NENT], got[NENT];
+    double ws[NENT], gs[NENT];
+    u32 nw = 0;
+    float v[VDIM];
+    for (int i = 0; i < NENT; i++) {
+        if (!ents[i].alive || (type && strcmp(ents[i].type, type))) continue;
+        ent_vector(i, v);
+        double s = vcos(q, v);
+        if (nw == k && s <= ws[nw - 1]) continue;
+        u32 j = nw < k ? nw++ : nw - 1;
+        while (j > 0 && ws[j - 1] < s) { want[j] = want[j - 1]; ws[j] = ws[j - 1]; j--; }
+        want[j] = ents[i].off; ws[j] = s;
+    }
+    u32 ng = graph_vector_search(gr, q, VDIM, (const u8 *)type, type ? (u16)strlen(type) : 0, k, got, gs);
+    int ok = ng == nw;
+    for (u32 i = 0; i < ng && ok; i++) {
+        int e = ent_at(got[i]);
+        if (e >= 0) ent_vector(e, v);
+        ok = e >= 0 && (!type || !strcmp(ents[e].type, type)) && fabs(vcos(q, v) - gs[i]) < 1e-5
+          && (i == 0 || gs[i] <= gs[i - 1]) && (!type || fabs(gs[i] - ws[i]) < 1e-5);
+        for (u32 j = 0; j < nw; j++) if (want[j] == got[i]) { (*hits)++; break; }
+    }
+    if (!ok) printf("  mismatch: vectors type=%s got=%u want=%u\n", type ? type : "-", ng, nw);
+    return ok;
+}
+
+/* model components: lab[i] = least live index connected to i (relations undirected) */
+static void model_components(int *lab) {
+    for (int i = 0; i < NENT; i++) lab[i] = i;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (size_t k = 0; k < nrel; k++) {
+            int a = rels[k].from, b = rels[k].to, m = lab[a] < lab[b] ? lab[a] : lab[b];
+            if (lab[a] != m || lab[b] != m) { lab[a] = lab[b] = m; changed = 1; }
+        }
+    }
+}
+
+/* graph_outside_component(anchor) against the model, plus graph_component agreeing on pairs */
+static int outside_matches_model(int anchor) {
+    int lab[NENT];
+    model_components(lab);
+    u64 want[NENT], got[NENT]; u32 nw = 0;
+    for (int i = 0; i < NENT; i++) if (ents[i].alive && (anchor < 0 || lab[i] != lab[anchor])) want[nw++] = ents[i].off;
+    u32 ng = graph_outside_component(gr, anchor < 0 ? 0 : ents[anchor].off, got, NENT);
+    if (ng != nw) return 0;
+    qsort(want, nw, 8, cmp_u64t); qsort(got, ng, 8, cmp_u64t);
+    if (memcmp(want, got, (size_t)nw * 8)) return 0;
+    if (graph_has_components(gr))
+        for (int t = 0; t < 200; t++) {
+            int a = (int)(xs() % NENT), b = (int)(xs() % NENT);
+            if (!ents[a].alive || !ents[b].alive) continue;
+            if ((graph_component(gr, ents[a].off) == graph_component(gr, ents[b].off)) != (lab[a] == lab[b])) return 0;
+        }
+    return 1;
+}
+
+static int orphans_match_model(void) {
+    u64 want[NENT], got[NENT]; u32 nw = 0;
+    for (int i = 0; i < NENT; i++) {
+        if (!ents[i].alive) continue;
+        int linked = 0;
+        for (size_t k = 0; k < nrel && !linked; k++) linked = rels[k].from == i || rels[k].to == i;
+        if (!linked) want[nw++] = ents[i].off;
+    }
+    u32 ng = graph_orphaned(gr, got, NENT);
+    for (u32 j = 1; j < ng && j < NENT; j++) if (got[j - 1] >= got[j]) return 0;
+    qsort(want, nw, 8, cmp_u64t);
+    return ng == nw && !memcmp(want, got, (size_t)nw * 8);
+}
+
+/* changed_since / relations_since, paged, against the records and adjacency */
+typedef struct { u64 k, v, rt; } rec_item;
+static int cmp_rec(const void *pa, const void *pb) {
+    const rec_item *a = pa, *b = pb;
+    if (a->k != b->k) return a->k < b->k ? -1 : 1;
+    if (a->v != b->v) return a->v < b->v ? -1 : 1;
+    return (a->rt > b->rt) - (a->rt < b->rt);
+}
+
+static int recency_matches(u64 since) {
+    rec_item want[NENT];
+    for (int f = 0; f < 4; f++) {                  /* mtime / obsMtime, newest and oldest first */
+        u32 nw = 0, key = (f & 1 ? GRAPH_RANK_OBS_MTIME : GRAPH_RANK_MTIME) | (f & 2 ? GRAPH_RANK_ASC : 0);
+        for (int i = 0; i < NENT; i++) {
+            if (!ents[i].alive) continue;
+            entity_t e; graph_read_entity(gr, ents[i].off, &e);
+            u64 m = f & 1 ? e.obs_mtime : e.mtime;
+            if (m >= since) want[nw++] = (rec_item){ m, ents[i].off, 0 };
+        }
+        qsort(want, nw, sizeof *want, cmp_rec);
+        u64 got[37]; u32 total = 0, pos = 0, n;
+        while ((n = graph_changed_since(gr, key, since, pos, 37, got, &total)) > 0) {
+            for (u32 j = 0; j < n; j++) if (got[j] != want[f & 2 ? pos + j : nw - 1 - pos - j].v) return 0;
+            pos += n;
+        }
+        if (pos != nw || total != nw) return 0;
+    }
+    /* relations: (mtime, pair) entries, every type of an entry on one page */
+    size_t cap = nrel + 1;
+    rec_item *rw = malloc(cap * sizeof *rw), *rg = malloc(cap * sizeof *rg);
+    u32 nw = 0, ng = 0, entries = 0, pos = 0, total = 0, n, entry[29];
+    for (int i = 0; i < NENT; i++) {
+        if (!ents[i].alive) continue;
+        u32 ec = graph_edge_count(gr, ents[i].off);
+        adj_entry_t *es = malloc((ec + 1) * sizeof *es);
+        graph_read_edges(gr, ents[i].off, es, ec);
+        for (u32 j = 0; j < ec; j++)
+            if (es[j].direction == DIR_FORWARD && es[j].mtime >= since)
+                rw[nw++] = (rec_item){ es[j].mtime, (u64)(ents[i].off >> 5) << 32 | (es[j].target_offset >> 5), es[j].rel_type_id };
+        free(es);
+    }
+    qsort(rw, nw, sizeof *rw, cmp_rec);
+    for (u32 j = 0; j < nw; j++) if (!j || rw[j].k != rw[j - 1].k || rw[j].v != rw[j - 1].v) entries++;
+    graph_rel_t page[29];
+    int ok = 1;
+    while (ok && (n = graph_relations_since(gr, since, 0, pos, 29, page, entry, &total)) > 0) {
+        for (u32 j = 0; j < n; j++) {
+            rg[ng++] = (rec_item){ page[j].mtime, (page[j].from >> 5) << 32 | (page[j].to >> 5), page[j].rel_type_id };
+            if (j && (entry[j] < entry[j - 1] || entry[j] > entry[j - 1] + 1)) ok = 0;
+            if (ng > 1 && cmp_rec(&rg[ng - 1], &rg[ng - 2]) > 0 && !(j && entry[j] == entry[j - 1])) ok = 0;   /* newest first */
+        }
+        pos = entry[n - 1] + 1;
+    }
+    qsort(rg, ng, sizeof *rg, cmp_rec);
+    ok = ok && ng == nw && total == entries && !memcmp(rw, rg, (size_t)nw * sizeof *rw);
+    free(rw); free(rg);
+    return ok;
+}
+
 static int pick_alive(void) {
     int n = count_alive(); if (!n) return -1;
     int k = (int)(xs() % (u64)n);
@@ -81,6 +478,8 @@ int main(void) {
         ents[i].off = 0; ents[i].alive = 0; obsn[i] = 0;
     }
 
+    CHECK(st_build_trigrams(st) == 1 && st_has_trigrams(st), "trigram index built before the fuzz (kept current from here on)");
+
     size_t bad = 0;
     char rb[16];
     for (size_t it = 0; it < 200000; it++) {
@@ -120,6 +519,7 @@ int main(void) {
             rel_del_idx(k);
         }
         if ((it & 0xFFF) == 0 && validate() != 0) bad++;
+        if (it == 100000) CHECK(graph_build_text_index(gr) && graph_has_text_index(gr), "text index built mid-fuzz (kept current from here on)");
     }
     CHECK(bad == 0, "per-op model: entity count + name-index lookups consistent");
 
@@ -130,8 +530,40 @@ int main(void) {
         int model = 0; for (int i = 0; i < NENT; i++) if (ents[i].alive && (i % 16) == 3) model++;
         u64 *buf = malloc((size_t)NENT * sizeof(u64));
         u32 got = graph_entities_by_type(gr, (const u8 *)"type-3", 6, buf, NENT);
-        CHECK((int)got == model, "entities_by_type == model");
+        int by_ok = (int)got == model;
+        for (u32 j = 0; by_ok && j < got; j++) {
+            int i = ent_at(buf[j]);
+            by_ok = i >= 0 && strcmp(ents[i].type, "type-3") == 0 && (j == 0 || buf[j - 1] < buf[j]);
+        }
+        CHECK(by_ok, "entities_by_type == model, offsets ascending");
         free(buf);
+
+        /* type counts: every live type once, ascending ids, counts as in the model */
+        u32 ids[64], cnt[64], nt = graph_entity_type_counts(gr, ids, cnt, 64), total = 0;
+        int tc_ok = nt <= 64;
+        for (u32 j = 0; tc_ok && j < nt; j++) {
+            u16 l; const u8 *p = st_get(st, ids[j], &l);
+            int m = 0;
+            for (int i = 0; i < NENT; i++) if (ents[i].alive && strlen(ents[i].type) == l && !memcmp(ents[i].type, p, l)) m++;
+            tc_ok = m > 0 && (u32)m == cnt[j] && (j == 0 || ids[j - 1] < ids[j]);
+            total += cnt[j];
+        }
+        CHECK(tc_ok && (int)total == count_alive(), "entity_type_counts == model");
+
+        /* relation types: live relTypes once, ascending ids, relations per type as in the model */
+        nt = graph_relation_type_counts(gr, ids, cnt, 64); total = 0;
+        tc_ok = nt <= NRT;
+        for (u32 j = 0; tc_ok && j < nt; j++) {
+            u16 l; const u8 *p = st_get(st, ids[j], &l);
+            char want[16]; u32 m = 0;
+            for (int r = 0; r < NRT; r++) {
+                rtname(r, want);
+                if (strlen(want) == l && !memcmp(want, p, l)) for (size_t k = 0; k < nrel; k++) m += rels[k].rt == r;
+            }
+            tc_ok = m > 0 && m == cnt[j] && (j == 0 || ids[j - 1] < ids[j]);
+            total += cnt[j];
+        }
+        CHECK(tc_ok && total == nrel, "relation_type_counts == model");
     }
     {
         u32 *tb = malloc(64 * sizeof(u32));
@@ -171,8 +603,126 @@ int main(void) {
             if (graph_find_path(gr, ents[rr.from].off, ents[rr.from].off, 4, DIR_ANY, path, 64) != 1) fp_ok = 0;
         }
         CHECK(fp_ok, "find_path: direct edge -> len 2, self -> len 1");
+
+        /* bidirectional search: same reachability and path length as the
+         * one-sided BFS, and every hop is an edge in the asked direction */
+        int bd_ok = 1;
+        for (int t = 0; t < 120; t++) {
+            int a = pick_alive(), b = pick_alive();
+            if (a < 0 || b < 0) break;
+            const u32 dirs[3] = { DIR_FORWARD, DIR_BACKWARD, DIR_ANY };
+            u32 dir = dirs[t % 3], depth = 1 + (u32)(t % 6);
+            u64 p1[64], p2[64], f1, f2; int r1, r2, e1, e2;
+            u32 n1 = graph_find_path_ex(gr, ents[a].off, ents[b].off, depth, dir, (u64)-1, p1, 64, &r1, &e1, &f1);
+            u32 n2 = graph_find_path_bidi(gr, ents[a].off, ents[b].off, depth, dir, (u64)-1, p2, 64, &r2, &e2, &f2);
+            if (r1 != r2 || e2) { bd_ok = 0; continue; }
+            if (!r2) continue;
+            if (n1 != n2 || p2[0] != ents[a].off || p2[n2 - 1] != ents[b].off) { bd_ok = 0; continue; }
+            for (u32 j = 0; j + 1 < n2; j++) {
+                u64 nb[NENT]; u32 nn = graph_neighbors(gr, p2[j], 1, dir, nb, NENT), hit = 0;
+                for (u32 q = 0; q < nn; q++) if (nb[q] == p2[j + 1]) hit = 1;
+                if (!hit) bd_ok = 0;
+            }
+        }
+        CHECK(bd_ok, "find_path bidi: matches one-sided BFS reachability and length");
+
+        /* bidi under small budgets. At 0 the first discovery trips it on both
+         * searches, so all outputs agree; above that a stop is either a
+         * shortest path, a proof of no path, or exhausted with a partial walk
+         * from `from` to `farthest` */
+        int bb_ok = 1, bb_partial = 0;
+        for (int t = 0; t < 120; t++) {
+            int a = pick_alive(), b = pick_alive();
+            if (a < 0 || b < 0) break;
+            if (a == b) continue;
+            const u32 dirs[3] = { DIR_FORWARD, DIR_BACKWARD, DIR_ANY };
+            const u64 budgets[4] = { 0, 60, 150, 300 };
+            u32 dir = dirs[t % 3], depth = 1 + (u32)(t % 6);
+            u64 p1[64], p2[64], f1, f2; int r1, r2, e1, e2;
+            u32 n1 = graph_find_path_ex(gr, ents[a].off, ents[b].off, depth, dir, (u64)-1, p1, 64, &r1, &e1, &f1);
+            for (int k = 0; k < 4; k++) {
+                u64 q1[64], g1; int s1, x1;
+                u32 m1 = graph_find_path_ex(gr, ents[a].off, ents[b].off, depth, dir, budgets[k], q1, 64, &s1, &x1, &g1);
+                u32 n2 = graph_find_path_bidi(gr, ents[a].off, ents[b].off, depth, dir, budgets[k], p2, 64, &r2, &e2, &f2);
+                if (r2 && e2) { bb_ok = 0; continue; }
+                if (budgets[k] == 0 &&
+                    (s1 != r2 || x1 != e2 || g1 != f2 || m1 != n2 || (n2 && memcmp(q1, p2, n2 * 8)))) { bb_ok = 0; continue; }
+                if (r2) { if (!r1 || n2 != n1 || f2 != ents[b].off || p2[n2 - 1] != ents[b].off) bb_ok = 0; }
+                else if (!e2) { if (r1) bb_ok = 0; continue; }
+                else if (!f2 || !n2 || p2[n2 - 1] != f2) { bb_ok = 0; continue; }
+                else bb_partial += n2 > 1;
+                if (n2 && p2[0] != ents[a].off) bb_ok = 0;
+                for (u32 j = 0; j + 1 < n2; j++) {
+                    u64 nb[NENT]; u32 nn = graph_neighbors(gr, p2[j], 1, dir, nb, NENT), hit = 0;
+                    for (u32 q = 0; q < nn; q++) if (nb[q] == p2[j + 1]) hit = 1;
+                    if (!hit) bb_ok = 0;
+                }
+            }
+        }
+        printf("  bidi small budgets: %d partial walks\n", bb_partial);
+        CHECK(bb_ok && bb_partial > 0, "find_path bidi: small budgets agree with one-sided BFS, partial walks end at farthest");
+
+        /* set relations: each direction against the model over random sets (one member repeated) */
+        int sr_ok = 1;
+        u32 rtid[NRT];
+        for (int r = 0; r < NRT; r++) { char b[16]; rtname(r, b); rtid[r] = (u32)st_find(st, (const u8 *)b, (u16)strlen(b)); }
+        graph_rel_t *got = malloc((nrel + 1) * sizeof *got);
+        for (int t = 0; t < 30; t++) {
+            u8 in[NENT] = { 0 };
+            u64 set[41]; u32 n = 0;
+            while (n < 40) { int i = pick_alive(); if (i < 0) break; set[n++] = ents[i].off; in[i] = 1; }
+            if (n) set[n] = set[0], n++;
+            const u32 dirs[3] = { DIR_FORWARD, DIR_BACKWARD, DIR_ANY };
+            for (int d = 0; d < 3; d++) {
+                u32 want = 0;
+                for (size_t k = 0; k < nrel; k++)
+                    if (d == 0 ? in[rels[k].from] : d == 1 ? in[rels[k].to] : in[rels[k].from] && in[rels[k].to]) want++;
+                u32 m = graph_set_relations(gr, set, n, dirs[d], got, (u32)nrel + 1);
+                if (m != want) { sr_ok = 0; continue; }
+                for (u32 j = 0; j < m; j++) {
+                    int f = ent_at(got[j].from), to = ent_at(got[j].to), r = 0;
+                    while (r < NRT && rtid[r] != got[j].rel_type_id) r++;
+                    if (f < 0 || to < 0 || r == NRT || rel_find(f, to, r) < 0) { sr_ok = 0; break; }
+                    if (d == 0 ? !in[f] : d == 1 ? !in[to] : !(in[f] && in[to])) { sr_ok = 0; break; }
+                }
+            }
+        }
+        free(got);
+        CHECK(sr_ok, "set_relations: out / in / induced match model over 30 sets");
+    }
+
+    /* zero-degree set and components: labels built, kept by new relations,
+     * dropped by a removal (BFS fallback meanwhile), rebuilt */
+    {
+        CHECK(orphans_match_model(), "orphaned == model (maintained set, offsets ascending)");
+        int anchor = pick_alive(), ok = 1;
+        ok = outside_matches_model(anchor);
+        CHECK(!graph_has_components(gr) && graph_component(gr, ents[anchor].off) == 0 && ok,
+              "no labels after the fuzz's removals; outside_component by BFS == model");
+        CHECK(graph_build_components(gr) && graph_has_components(gr) && outside_matches_model(anchor)
+              && outside_matches_model(-1), "labels built: outside_component and component pairs == model");
+        char rb[16];
+        for (int t = 0; t < 60; t++) {
+            int a = pick_alive(), b = pick_alive(), r = (int)(xs() % NRT);
+            if (a == b || rel_find(a, b, r) >= 0) continue;
+            rtname(r, rb);
+            graph_create_relation(gr, ents[a].off, ents[b].off, (const u8 *)rb, (u16)strlen(rb), 1);
+            rel_push(a, b, r);
+            if (t % 10 == 0 && !outside_matches_model(pick_alive())) ok = 0;
+        }
+        CHECK(ok && graph_has_components(gr) && outside_matches_model(anchor) && orphans_match_model(),
+              "60 new relations: labels kept by union, still == model");
+        Rel rr = rels[0]; rtname(rr.rt, rb);
+        graph_delete_relation(gr, ents[rr.from].off, ents[rr.to].off, (const u8 *)rb, (u16)strlen(rb));
+        rel_del_idx(0);
+        CHECK(!graph_has_components(gr) && outside_matches_model(anchor) && orphans_match_model(),
+              "a removal drops the labels; BFS fallback == model");
+        CHECK(graph_build_components(gr) && outside_matches_model(anchor), "rebuilt labels == model");
     }
 
+    CHECK(recency_matches(0) && recency_matches(150000) && recency_matches(199990) && recency_matches(~0ull),
+          "changed_since / relations_since pages == records and adjacency, several cut-offs");
+
     /* search: POSIX ERE over name/type/obs, full result set */
     {
         u64 *sb = malloc((size_t)NENT * sizeof(u64));
@@ -181,9 +731,214 @@ int main(void) {
         int model = 0; for (int i = 0; i < NENT; i++) if (ents[i].alive && (i % 16) == 3) model++;
         u32 s2 = graph_search(gr, "type-3", sb, NENT);
         CHECK((int)s2 == model, "search type-3 (type field) == model");
+        /* trigram-filtered search == brute-force regexec over the model strings */
+        static const char *pats[] = { "ent-1[0-9]", "^ent-(3|4)2$", "type-1[0-5]", "o-7-1", "(ent|type)-9",
+            "e.t-5", "o-[0-9]+-1$", "nt-2{2}", "[[:digit:]]{3}", "x|ent-1", "ty(pe)?-3", "(o-1)+-0",
+            "e(n|m)t-10?1", "ent-12\\>", "n[t]-3[^0]", "-39)?", "\\(ent" };
+        int tri_ok = 1, used = 0;
+        for (size_t p = 0; p < sizeof pats / sizeof pats[0]; p++) {
+            regex_t re; regcomp(&re, pats[p], REG_EXTENDED | REG_NOSUB);
+            int want = 0;
+            for (int i = 0; i < NENT; i++) {
+                if (!ents[i].alive) continue;
+                int hit = !regexec(&re, ents[i].name, 0, NULL, 0) || !regexec(&re, ents[i].type, 0, NULL, 0);
+                for (u32 k = 0; k < obsn[i] && !hit; k++) { char ob[32]; snprintf(ob, sizeof ob, "o-%d-%u", i, k); hit = !regexec(&re, ob, 0, NULL, 0); }
+                want += hit;
+            }
+            regfree(&re);
+            if (graph_search(gr, pats[p], sb, NENT) != (u32)want) { tri_ok = 0; printf("  mismatch: %s\n", pats[p]); }
+            used += graph_regex_indexable(pats[p]);
+        }
+        CHECK(tri_ok, "trigram-filtered search == brute-force regexec over 17 patterns");
+        /* reverse index: every live reference is held with its role, nothing else */
+        int rv_ok = 1;
+        for (int i = 0; i < NENT && rv_ok; i++) {
+            if (!ents[i].alive) continue;
+            u64 r[2];
+            u64 nid = st_find(st, (const u8 *)ents[i].name, (u16)strlen(ents[i].name));
+            if (graph_string_refs(gr, (u32)nid, r, 2) != 1 || r[0] != (ents[i].off | GRAPH_REF_NAME)) rv_ok = 0;
+            int want = 0;
+            for (int j = 0; j < NENT; j++) want += ents[j].alive && strcmp(ents[j].type, ents[i].type) == 0;
+            u64 *tr = malloc((size_t)NENT * sizeof(u64));
+            u64 tid = st_find(st, (const u8 *)ents[i].type, (u16)strlen(ents[i].type));
+            u32 tn = graph_string_refs(gr, (u32)tid, tr, NENT);
+            if ((int)tn != want) rv_ok = 0;
+            for (u32 k = 0; k < tn; k++) if ((tr[k] & GRAPH_REF_MASK) != GRAPH_REF_TYPE || (k && tr[k] <= tr[k - 1])) rv_ok = 0;
+            free(tr);
+            for (u32 k = 0; k < obsn[i]; k++) {
+                char ob[32]; int l = snprintf(ob, sizeof ob, "o-%d-%u", i, k);
+                u64 oid = st_find(st, (const u8 *)ob, (u16)l);
+                if (graph_string_refs(gr, (u32)oid, r, 2) != 1 || r[0] != (ents[i].off | GRAPH_REF_OBS)) rv_ok = 0;
+            }
+        }
+        CHECK(rv_ok, "reverse index: name/type/obs refs per string == model, ascending, role-tagged");
+        CHECK(used >= 12 && !graph_regex_indexable("e.t") && !graph_regex_indexable("[^a]+"), "most patterns yield trigrams; '.'/negated classes do not");
+        u32 s3 = graph_search_ex(gr, "^ENT-7$", GRAPH_SEARCH_ICASE, sb, NENT);
+        CHECK(s3 == s1 && graph_search(gr, "^ENT-7$", sb, NENT) == 0, "ICASE folds the pattern; default stays case-sensitive");
+        st_build_folds(gr->st);
+        CHECK(graph_search_ex(gr, "TYPE-[3]|[[:upper:]]{9}", GRAPH_SEARCH_ICASE, sb, NENT) == s2,
+              "ICASE over fold shadows == model");
+        CHECK(graph_search_ex(gr, "^[[:upper:]]{3}-7$", GRAPH_SEARCH_ICASE, sb, NENT) == s1
+              && graph_search_ex(gr, "^[^[:upper:]]{3}-7$", GRAPH_SEARCH_ICASE, sb, NENT) == 0
+              && graph_search_ex(gr, "^[[:lower:]]{3}-7$", GRAPH_SEARCH_ICASE, sb, NENT) == s1
+              && graph_search(gr, "^[[:upper:]]{3}-7$", sb, NENT) == 0,
+              "ICASE: [:upper:] matches either case, as under REG_ICASE");
+        /* bracket ranges keep their endpoints under ICASE: [0-Z] must not grow
+         * to [0-z] (taking [\]^_` along), nor [Z-a] invert to [z-a]. glibc's
+         * REG_ICASE rejects [Z-a] outright, so the counts are by hand: a byte
+         * matches when it or its other case lies in the range */
+        {
+            static const char *rn[] = { "Rng_x", "Rng`Q", "Rng[y", "RngZz", "Rng5a" };
+            static const char *rp[] = { "^rng[0-Z]", "^rng[Z-a]", "^RNG[]-a]", "^rng[^0-Z]", "^rng[a-z]" };
+            static const u32 want[] = { 2, 4, 2, 3, 1 };
+            u64 ro[5];
+            for (int i = 0; i < 5; i++) ro[i] = graph_create_entity(gr, (const u8 *)rn[i], 5, (const u8 *)"xt", 2, 1);
+            int rg_ok = 1;
+            for (int p = 0; p < 5; p++)
+                if (graph_search_ex(gr, rp[p], GRAPH_SEARCH_ICASE, sb, NENT) != want[p]) { rg_ok = 0; printf("  mismatch: %s\n", rp[p]); }
+            CHECK(rg_ok && graph_search(gr, "^Rng[0-Z]", sb, NENT) == 2 && graph_search(gr, "^Rng[Z-a]", sb, NENT) == 4,
+                  "ICASE: bracket ranges keep their span and add the other case ([0-Z], [Z-a], []-a])");
+            for (int i = 0; i < 5; i++) graph_delete_entity(gr, ro[i]);
+        }
         free(sb);
     }
 
+    /* full-text: BM25 top-k == brute-force model over the live entities' text */
+    {
+        char **docs = malloc(NENT * sizeof(char *));
+        u64 offs[NENT];
+        u32 n = fuzz_docs(docs, offs);
+        static const char *qs[] = { "ent 7", "o 1", "12 0", "ENT-3 o-3-1", "ent", "zzz", "5 5 5", "o 0 1 2 3 4 5 6 7 8 9" };
+        int ok = 1;
+        for (size_t q = 0; q < sizeof qs / sizeof qs[0]; q++) {
+            ok &= text_matches_model(qs[q], 10, docs, offs, n);
+            ok &= text_matches_model(qs[q], NENT, docs, offs, n);
+        }
+        CHECK(ok, "text search == brute-force BM25 top-k (k = 10 and all), case-folded query");
+        for (u32 i = 0; i < n; i++) free(docs[i]);
+        free(docs);
+    }
+
+    /* fuzzy names: index candidates + verification == brute force over the live entities */
+    {
+        CHECK(fz_distance((const u8 *)"kitten", 6, (const u8 *)"sitting", 7, 5) == 3
+              && fz_distance((const u8 *)"abcd", 4, (const u8 *)"acbd", 4, 2) == 1
+              && fz_distance((const u8 *)"caf\xc3\xa9", 5, (const u8 *)"cafe", 4, 2) == 1
+              && fz_distance((const u8 *)"", 0, (const u8 *)"abc", 3, 2) == 3,
+              "fz_distance: OSA over code points, cut off past maxd");
+        int ok = 1;
+        char q[40];
+        for (int t = 0; t < 300 && ok; t++) {
+            int i = pick_alive(); if (i < 0) break;
+            typo(ents[i].name, q);
+            ok = fuzzy_matches_model(q, 1, 5) && fuzzy_matches_model(q, 2, 5) && fuzzy_matches_model(q, 2, NENT);
+        }
+        ok = ok && fuzzy_matches_model("", 2, NENT) && fuzzy_matches_model("zzzzzzzz", 2, NENT);
+        CHECK(ok, "fuzzy lookup == brute-force edit distance (maxd 1 and 2, top 5 and all), case-folded");
+    }
+
+    /* near duplicates: band candidates + sketch estimates == the sketch of every
+     * live doc; clusters == components of the pairs over the threshold */
+    {
+        char **docs = malloc(NENT * sizeof(char *));
+        u64 offs[NENT];
+        u32 n = fuzz_docs(docs, offs), sa[MH_HASHES], sb[MH_HASHES];
+        mh_sketch((const u8 *)"", 0, sa);
+        mh_sketch((const u8 *)"abcdefgh", 8, sb);
+        u32 agree = 0;
+        for (u32 h = 0; h < MH_HASHES; h++) agree += sa[h] == sb[h];
+        doc_sketch("ABCDEFGH", sa);
+        CHECK(agree < MH_HASHES / 4 && mh_similarity(sa, sb) == 1.0, "sketches: distinct texts disagree, case folds away");
+        int ok = 1;
+        char q[80];
+        for (int t = 0; t < 150 && ok; t++) {
+            typo(docs[xs() % n], q);
+            ok = dups_match_model(q, 0.8, 5, docs, offs, n) && dups_match_model(q, 0.9, NENT, docs, offs, n)
+              && dups_match_model(q, 0.4, NENT, docs, offs, n);
+        }
+        CHECK(ok, "near duplicates == sketch model (exact top-k above the band bound, no false hits below it)");
+        CHECK(clusters_match_model(0.8, docs, offs, n) && clusters_match_model(0.95, docs, offs, n),
+              "duplicate clusters == components of the pairs at >= min");
+        int i = 0;
+        while (i < NENT && !(ents[i].alive && obsn[i] == 2)) i++;
+        if (i < NENT) {
+            char ob[24], d1[64], d2[64];
+            int l = snprintf(ob, sizeof ob, "o-%d-1", i);
+            snprintf(d1, sizeof d1, "%s o-%d-0", ents[i].name, i);
+            snprintf(d2, sizeof d2, "%s o-%d-0 o-%d-1", ents[i].name, i, i);
+            u64 o[2]; double sm[2];
+            graph_remove_observation(gr, ents[i].off, (const u8 *)ob, (u16)l, 7);
+            ok = graph_near_duplicates(gr, (const u8 *)d1, (u32)strlen(d1), 1.0, 2, o, sm) == 1 && o[0] == ents[i].off
+              && graph_near_duplicates(gr, (const u8 *)d2, (u32)strlen(d2), 1.0, 2, o, sm) == 0;
+            graph_add_observation(gr, ents[i].off, (const u8 *)ob, (u16)l, 8);
+            ok = ok && graph_near_duplicates(gr, (const u8 *)d2, (u32)strlen(d2), 1.0, 2, o, sm) == 1 && o[0] == ents[i].off
+              && graph_near_duplicates(gr, (const u8 *)d1, (u32)strlen(d1), 1.0, 2, o, sm) == 0;
+            CHECK(ok && clusters_match_model(0.8, docs, offs, n), "observation changes re-sketch the entity");
+        }
+        for (u32 k = 0; k < n; k++) free(docs[k]);
+        free(docs);
+    }
+
+    /* name order: case variants fold together (raw bytes break the tie), long
+     * shared prefixes go past the tree key, non-ASCII folds too */
+    {
+        static const char *extra[] = { "Ent-7x", "ENT-7X", "ent-7x", "ent-7",
+                                       "a-very-long-shared-prefix-1", "a-very-long-shared-prefix-2", "A-VERY-LONG-shared",
+                                       "\xc3\x89" "clair", "\xc3\xa9" "clair-2", "eclair", "" };
+        enum { NX = sizeof extra / sizeof extra[0] };
+        u64 xo[NX];
+        for (u32 i = 0; i < NX; i++) xo[i] = graph_create_entity(gr, (const u8 *)extra[i], (u16)strlen(extra[i]), (const u8 *)"xt", 2, 1);
+        static const char *pf[] = { "", "ent-", "ENT-1", "ent-7", "ent-7x", "a-very-long-shared-prefix", "A-VERY-LONG-SHARED-PREFIX-2",
+                                    "\xc3\xa9", "\xc3\x89" "CLAIR-", "ent-9999", "zzz", "e" };
+        CHECK(names_match_model(pf, sizeof pf / sizeof pf[0]), "name order == model: both directions, prefix ranges, rank seeks");
+        for (u32 i = 0; i < NX; i++) if (!(ents[7].alive && xo[i] == ents[7].off)) graph_delete_entity(gr, xo[i]);
+        CHECK(validate() == 0, "name order follows deletes");
+    }
+
+    /* entity vectors: created on demand with a fixed dim and format; searches
+     * == cosine over the live entities; a deleted entity takes its vector along */
+    {
+        u32 dim, fmt, cnt, nv = 0, hits = 0, typed = 0;
+        float v[VDIM], z[VDIM] = { 0 };
+        int live = pick_alive(), ok = 1;
+        CHECK(!graph_vector_info(gr, &dim, &fmt, &cnt) && (live < 0 || !graph_set_vector(gr, ents[live].off, z, VDIM)),
+              "no vector index until one is made");
+        CHECK(graph_vector_index(gr, VDIM, GRAPH_VEC_F32) && graph_vector_index(gr, VDIM, GRAPH_VEC_F32)
+              && !graph_vector_index(gr, VDIM + 1, GRAPH_VEC_F32) && !graph_vector_index(gr, VDIM, GRAPH_VEC_I8),
+              "vector index made once; its dim and format are then fixed");
+        for (int i = 0; i < NENT; i++) {
+            if (!ents[i].alive) continue;
+            ent_vector(i, v);
+            ok = ok && graph_set_vector(gr, ents[i].off, v, VDIM) && !graph_set_vector(gr, ents[i].off, v, VDIM - 1);
+            nv++;
+        }
+        ok = ok && (live < 0 || (!graph_set_vector(gr, ents[live].off, z, VDIM) && graph_get_vector(gr, ents[live].off, v)));
+        CHECK(ok && graph_vector_info(gr, &dim, &fmt, &cnt) && dim == VDIM && fmt == GRAPH_VEC_F32 && cnt == nv,
+              "a vector per live entity; zero vectors and other dims refused");
+        for (int t = 0; t < 60 && ok; t++) {
+            float q[VDIM];
+            char ty[16];
+            for (u32 d = 0; d < VDIM; d++) q[d] = (float)(xs() % 1000) / 1000.0f - 0.5f + (d == (u32)t % 8 ? 1.0f : 0.0f);
+            snprintf(ty, sizeof ty, "type-%d", (int)(xs() % 17));      /* type-16 has no entities */
+            ok = vectors_match_model(q, 10, NULL, &hits) && vectors_match_model(q, 5, ty, &typed);
+        }
+        u32 nq = 60 * (nv < 10 ? nv : 10);
+        printf("  vector recall@10: %u/%u\n", hits, nq);
+        CHECK(ok && hits * 10 >= nq * 9, "vector search == cosine model (exact with a type, 9 in 10 of the top 10 without)");
+
+        /* delete: the vector goes with the entity */
+        ent_vector(0, v);
+        u64 x = graph_create_entity(gr, (const u8 *)"vec-x", 5, (const u8 *)"xt", 2, 1), o[2];
+        double sm[2];
+        ok = graph_set_vector(gr, x, v, VDIM) && graph_vector_search(gr, v, VDIM, (const u8 *)"xt", 2, 2, o, sm) == 1
+          && o[0] == x && sm[0] > 0.9999;
+        graph_delete_entity(gr, x);
+        ok = ok && graph_vector_info(gr, &dim, &fmt, &cnt) && cnt == nv
+          && graph_vector_search(gr, v, VDIM, (const u8 *)"xt", 2, 2, o, sm) == 0
+          && graph_vector_search(gr, v, VDIM, NULL, 0, 2, o, sm) == 2 && o[0] != x && o[1] != x;
+        CHECK(ok, "deleting an entity drops its vector");
+    }
+
     /* ranking: structural sampling, MERW psi, random walk, walker counting */
     {
         graph_seed_rng(12345);
@@ -209,6 +964,77 @@ int main(void) {
             u32 pl = graph_random_walk(gr, ents[rels[0].from].off, 5, DIR_FORWARD, 1, 999, path, 16);
             CHECK(pl >= 1 && pl <= 6 && path[0] == ents[rels[0].from].off, "random_walk: valid path (start + <=depth steps)");
         }
+
+        /* split ranking: compute reads only; with the same seed it samples what
+         * the in-place pass does, and apply skips entities deleted meanwhile */
+        graph_rank_t r;
+        u64 st0 = graph_structural_total(gr);
+        CHECK(graph_rank_snapshot(gr, &r) && graph_rank_compute(&r, 1, 0.85, 0.85, 200, 1e-8, 4242) && r.n == graph_entity_count(gr)
+              && r.total > 0 && graph_structural_total(gr) == st0, "rank compute leaves the graph untouched");
+        u64 *sv0 = malloc((size_t)r.n * 8);
+        for (u32 i = 0; i < r.n; i++) { entity_t e; graph_read_entity(gr, r.offs[i], &e); sv0[i] = e.structural_visits; }
+        graph_seed_rng(4242);
+        int same = graph_structural_sample(gr, 1, 0.85) == r.total;
+        graph_compute_merw_psi(gr, 0.85, 200, 1e-8);
+        for (u32 i = 0; i < r.n; i++) {
+            entity_t e; graph_read_entity(gr, r.offs[i], &e);
+            same = same && e.structural_visits - sv0[i] == r.visits[i] && e.psi == r.psi[i];
+        }
+        CHECK(same, "rank compute == structural sample + MERW in place, for the same seed");
+        u32 gone = 0;
+        while (gone < r.n && !r.visits[gone]) gone++;
+        if (gone < r.n) {
+            int gi = ent_at(r.offs[gone]);
+            rel_drop_incident(gi);
+            graph_delete_entity(gr, r.offs[gone]);
+            ents[gi].alive = 0; obsn[gi] = 0;
+            u64 fresh = graph_create_entity(gr, (const u8 *)"rank-reuse", 10, (const u8 *)"t", 1, 1);
+            st0 = graph_structural_total(gr);
+            graph_rank_apply(gr, &r);
+            int ok = graph_structural_total(gr) == st0 + r.total - r.visits[gone];
+            for (u32 i = 0; i < r.n; i++) if (i != gone) {
+                entity_t e; graph_read_entity(gr, r.offs[i], &e);
+                ok = ok && e.structural_visits - sv0[i] == 2 * (u64)r.visits[i];
+            }
+            CHECK(ok, "rank apply adds the sampled visits to live entities only");
+            entity_t fe; graph_read_entity(gr, fresh, &fe);
+            CHECK(fresh == r.offs[gone] && fe.structural_visits == 0 && fe.psi == 0.0,
+                  "rank apply skips a record reused by a new entity since the snapshot");
+            graph_delete_entity(gr, fresh);
+        }
+        free(sv0);
+        graph_rank_free(&r);
+    }
+
+    /* reverse index: duplicate observations hold one ref each; removal drops one */
+    {
+        u64 a = graph_create_entity(gr, (const u8 *)"dup", 3, (const u8 *)"dup-type", 8, 1), r[4];
+        graph_add_observation(gr, a, (const u8 *)"same note", 9, 2);
+        graph_add_observation(gr, a, (const u8 *)"same note", 9, 3);
+        u32 oid = (u32)st_find(st, (const u8 *)"same note", 9);
+        CHECK(graph_string_refs(gr, oid, r, 4) == 2 && r[0] == (a | GRAPH_REF_OBS) && r[1] == r[0], "two equal observations -> two obs refs");
+        u64 sb[4];
+        CHECK(graph_search(gr, "same note", sb, 4) == 1 && sb[0] == a, "string-first search reports the entity once");
+        graph_remove_observation(gr, a, (const u8 *)"same note", 9, 4);
+        CHECK(graph_string_refs(gr, oid, r, 4) == 1, "removing one observation drops one ref");
+        graph_delete_entity(gr, a);
+        CHECK(graph_string_refs(gr, oid, r, 4) == 0, "deleting the entity drops the rest");
+    }
+
+    /* v2 records: short name/type inline, long ones overflow to the string table */
+    {
+        char lname[64]; memset(lname, 'n', 40); lname[40] = 0;
+        u64 a = graph_create_entity(gr, (const u8 *)"inl", 3, (const u8 *)"t", 1, 1);
+        u64 b = graph_create_entity(gr, (const u8 *)lname, 40, (const u8 *)"a-rather-long-type-name", 23, 1);
+        u16 l1, l2, l3, l4;
+        const u8 *p1 = graph_entity_name(gr, a, &l1), *p2 = graph_entity_type(gr, a, &l2);
+        CHECK(l1 == 3 && memcmp(p1, "inl", 3) == 0 && l2 == 1 && p2[0] == 't', "inline name/type read back");
+        CHECK((uintptr_t)p1 >= (uintptr_t)gr->mf->mmap_base && (uintptr_t)p1 < (uintptr_t)gr->mf->mmap_base + gr->mf->mmap_size,
+              "short name served from the entity record (no string-table hop)");
+        const u8 *p3 = graph_entity_name(gr, b, &l3), *p4 = graph_entity_type(gr, b, &l4);
+        CHECK(l3 == 40 && memcmp(p3, lname, 40) == 0 && l4 == 23 && memcmp(p4, "a-rather-long-type-name", 23) == 0,
+              "overflow name/type read via string id");
+        graph_delete_entity(gr, a); graph_delete_entity(gr, b);
     }
 
     /* validate_graph: obs limits + dangling edges */
@@ -226,6 +1052,261 @@ int main(void) {
         free(vo); free(vc); free(vov); free(ds); free(dt);
     }
 
+    /* partitioned scans: a graph big enough to split, scanned serially and on
+     * 4 workers — same totals, same entities, same order, truncation included */
+    {
+        enum { NB = 3 * 4096 + 123, CAP = NB + 8 };
+        u64 *bo = malloc((size_t)NB * 8);
+        char nm[32], ty[16], ob[160];
+        for (int i = 0; i < NB; i++) {
+            int nl = snprintf(nm, sizeof nm, "bulk-%d", i), tl = snprintf(ty, sizeof ty, "btype-%d", i % 7);
+            bo[i] = graph_create_entity(gr, (const u8 *)nm, (u16)nl, (const u8 *)ty, (u16)tl, 1000);
+            if (i % 3 == 0) { int ol = snprintf(ob, sizeof ob, "note %d on bulk", i); graph_add_observation(gr, bo[i], (const u8 *)ob, (u16)ol, 1000); }
+            if (i % 997 == 0) { memset(ob, 'y', 150); graph_add_observation(gr, bo[i], (const u8 *)ob, 150, 1000); }
+            if (i % 5 == 0 && i) graph_create_relation(gr, bo[i - 1], bo[i], (const u8 *)"bulk-rel", 8, 1000);
+        }
+        u64 *a = malloc((size_t)CAP * 8), *b = malloc((size_t)CAP * 8);
+        u64 *a2 = malloc((size_t)CAP * 8), *b2 = malloc((size_t)CAP * 8);
+        u8 *ac = malloc(CAP), *bc = malloc(CAP), *av = malloc(CAP), *bv = malloc(CAP);
+        static const char *pats[] = { "bulk-1[0-9]*7$", "note [0-9]+5 on", "btype-3", "^bulk-(12|40)", ".*", "e.t" };
+        int same = 1, trunc = 1;
+        u32 na, nb;
+        for (int pass = 0; pass < 3; pass++) {
+            u32 max = pass == 2 ? 100 : CAP;   /* last pass: results cut short at max */
+            for (size_t p = 0; p < sizeof pats / sizeof pats[0]; p++)
+                for (u32 fl = 0; fl <= GRAPH_SEARCH_ICASE; fl += GRAPH_SEARCH_ICASE) {
+                    pool_set_workers(1); na = graph_search_ex(gr, pats[p], fl, a, max);
+                    pool_set_workers(4); nb = graph_search_ex(gr, pats[p], fl, b, max);
+                    if (na != nb || memcmp(a, b, (size_t)(na < max ? na : max) * 8)) { same = 0; printf("  differs: search %s\n", pats[p]); }
+                }
+            pool_set_workers(1); na = graph_entities_by_type(gr, (const u8 *)"btype-2", 7, a, max);
+            pool_set_workers(4); nb = graph_entities_by_type(gr, (const u8 *)"btype-2", 7, b, max);
+            if (na != nb || na != NB / 7 + (NB % 7 > 2) || memcmp(a, b, (size_t)(na < max ? na : max) * 8)) { same = 0; printf("  differs: by_type\n"); }
+            pool_set_workers(1); na = graph_orphaned(gr, a, max);
+            pool_set_workers(4); nb = graph_orphaned(gr, b, max);
+            if (na != nb || memcmp(a, b, (size_t)(na < max ? na : max) * 8)) { same = 0; printf("  differs: orphaned\n"); }
+            pool_set_workers(1); na = graph_validate_obs(gr, a, ac, av, max);
+            pool_set_workers(4); nb = graph_validate_obs(gr, b, bc, bv, max);
+            u32 k = na < max ? na : max;
+            if (na != nb || na != NB / 997 + 1 || memcmp(a, b, (size_t)k * 8) || memcmp(ac, bc, k) || memcmp(av, bv, k)) { same = 0; printf("  differs: validate_obs\n"); }
+            pool_set_workers(1); na = graph_validate_dangling(gr, a, a2, max);
+            pool_set_workers(4); nb = graph_validate_dangling(gr, b, b2, max);
+            if (na != nb || na != 0) { same = 0; printf("  differs: validate_dangling\n"); }
+            if (pass == 2) trunc = graph_search(gr, ".*", a, max) == graph_entity_count(gr);
+        }
+        pool_set_workers(0);
+        {   /* text postings long enough to span many compressed blocks */
+            char **docs = malloc((size_t)(NB + NENT) * sizeof(char *));
+            u64 *offs = malloc((size_t)(NB + NENT) * 8);
+            u32 n = fuzz_docs(docs, offs);       /* the fuzz entities count toward N and avgdl too */
+            for (int i = 0; i < NB; i++, n++) {
+                docs[n] = malloc(200);
+                int l = snprintf(docs[n], 200, "bulk-%d", i);
+                if (i % 3 == 0) l += snprintf(docs[n] + l, 200 - l, " note %d on bulk", i);
+                if (i % 997 == 0) { docs[n][l++] = ' '; memset(docs[n] + l, 'y', 150); docs[n][l + 150] = 0; }
+                offs[n] = bo[i];
+            }
+            int ok = text_matches_model("note 1200 bulk", 20, docs, offs, n) && text_matches_model("on 99", 50, docs, offs, n)
+                  && text_matches_model("yyyy bulk", 5, docs, offs, n);
+            CHECK(ok, "text search over multi-block postings == brute-force BM25");
+            for (u32 i = 0; i < n; i++) free(docs[i]);
+            free(docs); free(offs);
+        }
+        {   /* fuzzy: names longer than the key prefix, edits in the unkeyed tail too */
+            int ok = 1;
+            char nm2[32], q[40];
+            for (int t = 0; t < 200 && ok; t++) {
+                snprintf(nm2, sizeof nm2, "bulk-%d", (int)(xs() % NB));
+                typo(nm2, q);
+                ok = fuzzy_matches_model(q, 2, 10) && fuzzy_matches_model(q, 1, CAP);
+            }
+            CHECK(ok, "fuzzy lookup over long names == brute force");
+        }
+        {   /* duplicate clusters over buckets past the window: well formed, and each
+             * cluster is chained together by pairs at >= min */
+            u32 *cl = malloc((size_t)CAP * 4), *sg = malloc((size_t)CAP * MH_HASHES * 4), *p = malloc((size_t)CAP * 4);
+            u32 n = graph_duplicate_clusters(gr, 0.75, a, cl, CAP), clusters = 0;
+            int ok = n <= CAP && (!n || cl[0] == 0);
+            for (u32 i = 0; i < n && ok; i++) {
+                char doc[512];
+                entity_doc(a[i], doc);
+                doc_sketch(doc, sg + (size_t)i * MH_HASHES);
+                p[i] = i;
+                if (i && cl[i] == cl[i - 1]) ok = a[i] > a[i - 1];
+                else if (i) ok = cl[i] == cl[i - 1] + 1 && a[i] > a[b[clusters - 1]];
+                if (!i || cl[i] != cl[i - 1]) b[clusters++] = i;    /* first member of each cluster */
+            }
+            for (u32 c = 0; c < clusters && ok; c++) {
+                u32 lo = (u32)b[c], hi = c + 1 < clusters ? (u32)b[c + 1] : n;
+                for (u32 x = lo; x < hi; x++)
+                    for (u32 y = x + 1; y < hi; y++)
+                        if (mh_similarity(sg + (size_t)x * MH_HASHES, sg + (size_t)y * MH_HASHES) >= 0.75) {
+                            u32 rx = uf_root(p, x), ry = uf_root(p, y);
+                            if (rx != ry) p[rx > ry ? rx : ry] = rx < ry ? rx : ry;
+                        }
+                for (u32 x = lo; x < hi; x++) if (uf_root(p, x) != lo) ok = 0;
+            }
+            printf("  clusters: %u entities in %u\n", n, clusters);
+            CHECK(ok && clusters > 1, "duplicate clusters over big buckets: grouped by least offset, each chained by similar pairs");
+            free(cl); free(sg); free(p);
+        }
+        CHECK(same, "partitioned scans == serial scans (search, by_type, orphaned, validate), in order");
+        CHECK(trunc, "a truncated scan still reports the full total");
+
+        /* paged search: pages joined back together == the full result, in
+         * node-log order (unranked) or rank order (ranked), last next == 0 */
+        {
+            u32 nall = graph_search(gr, "btype-[35]", a, CAP);
+            qsort(a, nall, 8, cmp_u64t);
+            u32 nl = graph_entity_count(gr), ne = 0;
+            u64 *lg = malloc((size_t)nl * 8);
+            graph_list_entities(gr, lg, nl);
+            for (u32 i = 0; i < nl; i++) if (bsearch(&lg[i], a, nall, 8, cmp_u64t)) b[ne++] = lg[i];
+            u32 cur = 0, got = 0, nx, tot, pages = 0;
+            int ok = 1;
+            do {
+                u32 n = graph_search_page(gr, "btype-[35]", 0, GRAPH_RANK_NONE, cur, 37, a2, &nx, &tot);
+                if (n > 37 || got + n > ne || memcmp(a2, b + got, (size_t)n * 8)) ok = 0;
+                got += n; cur = nx; pages++;
+            } while (cur && ok && pages < 1000);
+            CHECK(ok && got == ne, "unranked pages resume at the node-log cursor and join to the full result");
+
+            for (int i = 0; i < NB; i += 3) for (int v = 0; v < i % 11; v++) graph_inc_walker_visit(gr, bo[i]);
+            for (int i = 0; i < NB; i += 2) for (int v = 0; v < i % 4; v++) graph_inc_structural_visit(gr, bo[i]);
+            nall = graph_search(gr, "bulk-", a, CAP);
+            for (u32 i = 1; i < nall; i++) {     /* insertion sort: walker desc, structural desc, offset asc */
+                u64 x = a[i]; u32 j = i;
+                while (j > 0) {
+                    double wx = graph_walker_rank(gr, x), wy = graph_walker_rank(gr, a[j - 1]);
+                    double sx = graph_structural_rank(gr, x), sy = graph_structural_rank(gr, a[j - 1]);
+                    if (!(wx > wy || (wx == wy && (sx > sy || (sx == sy && x < a[j - 1]))))) break;
+                    a[j] = a[j - 1]; j--;
+                }
+                a[j] = x;
+            }
+            cur = 0; got = 0; ok = 1; pages = 0;
+            do {
+                u32 n = graph_search_page(gr, "bulk-", 0, GRAPH_RANK_WALKER, cur, 500, a2, &nx, &tot);
+                if (tot != nall || got + n > nall || memcmp(a2, a + got, (size_t)n * 8)) ok = 0;
+                got += n; cur = nx; pages++;
+            } while (cur && ok && pages < 1000);
+            CHECK(ok && got == nall && pages == (nall + 499) / 500, "ranked pages (llmrank) == full sort, cut at the cursor");
+            u32 ns = graph_search(gr, "bulk-", a2, CAP);
+            CHECK(ns == nall && graph_rank_sort(gr, a2, ns, GRAPH_RANK_WALKER) && !memcmp(a2, a, (size_t)ns * 8),
+                  "rank_sort (llmrank) over the matches == full sort");
+            u32 n = graph_search_page(gr, "bulk-", 0, GRAPH_RANK_MTIME | GRAPH_RANK_ASC, nall - 3, 10, a2, &nx, &tot);
+            CHECK(n == 3 && nx == 0 && tot == nall, "a short last page reports no next cursor");
+            CHECK(graph_search_page(gr, "bulk-", 0, GRAPH_RANK_WALKER, nall, 10, a2, &nx, &tot) == 0 && nx == 0,
+                  "a cursor past the end yields an empty page");
+            /* the _ex pages hand back the pass's whole match set, in search order */
+            {
+                u64 *mm = NULL, *mu = NULL;
+                u32 t2, t3, nx2;
+                u32 n1 = graph_search_page(gr, "bulk-", 0, GRAPH_RANK_WALKER, 3, 10, b2, &nx, &tot);
+                u32 n2 = graph_search_page_ex(gr, "bulk-", 0, GRAPH_RANK_WALKER, 3, 10, a2, &nx2, &t2, &mm);
+                u32 n3 = graph_search_page_ex(gr, "bulk-", 0, GRAPH_RANK_NONE, 0, 10, a2 + 10, &nx2, &t3, &mu);
+                u32 ns2 = graph_search(gr, "bulk-", b, CAP);
+                CHECK(mm && mu && n1 == n2 && !memcmp(a2, b2, (size_t)n1 * 8) && t2 == ns2 && t3 == ns2 &&
+                      n3 == 10 && !memcmp(mm, b, (size_t)ns2 * 8) && !memcmp(mu, b, (size_t)ns2 * 8),
+                      "search_page_ex: same page, every match from the same pass");
+                free(mm); free(mu);
+            }
+            static const char *pf[] = { "bulk-12", "BULK-1", "bulk-99999", "bulk-", "" };
+            CHECK(names_match_model(pf, sizeof pf / sizeof pf[0]), "name order over a multi-level tree == model");
+            /* name-ordered pages: the matches in name order, either direction */
+            qsort(lg, nl, 8, cmp_name_model);
+            for (int asc = 0; asc <= 1; asc++) {
+                nall = graph_search(gr, "btype-[35]", a, CAP);
+                qsort(a, nall, 8, cmp_u64t);
+                ne = 0;
+                for (u32 i = 0; i < nl; i++) {
+                    u64 x = lg[asc ? i : nl - 1 - i];
+                    if (bsearch(&x, a, nall, 8, cmp_u64t)) b[ne++] = x;
+                }
+                cur = 0; got = 0; ok = 1; pages = 0;
+                do {
+                    u32 m = graph_search_page(gr, "btype-[35]", 0, GRAPH_RANK_NAME | (asc ? GRAPH_RANK_ASC : 0), cur, 250, a2, &nx, &tot);
+                    if (tot != ne || got + m > ne || memcmp(a2, b + got, (size_t)m * 8)) ok = 0;
+                    got += m; cur = nx; pages++;
+                } while (cur && ok && pages < 1000);
+                CHECK(ok && got == ne, asc ? "name-ordered pages (asc) == matches in name order" : "name-ordered pages (desc) == matches in name order");
+                memcpy(a2, a, (size_t)nall * 8);
+                CHECK(graph_rank_sort(gr, a2, nall, GRAPH_RANK_NAME | (asc ? GRAPH_RANK_ASC : 0)) && nall == ne && !memcmp(a2, b, (size_t)ne * 8),
+                      "rank_sort by name == matches in name order");
+            }
+            free(lg);
+        }
+        for (int i = 0; i < NB; i++) graph_delete_entity(gr, bo[i]);
+        free(bo); free(a); free(b); free(a2); free(b2); free(ac); free(bc); free(av); free(bv);
+    }
+
+    /* long names sharing a packed observation's entry decode through st_get's
+     * 4-slot ring; sorting more of them than that must still order the text.
+     * Triples fold alike (OB/Ob/oB), so the raw bytes decide, and a slot
+     * reused by a later name would reorder them; lengths grow so a slot also
+     * gets reallocated once its buffer is outgrown (a use-after-free). */
+    {
+        enum { NP = 12 };
+        static const char *const lead[3] = { "OB", "Ob", "oB" };
+        char txt[NP][512], pad[401];
+        memset(pad, 'x', 400); pad[400] = 0;
+        u64 car[NP], named[NP], sorted[NP], want[NP];
+        for (int i = 0; i < NP; i++) {
+            snprintf(txt[i], sizeof txt[i], "%sservation shared with a long entity name %.*s", lead[i % 3],
+                     60 * (i / 3) + 1, pad);
+            char cn[16]; int cl = snprintf(cn, sizeof cn, "carrier-%d", i);
+            car[i] = graph_create_entity(gr, (const u8 *)cn, (u16)cl, (const u8 *)"t", 1, 1);
+            graph_add_observation(gr, car[i], (const u8 *)txt[i], (u16)strlen(txt[i]), 1);
+        }
+        graph_compress_observations(gr);
+        int shared = 1;
+        for (int i = 0; i < NP; i++) {
+            named[i] = graph_create_entity(gr, (const u8 *)txt[i], (u16)strlen(txt[i]), (const u8 *)"t", 1, 1);
+            entity_t a, b;
+            graph_read_entity(gr, car[i], &a); graph_read_entity(gr, named[i], &b);
+            shared &= a.obs0_id == b.name_id && st_is_packed(st, b.name_id);
+        }
+        memcpy(sorted, named, sizeof sorted); memcpy(want, named, sizeof want);
+        qsort(want, NP, 8, cmp_name_model);
+        int ok = graph_rank_sort(gr, sorted, NP, GRAPH_RANK_NAME | GRAPH_RANK_ASC) && !memcmp(sorted, want, sizeof want);
+        CHECK(shared && ok, "rank_sort by name: long names decoded from packed entries sort by their text");
+        for (int i = 0; i < NP; i++) { graph_delete_entity(gr, named[i]); graph_delete_entity(gr, car[i]); }
+    }
+
+    /* JSON pages: JSON.stringify's escapes and key order, the budget in UTF-16 units */
+    {
+        const char *nm = "q\"b\\s\n\x01", *ob = "\xc3\xa9 \xf0\x9f\x98\x80";
+        u64 e = graph_create_entity(gr, (const u8 *)nm, (u16)strlen(nm), (const u8 *)"t", 1, 5);
+        graph_add_observation(gr, e, (const u8 *)ob, (u16)strlen(ob), 6);
+        u32 nx; size_t len;
+        char *js = graph_json_page(gr, &e, 1, 0, 4096, &nx, &len);
+        const char *want = "{\"items\":[{\"name\":\"q\\\"b\\\\s\\n\\u0001\",\"entityType\":\"t\",\"observations\":[\"\xc3\xa9 \xf0\x9f\x98\x80\"],"
+                           "\"mtime\":6,\"obsMtime\":6}],\"nextCursor\":null,\"totalCount\":1}";
+        CHECK(js && len == strlen(want) && !strcmp(js, want) && nx == 0, "json_page: an entity as JSON.stringify writes it");
+        free(js);
+        graph_delete_entity(gr, e);
+
+        static const char *nb[] = { "ab", "cd", "\xf0\x9f\x98\x80x" };   /* items of 58, 58 and 59 units; wrapper 45 */
+        u64 o[3];
+        for (int i = 0; i < 3; i++) o[i] = graph_create_entity(gr, (const u8 *)nb[i], (u16)strlen(nb[i]), (const u8 *)"t", 1, 7);
+        int ok = 1;
+        js = graph_json_page(gr, o, 3, 0, 162, &nx, &len);
+        ok &= js && nx == 2 && !strcmp(js, "{\"items\":[{\"name\":\"ab\",\"entityType\":\"t\",\"observations\":[],\"mtime\":7},"
+                                           "{\"name\":\"cd\",\"entityType\":\"t\",\"observations\":[],\"mtime\":7}],\"nextCursor\":2,\"totalCount\":3}");
+        free(js);
+        js = graph_json_page(gr, o, 3, 1, 163, &nx, &len);   /* fits only counted in UTF-16 units */
+        ok &= js && nx == 0;
+        free(js);
+        js = graph_json_page(gr, o, 3, 0, 50, &nx, &len);    /* over budget: the first item alone */
+        ok &= js && nx == 1 && !strcmp(js, "{\"items\":[{\"name\":\"ab\",\"entityType\":\"t\",\"observations\":[],\"mtime\":7}],\"nextCursor\":1,\"totalCount\":3}");
+        free(js);
+        js = graph_json_page(gr, o, 3, 3, 4096, &nx, &len);
+        ok &= js && nx == 0 && !strcmp(js, "{\"items\":[],\"nextCursor\":null,\"totalCount\":3}");
+        free(js);
+        CHECK(ok, "json_page: cut at the budget as paginateItems cuts, oversized first item alone, past the end empty");
+        for (int i = 0; i < 3; i++) graph_delete_entity(gr, o[i]);
+    }
+
     /* teardown: delete all relations, then all entities -> string table must empty */
     while (nrel > 0) {
         Rel rr = rels[nrel - 1]; rtname(rr.rt, rb);
@@ -236,6 +1317,36 @@ int main(void) {
 
     CHECK(graph_entity_count(gr) == 0, "all entities deleted");
     CHECK(st_count(st) == 0, "string table empty after teardown (no name/type/relType/observation leak)");
+    {
+        u32 *c = NULL, cn = 1;
+        CHECK(st_trigram_candidates(st, "ent-", &c, &cn) == 1 && cn == 0, "trigram postings empty after teardown");
+        free(c);
+    }
+    {
+        u64 o[4]; double sc[4];
+        CHECK(graph_text_search(gr, (const u8 *)"ent o note bulk same dup", 24, 4, o, sc) == 0, "text index empty after teardown");
+    }
+    {
+        u64 o[4]; u32 d[4];
+        CHECK(graph_fuzzy_lookup(gr, (const u8 *)"ent-1", 5, 2, 4, o, d) == 0
+              && graph_fuzzy_lookup(gr, (const u8 *)"bulk-10", 7, 2, 4, o, d) == 0, "fuzzy index empty after teardown");
+    }
+    {
+        u64 o[2]; u32 f;
+        CHECK(graph_names_at(gr, 0, 2, 0, o) == 0 && graph_name_prefix(gr, (const u8 *)"", 0, &f) == 0, "name order empty after teardown");
+    }
+    {
+        u64 o[2]; u32 c[2]; double sm[2];
+        CHECK(graph_near_duplicates(gr, (const u8 *)"ent-1", 5, 0.0, 2, o, sm) == 0
+              && graph_duplicate_clusters(gr, 0.0, o, c, 2) == 0, "near-duplicate index empty after teardown");
+    }
+    {
+        u32 dim, fmt, cnt;
+        u64 o[2]; double sm[2]; float q[VDIM];
+        ent_vector(1, q);
+        CHECK(graph_vector_info(gr, &dim, &fmt, &cnt) && cnt == 0 && graph_vector_search(gr, q, VDIM, NULL, 0, 2, o, sm) == 0,
+              "vector index empty after teardown");
+    }
     printf("  final strings=%u entity_count=%u\n", st_count(st), graph_entity_count(gr));
 
     graph_close(gr);
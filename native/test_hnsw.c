@@ -0,0 +1,184 @@
+/*
+ * hnsw.c validation, per storage format: recall of the graph search against
+ * an exact scan, the distance kernels (SIMD body and scalar tail) against
+ * float math, stored vectors round-tripping within the format's error, and
+ * removal — dead nodes never returned, consolidation keeping the structure
+ * sound (hnsw_check) and the recall up. Filters and teardown too.
+ * Standalone (no N-API). Run under ASan+UBSan.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "memoryfile.h"
+#include "hnsw.h"
+
+static u64 rs = 0x5eed4e5eull;
+static u64 xs(void) { u64 x = rs; x ^= x << 13; x ^= x >> 7; x ^= x << 17; return rs = x; }
+static double unif(void) { return ((xs() >> 11) + 1) * 0x1.0p-53; }
+static float gauss(void) { return (float)(sqrt(-2 * log(unif())) * cos(6.283185307179586 * unif())); }
+
+static int fails = 0;
+#define CHECK(c, m) do { if (!(c)) { printf("  FAIL: %s\n", m); fails++; } else printf("  ok:   %s\n", m); } while (0)
+
+#define DIM      37u          /* not a multiple of any SIMD width: the tails run too */
+#define N        3000u
+#define CENTERS  24u
+#define K        10u
+#define QUERIES  100u
+
+static float data[N * DIM], centers[CENTERS * DIM];
+static u8 live[N];
+
+static void point_near(const float *c, float spread, float *out) { for (u32 d = 0; d < DIM; d++) out[d] = c[d] + spread * gauss(); }
+
+static double cosine(const float *a, const float *b) {
+    double ab = 0, aa = 0, bb = 0;
+    for (u32 d = 0; d < DIM; d++) { ab += (double)a[d] * b[d]; aa += (double)a[d] * a[d]; bb += (double)b[d] * b[d]; }
+    return ab / sqrt(aa * bb);
+}
+
+static int even_only(void *ctx, u32 id) { (void)ctx; return !(id & 1); }
+
+/* share of the exact top K (by the index's own distances) the graph search finds */
+static double recall(memfile_t *mf, u64 root, hnsw_accept_fn accept, int *leaked) {
+    u32 all[N], na = 0, got[K], want[K], hits = 0, total = 0;
+    double s1[K], s2[K];
+    for (u32 i = 0; i < N; i++) if (live[i] && (!accept || accept(NULL, i))) all[na++] = i;
+    for (u32 q = 0; q < QUERIES; q++) {
+        float v[DIM];
+        point_near(centers + (xs() % CENTERS) * DIM, 0.8f, v);
+        u32 ng = hnsw_search(mf, root, v, K, 0, accept, NULL, got, s1);
+        u32 nw = hnsw_rank(mf, root, v, all, na, K, want, s2);
+        for (u32 i = 0; i < ng; i++) if (!live[got[i]] || (accept && !accept(NULL, got[i]))) (*leaked)++;
+        for (u32 i = 0; i < nw; i++)
+            for (u32 j = 0; j < ng; j++) if (got[j] == want[i]) { hits++; break; }
+        total += nw;
+    }
+    return total ? (double)hits / total : 1.0;
+}
+
+static void run_format(memfile_t *mf, u64 root, u32 format, const char *name, double tol) {
+    char m[160];
+    printf("-- %s\n", name);
+    memset(live, 0, sizeof live);
+    CHECK(hnsw_create(mf, root, DIM, format) && hnsw_count(mf, root) == 0 && hnsw_check(mf, root), "empty index");
+    u32 ids[K];
+    double sim[K];
+    CHECK(hnsw_search(mf, root, data, K, 0, NULL, NULL, ids, sim) == 0, "empty index: no results");
+
+    int bad = 0;
+    for (u32 i = 0; i < N; i++) { if (!hnsw_put(mf, root, i, data + (size_t)i * DIM)) bad++; live[i] = 1; }
+    snprintf(m, sizeof m, "%u vectors in, audit clean", N);
+    CHECK(!bad && hnsw_count(mf, root) == N && hnsw_check(mf, root), m);
+
+    float z[DIM] = { 0 }, nan[DIM];
+    memcpy(nan, data, sizeof nan);
+    nan[3] = NAN;
+    CHECK(!hnsw_put(mf, root, N + 1, z) && !hnsw_put(mf, root, N + 1, nan) && hnsw_count(mf, root) == N,
+          "zero and non-finite vectors rejected");
+
+    /* decoded vectors and kernel similarities against float math */
+    double worst_v = 0, worst_s = 0;
+    for (u32 t = 0; t < 200; t++) {
+        u32 i = (u32)(xs() % N), one = i, got;
+        float back[DIM], norm = 0;
+        double s;
+        const float *v = data + (size_t)i * DIM;
+        for (u32 d = 0; d < DIM; d++) norm += v[d] * v[d];
+        norm = sqrtf(norm);
+        if (!hnsw_get(mf, root, i, back)) { bad++; continue; }
+        for (u32 d = 0; d < DIM; d++) if (fabs(back[d] - v[d] / norm) > worst_v) worst_v = fabs(back[d] - v[d] / norm);
+        float q[DIM];
+        point_near(v, 1.0f, q);
+        if (hnsw_rank(mf, root, q, &one, 1, 1, &got, &s) != 1 || got != i) { bad++; continue; }
+        if (fabs(s - cosine(q, v)) > worst_s) worst_s = fabs(s - cosine(q, v));
+    }
+    printf("  max |decoded - unit| = %.2e, max |sim - cosine| = %.2e\n", worst_v, worst_s);
+    CHECK(!bad && worst_v <= tol && worst_s <= 2 * tol, "stored vectors and kernel similarities within the format's error");
+
+    int leaked = 0;
+    double r = recall(mf, root, NULL, &leaked);
+    snprintf(m, sizeof m, "recall@%u vs exact scan: %.3f", K, r);
+    CHECK(r >= 0.9, m);
+
+    /* exact top hit of a stored vector is itself */
+    u32 self = 0;
+    for (u32 t = 0; t < 50; t++) {
+        u32 i = (u32)(xs() % N);
+        if (hnsw_search(mf, root, data + (size_t)i * DIM, 1, 0, NULL, NULL, ids, sim) == 1 && sim[0] > 0.99) self++;
+    }
+    CHECK(self == 50, "a stored vector finds a twin of itself");
+
+    r = recall(mf, root, even_only, &leaked);
+    snprintf(m, sizeof m, "filtered (even ids) recall: %.3f, nothing filtered out returned", r);
+    CHECK(r >= 0.85 && !leaked, m);
+
+    /* removal: dead links stay walkable until a consolidation trades them */
+    u32 removed = 0, audits = 0;
+    for (u32 t = 0; t < N * 2 / 3; t++) {
+        u32 i = (u32)(xs() % N);
+        if (hnsw_remove(mf, root, i) != live[i]) bad++;
+        removed += live[i]; live[i] = 0;
+        if (t % 97 == 0) { audits++; if (!hnsw_check(mf, root)) bad++; }
+    }
+    snprintf(m, sizeof m, "removed %u (%u audits), counts agree", removed, audits);
+    CHECK(!bad && hnsw_count(mf, root) == N - removed && hnsw_check(mf, root), m);
+    leaked = 0;
+    r = recall(mf, root, NULL, &leaked);
+    snprintf(m, sizeof m, "after removals: recall %.3f, no removed id returned", r);
+    CHECK(r >= 0.9 && !leaked, m);
+
+    /* put over a live id replaces its vector; re-put removed ids */
+    for (u32 t = 0; t < 300; t++) {
+        u32 i = (u32)(xs() % N);
+        if (live[i]) point_near(centers + (xs() % CENTERS) * DIM, 0.3f, data + (size_t)i * DIM);
+        if (!hnsw_put(mf, root, i, data + (size_t)i * DIM)) bad++;
+        live[i] = 1;
+    }
+    u32 n_live = 0;
+    for (u32 i = 0; i < N; i++) n_live += live[i];
+    leaked = 0;
+    r = recall(mf, root, NULL, &leaked);
+    snprintf(m, sizeof m, "replaced and re-added: count %u, recall %.3f", n_live, r);
+    CHECK(!bad && hnsw_count(mf, root) == n_live && hnsw_check(mf, root) && r >= 0.9 && !leaked, m);
+
+    for (u32 i = 0; i < N; i++) if (live[i] && !hnsw_remove(mf, root, i)) bad++;
+    memset(live, 0, sizeof live);
+    CHECK(!bad && hnsw_count(mf, root) == 0 && hnsw_check(mf, root)
+          && hnsw_search(mf, root, data, K, 0, NULL, NULL, ids, sim) == 0, "emptied: no results, audit clean");
+    CHECK(hnsw_put(mf, root, 7, data) && hnsw_search(mf, root, data, K, 0, NULL, NULL, ids, sim) == 1 && ids[0] == 7,
+          "an emptied index takes vectors again");
+    hnsw_destroy(mf, root);
+}
+
+int main(void) {
+    const char *p = "/tmp/hnsw_test.dat";
+    unlink(p);
+    memfile_t *mf = memfile_open(p, 1u << 20);
+    if (!mf) { printf("open failed\n"); return 2; }
+    u64 slots = memfile_alloc(mf, 32);
+    memset(memfile_ptr(mf, slots), 0, 32);
+    u64 base = mf->header->allocated;
+
+    for (u32 c = 0; c < CENTERS * DIM; c++) centers[c] = gauss();
+    for (u32 i = 0; i < N; i++) point_near(centers + (xs() % CENTERS) * DIM, 0.6f, data + (size_t)i * DIM);
+
+    CHECK(!hnsw_create(mf, slots, 0, HNSW_F32) && !hnsw_create(mf, slots, HNSW_MAX_DIM + 1, HNSW_F32)
+          && !hnsw_create(mf, slots, DIM, HNSW_I8 + 1) && !*(u64 *)memfile_ptr(mf, slots), "bad dimension or format refused");
+
+    run_format(mf, slots, HNSW_F32, "float32", 1e-6);
+    run_format(mf, slots, HNSW_F16, "float16", 1e-3);
+    run_format(mf, slots, HNSW_I8, "int8", 1.0 / 127);
+    CHECK(mf->header->free_bytes == mf->header->allocated - base && !*(u64 *)memfile_ptr(mf, slots),
+          "destroy hands every node back to the allocator");
+
+    memfile_close(mf); free(mf);
+    unlink(p);
+    printf(fails ? "\nFAILED (%d)\n" : "\nALL PASS\n", fails);
+    return fails ? 1 : 0;
+}
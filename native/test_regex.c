@@ -0,0 +1,198 @@
+/*
+ * regex_dfa validation: differential fuzz against glibc regexec (matches AND
+ * validity), the mid-match ^/$ newline rules, linear time on backtracking
+ * killers, regcomp fallback, and the LRU cache. Standalone, run under ASan+UBSan.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <regex.h>
+#include "regex_dfa.h"
+
+static int fails = 0;
+#define CHECK(c, m) do { if (!(c)) { printf("  FAIL: %s\n", m); fails++; } else printf("  ok:   %s\n", m); } while (0)
+
+static u64 g = 88172645463325252ull;
+static u64 xs(void) { u64 x = g; x ^= x << 13; x ^= x >> 7; x ^= x << 17; return g = x; }
+static u32 rnd(u32 n) { return (u32)(xs() % n); }
+
+static int glibc_match(const regex_t *re, const u8 *s, u32 len) {
+    regmatch_t pm; pm.rm_so = 0; pm.rm_eo = (regoff_t)len;
+    return regexec(re, (const char *)s, 1, &pm, REG_STARTEND) == 0;
+}
+
+static int match_str(const char *pat, const char *s) {
+    rx_t *r = rx_acquire(pat);
+    int m = r && rx_match(r, (const u8 *)s, (u32)strlen(s));
+    rx_release(r);
+    return m;
+}
+
+/* Random ERE over the GNU dialect. Counted repetition only on leaves: glibc
+ * itself can take exponential time compiling nested intervals. */
+static const char *atoms[] = { "a", "b", "c", "ab", "_", " ", ".", "\\w", "\\W", "\\s", "\\S", "\\b", "\\B",
+    "\\<", "\\>", "^", "$", "\\`", "\\'", "[ab]", "[^a]", "[a-c]", "[[:alpha:]]", "[[:space:]_]", "[]a]",
+    "[^]b]", "[a-]", "[--b]", "[[.a.]]", "[[=b=]]", "\\.", "\\n", "\\(", ")", "\xc3\xa9", "[\xc3\xa9]", "\x80",
+    "[^[:alnum:]]", "\\{", "x" };
+static void gen(char *o, int d) {
+    u32 k = rnd(d > 3 ? 3 : 8);
+    if (k == 0 && d < 4) { strcat(o, "("); gen(o, d + 1); if (!rnd(3)) { strcat(o, "|"); gen(o, d + 1); } strcat(o, ")"); }
+    else if (k == 1 && d < 4) { gen(o, d + 1); strcat(o, "|"); gen(o, d + 1); }
+    else if (k == 2 && d < 4) { gen(o, d + 1); gen(o, d + 1); }
+    else strcat(o, atoms[rnd(sizeof atoms / sizeof atoms[0])]);
+    static const char *qs[] = { "*", "+", "?", "{2}", "{1,3}", "{,2}", "{0}", "{2,}", "**", "+?" };
+    u32 q = rnd(12);
+    if (d < 3 && q >= 3 && q < 8) q = 10;
+    if (q < 10) strcat(o, qs[q]);
+}
+
+int main(void) {
+    /* T1: differential fuzz — random patterns x random subjects vs regexec */
+    {
+        static const char alpha[] = "abc_ .\n\0xA(){}";
+        size_t tested = 0, bad = 0, valid = 0, dfa = 0, vbad = 0;
+        for (int i = 0; i < 6000; i++) {
+            char pat[512] = {0};
+            gen(pat, 0);
+            if (!rnd(10)) { memmove(pat + 1, pat, strlen(pat) + 1); pat[0] = '^'; }
+            regex_t re;
+            int ok = regcomp(&re, pat, REG_EXTENDED) == 0;
+            rx_t *r = rx_acquire(pat);
+            if (rx_valid(r) != ok) vbad++;
+            if (!ok) { rx_release(r); continue; }
+            valid++; dfa += (size_t)rx_is_dfa(r);
+            for (int t = 0; t < 40; t++) {
+                u8 s[24]; u32 l = rnd(23);
+                for (u32 j = 0; j < l; j++) {
+                    u32 q = rnd(20);
+                    s[j] = q < 15 ? (u8)alpha[rnd(sizeof alpha - 1)] : q < 17 ? 0xc3 : q < 18 ? 0xa9 : q < 19 ? 0x80 : (u8)rnd(256);
+                }
+                s[l] = 0;   /* ASan's regexec interceptor strlen()s the subject */
+                if (glibc_match(&re, s, l) != rx_match(r, s, l)) bad++;
+                tested++;
+            }
+            rx_release(r); regfree(&re);
+        }
+        printf("  fuzz valid=%zu dfa=%zu tested=%zu bad=%zu vbad=%zu\n", valid, dfa, tested, bad, vbad);
+        CHECK(vbad == 0, "validity agrees with regcomp on every generated pattern");
+        CHECK(bad == 0, "match results agree with regexec on every (pattern, subject)");
+        CHECK(dfa * 10 >= valid * 9, "the DFA handles the dialect (>= 90% of valid patterns)");
+    }
+
+    /* T2: validity edge cases — the parser must reject exactly what regcomp rejects */
+    {
+        static const char *pats[] = { "a{x}", "a{,}", "a{1,2,3}", "a{ 1}", "a{1}{2}", "(|*)", "[[:alpha:]-a]",
+            "[[:alpha:]-]", "[a-[=b=]]", "[[=a=]-z]", "[[.a.]-z]", "()", "(a))", "a\\", "[a", "[]", "[]]", "[z-a]",
+            "[[:foo:]]", "[[=ab=]]", "[[.ab.]]", "x{32768}", "a||", "$*", "\\b*", "\\w*", "a{1", "{", "a|{",
+            "[[:alpha:]", "[[.a]", "[a-c-e]", "[a-c-]", "[---]", "[a--]", "[ab--]", "[]-a]", "(", ")", "\\`*",
+            "a**?+", "a{1,0}", "a{0,0}", "a{\\0}", "a{\\,2}", "a{1\\}", "\\1", "(a)\\1", "" };
+        int agree = 1;
+        for (size_t i = 0; i < sizeof pats / sizeof pats[0]; i++) {
+            regex_t re;
+            int ok = regcomp(&re, pats[i], REG_EXTENDED | REG_NOSUB) == 0;
+            if (ok) regfree(&re);
+            rx_t *r = rx_acquire(pats[i]);
+            if (rx_valid(r) != ok) { agree = 0; printf("  validity differs: %s\n", pats[i]); }
+            rx_release(r);
+        }
+        CHECK(agree, "validity edge cases match regcomp");
+    }
+
+    /* T3: glibc gives ^ and $ a line meaning inside a match, never at its edges */
+    CHECK(match_str("a\n^b", "a\nb") && match_str("a$\nb", "a\nb"), "^ after / $ before a newline the match consumes");
+    CHECK(!match_str("^b", "a\nb") && !match_str("a$", "a\nb"), "no line meaning where a match starts or ends");
+    CHECK(match_str("\\`a", "ab") && !match_str("\\`b", "ab") && match_str("b\\'", "ab"), "\\` and \\' anchor the text");
+
+    /* T4: linear time where backtracking blows up; regcomp never sees these */
+    {
+        enum { L = 1 << 20 };
+        u8 *s = malloc(L);
+        memset(s, 'a', L);
+        static const char *killers[] = { "(a|aa)*\\W", "(a*)*\\W", "(\\w+\\w+)+\\W", "(((\\`)*|\\b)**)+\\W" };
+        int lin = 1;
+        clock_t t0 = clock();
+        for (size_t i = 0; i < sizeof killers / sizeof killers[0]; i++) {
+            rx_t *r = rx_acquire(killers[i]);
+            if (!rx_valid(r) || !rx_is_dfa(r) || rx_prefilter(r) || rx_match(r, s, L)) lin = 0;
+            rx_release(r);
+        }
+        double sec = (double)(clock() - t0) / CLOCKS_PER_SEC;
+        printf("  killers over 1 MiB: %.3fs\n", sec);
+        CHECK(lin && sec < 5.0, "pathological patterns run through the DFA and finish");
+        free(s);
+    }
+
+    /* T5: what the DFA does not model still matches, via regexec */
+    {
+        rx_t *r = rx_acquire("(ab)\\1");
+        CHECK(rx_valid(r) && !rx_is_dfa(r), "back-references fall back to regcomp");
+        CHECK(rx_match(r, (const u8 *)"xabab", 5) && !rx_match(r, (const u8 *)"abba", 4), "fallback matches like regexec");
+        rx_release(r);
+    }
+
+    /* T6: required-literal prefilter — extraction, then the scan at every offset */
+    {
+        static const struct { const char *pat; u32 n; } pf[] = {
+            { "Project.*Alpha", 1 }, { "kubernetes", 1 }, { "memory|graph", 2 }, { "(memory|graph)file", 2 },
+            { "[Pp]roject", 2 }, { "colou?r", 2 }, { "\\bSelf\\b", 1 }, { ".*", 0 }, { "a*", 0 }, { "x|.", 0 },
+        };
+        int ok = 1;
+        for (size_t i = 0; i < sizeof pf / sizeof pf[0]; i++) {
+            rx_t *r = rx_acquire(pf[i].pat);
+            if (rx_prefilter(r) != pf[i].n) { ok = 0; printf("  prefilter %s: %u literals\n", pf[i].pat, rx_prefilter(r)); }
+            rx_release(r);
+        }
+        CHECK(ok, "required literals: factors, alternations, small classes; none for open patterns");
+        CHECK(match_str("Project.*Alpha", "the Project named Alpha") && !match_str("Project.*Alpha", "Alpha Project"),
+              "prefilter passes candidates on to the matcher");
+
+        u8 buf[100];
+        rx_t *r = rx_acquire("kubernetes|etcd-cluster");
+        int hit = 1, miss = 1;
+        for (u32 len = 10; len <= sizeof buf; len++)
+            for (u32 at = 0; at + 10 <= len; at++) {
+                memset(buf, 'k', len);
+                memcpy(buf + at, "kubernetes", 10);
+                hit &= rx_match(r, buf, len);
+                buf[at + 9] = 'z';
+                miss &= !rx_match(r, buf, len);
+            }
+        rx_release(r);
+        CHECK(hit && miss, "literal found at every offset and length (block and tail), near-misses rejected");
+    }
+
+    /* T7: LRU cache — a free entry is reused, a held one is not shared, size is
+     * bounded, held entries survive */
+    {
+        rx_cache_clear();
+        rx_t *a = rx_acquire("held-[0-9]+"), *b = rx_acquire("held-[0-9]+");
+        CHECK(a && b && a != b && rx_match(b, (const u8 *)"held-7", 6) && rx_cache_size() == 1,
+              "acquiring a held pattern returns a private copy, not the cached entry");
+        rx_release(b);
+        rx_t *d = rx_acquire("free-[0-9]+");
+        rx_release(d);
+        rx_t *e = rx_acquire("free-[0-9]+");
+        CHECK(d == e, "reacquiring a released pattern returns the cached entry");
+        rx_release(e);
+        char pat[32];
+        for (int i = 0; i < 200; i++) {
+            snprintf(pat, sizeof pat, "p%d[a-z]*", i);
+            rx_release(rx_acquire(pat));
+        }
+        CHECK(rx_cache_size() == RX_CACHE_MAX, "cache stays at RX_CACHE_MAX entries");
+        CHECK(rx_match(a, (const u8 *)"held-42", 7), "an entry held across evictions stays usable");
+        rx_release(a);
+        rx_t *c = rx_acquire("held-[0-9]+");
+        CHECK(c == a, "held entry is never evicted");
+        rx_release(c);
+        rx_cache_clear();
+        CHECK(rx_cache_size() == 0, "rx_cache_clear drops every unreferenced entry");
+    }
+
+    printf(fails ? "\nFAILED (%d)\n" : "\nALL PASS\n", fails);
+    return fails ? 1 : 0;
+}
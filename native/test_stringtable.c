@@ -50,13 +50,16 @@ int main(void) {
     {
         const char *s = "duplicate-string";
         u16 sl = (u16)strlen(s);
+        u32 gen = st_generation(st);
         u64 a = st_intern(st, (const u8 *)s, sl), b = st_intern(st, (const u8 *)s, sl);
         CHECK(a == b, "duplicate interns return the same id");
         CHECK(st_refcount(st, a) == 2, "refcount == 2 after two interns");
         st_release(st, a);
         CHECK(st_refcount(st, a) == 1, "refcount == 1 after one release");
+        CHECK(st_generation(st) == gen, "interning and releasing a live entry keep the generation");
         st_release(st, a);
         CHECK(st_find(st, (const u8 *)s, sl) == 0, "entry freed + unindexed when refcount hits 0");
+        CHECK(st_generation(st) == gen + 1, "freeing an entry bumps the generation");
     }
 
     /* T3: model-based fuzz — parallel-track expected refcounts, validate every step */
@@ -86,6 +89,104 @@ int main(void) {
     CHECK(st_count(st) == N, "after releasing the whole pool, only the T1 strings remain");
     printf("  fuzz bad=%zu final_count=%u (expected %d)\n", bad, st_count(st), N);
 
+    /* T4: symbol-table compression — train, pack in place, packed interns, dedup */
+    {
+        static const char *words[] = { "the", "memory", "graph", "stores", "observations", "about",
+            "entities", "and", "their", "relations", "between", "each", "other", "which", "agent", "notes" };
+        enum { Q = 600 };
+        static u64 qid[Q]; static char qs[Q][160]; static u16 ql[Q];
+        u32 base = st_count(st);
+        for (int i = 0; i < Q; i++) {
+            int l = 0;
+            while (l < 120) l += snprintf(qs[i] + l, sizeof qs[i] - (size_t)l, "%s ", words[xs() % 16]);
+            l += snprintf(qs[i] + l, sizeof qs[i] - (size_t)l, "#%d", i);
+            ql[i] = (u16)l;
+            qid[i] = st_intern(st, (const u8 *)qs[i], ql[i]);
+        }
+        CHECK(!st_has_dictionary(st), "no dictionary before training");
+        CHECK(st_train_dictionary(st, qid, Q) == 1, "train_dictionary stores a symbol table");
+        CHECK(st_train_dictionary(st, qid, Q) == 0, "dictionary is trained once (immutable)");
+        u32 packed = 0; for (int i = 0; i < Q; i++) packed += (u32)st_pack(st, qid[i]);
+        CHECK(packed > Q / 2, "most English-like strings pack");
+        size_t bad = 0;
+        for (int i = 0; i < Q; i++) {
+            u16 l; const u8 *p = st_get(st, qid[i], &l);
+            if (l != ql[i] || memcmp(p, qs[i], l) != 0) bad++;
+            if (st_len(st, qid[i]) != ql[i]) bad++;
+            if (st_find(st, (const u8 *)qs[i], ql[i]) != qid[i]) bad++;
+        }
+        CHECK(bad == 0, "packed entries decode, report raw length, and are found by raw bytes");
+        printf("  packed=%u/%d\n", packed, Q);
+        u64 d = st_intern_packed(st, (const u8 *)qs[7], ql[7]);
+        CHECK(d == qid[7] && st_refcount(st, d) == 2, "intern of a packed string dedups + refcount++");
+        st_release(st, d);
+        char fresh[160]; int fl = snprintf(fresh, sizeof fresh, "the memory graph stores observations about the entities and their relations between each other fresh");
+        u64 f = st_intern_packed(st, (const u8 *)fresh, (u16)fl);
+        u16 gl; const u8 *gp = st_get(st, f, &gl);
+        CHECK(st_is_packed(st, f) && gl == fl && memcmp(gp, fresh, gl) == 0, "new compressible text is interned packed");
+        u64 r = st_intern(st, (const u8 *)"the", 3);
+        CHECK(!st_is_packed(st, r), "short strings stay raw");
+        st_release(st, r); st_release(st, f);
+        for (int i = 0; i < Q; i++) st_release(st, qid[i]);
+        CHECK(st_count(st) == base, "releasing packed entries frees them");
+    }
+
+    /* T5: case folding + fold shadows kept current by intern/release */
+    {
+        u8 fb[64];
+        static const struct { const char *in, *out; } fc[] = {
+            { "Hello WORLD-42", "hello world-42" },
+            { "\xCE\x9A\xCE\xB1\xCE\xBB\xCE\x97", "\xCE\xBA\xCE\xB1\xCE\xBB\xCE\xB7" },   /* ΚαλΗ -> καλη */
+            { "\xD0\x9F\xD0\xA0\xD0\x98\xD0\x81", "\xD0\xBF\xD1\x80\xD0\xB8\xD1\x91" },   /* ПРИЁ -> приё */
+            { "\xC3\x89t\xC3\xA9 \xFF\xC3", "\xC3\xA9t\xC3\xA9 \xFF\xC3" },               /* malformed tail passes through */
+        };
+        int fok = 1;
+        for (size_t i = 0; i < sizeof fc / sizeof fc[0]; i++) {
+            u32 n = st_fold_utf8((const u8 *)fc[i].in, (u32)strlen(fc[i].in), fb);
+            if (n != strlen(fc[i].out) || memcmp(fb, fc[i].out, n) != 0) fok = 0;
+        }
+        CHECK(fok, "st_fold_utf8 folds ASCII, Greek, Cyrillic; malformed bytes pass through");
+
+        u32 base = st_count(st);
+        u64 mixed = st_intern(st, (const u8 *)"Alpha Beta", 10);
+        CHECK(st_fold(st, mixed) == 0 && !st_has_folds(st), "no shadows before st_build_folds");
+        CHECK(st_build_folds(st) == 1 && st_has_folds(st), "st_build_folds builds the fold map");
+        u64 sh = st_fold(st, mixed);
+        u16 sl; const u8 *sp = st_get(st, sh, &sl);
+        CHECK(sh && sh != mixed && sl == 10 && memcmp(sp, "alpha beta", 10) == 0, "mixed-case string maps to its folded shadow");
+        CHECK(st_fold(st, sh) == sh && st_fold(st, ids[5]) == ids[5], "folded strings map to themselves");
+        u64 late = st_intern(st, (const u8 *)"ALPHA BETA", 10);
+        CHECK(st_fold(st, late) == sh && st_refcount(st, sh) == 2, "interns after the build share the shadow");
+        st_release(st, mixed);
+        CHECK(st_refcount(st, sh) == 1 && st_fold(st, mixed) == 0, "release drops the map entry and its shadow ref");
+        st_release(st, late);
+        CHECK(st_count(st) == base, "last release frees the shadow too");
+    }
+
+    /* T6: trigram index — bulk build over T1, then maintained by intern/release */
+    {
+        u32 *c = NULL, cn = 0;
+        CHECK(st_trigram_candidates(st, "string-12", &c, &cn) == 0, "no candidates before the index exists (scan)");
+        CHECK(st_build_trigrams(st) == 1 && st_has_trigrams(st), "st_build_trigrams indexes the existing entries");
+        int in = st_trigram_candidates(st, "string-123[0-9]", &c, &cn), has = 0;
+        for (u32 i = 0; in && i < cn; i++) has += c[i] == (u32)ids[1234];
+        CHECK(in == 1 && has == 1 && cn < 20, "a selective pattern narrows 10k strings to a handful, including the match");
+        free(c); c = NULL;
+        in = st_trigram_candidates(st, "STRING-9999$", &c, &cn); has = 0;
+        for (u32 i = 0; in && i < cn; i++) has += c[i] == (u32)ids[9999];
+        CHECK(in == 1 && has == 1 && cn <= 11, "literals are folded: upper-case pattern finds the lower-case string");
+        free(c); c = NULL;
+        CHECK(st_trigram_candidates(st, "s.*g", &c, &cn) == 0, "no trigrams to use -> scan");
+        u64 nw = st_intern(st, (const u8 *)"Zebra crossing", 14);
+        in = st_trigram_candidates(st, "zebra|quagga", &c, &cn); has = 0;
+        for (u32 i = 0; in && i < cn; i++) has += c[i] == (u32)nw;
+        CHECK(in == 1 && has == 1 && cn <= 2, "interns are posted (with their fold shadow)");
+        free(c); c = NULL;
+        st_release(st, nw);
+        CHECK(st_trigram_candidates(st, "zebra", &c, &cn) == 1 && cn == 0, "releases are unposted");
+        free(c);
+    }
+
     st_close(st);
     printf(fails ? "\nFAILED (%d)\n" : "\nALL PASS\n", fails);
     return fails ? 1 : 0;
@@ -0,0 +1,481 @@
+#include "textindex.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pmap.h"
+
+#define TH_TERMS   0u     /* header fields */
+#define TH_DOCLEN  8u
+#define TH_DOCS    16u
+#define TH_TOTAL   24u
+#define TH_SIZE    32u
+
+#define TB_DF      0u     /* term block fields */
+#define TB_NBLK    4u
+#define TB_CAP     8u
+#define TB_LEN     12u
+#define TB_WORD    16u
+
+#define DE_FIRST   0u     /* dir entry fields */
+#define DE_LAST    4u
+#define DE_COUNT   8u
+#define DE_MAXTF   10u
+#define DE_NBYTES  12u
+#define DE_DATA    16u
+#define DE_SIZE    24u
+
+#define PROBE_STEP 0x9e3779b9u
+#define DOC_END    0xffffffffu
+
+static inline u8  rdu8(memfile_t *mf, u64 o)  { return *(const u8 *)memfile_ptr(mf, o); }
+static inline u16 rdu16(memfile_t *mf, u64 o) { u16 v; memcpy(&v, memfile_ptr(mf, o), 2); return v; }
+static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline u64 rdu64(memfile_t *mf, u64 o) { u64 v; memcpy(&v, memfile_ptr(mf, o), 8); return v; }
+static inline void wru16(memfile_t *mf, u64 o, u16 v) { memcpy(memfile_ptr(mf, o), &v, 2); }
+static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+static inline void wru64(memfile_t *mf, u64 o, u64 v) { memcpy(memfile_ptr(mf, o), &v, 8); }
+
+static inline u64 tb_size(u32 len, u32 cap) { return TB_WORD + ((len + 7u) & ~7u) + (u64)cap * DE_SIZE; }
+static inline u64 tb_entry(memfile_t *mf, u64 tb, u32 i) {
+    return tb + TB_WORD + ((rdu8(mf, tb + TB_LEN) + 7u) & ~7u) + (u64)i * DE_SIZE;
+}
+
+/* ======================================================================
+ * Tokenizer
+ * ====================================================================== */
+
+typedef struct { const u8 *p; u32 len; } word;
+
+static inline int is_word_byte(u8 c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c >= 0x80; }
+
+/* words of `t` in text order into w (needs len/2 + 1 entries); returns count */
+static u32 tokenize(const u8 *t, u32 len, word *w) {
+    u32 n = 0;
+    for (u32 i = 0; i < len;) {
+        while (i < len && !is_word_byte(t[i])) i++;
+        u32 s = i;
+        while (i < len && is_word_byte(t[i])) i++;
+        if (i > s) { w[n].p = t + s; w[n].len = i - s > TI_WORD_MAX ? TI_WORD_MAX : i - s; n++; }
+    }
+    return n;
+}
+
+static int cmp_word(const void *a, const void *b) {
+    const word *x = a, *y = b;
+    int c = memcmp(x->p, y->p, x->len < y->len ? x->len : y->len);
+    return c ? c : (x->len > y->len) - (x->len < y->len);
+}
+
+/* tokenize and sort, so equal words are adjacent; NULL on OOM (or *n == 0) */
+static word *words_sorted(const u8 *t, u32 len, u32 *n) {
+    word *w = malloc(((size_t)len / 2 + 1) * sizeof *w);
+    if (!w) { *n = 0; return NULL; }
+    *n = tokenize(t, len, w);
+    qsort(w, *n, sizeof *w, cmp_word);
+    return w;
+}
+
+static u32 word_hash(const u8 *p, u32 len) {
+    u32 h = 2166136261u;
+    for (u32 i = 0; i < len; i++) { h ^= p[i]; h *= 16777619u; }
+    return h;
+}
+
+/* ======================================================================
+ * Terms and postings
+ * ====================================================================== */
+
+/* Term block for `w`, or 0. *key gets its pmap key — or, when absent, the
+ * first free key on its probe path. */
+static u64 term_find(memfile_t *mf, u64 troot, const u8 *w, u32 len, u32 *key) {
+    u32 h = word_hash(w, len);
+    for (u32 i = 0;; i++) {
+        u32 k = h + i * PROBE_STEP;
+        u64 tb = pmap_get(mf, troot, k);
+        if (!tb) { *key = k; return 0; }
+        if (rdu8(mf, tb + TB_LEN) == len && !memcmp(memfile_ptr(mf, tb + TB_WORD), w, len)) { *key = k; return tb; }
+    }
+}
+
+static u64 term_create(memfile_t *mf, u64 troot, u32 key, const u8 *w, u32 len) {
+    u64 sz = tb_size(len, 1);
+    u64 tb = memfile_alloc(mf, sz);
+    if (!tb) return 0;
+    memset(memfile_ptr(mf, tb), 0, sz);
+    wru32(mf, tb + TB_CAP, 1);
+    *(u8 *)memfile_ptr(mf, tb + TB_LEN) = (u8)len;
+    memcpy(memfile_ptr(mf, tb + TB_WORD), w, len);
+    if (!pmap_put(mf, troot, key, tb)) { memfile_free(mf, tb, sz); return 0; }
+    return tb;
+}
+
+static u32 put_varint(u8 *o, u32 v) {
+    u32 n = 0;
+    while (v >= 0x80) { o[n++] = (u8)(v | 0x80); v >>= 7; }
+    o[n++] = (u8)v;
+    return n;
+}
+
+static const u8 *get_varint(const u8 *p, u32 *v) {
+    u32 x = 0;
+    for (u32 s = 0;; s += 7) { u8 b = *p++; x |= (u32)(b & 0x7f) << s; if (!(b & 0x80)) break; }
+    *v = x;
+    return p;
+}
+
+static u32 block_decode(memfile_t *mf, u64 de, u32 *docs, u32 *tfs) {
+    u32 n = rdu16(mf, de + DE_COUNT), d = rdu32(mf, de + DE_FIRST);
+    const u8 *p = memfile_ptr(mf, rdu64(mf, de + DE_DATA));
+    for (u32 i = 0; i < n; i++) {
+        u32 delta;
+        p = get_varint(p, &delta);
+        d += delta;
+        docs[i] = d;
+        p = get_varint(p, &tfs[i]);
+    }
+    return n;
+}
+
+/* (re)write block `bi` of `tb` from n >= 1 ascending postings, reusing its data when the size class holds */
+static int block_store(memfile_t *mf, u64 tb, u32 bi, const u32 *docs, const u32 *tfs, u32 n) {
+    u8 buf[TI_BLOCK * 10];
+    u32 nb = 0, prev = docs[0], mt = 0;
+    for (u32 i = 0; i < n; i++) {
+        nb += put_varint(buf + nb, docs[i] - prev);
+        nb += put_varint(buf + nb, tfs[i]);
+        prev = docs[i];
+        if (tfs[i] > mt) mt = tfs[i];
+    }
+    u64 de = tb_entry(mf, tb, bi);
+    u64 data = rdu64(mf, de + DE_DATA);
+    u32 old = rdu32(mf, de + DE_NBYTES);
+    if (!data || ((old + 31u) & ~31u) != ((nb + 31u) & ~31u)) {
+        u64 nd = memfile_alloc(mf, nb);
+        if (!nd) return 0;
+        memfile_free(mf, data, old);
+        data = nd;
+        de = tb_entry(mf, tb, bi);
+    }
+    memcpy(memfile_ptr(mf, data), buf, nb);
+    wru32(mf, de + DE_FIRST, docs[0]);
+    wru32(mf, de + DE_LAST, docs[n - 1]);
+    wru16(mf, de + DE_COUNT, (u16)n);
+    wru16(mf, de + DE_MAXTF, (u16)(mt > 0xffff ? 0xffff : mt));
+    wru32(mf, de + DE_NBYTES, nb);
+    wru64(mf, de + DE_DATA, data);
+    return 1;
+}
+
+/* open a zeroed dir entry at `at`, growing (and relocating) the term block
+ * when it is full; returns the term block, 0 on OOM */
+static u64 dir_insert(memfile_t *mf, u64 troot, u32 key, u64 tb, u32 at) {
+    u32 n = rdu32(mf, tb + TB_NBLK), cap = rdu32(mf, tb + TB_CAP), len = rdu8(mf, tb + TB_LEN);
+    if (n == cap) {
+        u64 nt = memfile_alloc(mf, tb_size(len, cap * 2));
+        if (!nt) return 0;
+        memcpy(memfile_ptr(mf, nt), memfile_ptr(mf, tb), tb_size(len, n));
+        wru32(mf, nt + TB_CAP, cap * 2);
+        memfile_free(mf, tb, tb_size(len, cap));
+        pmap_put(mf, troot, key, nt);             /* replaces in place */
+        tb = nt;
+    }
+    u64 de = tb_entry(mf, tb, at);
+    memmove(memfile_ptr(mf, de + DE_SIZE), memfile_ptr(mf, de), (size_t)(n - at) * DE_SIZE);
+    memset(memfile_ptr(mf, de), 0, DE_SIZE);
+    wru32(mf, tb + TB_NBLK, n + 1);
+    return tb;
+}
+
+/* first block whose last doc is >= doc (nblk if none) */
+static u32 block_for(memfile_t *mf, u64 tb, u32 doc) {
+    u32 lo = 0, hi = rdu32(mf, tb + TB_NBLK);
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (rdu32(mf, tb_entry(mf, tb, mid) + DE_LAST) < doc) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static int post(memfile_t *mf, u64 troot, u32 key, u64 tb, u32 doc, u32 tf) {
+    u32 docs[TI_BLOCK + 1], tfs[TI_BLOCK + 1];
+    u32 nblk = rdu32(mf, tb + TB_NBLK);
+    if (nblk == 0) {
+        if (!(tb = dir_insert(mf, troot, key, tb, 0))) return 0;
+        docs[0] = doc; tfs[0] = tf;
+        if (!block_store(mf, tb, 0, docs, tfs, 1)) return 0;
+        wru32(mf, tb + TB_DF, rdu32(mf, tb + TB_DF) + 1);
+        return 1;
+    }
+    u32 bi = block_for(mf, tb, doc);
+    if (bi == nblk) bi--;
+    u32 n = block_decode(mf, tb_entry(mf, tb, bi), docs, tfs), j = 0;
+    while (j < n && docs[j] < doc) j++;
+    if (j < n && docs[j] == doc) { tfs[j] = tf; return block_store(mf, tb, bi, docs, tfs, n); }
+    memmove(docs + j + 1, docs + j, (n - j) * sizeof *docs);
+    memmove(tfs + j + 1, tfs + j, (n - j) * sizeof *tfs);
+    docs[j] = doc; tfs[j] = tf; n++;
+    if (n <= TI_BLOCK) {
+        if (!block_store(mf, tb, bi, docs, tfs, n)) return 0;
+    } else {
+        u32 h = n / 2;
+        if (!(tb = dir_insert(mf, troot, key, tb, bi + 1))) return 0;
+        if (!block_store(mf, tb, bi, docs, tfs, h) || !block_store(mf, tb, bi + 1, docs + h, tfs + h, n - h)) return 0;
+    }
+    wru32(mf, tb + TB_DF, rdu32(mf, tb + TB_DF) + 1);
+    return 1;
+}
+
+static void unpost(memfile_t *mf, u64 tb, u32 doc) {
+    u32 docs[TI_BLOCK], tfs[TI_BLOCK];
+    u32 nblk = rdu32(mf, tb + TB_NBLK);
+    u32 bi = block_for(mf, tb, doc);
+    if (bi == nblk) return;
+    u64 de = tb_entry(mf, tb, bi);
+    u32 n = block_decode(mf, de, docs, tfs), j = 0;
+    while (j < n && docs[j] < doc) j++;
+    if (j == n || docs[j] != doc) return;
+    wru32(mf, tb + TB_DF, rdu32(mf, tb + TB_DF) - 1);
+    if (n == 1) {
+        memfile_free(mf, rdu64(mf, de + DE_DATA), rdu32(mf, de + DE_NBYTES));
+        memmove(memfile_ptr(mf, de), memfile_ptr(mf, de + DE_SIZE), (size_t)(nblk - bi - 1) * DE_SIZE);
+        wru32(mf, tb + TB_NBLK, nblk - 1);
+        return;
+    }
+    memmove(docs + j, docs + j + 1, (n - j - 1) * sizeof *docs);
+    memmove(tfs + j, tfs + j + 1, (n - j - 1) * sizeof *tfs);
+    block_store(mf, tb, bi, docs, tfs, n - 1);    /* shrinks: never allocates more than it frees */
+}
+
+/* ======================================================================
+ * Index
+ * ====================================================================== */
+
+int ti_create(memfile_t *mf, u64 root) {
+    u64 hdr = memfile_alloc(mf, TH_SIZE);
+    if (!hdr) return 0;
+    memset(memfile_ptr(mf, hdr), 0, TH_SIZE);
+    if (!pmap_create(mf, hdr + TH_TERMS, PMAP_INITIAL_BUCKETS)) { memfile_free(mf, hdr, TH_SIZE); return 0; }
+    if (!pmap_create(mf, hdr + TH_DOCLEN, PMAP_INITIAL_BUCKETS)) {
+        pmap_destroy(mf, hdr + TH_TERMS);
+        memfile_free(mf, hdr, TH_SIZE);
+        return 0;
+    }
+    wru64(mf, root, hdr);
+    return 1;
+}
+
+void ti_destroy(memfile_t *mf, u64 root) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr) return;
+    u64 troot = hdr + TH_TERMS;
+    u32 cap = pmap_capacity(mf, troot);
+    for (u32 i = 0; i < cap; i++) {
+        u32 k; u64 tb;
+        if (!pmap_at(mf, troot, i, &k, &tb)) continue;
+        u32 nblk = rdu32(mf, tb + TB_NBLK);
+        for (u32 b = 0; b < nblk; b++) {
+            u64 de = tb_entry(mf, tb, b);
+            memfile_free(mf, rdu64(mf, de + DE_DATA), rdu32(mf, de + DE_NBYTES));
+        }
+        memfile_free(mf, tb, tb_size(rdu8(mf, tb + TB_LEN), rdu32(mf, tb + TB_CAP)));
+    }
+    pmap_destroy(mf, troot);
+    pmap_destroy(mf, hdr + TH_DOCLEN);
+    memfile_free(mf, hdr, TH_SIZE);
+    wru64(mf, root, 0);
+}
+
+int ti_add(memfile_t *mf, u64 root, u32 doc, const u8 *text, u32 len) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr) return 0;
+    u32 n;
+    word *w = words_sorted(text, len, &n);
+    if (!w) return 0;
+    int ok = 1;
+    for (u32 i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && !cmp_word(&w[i], &w[j]); j++) {}
+        u32 key;
+        u64 tb = term_find(mf, hdr + TH_TERMS, w[i].p, w[i].len, &key);
+        if (!tb) tb = term_create(mf, hdr + TH_TERMS, key, w[i].p, w[i].len);
+        if (!tb || !post(mf, hdr + TH_TERMS, key, tb, doc, j - i)) ok = 0;
+    }
+    free(w);
+    if (n && pmap_put(mf, hdr + TH_DOCLEN, doc, n)) {
+        wru64(mf, hdr + TH_DOCS, rdu64(mf, hdr + TH_DOCS) + 1);
+        wru64(mf, hdr + TH_TOTAL, rdu64(mf, hdr + TH_TOTAL) + n);
+    } else if (n) ok = 0;
+    return ok;
+}
+
+void ti_remove(memfile_t *mf, u64 root, u32 doc, const u8 *text, u32 len) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr) return;
+    u32 n;
+    word *w = words_sorted(text, len, &n);
+    if (!w) return;
+    for (u32 i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && !cmp_word(&w[i], &w[j]); j++) {}
+        u32 key;
+        u64 tb = term_find(mf, hdr + TH_TERMS, w[i].p, w[i].len, &key);
+        if (tb) unpost(mf, tb, doc);
+    }
+    free(w);
+    u64 dl = pmap_get(mf, hdr + TH_DOCLEN, doc);
+    if (dl && pmap_del(mf, hdr + TH_DOCLEN, doc)) {
+        wru64(mf, hdr + TH_DOCS, rdu64(mf, hdr + TH_DOCS) - 1);
+        wru64(mf, hdr + TH_TOTAL, rdu64(mf, hdr + TH_TOTAL) - dl);
+    }
+}
+
+u32 ti_docs(memfile_t *mf, u64 root) {
+    u64 hdr = rdu64(mf, root);
+    return hdr ? (u32)rdu64(mf, hdr + TH_DOCS) : 0;
+}
+
+u32 ti_df(memfile_t *mf, u64 root, const u8 *w, u32 len) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr || !len) return 0;
+    if (len > TI_WORD_MAX) len = TI_WORD_MAX;
+    u32 key;
+    u64 tb = term_find(mf, hdr + TH_TERMS, w, len, &key);
+    return tb ? rdu32(mf, tb + TB_DF) : 0;
+}
+
+/* ======================================================================
+ * Top-k search (WAND)
+ * ====================================================================== */
+
+typedef struct {
+    u64    tb;
+    u32    nblk, bi, pos, n, doc;
+    double idf, ub;
+    u32    docs[TI_BLOCK], tfs[TI_BLOCK];
+} cursor;
+
+typedef struct { double s; u32 doc; } hit;
+
+static void cur_load(memfile_t *mf, cursor *c, u32 bi) {
+    c->bi = bi; c->pos = 0;
+    if (bi >= c->nblk) { c->n = 0; c->doc = DOC_END; return; }
+    c->n = block_decode(mf, tb_entry(mf, c->tb, bi), c->docs, c->tfs);
+    c->doc = c->docs[0];
+}
+
+static void cur_next(memfile_t *mf, cursor *c) {
+    if (++c->pos < c->n) c->doc = c->docs[c->pos];
+    else cur_load(mf, c, c->bi + 1);
+}
+
+/* advance to the first doc >= target, stepping over whole blocks by their last doc */
+static void cur_seek(memfile_t *mf, cursor *c, u32 target) {
+    if (c->doc >= target) return;
+    u32 b = c->bi;
+    while (b < c->nblk && rdu32(mf, tb_entry(mf, c->tb, b) + DE_LAST) < target) b++;
+    if (b != c->bi) cur_load(mf, c, b);
+    while (c->doc < target) cur_next(mf, c);
+}
+
+/* worse ranks first: lower score, then higher doc */
+static inline int hit_lt(hit a, hit b) { return a.s < b.s || (a.s == b.s && a.doc > b.doc); }
+
+static void hit_push(hit *h, u32 *n, u32 k, hit x) {
+    if (*n == k) {
+        if (!hit_lt(h[0], x)) return;
+        u32 i = 0;                                /* replace the root, sift down */
+        for (;;) {
+            u32 l = 2 * i + 1, m = i;
+            hit best = x;
+            if (l < k && hit_lt(h[l], best)) { m = l; best = h[l]; }
+            if (l + 1 < k && hit_lt(h[l + 1], best)) m = l + 1;
+            if (m == i) break;
+            h[i] = h[m]; i = m;
+        }
+        h[i] = x;
+        return;
+    }
+    u32 i = (*n)++;
+    while (i && hit_lt(x, h[(i - 1) / 2])) { h[i] = h[(i - 1) / 2]; i = (i - 1) / 2; }
+    h[i] = x;
+}
+
+static int cmp_hit(const void *a, const void *b) {
+    hit x = *(const hit *)a, y = *(const hit *)b;
+    return hit_lt(y, x) ? -1 : hit_lt(x, y) ? 1 : 0;
+}
+
+u32 ti_search(memfile_t *mf, u64 root, const u8 *query, u32 len, u32 k, u32 *docs, double *scores) {
+    u64 hdr = rdu64(mf, root);
+    if (!hdr || !k) return 0;
+    double N = (double)rdu64(mf, hdr + TH_DOCS);
+    if (N == 0) return 0;
+    double avgdl = (double)rdu64(mf, hdr + TH_TOTAL) / N;
+
+    u32 nw;
+    word *w = words_sorted(query, len, &nw);
+    if (!w) return 0;
+    cursor *cs = malloc(((size_t)nw + 1) * sizeof *cs);
+    cursor **order = malloc(((size_t)nw + 1) * sizeof *order);
+    hit *heap = malloc((size_t)k * sizeof *heap);
+    u32 nt = 0, nh = 0;
+    if (!cs || !order || !heap) { free(w); free(cs); free(order); free(heap); return 0; }
+
+    for (u32 i = 0, j; i < nw; i = j) {
+        for (j = i + 1; j < nw && !cmp_word(&w[i], &w[j]); j++) {}
+        u32 key;
+        u64 tb = term_find(mf, hdr + TH_TERMS, w[i].p, w[i].len, &key);
+        u32 df = tb ? rdu32(mf, tb + TB_DF) : 0;
+        if (!df) continue;
+        cursor *c = &cs[nt];
+        c->tb = tb;
+        c->nblk = rdu32(mf, tb + TB_NBLK);
+        c->idf = log(1.0 + (N - df + 0.5) / (df + 0.5));
+        u32 mt = 0;
+        for (u32 b = 0; b < c->nblk; b++) {
+            u32 m = rdu16(mf, tb_entry(mf, tb, b) + DE_MAXTF);
+            if (m > mt) mt = m;
+        }
+        /* the bound takes the shortest document; a saturated max_tf bounds by the limit */
+        c->ub = mt == 0xffff ? c->idf * (TI_K1 + 1)
+                             : c->idf * mt * (TI_K1 + 1) / (mt + TI_K1 * (1 - TI_B));
+        c->ub *= 1 + 1e-9;
+        cur_load(mf, c, 0);
+        order[nt++] = c;
+    }
+    free(w);
+
+    for (;;) {
+        for (u32 i = 1; i < nt; i++) {            /* nearly sorted already: insertion sort */
+            cursor *c = order[i]; u32 j = i;
+            while (j && order[j - 1]->doc > c->doc) { order[j] = order[j - 1]; j--; }
+            order[j] = c;
+        }
+        double acc = 0;
+        u32 p = nt;
+        for (u32 i = 0; i < nt && order[i]->doc != DOC_END; i++) {
+            acc += order[i]->ub;
+            if (nh < k || acc >= heap[0].s) { p = i; break; }
+        }
+        if (p == nt) break;
+        u32 pd = order[p]->doc;
+        if (order[0]->doc == pd) {
+            double dl = (double)pmap_get(mf, hdr + TH_DOCLEN, pd), s = 0;
+            double norm = TI_K1 * (1 - TI_B + TI_B * dl / avgdl);
+            for (u32 t = 0; t < nt; t++) {       /* term order, so equal documents score bit-equal */
+                cursor *c = &cs[t];
+                if (c->doc != pd) continue;
+                double tf = c->tfs[c->pos];
+                s += c->idf * tf * (TI_K1 + 1) / (tf + norm);
+                cur_next(mf, c);
+            }
+            hit_push(heap, &nh, k, (hit){ s, pd });
+        } else {
+            for (u32 i = 0; i < p; i++) cur_seek(mf, order[i], pd);
+        }
+    }
+
+    qsort(heap, nh, sizeof *heap, cmp_hit);
+    for (u32 i = 0; i < nh; i++) { docs[i] = heap[i].doc; scores[i] = heap[i].s; }
+    free(cs); free(order); free(heap);
+    return nh;
+}
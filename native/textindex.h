@@ -0,0 +1,46 @@
+/*
+ * BM25 full-text index over a v3 MemoryFile: words -> documents, ranked top-k.
+ *
+ * Header (the block a root slot points at):
+ *   [u64 terms pmap][u64 doc-length pmap][u64 docs][u64 total length]
+ * Terms: pmap from a hash of the word to a term block
+ *   [u32 df][u32 nblk][u32 cap][u8 len][3 pad][word, 8-aligned][dir entry * cap]
+ * A dir entry [u32 first][u32 last][u16 count][u16 max_tf][u32 nbytes][u64 data]
+ * describes one postings block of up to TI_BLOCK (doc, tf) pairs, doc ids
+ * ascending, stored as varint doc deltas and tfs. Colliding hashes probe on to
+ * the next key, so a term block whose postings empty stays as a marker.
+ *
+ * Text is tokenized on bytes: runs of [0-9a-z] and non-ASCII bytes are words,
+ * so the caller passes case-folded text (st_fold_utf8) for documents and query
+ * alike. Words longer than TI_WORD_MAX are cut to that many bytes.
+ *
+ * Queries run WAND over per-term score bounds; cursors skip whole blocks via
+ * their directory without decoding them.
+ */
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+#include "memoryfile.h"
+
+#define TI_BLOCK     128u    /* postings per compressed block */
+#define TI_WORD_MAX  64u
+#define TI_K1        1.2
+#define TI_B         0.75
+
+/* allocate an empty index and store its header offset at `root`; 0 on failure */
+int  ti_create(memfile_t *mf, u64 root);
+/* free every block and zero `root` */
+void ti_destroy(memfile_t *mf, u64 root);
+
+/* index / unindex one document; remove takes the text it was added with */
+int  ti_add(memfile_t *mf, u64 root, u32 doc, const u8 *text, u32 len);
+void ti_remove(memfile_t *mf, u64 root, u32 doc, const u8 *text, u32 len);
+
+u32  ti_docs(memfile_t *mf, u64 root);                        /* documents holding a word */
+u32  ti_df(memfile_t *mf, u64 root, const u8 *word, u32 len); /* documents holding `word` */
+
+/* Best `k` documents for the words of `query` by BM25 (k1 = TI_K1, b = TI_B),
+ * score descending then doc ascending; returns how many were written. */
+u32  ti_search(memfile_t *mf, u64 root, const u8 *query, u32 len, u32 k, u32 *docs, double *scores);
+
+#endif /* TEXTINDEX_H */
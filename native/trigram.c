@@ -0,0 +1,332 @@
+#include "trigram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "pmap.h"
+
+#define TRI_QUANTUM   32u   /* memfile allocation granularity */
+#define PB_HDR        8u    /* postings block: u32 count + u32 cap */
+#define ARENA_BLOCK   65536u
+
+static inline u32 rdu32(memfile_t *mf, u64 o) { u32 v; memcpy(&v, memfile_ptr(mf, o), 4); return v; }
+static inline void wru32(memfile_t *mf, u64 o, u32 v) { memcpy(memfile_ptr(mf, o), &v, 4); }
+static inline u32 at(const u8 *p, u32 i) { u32 v; memcpy(&v, p + (size_t)i * 4, 4); return v; }
+
+static int cmp_u32(const void *a, const void *b) { u32 x = *(const u32 *)a, y = *(const u32 *)b; return (x > y) - (x < y); }
+static int cmp_u64(const void *a, const void *b) { u64 x = *(const u64 *)a, y = *(const u64 *)b; return (x > y) - (x < y); }
+
+/* ======================================================================
+ * Arena + query constructors
+ * ====================================================================== */
+
+typedef struct ablk { struct ablk *next; size_t used, cap; } ablk;
+struct tq_arena { ablk *head; };
+
+tq_arena *tq_arena_new(void) { return calloc(1, sizeof(tq_arena)); }
+
+void tq_arena_free(tq_arena *a) {
+    if (!a) return;
+    for (ablk *b = a->head, *nx; b; b = nx) { nx = b->next; free(b); }
+    free(a);
+}
+
+void *tq_alloc(tq_arena *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    ablk *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = malloc(sizeof(ablk) + cap);
+        if (!b) return NULL;
+        b->cap = cap; b->used = 0; b->next = a->head; a->head = b;
+    }
+    void *p = (u8 *)(b + 1) + b->used;
+    b->used += n;
+    memset(p, 0, n);
+    return p;
+}
+
+static tq_t *leaf(tq_arena *a, u8 tag) { tq_t *q = tq_alloc(a, sizeof(tq_t)); if (q) q->tag = tag; return q; }
+tq_t *tq_all(tq_arena *a)  { return leaf(a, TQ_ALL); }
+tq_t *tq_none(tq_arena *a) { return leaf(a, TQ_NONE); }
+tq_t *tq_tri(tq_arena *a, u32 t) { tq_t *q = leaf(a, TQ_TRI); if (q) q->tri = t; return q; }
+
+static void push_unique(tq_t **v, u32 *m, tq_t *q) {
+    if (q->tag == TQ_TRI)
+        for (u32 i = 0; i < *m; i++) if (v[i]->tag == TQ_TRI && v[i]->tri == q->tri) return;
+    v[(*m)++] = q;
+}
+
+/* shared body of tq_and / tq_or: `absorb` short-circuits the whole node, `unit` is dropped */
+static tq_t *combine(tq_arena *a, tq_t *const *qs, u32 n, u8 tag, u8 absorb, u8 unit) {
+    u32 cap = 0;
+    for (u32 i = 0; i < n; i++) {
+        if (!qs[i]) return NULL;
+        if (qs[i]->tag == absorb) return leaf(a, absorb);
+        if (qs[i]->tag == unit) continue;
+        cap += qs[i]->tag == tag ? qs[i]->n : 1;
+    }
+    if (cap == 0) return leaf(a, unit);
+    tq_t **v = tq_alloc(a, (size_t)cap * sizeof(tq_t *));
+    if (!v) return NULL;
+    u32 m = 0;
+    for (u32 i = 0; i < n; i++) {
+        if (qs[i]->tag == unit) continue;
+        if (qs[i]->tag == tag) for (u32 k = 0; k < qs[i]->n; k++) push_unique(v, &m, qs[i]->ks[k]);
+        else push_unique(v, &m, qs[i]);
+    }
+    if (m == 1) return v[0];
+    tq_t *q = leaf(a, tag);
+    if (q) { q->n = m; q->ks = v; }
+    return q;
+}
+tq_t *tq_and(tq_arena *a, tq_t *const *qs, u32 n) { return combine(a, qs, n, TQ_AND, TQ_NONE, TQ_ALL); }
+tq_t *tq_or(tq_arena *a, tq_t *const *qs, u32 n)  { return combine(a, qs, n, TQ_OR, TQ_ALL, TQ_NONE); }
+
+/* ======================================================================
+ * Persistent postings
+ * ====================================================================== */
+
+static inline u64 pb_size(u32 cap) { return PB_HDR + (u64)cap * 4; }
+/* largest capacity whose block fills the quanta that `want` ids need */
+static inline u32 cap_for(u32 want) {
+    u64 q = (pb_size(want) + TRI_QUANTUM - 1) & ~(u64)(TRI_QUANTUM - 1);
+    return (u32)((q - PB_HDR) / 4);
+}
+
+/* first index in the block's id array with ids[i] >= id */
+static u32 lower_bound(const u8 *ids, u32 n, u32 id) {
+    u32 lo = 0, hi = n;
+    while (lo < hi) { u32 mid = lo + (hi - lo) / 2; if (at(ids, mid) < id) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+
+u32 tri_collect(const u8 *text, u32 len, u32 *out) {
+    if (len < 3) return 0;
+    u32 k = 0;
+    for (u32 i = 0; i + 3 <= len; i++) out[k++] = tri_pack(text + i);
+    qsort(out, k, 4, cmp_u32);
+    u32 m = 0;
+    for (u32 i = 0; i < k; i++) if (m == 0 || out[m - 1] != out[i]) out[m++] = out[i];
+    return m;
+}
+
+int tri_index_build(memfile_t *mf, u64 root, u64 *pairs, size_t n) {
+    qsort(pairs, n, 8, cmp_u64);
+    u32 distinct = 0;
+    for (size_t i = 0; i < n; i++) if (i == 0 || (pairs[i] >> 32) != (pairs[i - 1] >> 32)) distinct++;
+    u32 buckets = PMAP_INITIAL_BUCKETS;
+    while ((u64)buckets * 7 < (u64)distinct * 10) buckets *= 2;
+    if (!pmap_create(mf, root, buckets)) return 0;
+    for (size_t i = 0; i < n; ) {
+        u32 t = (u32)(pairs[i] >> 32);
+        size_t j = i;
+        while (j < n && (u32)(pairs[j] >> 32) == t) j++;
+        u32 cap = cap_for((u32)(j - i));
+        u64 b = memfile_alloc(mf, pb_size(cap));
+        if (!b) return 0;
+        u32 cnt = 0;
+        for (size_t k = i; k < j; k++) {
+            u32 id = (u32)pairs[k];
+            if (cnt && rdu32(mf, b + PB_HDR + (u64)(cnt - 1) * 4) == id) continue;
+            wru32(mf, b + PB_HDR + (u64)cnt * 4, id);
+            cnt++;
+        }
+        wru32(mf, b + 0, cnt);
+        wru32(mf, b + 4, cap);
+        if (!pmap_put(mf, root, t, b)) { memfile_free(mf, b, pb_size(cap)); return 0; }
+        i = j;
+    }
+    return 1;
+}
+
+void tri_index_destroy(memfile_t *mf, u64 root) {
+    u32 cap = pmap_capacity(mf, root);
+    for (u32 i = 0; i < cap; i++) {
+        u64 b;
+        if (pmap_at(mf, root, i, NULL, &b)) memfile_free(mf, b, pb_size(rdu32(mf, b + 4)));
+    }
+    pmap_destroy(mf, root);
+}
+
+int tri_post(memfile_t *mf, u64 root, u32 t, u32 id) {
+    u64 b = pmap_get(mf, root, t);
+    if (!b) {
+        u32 cap = cap_for(1);
+        if (!(b = memfile_alloc(mf, pb_size(cap)))) return 0;
+        wru32(mf, b + 0, 1); wru32(mf, b + 4, cap); wru32(mf, b + PB_HDR, id);
+        if (!pmap_put(mf, root, t, b)) { memfile_free(mf, b, pb_size(cap)); return 0; }
+        return 1;
+    }
+    u32 cnt = rdu32(mf, b + 0), cap = rdu32(mf, b + 4);
+    u32 pos = lower_bound(memfile_ptr(mf, b + PB_HDR), cnt, id);
+    if (pos < cnt && rdu32(mf, b + PB_HDR + (u64)pos * 4) == id) return 1;
+    if (cnt == cap) {                                   /* relocate at double capacity */
+        u32 ncap = cap_for(cap * 2);
+        u64 nb = memfile_alloc(mf, pb_size(ncap));
+        if (!nb) return 0;
+        memcpy(memfile_ptr(mf, nb + PB_HDR), memfile_ptr(mf, b + PB_HDR), (size_t)cnt * 4);
+        wru32(mf, nb + 4, ncap);
+        memfile_free(mf, b, pb_size(cap));
+        pmap_put(mf, root, t, nb);                      /* key present: replace, never grows */
+        b = nb;
+    }
+    u8 *p = memfile_ptr(mf, b + PB_HDR);
+    memmove(p + (size_t)(pos + 1) * 4, p + (size_t)pos * 4, (size_t)(cnt - pos) * 4);
+    memcpy(p + (size_t)pos * 4, &id, 4);
+    wru32(mf, b + 0, cnt + 1);
+    return 1;
+}
+
+void tri_unpost(memfile_t *mf, u64 root, u32 t, u32 id) {
+    u64 b = pmap_get(mf, root, t);
+    if (!b) return;
+    u32 cnt = rdu32(mf, b + 0), cap = rdu32(mf, b + 4);
+    u8 *p = memfile_ptr(mf, b + PB_HDR);
+    u32 pos = lower_bound(p, cnt, id);
+    if (pos >= cnt || at(p, pos) != id) return;
+    memmove(p + (size_t)pos * 4, p + (size_t)(pos + 1) * 4, (size_t)(cnt - pos - 1) * 4);
+    if (--cnt == 0) { memfile_free(mf, b, pb_size(cap)); pmap_del(mf, root, t); return; }
+    wru32(mf, b + 0, cnt);
+    u32 ncap = cap_for(cap / 2);
+    if ((u64)cnt * 4 <= cap && ncap < cap) {            /* shrink: hand the quantized tail back */
+        memfile_free(mf, b + pb_size(ncap), pb_size(cap) - pb_size(ncap));
+        wru32(mf, b + 4, ncap);
+    }
+}
+
+int tri_index_add(memfile_t *mf, u64 root, u32 id, const u8 *text, u32 len) {
+    if (len < 3) return 1;
+    u32 *tris = malloc((size_t)len * 4);
+    if (!tris) return 0;
+    u32 k = tri_collect(text, len, tris), ok = 1;
+    for (u32 i = 0; i < k && ok; i++) ok = (u32)tri_post(mf, root, tris[i], id);
+    free(tris);
+    return (int)ok;
+}
+
+int tri_index_remove(memfile_t *mf, u64 root, u32 id, const u8 *text, u32 len) {
+    if (len < 3) return 1;
+    u32 *tris = malloc((size_t)len * 4);
+    if (!tris) return 0;
+    u32 k = tri_collect(text, len, tris);
+    for (u32 i = 0; i < k; i++) tri_unpost(mf, root, tris[i], id);
+    free(tris);
+    return 1;
+}
+
+u32 tri_index_postings(memfile_t *mf, u64 root, u32 tri) {
+    u64 b = pmap_get(mf, root, tri);
+    return b ? rdu32(mf, b + 0) : 0;
+}
+
+const u8 *tri_postings_at(memfile_t *mf, u64 root, u32 key, u32 *n) {
+    u64 b = pmap_get(mf, root, key);
+    *n = b ? rdu32(mf, b + 0) : 0;
+    return b ? memfile_ptr(mf, b + PB_HDR) : NULL;
+}
+
+/* ======================================================================
+ * Evaluation. A posting list is read in place from the map (no allocation
+ * happens while evaluating, so the mapping stays put); only AND/OR results
+ * are materialized.
+ * ====================================================================== */
+
+typedef struct { const u8 *p; u32 n; u32 *own; } plist;
+
+enum { EV_ALL = 0, EV_LIST = 1, EV_OOM = -1 };
+
+static void pl_free(plist *l) { free(l->own); l->own = NULL; }
+
+static int ev(memfile_t *mf, u64 root, const tq_t *q, plist *out);
+
+static int cmp_plist(const void *a, const void *b) {
+    u32 x = ((const plist *)a)->n, y = ((const plist *)b)->n; return (x > y) - (x < y);
+}
+
+static int ev_and(memfile_t *mf, u64 root, const tq_t *q, plist *out) {
+    plist *ls = malloc((size_t)q->n * sizeof(plist));
+    if (!ls) return EV_OOM;
+    u32 m = 0; int rc = EV_LIST;
+    for (u32 i = 0; i < q->n; i++) {
+        plist l = { 0 };
+        int r = ev(mf, root, q->ks[i], &l);
+        if (r == EV_ALL) continue;
+        if (r == EV_OOM) { rc = EV_OOM; break; }
+        ls[m++] = l;
+        if (l.n == 0) break;                            /* empty conjunct: nothing can match */
+    }
+    if (rc == EV_LIST && m == 0) rc = EV_ALL;
+    if (rc == EV_LIST) {
+        qsort(ls, m, sizeof(plist), cmp_plist);         /* smallest first; later lists are probed */
+        u32 *acc = malloc((size_t)ls[0].n * 4 + 4), na = ls[0].n;
+        if (!acc) rc = EV_OOM;
+        else {
+            if (na) memcpy(acc, ls[0].p, (size_t)na * 4);
+            for (u32 k = 1; k < m && na; k++) {
+                u32 w = 0, lo = 0;
+                for (u32 i = 0; i < na; i++) {
+                    lo += lower_bound(ls[k].p + (size_t)lo * 4, ls[k].n - lo, acc[i]);
+                    if (lo < ls[k].n && at(ls[k].p, lo) == acc[i]) acc[w++] = acc[i];
+                }
+                na = w;
+            }
+            *out = (plist){ (const u8 *)acc, na, acc };
+        }
+    }
+    for (u32 i = 0; i < m; i++) pl_free(&ls[i]);
+    free(ls);
+    return rc;
+}
+
+static int ev_or(memfile_t *mf, u64 root, const tq_t *q, plist *out) {
+    plist *ls = malloc((size_t)q->n * sizeof(plist));
+    if (!ls) return EV_OOM;
+    u32 m = 0; int rc = EV_LIST; size_t total = 0;
+    for (u32 i = 0; i < q->n; i++) {
+        plist l = { 0 };
+        int r = ev(mf, root, q->ks[i], &l);
+        if (r != EV_LIST) { rc = r; break; }            /* ALL absorbs; OOM propagates */
+        ls[m++] = l; total += l.n;
+    }
+    if (rc == EV_LIST) {
+        u32 *u = malloc(total * 4 + 4);
+        if (!u) rc = EV_OOM;
+        else {
+            size_t k = 0;
+            for (u32 i = 0; i < m; i++) { if (ls[i].n) memcpy(u + k, ls[i].p, (size_t)ls[i].n * 4); k += ls[i].n; }
+            qsort(u, k, 4, cmp_u32);
+            u32 w = 0;
+            for (size_t i = 0; i < k; i++) if (w == 0 || u[w - 1] != u[i]) u[w++] = u[i];
+            *out = (plist){ (const u8 *)u, w, u };
+        }
+    }
+    for (u32 i = 0; i < m; i++) pl_free(&ls[i]);
+    free(ls);
+    return rc;
+}
+
+static int ev(memfile_t *mf, u64 root, const tq_t *q, plist *out) {
+    switch (q->tag) {
+    case TQ_ALL:  return EV_ALL;
+    case TQ_NONE: *out = (plist){ NULL, 0, NULL }; return EV_LIST;
+    case TQ_TRI: {
+        u64 b = pmap_get(mf, root, q->tri);
+        *out = b ? (plist){ memfile_ptr(mf, b + PB_HDR), rdu32(mf, b + 0), NULL } : (plist){ NULL, 0, NULL };
+        return EV_LIST;
+    }
+    case TQ_AND:  return ev_and(mf, root, q, out);
+    default:      return ev_or(mf, root, q, out);
+    }
+}
+
+int tri_eval(memfile_t *mf, u64 root, const tq_t *q, u32 **ids, u32 *n) {
+    plist l = { 0 };
+    if (ev(mf, root, q, &l) != EV_LIST) return 0;
+    if (!l.own) {                                       /* a bare trigram: copy out of the map */
+        l.own = malloc((size_t)l.n * 4 + 4);
+        if (!l.own) return 0;
+        if (l.n) memcpy(l.own, l.p, (size_t)l.n * 4);
+    }
+    *ids = l.own; *n = l.n;
+    return 1;
+}
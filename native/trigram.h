@@ -0,0 +1,72 @@
+/*
+ * Trigram inverted index over a v3 MemoryFile, for regex pre-filtering.
+ *
+ * Index: pmap (see pmap.h) from a packed trigram (3 bytes, little-endian in a
+ * u32) to a postings block [u32 count][u32 cap][u32 ids[cap]], ids ascending.
+ * A string is posted once under each distinct trigram of its CASE-FOLDED bytes,
+ * so one index serves case-sensitive and case-insensitive search alike (the
+ * query side folds its literals the same way).
+ *
+ * Queries (tq_t) are boolean expressions over trigrams, built by regex_query.c
+ * (Cox's algorithm) and evaluated against the postings. Query nodes live in a
+ * tq_arena the caller frees in one go.
+ */
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <stddef.h>
+#include "memoryfile.h"
+
+static inline u32 tri_pack(const u8 *b) { return (u32)b[0] | ((u32)b[1] << 8) | ((u32)b[2] << 16); }
+
+/* ---- query expressions ---- */
+enum { TQ_ALL, TQ_NONE, TQ_TRI, TQ_AND, TQ_OR };
+
+typedef struct tq {
+    u8          tag;
+    u32         tri;     /* TQ_TRI */
+    u32         n;       /* TQ_AND / TQ_OR */
+    struct tq **ks;
+} tq_t;
+
+typedef struct tq_arena tq_arena;
+tq_arena *tq_arena_new(void);
+void      tq_arena_free(tq_arena *a);
+void     *tq_alloc(tq_arena *a, size_t n);      /* zeroed; never NULL unless OOM */
+
+tq_t *tq_all(tq_arena *a);
+tq_t *tq_none(tq_arena *a);
+tq_t *tq_tri(tq_arena *a, u32 t);
+/* normalizing constructors: flatten same-tag children, short-circuit ALL/NONE,
+ * dedupe trigram leaves; 0 survivors -> ALL (and) / NONE (or), 1 -> that child */
+tq_t *tq_and(tq_arena *a, tq_t *const *qs, u32 n);
+tq_t *tq_or(tq_arena *a, tq_t *const *qs, u32 n);
+static inline tq_t *tq_and2(tq_arena *a, tq_t *x, tq_t *y) { tq_t *v[2] = { x, y }; return tq_and(a, v, 2); }
+static inline tq_t *tq_or2(tq_arena *a, tq_t *x, tq_t *y)  { tq_t *v[2] = { x, y }; return tq_or(a, v, 2); }
+
+/* ---- persistent index (root = offset of the u64 slot holding the pmap) ---- */
+/* distinct trigrams of `text`, ascending, into out (needs len entries); returns count */
+u32  tri_collect(const u8 *text, u32 len, u32 *out);
+/* create the index from (trigram << 32 | id) pairs (sorted in place); 0 on failure */
+int  tri_index_build(memfile_t *mf, u64 root, u64 *pairs, size_t n);
+/* free every postings block and the map, zeroing `root` */
+void tri_index_destroy(memfile_t *mf, u64 root);
+/* post / unpost one string; `text` is its folded bytes. 0 on OOM, which may
+ * leave the string posted under only some of its trigrams */
+int  tri_index_add(memfile_t *mf, u64 root, u32 id, const u8 *text, u32 len);
+int  tri_index_remove(memfile_t *mf, u64 root, u32 id, const u8 *text, u32 len);
+/* number of strings posted under one trigram (0 if none) */
+u32  tri_index_postings(memfile_t *mf, u64 root, u32 tri);
+/* Raw postings under any u32 key, for other indexes sharing this layout (fuzzy.h).
+ * tri_postings_at points into the map (ids as unaligned u32s, ascending) and
+ * stays valid until the next allocation; NULL when the key has none. */
+int  tri_post(memfile_t *mf, u64 root, u32 key, u32 id);
+void tri_unpost(memfile_t *mf, u64 root, u32 key, u32 id);
+const u8 *tri_postings_at(memfile_t *mf, u64 root, u32 key, u32 *n);
+
+/* Evaluate q: 0 = unconstrained (TQ_ALL, or out of memory) — caller must scan;
+ * 1 = *ids (malloc'd, ascending, caller frees; may be empty) holds every string
+ * id that can satisfy q. */
+int  tri_eval(memfile_t *mf, u64 root, const tq_t *q, u32 **ids, u32 *n);
+
+#endif /* TRIGRAM_H */
@@ -11,7 +11,7 @@ import fs from 'fs';
 import os from 'os';
 import path from 'path';
 import { fileURLToPath } from 'url';
-import { Store, DIR_FORWARD, DIR_BACKWARD, type NativeEntity } from './src/store.js';
+import { Store, DIR_FORWARD, DIR_BACKWARD, VEC_F16, VEC_F32, VEC_I8, RANK_ASC, RANK_MTIME, RANK_NAME, RANK_OBS_MTIME, RANK_STRUCTURAL, RANK_WALKER, READ_NAME, READ_OBS, READ_TIMES, READ_TYPE, type NativeEntity, type PackedRelations } from './src/store.js';
 import { ensureV3 } from './src/migrate.js';
 import { validateExtension, loadDocument, type KbLoadResult } from './src/kb_load.js';
 import { toolDurationHistogram, traced, tracer } from './src/tracing.js';
@@ -151,97 +151,6 @@ export interface Neighbor {
   obsMtime?: number;
 }
 
-/**
- * Sort entities by the specified field and direction.
- * Returns a new array (does not mutate input).
- * Defaults to 'llmrank' when sortBy is undefined.
- *
- * For 'pagerank' sort: uses structural rank (desc by default).
- * For 'llmrank' sort: uses walker rank, falls back to structural rank on tie, then random.
- * Both rank sorts require rankMaps parameter.
- */
-function sortEntities(
-  entities: Entity[],
-  sortBy: EntitySortField = "llmrank",
-  sortDir?: SortDirection,
-  rankMaps?: { structural: Map<string, number>; walker: Map<string, number> }
-): Entity[] {
-  const dir = sortDir ?? (sortBy === "name" ? "asc" : "desc");
-  const mult = dir === "asc" ? 1 : -1;
-
-  return [...entities].sort((a, b) => {
-    if (sortBy === "name") {
-      return mult * a.name.localeCompare(b.name);
-    }
-    if (sortBy === "pagerank") {
-      const aRank = rankMaps?.structural.get(a.name) ?? 0;
-      const bRank = rankMaps?.structural.get(b.name) ?? 0;
-      const diff = aRank - bRank;
-      if (diff !== 0) return mult * diff;
-      return Math.random() - 0.5; // random tiebreak
-    }
-    if (sortBy === "llmrank") {
-      // Primary: walker rank
-      const aWalker = rankMaps?.walker.get(a.name) ?? 0;
-      const bWalker = rankMaps?.walker.get(b.name) ?? 0;
-      const walkerDiff = aWalker - bWalker;
-      if (walkerDiff !== 0) return mult * walkerDiff;
-      // Fallback: structural rank
-      const aStruct = rankMaps?.structural.get(a.name) ?? 0;
-      const bStruct = rankMaps?.structural.get(b.name) ?? 0;
-      const structDiff = aStruct - bStruct;
-      if (structDiff !== 0) return mult * structDiff;
-      // Final: random tiebreak
-      return Math.random() - 0.5;
-    }
-    // For timestamps, treat undefined as 0 (oldest)
-    const aVal = a[sortBy] ?? 0;
-    const bVal = b[sortBy] ?? 0;
-    return mult * (aVal - bVal);
-  });
-}
-
-/**
- * Sort neighbors by the specified field and direction.
- * Defaults to 'llmrank' when sortBy is undefined.
- */
-function sortNeighbors(
-  neighbors: Neighbor[],
-  sortBy: EntitySortField = "llmrank",
-  sortDir?: SortDirection,
-  rankMaps?: { structural: Map<string, number>; walker: Map<string, number> }
-): Neighbor[] {
-  const dir = sortDir ?? (sortBy === "name" ? "asc" : "desc");
-  const mult = dir === "asc" ? 1 : -1;
-
-  return [...neighbors].sort((a, b) => {
-    if (sortBy === "name") {
-      return mult * a.name.localeCompare(b.name);
-    }
-    if (sortBy === "pagerank") {
-      const aRank = rankMaps?.structural.get(a.name) ?? 0;
-      const bRank = rankMaps?.structural.get(b.name) ?? 0;
-      const diff = aRank - bRank;
-      if (diff !== 0) return mult * diff;
-      return Math.random() - 0.5;
-    }
-    if (sortBy === "llmrank") {
-      const aWalker = rankMaps?.walker.get(a.name) ?? 0;
-      const bWalker = rankMaps?.walker.get(b.name) ?? 0;
-      const walkerDiff = aWalker - bWalker;
-      if (walkerDiff !== 0) return mult * walkerDiff;
-      const aStruct = rankMaps?.structural.get(a.name) ?? 0;
-      const bStruct = rankMaps?.structural.get(b.name) ?? 0;
-      const structDiff = aStruct - bStruct;
-      if (structDiff !== 0) return mult * structDiff;
-      return Math.random() - 0.5;
-    }
-    const aVal = a[sortBy] ?? 0;
-    const bVal = b[sortBy] ?? 0;
-    return mult * (aVal - bVal);
-  });
-}
-
 export const MAX_CHARS = 4096;
 
 /**
@@ -259,12 +168,12 @@ export const MAX_CHARS = 4096;
  * alternative (skipping the item, or returning an error) hides data from the
  * caller and makes downstream pagination inconsistent.
  */
-function paginateItems<T>(items: T[], cursor: number = 0, maxChars: number = MAX_CHARS): PaginatedResult<T> {
+function paginateItems<T>(items: T[], cursor: number = 0, maxChars: number = MAX_CHARS, totalCount: number = items.length): PaginatedResult<T> {
   const result: T[] = [];
   let i = cursor;
 
   // Calculate overhead for wrapper: {"items":[],"nextCursor":null,"totalCount":123}
-  const wrapperTemplate = { items: [] as T[], nextCursor: null as number | null, totalCount: items.length };
+  const wrapperTemplate = { items: [] as T[], nextCursor: null as number | null, totalCount };
   const overhead = JSON.stringify(wrapperTemplate).length;
   let charCount = overhead;
 
@@ -295,7 +204,7 @@ function paginateItems<T>(items: T[], cursor: number = 0, maxChars: number = MAX
   return {
     items: result,
     nextCursor,
-    totalCount: items.length
+    totalCount
   };
 }
 
@@ -310,6 +219,36 @@ function paginateGraph(graph: KnowledgeGraph, entityCursor: number = 0, relation
   };
 }
 
+/**
+ * Estimated similarity (Jaccard over 4-byte shingles of the case-folded name
+ * and observations) at which two entities count as near duplicates. Above 0.75
+ * the native LSH lookup finds every such entity.
+ */
+const NEAR_DUPLICATE_SIMILARITY = 0.8;
+
+/** How the entity-vector index stores each embedding; fixed when the first one is set. */
+export type EmbeddingQuantization = 'float32' | 'float16' | 'int8';
+const VECTOR_FORMAT: Record<EmbeddingQuantization, number> = { float32: VEC_F32, float16: VEC_F16, int8: VEC_I8 };
+
+/** Entities fetched per native search page; the character budget usually cuts the page first. */
+const SEARCH_PAGE_LIMIT = 100;
+
+/** Native ranking key for each sort field the C side can order. */
+const SEARCH_RANK: Partial<Record<EntitySortField, number>> = {
+  name: RANK_NAME,
+  mtime: RANK_MTIME,
+  obsMtime: RANK_OBS_MTIME,
+  pagerank: RANK_STRUCTURAL,
+  llmrank: RANK_WALKER,
+};
+
+/** Native rank (key plus RANK_ASC) of a sort: timestamps and ranks descend and
+ *  names ascend unless told otherwise. */
+function sortRank(sortBy: EntitySortField, sortDir?: SortDirection): number {
+  const asc = (sortDir ?? (sortBy === 'name' ? 'asc' : 'desc')) === 'asc';
+  return (SEARCH_RANK[sortBy] ?? RANK_WALKER) | (asc ? RANK_ASC : 0);
+}
+
 // The KnowledgeGraphManager class contains all operations to interact with the knowledge graph
 export class KnowledgeGraphManager {
   private db: Store;
@@ -338,6 +277,10 @@ export class KnowledgeGraphManager {
       if (this.db.entityCount() > 0) {
         this.db.structuralSample(1, 0.85);
         this.db.computeMerwPsi(0.85, 200, 1e-8);
+        // Opt-in observation compression: trains the strings-file symbol table
+        // once, then packs existing observations in place. Once a table exists,
+        // new observations are stored packed whenever it saves space.
+        if (process.env.KB_COMPRESS_OBSERVATIONS === '1') this.db.compressObservations();
       }
     });
   }
@@ -462,43 +405,55 @@ export class KnowledgeGraphManager {
     const db = this.db;
     return {
       *entries() {
-        for (const off of db.listEntities()) {
-          const r = db.readEntity(off);
-          yield { id: off, text: r.name, refcount: 1 };
-          yield { id: off, text: r.type, refcount: 1 };
-          for (const o of r.observations) yield { id: off, text: o, refcount: 1 };
+        const offsets = db.listEntities();
+        const batch = db.readEntities(offsets, READ_NAME | READ_TYPE | READ_OBS);
+        for (let i = 0; i < batch.length; i++) {
+          const id = offsets[i];
+          yield { id, text: batch.name(i), refcount: 1 };
+          yield { id, text: batch.type(i), refcount: 1 };
+          for (const o of batch.observations(i)) yield { id, text: o, refcount: 1 };
         }
       },
     };
   }
 
-  /** Build rank maps from the binary store for pagerank/llmrank sorting.
-   *  NOTE: Must be called inside a lock (read or write).
+  /**
+   * Entity offsets in the order of a sort field (llmrank by default), ranked
+   * natively from their own records: timestamps and ranks descend and names
+   * ascend unless told otherwise, ties to the lower offset. Only the given
+   * records are read. NOTE: Must be called inside a lock (read or write).
    *
-   *  Always-on `kb.rank.read` child span: this is a hot path called from every
-   *  read tool that sorts by rank, and surfaces the cost of reading the
-   *  per-entity rank fields under the active lock.
+   * Always-on `kb.rank.sort` child span: every read tool that sorts comes
+   * through here.
    */
-  private getRankMapsUnlocked(): { structural: Map<string, number>; walker: Map<string, number> } {
-    return traced('kb.rank.read', { 'kb.entity_count': this.db.entityCount() }, () => {
-      const structural = new Map<string, number>();
-      const walker = new Map<string, number>();
-      const structTotal = this.db.structuralTotal();
-      const walkerTotal = this.db.walkerTotal();
-
-      for (const offset of this.db.listEntities()) {
-        const rec = this.db.readEntity(offset);
-        structural.set(rec.name, structTotal > 0n ? Number(rec.structuralVisits) / Number(structTotal) : 0);
-        walker.set(rec.name, walkerTotal > 0n ? Number(rec.walkerVisits) / Number(walkerTotal) : 0);
-      }
+  private sortOffsetsUnlocked(offsets: bigint[], sortBy: EntitySortField = 'llmrank', sortDir?: SortDirection): bigint[] {
+    return traced('kb.rank.sort', { 'kb.rank.count': offsets.length, 'kb.rank.sort_by': sortBy },
+      () => this.db.rankSort(offsets, sortRank(sortBy, sortDir)));
+  }
 
-      return { structural, walker };
-    });
+  /**
+   * A paginateItems page of the given entities, as JSON text, in the order of
+   * a sort field — the same text JSON.stringify(paginateItems(...)) gives for
+   * the sorted Entity[], without building it. NOTE: Must be called inside a
+   * lock (read or write).
+   */
+  private jsonPageUnlocked(offsets: bigint[], sortBy: EntitySortField = 'llmrank', sortDir?: SortDirection, cursor: number = 0): string {
+    return traced('kb.rank.page', { 'kb.rank.count': offsets.length, 'kb.rank.sort_by': sortBy },
+      () => this.db.jsonPage(offsets, sortRank(sortBy, sortDir), cursor, MAX_CHARS));
+  }
+
+  /** "Did you mean …?" for a name with no exact entity, listing up to `limit`
+   *  live names within two edits (nearest first); '' when there are none or the
+   *  name exists. NOTE: Must be called inside a lock (read or write). */
+  private didYouMeanUnlocked(name: string, limit: number = 3): string {
+    if (this.db.lookup(name) !== 0n) return '';
+    const names = this.db.fuzzyLookup(name, 2, limit).map(h => `"${this.db.entityName(h.offset)}"`);
+    return names.length ? `Did you mean ${names.join(' or ')}?` : '';
   }
 
-  /** Build rank maps (acquires read lock). */
-  getRankMaps(): { structural: Map<string, number>; walker: Map<string, number> } {
-    return this.withReadLock(() => this.getRankMapsUnlocked());
+  /** Typo suggestion for an unknown entity name (acquires read lock). */
+  didYouMean(name: string): string {
+    return this.withReadLock(() => this.didYouMeanUnlocked(name));
   }
 
   /** Increment walker visit count for a list of entity names */
@@ -517,26 +472,23 @@ export class KnowledgeGraphManager {
 
   /**
    * Re-run structural sampling and MERW eigenvector computation (call after
-   * graph mutations).
+   * graph mutations). Runs off the event loop: the native side copies the
+   * graph's adjacency under a brief shared lock, samples the copy on a worker
+   * thread holding no lock, so reads and writes are still served meanwhile,
+   * then stores the result under a brief exclusive one.
    *
-   * Emits two child spans under the active span: `kb.rank.pagerank`
-   * (structural sampling — PageRank-style random walks) and `kb.rank.merw`
-   * (Maximum-Entropy Random Walk eigenvector). Skipped entirely on an empty
-   * graph so the spans aren't emitted for trivial no-op resamples.
+   * Emits one `kb.rank.resample` child span under the active span, carrying
+   * the structural visits sampled (PageRank-style random walks) and the MERW
+   * iterations run. Skipped entirely on an empty graph so the span isn't
+   * emitted for trivial no-op resamples.
    */
-  resample(): void {
-    this.withWriteLock(() => {
-      if (this.db.entityCount() === 0) return;
-      traced(
-        'kb.rank.pagerank',
-        { 'kb.entity_count': this.db.entityCount() },
-        () => this.db.structuralSample(1, 0.85),
-      );
-      traced(
-        'kb.rank.merw',
-        { 'kb.entity_count': this.db.entityCount() },
-        () => this.db.computeMerwPsi(0.85, 200, 1e-8),
-      );
+  async resample(): Promise<void> {
+    const entityCount = this.withReadLock(() => this.db.entityCount());
+    if (entityCount === 0) return;
+    await traced('kb.rank.resample', { 'kb.entity_count': entityCount }, async (span) => {
+      const result = await this.db.resampleAsync(1, 0.85, 0.85, 200, 1e-8);
+      span.setAttribute('kb.rank.visits', result.visits);
+      span.setAttribute('kb.rank.merw_iterations', result.iterations);
     });
   }
 
@@ -550,9 +502,25 @@ export class KnowledgeGraphManager {
     return entity;
   }
 
+  /**
+   * Entity objects for `offsets`, in order, read in one native call rather
+   * than a readEntity per offset. NOTE: Must be called inside a lock (read or write).
+   */
+  private entitiesAt(offsets: bigint[]): Entity[] {
+    const batch = this.db.readEntities(offsets, READ_NAME | READ_TYPE | READ_OBS | READ_TIMES);
+    const entities: Entity[] = new Array(batch.length);
+    for (let i = 0; i < batch.length; i++) {
+      const entity: Entity = { name: batch.name(i), entityType: batch.type(i), observations: batch.observations(i) };
+      if (batch.mtime(i) > 0) entity.mtime = batch.mtime(i);
+      if (batch.obsMtime(i) > 0) entity.obsMtime = batch.obsMtime(i);
+      entities[i] = entity;
+    }
+    return entities;
+  }
+
   /** Get all entities as Entity objects (preserves node log order = insertion order) */
   private getAllEntities(): Entity[] {
-    return this.db.listEntities().map(o => this.recordToEntity(this.db.readEntity(o)));
+    return this.entitiesAt(this.db.listEntities());
   }
 
   /** Get all relations by scanning adjacency lists (forward edges only to avoid duplication) */
@@ -572,6 +540,25 @@ export class KnowledgeGraphManager {
     return relations;
   }
 
+  /**
+   * Relations touching the given entities (forward: outgoing, backward:
+   * incoming, any: among them), names resolved in C. Reads only these
+   * entities' adjacency. NOTE: Must be called inside a lock (read or write).
+   */
+  private relationsOf(offsets: bigint[], direction: 'forward' | 'backward' | 'any'): Relation[] {
+    return this.unpackRelations(this.db.setRelations(offsets, direction));
+  }
+
+  private unpackRelations({ names, types, rels, mtime }: PackedRelations): Relation[] {
+    const relations: Relation[] = new Array(mtime.length);
+    for (let i = 0; i < mtime.length; i++) {
+      const r: Relation = { from: names[rels[3 * i]], to: names[rels[3 * i + 1]], relationType: types[rels[3 * i + 2]] };
+      if (mtime[i] > 0) r.mtime = mtime[i];
+      relations[i] = r;
+    }
+    return relations;
+  }
+
   /** Load the full graph (entities + relations) */
   private loadGraph(): KnowledgeGraph {
     return {
@@ -580,7 +567,17 @@ export class KnowledgeGraphManager {
     };
   }
 
-  async createEntities(entities: Entity[]): Promise<Entity[]> {
+  /**
+   * Names of existing entities whose text (name + observations) nearly
+   * duplicates the given one, most similar first. NOTE: Must be called inside
+   * a lock (read or write).
+   */
+  private nearDuplicatesUnlocked(name: string, observations: string[], limit: number = 3): string[] {
+    return this.db.nearDuplicates([name, ...observations].join(' '), NEAR_DUPLICATE_SIMILARITY, limit)
+      .map(h => this.db.entityName(h.offset));
+  }
+
+  async createEntities(entities: Entity[]): Promise<(Entity & { nearDuplicates?: string[] })[]> {
     // Validate observation limits (can do outside lock)
     for (const entity of entities) {
       if (entity.observations.length > 2) {
@@ -595,7 +592,7 @@ export class KnowledgeGraphManager {
 
     return this.withWriteLock(() => {
       const now = BigInt(Date.now());
-      const newEntities: Entity[] = [];
+      const newEntities: (Entity & { nearDuplicates?: string[] })[] = [];
 
       for (const e of entities) {
         const existingOffset = this.db.lookup(e.name);
@@ -608,16 +605,19 @@ export class KnowledgeGraphManager {
           throw new Error(`Entity "${e.name}" already exists with different data (type: "${existing.entityType}" vs "${e.entityType}", observations: ${existing.observations.length} vs ${e.observations.length})`);
         }
 
+        // Checked before creating, so the entity cannot match itself.
+        const similar = this.nearDuplicatesUnlocked(e.name, e.observations);
         const offset = this.db.createEntity(e.name, e.entityType, now);
         for (const obs of e.observations) {
           this.db.addObservation(offset, obs, now);
         }
 
-        const newEntity: Entity = {
+        const newEntity: Entity & { nearDuplicates?: string[] } = {
           ...e,
           mtime: Number(now),
           obsMtime: e.observations.length > 0 ? Number(now) : undefined,
         };
+        if (similar.length) newEntity.nearDuplicates = similar;
         newEntities.push(newEntity);
       }
 
@@ -656,7 +656,8 @@ export class KnowledgeGraphManager {
       for (const o of observations) {
         const offset = this.db.lookup(o.entityName);
         if (offset === 0n) {
-          throw new Error(`Entity with name ${o.entityName} not found`);
+          const hint = this.didYouMeanUnlocked(o.entityName);
+          throw new Error(`Entity with name ${o.entityName} not found${hint ? `. ${hint}` : ''}`);
         }
 
         for (const obs of o.contents) {
@@ -725,69 +726,299 @@ export class KnowledgeGraphManager {
   /**
    * Regex-based entity search.
    *
-   * Internally tries to extract a trigram filter from the regex source via
-   * {@link extractRequiredTrigramFilter}. If extraction succeeds we use the
-   * trigram index to narrow the candidate set before running the regex; if
-   * not (regex contains metacharacters we don't safely handle), we fall back
-   * to the linear scan. Same external contract — caller still passes a
-   * regex; the speedup is invisible.
+   * The native search turns the regex into a boolean trigram query and reads
+   * the candidate strings from the trigram index kept in the strings file, so
+   * the regex only runs against strings that can match. Patterns with no usable
+   * trigrams fall back to the linear scan. Same external contract — caller
+   * still passes a regex; the speedup is invisible.
    */
   async searchNodes(
     query: string,
     sortBy?: EntitySortField,
     sortDir?: SortDirection,
     direction: 'forward' | 'backward' | 'any' = 'forward',
+    caseInsensitive = false,
   ): Promise<KnowledgeGraph> {
-    // Validate with the SAME engine that matches (C POSIX ERE), so a valid ERE
-    // query is never rejected by a divergent JS RegExp dialect, and an invalid one
-    // is rejected consistently. Preserves the "Invalid regex pattern" contract.
-    if (!this.db.regexValid(query)) {
-      throw new Error(`Invalid regex pattern: ${query}`);
-    }
+    this.prepareSearch(query, caseInsensitive);
 
     return traced(
       'kb.search_nodes',
       {
         'kb.search.direction': direction,
+        'kb.search.case_insensitive': caseInsensitive,
         'kb.search.query_length': query.length,
         ...(sortBy ? { 'kb.search.sort_by': sortBy } : {}),
       },
       (span) => this.withReadLock(() => {
-        const filteredEntities = this.db.search(query).map(o => this.recordToEntity(this.db.readEntity(o)));
-        const filteredEntityNames = new Set(filteredEntities.map(e => e.name));
-
-        const allRelations = this.getAllRelations();
-        const filteredRelations = allRelations.filter(r => {
-          if (direction === 'forward') return filteredEntityNames.has(r.from);
-          if (direction === 'backward') return filteredEntityNames.has(r.to);
-          return filteredEntityNames.has(r.from) && filteredEntityNames.has(r.to);
-        });
+        const matches = this.db.search(query, caseInsensitive);
+        const filteredEntities = this.entitiesAt(this.sortOffsetsUnlocked(matches, sortBy, sortDir));
+        const filteredRelations = this.relationsOf(matches, direction);
 
-        span.setAttribute('kb.search.used_trigram', false);
+        span.setAttribute('kb.search.used_trigram', this.db.regexIndexable(query));
         span.setAttribute('kb.search.scanned.entities', this.db.entityCount());
-        span.setAttribute('kb.search.scanned.relations', allRelations.length);
         span.setAttribute('kb.search.matched.entities', filteredEntities.length);
         span.setAttribute('kb.search.matched.relations', filteredRelations.length);
 
-        const rankMaps = this.getRankMapsUnlocked();
-        return {
-          entities: sortEntities(filteredEntities, sortBy, sortDir, rankMaps),
-          relations: filteredRelations,
-        };
+        return { entities: filteredEntities, relations: filteredRelations };
+      }),
+    );
+  }
+
+  /**
+   * One page of `searchNodes`, ranked and cut in C: only the entities on the
+   * page are read. Relations keep their own cursor over the whole result
+   * (forward: outgoing, backward: incoming, any: among all matches), as in
+   * `searchNodes`; the native page returns them from the same search pass,
+   * reading the match offsets alone, not the records.
+   * Ties rank by store position instead of at random, so pages never
+   * overlap. Name order walks the native name index; a file without one
+   * takes the full `searchNodes` path.
+   */
+  async searchNodesPage(
+    query: string,
+    sortBy?: EntitySortField,
+    sortDir?: SortDirection,
+    direction: 'forward' | 'backward' | 'any' = 'forward',
+    caseInsensitive = false,
+    entityCursor = 0,
+    relationCursor = 0,
+  ): Promise<{ entities: PaginatedResult<Entity>; relations: PaginatedResult<Relation> }> {
+    const rank = SEARCH_RANK[sortBy ?? 'llmrank'];
+    if (rank === undefined || (rank === RANK_NAME && !this.withReadLock(() => this.db.hasNameIndex()))) {
+      return paginateGraph(await this.searchNodes(query, sortBy, sortDir, direction, caseInsensitive), entityCursor, relationCursor);
+    }
+    this.prepareSearch(query, caseInsensitive);
+
+    return traced(
+      'kb.search_nodes',
+      {
+        'kb.search.direction': direction,
+        'kb.search.case_insensitive': caseInsensitive,
+        'kb.search.query_length': query.length,
+        'kb.search.entity_cursor': entityCursor,
+        ...(sortBy ? { 'kb.search.sort_by': sortBy } : {}),
+      },
+      (span) => this.withReadLock(() => {
+        const asc = (sortDir ?? (sortBy === 'name' ? 'asc' : 'desc')) === 'asc';
+        const page = this.db.searchPage(query, caseInsensitive, rank | (asc ? RANK_ASC : 0), entityCursor, SEARCH_PAGE_LIMIT, direction);
+        const fetched = this.entitiesAt(page.offsets);
+        const entities = paginateItems(fetched, 0, MAX_CHARS, page.total);
+        const shown = entities.items.length;
+        entities.nextCursor = shown < fetched.length ? entityCursor + shown : page.next;
+
+        const relations = this.unpackRelations(page.relations);
+
+        span.setAttribute('kb.search.used_trigram', this.db.regexIndexable(query));
+        span.setAttribute('kb.search.matched.entities', page.total);
+        span.setAttribute('kb.search.matched.relations', relations.length);
+
+        return { entities, relations: paginateItems(relations, relationCursor) };
+      }),
+    );
+  }
+
+  /**
+   * Keyword search over names and observations, ranked by BM25 in C. The word
+   * index is built on the first call, then maintained by the entity and
+   * observation ops. The cursor is a rank position; each page re-runs the top-k
+   * with k reaching one past the page, so `totalCount` is exact only on the
+   * last page (nextCursor null) and a lower bound before it.
+   */
+  async searchText(query: string, cursor = 0): Promise<PaginatedResult<Entity & { score: number }>> {
+    if (!this.withReadLock(() => this.db.hasTextIndex())) {
+      this.withWriteLock(() => { this.db.buildTextIndex(); });
+    }
+
+    return traced(
+      'kb.search_text',
+      {
+        'kb.search.query_length': query.length,
+        'kb.search.entity_cursor': cursor,
+      },
+      (span) => this.withReadLock(() => {
+        const hits = this.db.textSearch(query, cursor + SEARCH_PAGE_LIMIT + 1);
+        const shownHits = hits.slice(cursor, cursor + SEARCH_PAGE_LIMIT);
+        const fetched = this.entitiesAt(shownHits.map(h => h.offset)).map((e, i) => ({
+          ...e,
+          score: Math.round(shownHits[i].score * 1000) / 1000,
+        }));
+        const page = paginateItems(fetched, 0, MAX_CHARS, hits.length);
+        const shown = page.items.length;
+        page.nextCursor = shown < fetched.length ? cursor + shown
+          : hits.length > cursor + SEARCH_PAGE_LIMIT ? cursor + SEARCH_PAGE_LIMIT : null;
+
+        span.setAttribute('kb.search.scanned.entities', this.db.entityCount());
+        span.setAttribute('kb.search.matched.entities', hits.length);
+        return page;
+      }),
+    );
+  }
+
+  /**
+   * Attach client-computed embeddings to entities. The first call fixes the
+   * index's dimension and storage format; every later vector must match the
+   * dimension. All entities and vectors are checked before any is written.
+   */
+  async setEmbeddings(embeddings: { entityName: string; vector: number[] }[], quantization: EmbeddingQuantization = 'float16'): Promise<{ set: number; dimensions: number; quantization: EmbeddingQuantization }> {
+    return this.withWriteLock(() => {
+      const info = this.db.vectorInfo();
+      const dim = info?.dim ?? embeddings[0]?.vector.length ?? 0;
+      const format = info ? (Object.keys(VECTOR_FORMAT) as EmbeddingQuantization[]).find(q => VECTOR_FORMAT[q] === info.format)! : quantization;
+      const resolved = embeddings.map(e => {
+        const offset = this.db.lookup(e.entityName);
+        if (offset === 0n) {
+          const hint = this.didYouMeanUnlocked(e.entityName);
+          throw new Error(`Entity with name ${e.entityName} not found${hint ? `. ${hint}` : ''}`);
+        }
+        if (e.vector.length !== dim) {
+          throw new Error(`Embedding for "${e.entityName}" has ${e.vector.length} dimensions; the index holds ${dim}`);
+        }
+        if (!e.vector.some(x => x !== 0) || !e.vector.every(Number.isFinite)) {
+          throw new Error(`Embedding for "${e.entityName}" must be finite and not all zero`);
+        }
+        return { offset, vector: Float32Array.from(e.vector) };
+      });
+      if (resolved.length && !info && !this.db.vectorIndex(dim, VECTOR_FORMAT[format])) {
+        throw new Error(`Cannot create an embedding index of ${dim} dimensions (at most 4096)`);
+      }
+      for (const r of resolved) this.db.setVector(r.offset, r.vector);
+      return { set: resolved.length, dimensions: dim, quantization: format };
+    });
+  }
+
+  /**
+   * Entities whose embeddings are nearest `vector` by cosine similarity,
+   * through the native HNSW index (approximate), optionally of one type. The
+   * cursor is a rank position, as for searchText.
+   */
+  async searchEmbeddings(vector: number[], entityType?: string, cursor = 0): Promise<PaginatedResult<Entity & { similarity: number }>> {
+    return traced(
+      'kb.search_embeddings',
+      {
+        'kb.search.dimensions': vector.length,
+        'kb.search.entity_cursor': cursor,
+      },
+      (span) => this.withReadLock(() => {
+        const info = this.db.vectorInfo();
+        if (!info) throw new Error('No embeddings stored yet; add some with set_embeddings');
+        if (vector.length !== info.dim) throw new Error(`Query has ${vector.length} dimensions; the index holds ${info.dim}`);
+        const hits = this.db.vectorSearch(Float32Array.from(vector), cursor + SEARCH_PAGE_LIMIT + 1, entityType ?? null);
+        const shownHits = hits.slice(cursor, cursor + SEARCH_PAGE_LIMIT);
+        const fetched = this.entitiesAt(shownHits.map(h => h.offset)).map((e, i) => ({
+          ...e,
+          similarity: Math.round(shownHits[i].similarity * 1000) / 1000,
+        }));
+        const page = paginateItems(fetched, 0, MAX_CHARS, hits.length);
+        const shown = page.items.length;
+        page.nextCursor = shown < fetched.length ? cursor + shown
+          : hits.length > cursor + SEARCH_PAGE_LIMIT ? cursor + SEARCH_PAGE_LIMIT : null;
+
+        span.setAttribute('kb.search.embedded.entities', info.count);
+        span.setAttribute('kb.search.matched.entities', hits.length);
+        return page;
+      }),
+    );
+  }
+
+  /**
+   * Entity names in name order (case-insensitive), straight off the native
+   * name index: those starting with `prefix` (all when empty), optionally from
+   * the first name at or after `startAt`. The cursor counts from there, so a
+   * page costs a seek plus the names on it.
+   */
+  async listNames(prefix = '', startAt?: string, cursor = 0): Promise<PaginatedResult<{ name: string; entityType: string }>> {
+    return traced(
+      'kb.list_names',
+      {
+        'kb.names.prefix_length': prefix.length,
+        'kb.names.cursor': cursor,
+      },
+      (span) => this.withReadLock(() => {
+        const range = this.db.namePrefix(prefix);
+        const end = range.first + range.count;
+        const from = startAt === undefined ? range.first : Math.min(end, Math.max(range.first, this.db.nameRank(startAt)));
+        const total = end - from;
+        const slice = cursor < total ? this.db.namesAt(from + cursor, Math.min(SEARCH_PAGE_LIMIT, total - cursor)) : [];
+        const batch = this.db.readEntities(slice, READ_NAME | READ_TYPE);
+        const fetched = Array.from({ length: batch.length }, (_, i) => ({ name: batch.name(i), entityType: batch.type(i) }));
+        const page = paginateItems(fetched, 0, MAX_CHARS, total);
+        const next = cursor + page.items.length;
+        page.nextCursor = next < total ? next : null;
+
+        span.setAttribute('kb.names.matched', total);
+        return page;
+      }),
+    );
+  }
+
+  /**
+   * What changed at or after `since` (ms): entities by mtime or obsMtime and
+   * relations by mtime, newest first, each list paged by its own cursor. Both
+   * come off the native recency trees, so a page costs a seek plus its items.
+   * Relation types linking one pair at one instant share a cursor position and
+   * stay on one page.
+   */
+  async getRecentChanges(since = 0, sortBy: 'mtime' | 'obsMtime' = 'mtime', entityCursor = 0, relationCursor = 0):
+      Promise<{ entities: PaginatedResult<Entity>; relations: PaginatedResult<Relation> }> {
+    return traced(
+      'kb.get_recent_changes',
+      { 'kb.recent.since': since, 'kb.recent.sort_by': sortBy },
+      (span) => this.withReadLock(() => {
+        const from = BigInt(Math.max(0, Math.floor(since)));
+        const changed = this.db.changedSince(sortBy === 'obsMtime' ? RANK_OBS_MTIME : RANK_MTIME, from, entityCursor, SEARCH_PAGE_LIMIT);
+        const entities = paginateItems(this.entitiesAt(changed.offsets), 0, MAX_CHARS, changed.total);
+        const nextEntity = entityCursor + entities.items.length;
+        entities.nextCursor = nextEntity < changed.total ? nextEntity : null;
+
+        const packed = this.db.relationsSince(from, relationCursor, SEARCH_PAGE_LIMIT);
+        const fetched = this.unpackRelations(packed);
+        const relations = paginateItems(fetched, 0, MAX_CHARS, packed.total);
+        let cut = relations.items.length;
+        while (cut > 1 && cut < fetched.length && packed.entry[cut - 1] === packed.entry[cut]) cut--;   // keep an entry whole
+        relations.items = relations.items.slice(0, cut);
+        const nextRelation = cut < fetched.length ? packed.entry[cut] : cut ? packed.entry[cut - 1] + 1 : relationCursor;
+        relations.nextCursor = nextRelation < packed.total ? Math.max(nextRelation, relationCursor + 1) : null;
+
+        span.setAttribute('kb.recent.entities', changed.total);
+        span.setAttribute('kb.recent.relation_entries', packed.total);
+        return { entities, relations };
       }),
     );
   }
 
+  /**
+   * Validate a search pattern and build the indexes it reads.
+   *
+   * Validation uses the SAME engine that matches (C POSIX ERE), so a valid ERE
+   * query is never rejected by a divergent JS RegExp dialect, and an invalid one
+   * is rejected consistently. Preserves the "Invalid regex pattern" contract.
+   */
+  private prepareSearch(query: string, caseInsensitive: boolean): void {
+    if (!this.db.regexValid(query)) {
+      throw new Error(`Invalid regex pattern: ${query}`);
+    }
+    // Case-insensitive search reads the string table's case-fold shadows. They are
+    // built once per file (first such query), then maintained by intern/release.
+    if (caseInsensitive && !this.withReadLock(() => this.db.hasFoldIndex())) {
+      this.withWriteLock(() => { this.db.buildFoldIndex(); });
+    }
+    // Likewise the trigram index: built over existing strings on the first search.
+    if (!this.withReadLock(() => this.db.hasTrigramIndex())) {
+      this.withWriteLock(() => { this.db.buildTrigramIndex(); });
+    }
+  }
+
   async openNodes(names: string[], direction: 'forward' | 'backward' | 'any' = 'forward'): Promise<KnowledgeGraph> {
     return this.withReadLock(() => {
-      const filteredEntities: Entity[] = [];
+      const offsets: bigint[] = [];
       const offsetByName = new Map<string, bigint>();
       for (const name of names) {
         const offset = this.db.lookup(name);
         if (offset === 0n) continue;
-        filteredEntities.push(this.recordToEntity(this.db.readEntity(offset)));
+        offsets.push(offset);
         offsetByName.set(name, offset);
       }
+      const filteredEntities = this.entitiesAt(offsets);
 
       const filteredEntityNames = new Set(filteredEntities.map(e => e.name));
 
@@ -845,20 +1076,17 @@ export class KnowledgeGraphManager {
         // C BFS returns neighbor offsets within `depth` hops, excluding start.
         // The old TS semantics were one hop deeper (depth=0 returned immediate
         // neighbors), so request depth+1 from C to match.
-        const neighbors: Neighbor[] = this.db.neighbors(startOffset, depth + 1, direction).map(off => {
-          const rec = this.db.readEntity(off);
-          const mtime = Number(rec.mtime);
-          const obsMtime = Number(rec.obsMtime);
-          const n: Neighbor = { name: rec.name };
-          if (mtime > 0) n.mtime = mtime;
-          if (obsMtime > 0) n.obsMtime = obsMtime;
+        const offsets = this.sortOffsetsUnlocked(this.db.neighbors(startOffset, depth + 1, direction), sortBy, sortDir);
+        const batch = this.db.readEntities(offsets, READ_NAME | READ_TIMES);
+        const neighbors: Neighbor[] = Array.from({ length: batch.length }, (_, i) => {
+          const n: Neighbor = { name: batch.name(i) };
+          if (batch.mtime(i) > 0) n.mtime = batch.mtime(i);
+          if (batch.obsMtime(i) > 0) n.obsMtime = batch.obsMtime(i);
           return n;
         });
 
         span.setAttribute('kb.traversal.neighbor_count', neighbors.length);
-
-        const rankMaps = this.getRankMapsUnlocked();
-        return sortNeighbors(neighbors, sortBy, sortDir, rankMaps);
+        return neighbors;
       }),
     );
   }
@@ -943,7 +1171,10 @@ export class KnowledgeGraphManager {
         // farthest-discovered node when the target isn't reached (β-contract).
         // The byte budget bounds the C BFS just as it bounded the old JS BFS;
         // KB_FIND_PATH_BUDGET_BYTES flows in via findPathBudgetBytes().
-        const res = this.db.findPath(fromOffset, toOffset, maxDepth, direction, BigInt(budgetBytes));
+        // Searched from both ends: around a hub the two frontiers meet after
+        // ~b^(d/2) discoveries each instead of b^d from one side. farthest
+        // stays on the `from` side, so the partial path is unchanged in shape.
+        const res = this.db.findPath(fromOffset, toOffset, maxDepth, direction, BigInt(budgetBytes), true);
         const found = res.targetReached;
         const nodePath = res.path;
 
@@ -989,97 +1220,86 @@ export class KnowledgeGraphManager {
 
   async getEntitiesByType(entityType: string, sortBy?: EntitySortField, sortDir?: SortDirection): Promise<Entity[]> {
     return this.withReadLock(() => {
-      const filtered = this.getAllEntities().filter(e => e.entityType === entityType);
-      const rankMaps = this.getRankMapsUnlocked();
-      return sortEntities(filtered, sortBy, sortDir, rankMaps);
+      return this.entitiesAt(this.sortOffsetsUnlocked(this.db.entitiesByType(entityType), sortBy, sortDir));
     });
   }
 
+  /**
+   * One page of getEntitiesByType as the tool's JSON text, sorted, cut and
+   * serialized natively: only the entities on the page are ever read.
+   */
+  async getEntitiesByTypePage(entityType: string, sortBy?: EntitySortField, sortDir?: SortDirection, cursor: number = 0): Promise<string> {
+    return this.withReadLock(() => this.jsonPageUnlocked(this.db.entitiesByType(entityType), sortBy, sortDir, cursor));
+  }
+
   async getEntityTypes(): Promise<string[]> {
     return this.withReadLock(() => {
-      const types = new Set(this.getAllEntities().map(e => e.entityType));
-      return Array.from(types).sort();
+      return this.db.entityTypes().sort();
     });
   }
 
   async getRelationTypes(): Promise<string[]> {
     return this.withReadLock(() => {
-      const types = new Set(this.getAllRelations().map(r => r.relationType));
-      return Array.from(types).sort();
+      return this.db.relationTypes().sort();
     });
   }
 
   async getStats(): Promise<{ entityCount: number; relationCount: number; entityTypes: number; relationTypes: number }> {
-    return this.withReadLock(() => {
-      const entities = this.getAllEntities();
-      const relations = this.getAllRelations();
-      const entityTypes = new Set(entities.map(e => e.entityType));
-      const relationTypes = new Set(relations.map(r => r.relationType));
-
-      return {
-        entityCount: entities.length,
-        relationCount: relations.length,
-        entityTypes: entityTypes.size,
-        relationTypes: relationTypes.size,
-      };
-    });
+    return this.withReadLock(() => ({
+      entityCount: this.db.entityCount(),
+      relationCount: this.db.relationCount(),
+      entityTypes: this.db.entityTypes().length,
+      relationTypes: this.db.relationTypes().length,
+    }));
   }
 
   async getOrphanedEntities(strict: boolean = false, sortBy?: EntitySortField, sortDir?: SortDirection): Promise<Entity[]> {
+    return this.withOrphans(strict, offsets =>
+      this.entitiesAt(this.sortOffsetsUnlocked(offsets, sortBy, sortDir)));
+  }
+
+  /** One page of getOrphanedEntities as the tool's JSON text (see getEntitiesByTypePage). */
+  async getOrphanedEntitiesPage(strict: boolean = false, sortBy?: EntitySortField, sortDir?: SortDirection, cursor: number = 0): Promise<string> {
+    return this.withOrphans(strict, offsets => this.jsonPageUnlocked(offsets, sortBy, sortDir, cursor));
+  }
+
+  /** Run `fn` on the orphan offsets (strict: outside Self's component) under
+   *  a read lock, inside the `kb.get_orphaned_entities` span. */
+  private withOrphans<T>(strict: boolean, fn: (offsets: bigint[]) => T): T {
+    // Strict mode reads component labels; a relation removal drops them, so
+    // relabel first (same lazy pattern as the text index).
+    if (strict && !this.withReadLock(() => this.db.hasComponents())) {
+      this.withWriteLock(() => { this.db.buildComponents(); });
+    }
+
     return traced(
       'kb.get_orphaned_entities',
       { 'kb.orphan.strict': strict },
       (span) => this.withReadLock(() => {
-        const entities = this.getAllEntities();
-
-        if (!strict) {
-          const connectedEntityNames = new Set<string>();
-          const relations = this.getAllRelations();
-          relations.forEach(r => {
-            connectedEntityNames.add(r.from);
-            connectedEntityNames.add(r.to);
-          });
-          const orphans = entities.filter(e => !connectedEntityNames.has(e.name));
-          span.setAttribute('kb.entity_count', entities.length);
-          span.setAttribute('kb.relation_count', relations.length);
-          span.setAttribute('kb.orphan.count', orphans.length);
-          const rankMaps = this.getRankMapsUnlocked();
-          return sortEntities(orphans, sortBy, sortDir, rankMaps);
-        }
-
-        const neighbors = new Map<string, Set<string>>();
-        entities.forEach(e => neighbors.set(e.name, new Set()));
-        const relations = this.getAllRelations();
-        relations.forEach(r => {
-          neighbors.get(r.from)?.add(r.to);
-          neighbors.get(r.to)?.add(r.from);
-        });
-
-        const connectedToSelf = new Set<string>();
-        const queue: string[] = ['Self'];
-
-        while (queue.length > 0) {
-          const current = queue.shift()!;
-          if (connectedToSelf.has(current)) continue;
-          connectedToSelf.add(current);
-
-          const currentNeighbors = neighbors.get(current);
-          if (currentNeighbors) {
-            for (const neighbor of currentNeighbors) {
-              if (!connectedToSelf.has(neighbor)) {
-                queue.push(neighbor);
-              }
-            }
-          }
-        }
+        const offsets = strict ? this.db.outsideComponent(this.db.lookup('Self')) : this.db.orphaned();
+        span.setAttribute('kb.entity_count', this.db.entityCount());
+        span.setAttribute('kb.relation_count', this.db.relationCount());
+        span.setAttribute('kb.orphan.count', offsets.length);
+        if (strict) span.setAttribute('kb.orphan.connected_to_self', this.db.entityCount() - offsets.length);
+        return fn(offsets);
+      }),
+    );
+  }
 
-        const orphans = entities.filter(e => !connectedToSelf.has(e.name));
-        span.setAttribute('kb.entity_count', entities.length);
-        span.setAttribute('kb.relation_count', relations.length);
-        span.setAttribute('kb.orphan.count', orphans.length);
-        span.setAttribute('kb.orphan.connected_to_self', connectedToSelf.size);
-        const rankMaps = this.getRankMapsUnlocked();
-        return sortEntities(orphans, sortBy, sortDir, rankMaps);
+  /**
+   * Groups of near-duplicate entities across the whole graph: entities chained
+   * by pairs whose name + observations reach `minSimilarity`. Pairs come from
+   * the native LSH buckets, so the pass never compares every entity with every
+   * other. Groups are ordered by their oldest entity.
+   */
+  async findDuplicates(minSimilarity: number = NEAR_DUPLICATE_SIMILARITY): Promise<string[][]> {
+    return traced(
+      'kb.find_duplicates',
+      { 'kb.duplicates.min_similarity': minSimilarity },
+      (span) => this.withReadLock(() => {
+        const clusters = this.db.duplicateClusters(minSimilarity).map(c => c.map(o => this.db.entityName(o)));
+        span.setAttribute('kb.duplicates.clusters', clusters.length);
+        return clusters;
       }),
     );
   }
@@ -1134,7 +1354,8 @@ export class KnowledgeGraphManager {
       (span) => this.withReadLock(() => {
         const startOffset = this.db.lookup(start);
         if (startOffset === 0n) {
-          throw new Error(`Start entity not found: ${start}`);
+          const hint = this.didYouMeanUnlocked(start);
+          throw new Error(`Start entity not found: ${start}${hint ? `. ${hint}` : ''}`);
         }
 
         // Seeded walk: hash the string seed to a u64 the C RNG can use. A
@@ -1414,7 +1635,8 @@ server.setRequestHandler(ListToolsRequestSchema, async () => {
           type: "object",
           properties: {
             query: { type: "string", description: "Regex pattern to match against entity names, types, and observations." },
-            direction: { type: "string", enum: ["forward", "backward", "any"], description: "Edge direction filter for returned relations. Default: forward" },
+            caseInsensitive: { type: "boolean", description: "Match regardless of letter case (Latin, Greek, Cyrillic). Default: false" },
+            direction: { type: "string", enum: ["forward", "backward", "any"], description: "Edge direction filter for the relations of the returned entities. Default: forward" },
             sortBy: { type: "string", enum: ["mtime", "obsMtime", "name", "pagerank", "llmrank"], description: "Sort field for entities. Omit for insertion order." },
             sortDir: { type: "string", enum: ["asc", "desc"], description: "Sort direction. Default: desc for timestamps, asc for name." },
             entityCursor: { type: "number", description: "Cursor for entity pagination (from previous response's nextCursor)" },
@@ -1423,6 +1645,78 @@ server.setRequestHandler(ListToolsRequestSchema, async () => {
           required: ["query"],
         },
       },
+      {
+        name: "search_text",
+        description: "Keyword search over entity names and observations, ranked by relevance (BM25): whole words, case-insensitive, any word may match and rarer words weigh more. Use search_nodes for regex patterns. Results are paginated (max 4096 chars).",
+        inputSchema: {
+          type: "object",
+          properties: {
+            query: { type: "string", description: "Words to look for, e.g. \"graph storage format\"" },
+            cursor: { type: "number", description: "Cursor for pagination (from previous response's nextCursor)" },
+          },
+          required: ["query"],
+        },
+      },
+      {
+        name: "set_embeddings",
+        description: "Attach embedding vectors (computed by you or your client) to existing entities, for similarity search with search_embeddings. Every vector must have the same number of dimensions; the first call fixes it, and the storage format. Setting a vector again replaces it; deleting an entity drops it.",
+        inputSchema: {
+          type: "object",
+          properties: {
+            embeddings: {
+              type: "array",
+              items: {
+                type: "object",
+                properties: {
+                  entityName: { type: "string", description: "The entity to attach the vector to" },
+                  vector: { type: "array", items: { type: "number" }, description: "The embedding (at most 4096 numbers)" },
+                },
+                required: ["entityName", "vector"],
+              },
+            },
+            quantization: { type: "string", enum: ["float32", "float16", "int8"], description: "How vectors are stored, fixed by the first call: float32 is exact, float16 halves the space, int8 quarters it at a small loss in precision. Default: float16" },
+          },
+          required: ["embeddings"],
+        },
+      },
+      {
+        name: "search_embeddings",
+        description: "Find the entities whose embeddings are most similar (cosine) to a query vector, most similar first; approximate, over an index. Optionally only entities of one type. The query must have the dimensions of the stored embeddings. Results are paginated (max 4096 chars).",
+        inputSchema: {
+          type: "object",
+          properties: {
+            vector: { type: "array", items: { type: "number" }, description: "The query embedding" },
+            entityType: { type: "string", description: "Only entities of this type" },
+            cursor: { type: "number", description: "Cursor for pagination (from previous response's nextCursor)" },
+          },
+          required: ["vector"],
+        },
+      },
+      {
+        name: "list_names",
+        description: "List entity names in alphabetical order (case-insensitive), optionally only those starting with a prefix — for autocomplete or browsing the graph by name. Returns names and entity types only; use open_nodes for details. Results are paginated (max 4096 chars).",
+        inputSchema: {
+          type: "object",
+          properties: {
+            prefix: { type: "string", description: "Only names starting with this (case-insensitive). Omit to list every name." },
+            startAt: { type: "string", description: "Begin at the first name at or after this one (case-insensitive)" },
+            cursor: { type: "number", description: "Cursor for pagination (from previous response's nextCursor)" },
+          },
+        },
+      },
+      {
+        name: "get_recent_changes",
+        description: "Get what changed at or after a point in time: entities (by mtime or obsMtime) and relations (by mtime), newest first. Use it to reload recent context. Results are paginated (max 4096 chars per list).",
+        inputSchema: {
+          type: "object",
+          properties: {
+            since: { type: "number", description: "Unix timestamp in milliseconds; only changes at or after it. Default: 0 (everything, newest first)" },
+            sortBy: { type: "string", enum: ["mtime", "obsMtime"], description: "Entity timestamp to use: any change (mtime) or observation changes only (obsMtime). Default: mtime" },
+            entityCursor: { type: "number", description: "Cursor for entity pagination" },
+            relationCursor: { type: "number", description: "Cursor for relation pagination" },
+          },
+        },
+      },
       {
         name: "open_nodes",
         description: "Open specific nodes in the knowledge graph by their names. Results are paginated (max 4096 chars).",
@@ -1527,6 +1821,17 @@ server.setRequestHandler(ListToolsRequestSchema, async () => {
           },
         },
       },
+      {
+        name: "find_duplicates",
+        description: "Find groups of near-duplicate entities: entities whose name and observations are nearly the same text (estimated shingle overlap), chained together. Use it to spot entities worth merging. Results are paginated (max 4096 chars).",
+        inputSchema: {
+          type: "object",
+          properties: {
+            minSimilarity: { type: "number", description: "Similarity (0-1) at which two entities count as duplicates. Default: 0.8" },
+            cursor: { type: "number", description: "Cursor for pagination" },
+          },
+        },
+      },
       {
         name: "validate_graph",
         description: "Validate the knowledge graph. Returns missing entities referenced in relations and observation limit violations (>2 observations or >140 chars). Each list is independently paginated (max 4096 chars per list).",
@@ -1630,34 +1935,37 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
     switch (name) {
       case "create_entities": {
         const result = await knowledgeGraphManager.createEntities(args.entities as Entity[]);
-        knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
+        await knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
         return { content: [{ type: "text", text: JSON.stringify(result, null, 2) }] };
       }
       case "create_relations": {
         const result = await knowledgeGraphManager.createRelations(args.relations as Relation[]);
-        knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
+        await knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
         return { content: [{ type: "text", text: JSON.stringify(result, null, 2) }] };
       }
       case "add_observations":
         return { content: [{ type: "text", text: JSON.stringify(await knowledgeGraphManager.addObservations(args.observations as { entityName: string; contents: string[] }[]), null, 2) }] };
       case "delete_entities":
         await knowledgeGraphManager.deleteEntities(args.entityNames as string[]);
-        knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
+        await knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
         return { content: [{ type: "text", text: "Entities deleted successfully" }] };
       case "delete_observations":
         await knowledgeGraphManager.deleteObservations(args.deletions as { entityName: string; observations: string[] }[]);
         return { content: [{ type: "text", text: "Observations deleted successfully" }] };
       case "delete_relations":
         await knowledgeGraphManager.deleteRelations(args.relations as Relation[]);
-        knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
+        await knowledgeGraphManager.resample(); // Re-run structural sampling after graph mutation
         return { content: [{ type: "text", text: "Relations deleted successfully" }] };
       case "search_nodes": {
         const query = args.query as string;
-        const graph = await knowledgeGraphManager.searchNodes(
+        const page = await knowledgeGraphManager.searchNodesPage(
           query,
           args.sortBy as EntitySortField | undefined,
           args.sortDir as SortDirection | undefined,
           (args.direction as 'forward' | 'backward' | 'any') ?? 'forward',
+          args.caseInsensitive === true,
+          args.entityCursor as number ?? 0,
+          args.relationCursor as number ?? 0,
         );
 
         // Natural-language guard: literal queries (no regex metacharacters) that
@@ -1665,7 +1973,7 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
         // for a vector-search/NL-search endpoint. Surface a tool-level error
         // (visible to the model) with a regex suggestion. Skip walker-visit
         // recording on this path so failed NL queries don't bias llmrank.
-        if (!HAS_REGEX_META.test(query) && graph.entities.length === 0 && graph.relations.length === 0) {
+        if (!HAS_REGEX_META.test(query) && page.entities.totalCount === 0 && page.relations.totalCount === 0) {
           const suggested = query.trim().split(/\s+/).filter(Boolean).join('|');
           const suggestion = suggested && suggested !== query
             ? ` For multiple terms try ${JSON.stringify(suggested)}.`
@@ -1673,15 +1981,45 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
           return {
             content: [{
               type: "text",
-              text: `No matches for ${JSON.stringify(query)}. search_nodes uses POSIX Extended Regular Expressions (ERE), case-sensitive — not natural language, and not JS/PCRE regex (use [0-9] not \\d, [[:alpha:]] not \\w; no lookahead or backreferences).${suggestion} You can also browse with get_entities_by_type, get_neighbors, or random_walk.`,
+              text: `No matches for ${JSON.stringify(query)}. search_nodes uses POSIX Extended Regular Expressions (ERE), case-sensitive unless caseInsensitive is set — not natural language, and not JS/PCRE regex (use [0-9] not \\d, [[:alpha:]] not \\w; no lookahead or backreferences).${suggestion} For keyword search use search_text; you can also browse with get_entities_by_type, get_neighbors, or random_walk.`,
             }],
             isError: true,
           };
         }
 
         // Record walker visits for entities that will be returned to the LLM
-        knowledgeGraphManager.recordWalkerVisits(graph.entities.map(e => e.name));
-        return { content: [{ type: "text", text: JSON.stringify(paginateGraph(graph, args.entityCursor as number ?? 0, args.relationCursor as number ?? 0)) }] };
+        knowledgeGraphManager.recordWalkerVisits(page.entities.items.map(e => e.name));
+        return { content: [{ type: "text", text: JSON.stringify(page) }] };
+      }
+      case "search_text": {
+        const page = await knowledgeGraphManager.searchText(args.query as string, args.cursor as number ?? 0);
+        knowledgeGraphManager.recordWalkerVisits(page.items.map(e => e.name));
+        return { content: [{ type: "text", text: JSON.stringify(page) }] };
+      }
+      case "set_embeddings": {
+        const result = await knowledgeGraphManager.setEmbeddings(
+          args.embeddings as { entityName: string; vector: number[] }[],
+          args.quantization as EmbeddingQuantization | undefined,
+        );
+        return { content: [{ type: "text", text: JSON.stringify(result) }] };
+      }
+      case "search_embeddings": {
+        const page = await knowledgeGraphManager.searchEmbeddings(args.vector as number[], args.entityType as string | undefined, args.cursor as number ?? 0);
+        knowledgeGraphManager.recordWalkerVisits(page.items.map(e => e.name));
+        return { content: [{ type: "text", text: JSON.stringify(page) }] };
+      }
+      case "list_names": {
+        const page = await knowledgeGraphManager.listNames(args.prefix as string ?? '', args.startAt as string | undefined, args.cursor as number ?? 0);
+        return { content: [{ type: "text", text: JSON.stringify(page) }] };
+      }
+      case "get_recent_changes": {
+        const changes = await knowledgeGraphManager.getRecentChanges(
+          args.since as number ?? 0,
+          (args.sortBy as 'mtime' | 'obsMtime') ?? 'mtime',
+          args.entityCursor as number ?? 0,
+          args.relationCursor as number ?? 0,
+        );
+        return { content: [{ type: "text", text: JSON.stringify(changes) }] };
       }
       case "open_nodes": {
         const graph = await knowledgeGraphManager.openNodes(args.names as string[], (args.direction as 'forward' | 'backward' | 'any') ?? 'forward');
@@ -1717,7 +2055,10 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
         } else if (!result.targetReached) {
           note = result.farthestDiscovered === undefined
             ? `find_path could not expand any edges from '${args.fromEntity}' in direction '${(args.direction as string) ?? 'forward'}'. ` +
-              `The 'path' is empty. Check the entity name and direction; the source may have no matching outgoing relations.`
+              `The 'path' is empty. Check the entity name and direction; the source may have no matching outgoing relations.` +
+              [args.fromEntity as string, toEntityName]
+                .map(n => { const hint = knowledgeGraphManager.didYouMean(n); return hint ? ` No entity '${n}'. ${hint}` : ''; })
+                .join('')
             : `find_path could not reach '${toEntityName}' within maxDepth=${args.maxDepth ?? 5}. ` +
               `The returned 'path' is a best-effort exploration that ended at '${result.farthestDiscovered}'. ` +
               `Call find_path again with fromEntity='${result.farthestDiscovered}' to continue toward the target, ` +
@@ -1732,8 +2073,8 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
         }) }] };
       }
       case "get_entities_by_type": {
-        const entities = await knowledgeGraphManager.getEntitiesByType(args.entityType as string, args.sortBy as EntitySortField | undefined, args.sortDir as SortDirection | undefined);
-        return { content: [{ type: "text", text: JSON.stringify(paginateItems(entities, args.cursor as number ?? 0)) }] };
+        const text = await knowledgeGraphManager.getEntitiesByTypePage(args.entityType as string, args.sortBy as EntitySortField | undefined, args.sortDir as SortDirection | undefined, args.cursor as number ?? 0);
+        return { content: [{ type: "text", text }] };
       }
       case "get_entity_types": {
         const types = await knowledgeGraphManager.getEntityTypes();
@@ -1746,8 +2087,12 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
       case "get_stats":
         return { content: [{ type: "text", text: JSON.stringify(await knowledgeGraphManager.getStats(), null, 2) }] };
       case "get_orphaned_entities": {
-        const entities = await knowledgeGraphManager.getOrphanedEntities(args.strict as boolean ?? false, args.sortBy as EntitySortField | undefined, args.sortDir as SortDirection | undefined);
-        return { content: [{ type: "text", text: JSON.stringify(paginateItems(entities, args.cursor as number ?? 0)) }] };
+        const text = await knowledgeGraphManager.getOrphanedEntitiesPage(args.strict as boolean ?? false, args.sortBy as EntitySortField | undefined, args.sortDir as SortDirection | undefined, args.cursor as number ?? 0);
+        return { content: [{ type: "text", text }] };
+      }
+      case "find_duplicates": {
+        const clusters = await knowledgeGraphManager.findDuplicates(args.minSimilarity as number | undefined);
+        return { content: [{ type: "text", text: JSON.stringify(paginateItems(clusters, args.cursor as number ?? 0)) }] };
       }
       case "validate_graph": {
         const report = await knowledgeGraphManager.validateGraph();
@@ -1811,7 +2156,7 @@ The file MUST be plaintext (.txt, .tex, .md, source code, etc.). For PDFs, use p
             relationType: r.relationType,
           }))
         );
-        knowledgeGraphManager.resample();
+        await knowledgeGraphManager.resample();
 
         return {
           content: [{
@@ -18,6 +18,72 @@ export const DIR_FORWARD = 0;
 export const DIR_BACKWARD = 1;
 export const DIR_ANY = 255;
 
+// Search flags (must match GRAPH_SEARCH_* in graph.h).
+export const SEARCH_ICASE = 1;
+
+// Paged-search ranking keys (must match GRAPH_RANK_* in graph.h); descending unless RANK_ASC.
+export const RANK_NONE = 0;
+export const RANK_MTIME = 1;
+export const RANK_OBS_MTIME = 2;
+export const RANK_STRUCTURAL = 3;
+export const RANK_WALKER = 4;
+export const RANK_NAME = 5;
+export const RANK_ASC = 0x100;
+
+// Column mask of readEntities (must match READ_* in graphbind.c).
+export const READ_NAME = 0x01;
+export const READ_TYPE = 0x02;
+export const READ_OBS = 0x04;
+export const READ_TIMES = 0x08;
+export const READ_VISITS = 0x10;
+export const READ_PSI = 0x20;
+
+// Entity-vector storage formats (must match GRAPH_VEC_* in graph.h).
+export const VEC_F32 = 0;
+export const VEC_F16 = 1;
+export const VEC_I8 = 2;
+
+/** One page of search results. `next` is the cursor of the following page (null = last page);
+ *  `total` counts every match. `relations` are those among all matches in the given
+ *  direction, taken from the same native pass as the page. */
+export interface SearchPage {
+  offsets: bigint[];
+  next: number | null;
+  total: number;
+  relations: PackedRelations;
+}
+
+/** One full-text hit: an entity and its BM25 score. */
+export interface TextHit {
+  offset: bigint;
+  score: number;
+}
+
+/** One fuzzy name match: an entity and its edit distance from the query. */
+export interface FuzzyHit {
+  offset: bigint;
+  distance: number;
+}
+
+/** One near-duplicate: an entity and the estimated similarity of its text to the query. */
+export interface DuplicateHit {
+  offset: bigint;
+  similarity: number;
+}
+
+/** One vector-search hit: an entity and the cosine similarity of its vector to the query. */
+export interface VectorHit {
+  offset: bigint;
+  similarity: number;
+}
+
+/** The entity-vector index: its fixed dimension and format (VEC_*), and how many entities carry a vector. */
+export interface VectorInfo {
+  dim: number;
+  format: number;
+  count: number;
+}
+
 export type Direction = 'forward' | 'backward' | 'any';
 export function dirCode(d: Direction): number {
   return d === 'forward' ? DIR_FORWARD : d === 'backward' ? DIR_BACKWARD : DIR_ANY;
@@ -35,6 +101,63 @@ export interface NativeEntity {
   psi: number;
 }
 
+/** Entity columns as returned by the native readEntities op (see EntityBatch). */
+interface EntityColumns {
+  count: number;
+  text: Uint8Array;
+  spans: Uint32Array;
+  obs?: Uint8Array;
+  mtime?: Float64Array;
+  obsMtime?: Float64Array;
+  structuralVisits?: Float64Array;
+  walkerVisits?: Float64Array;
+  psi?: Float64Array;
+}
+
+/** Keeps a leading U+FEFF, as napi_create_string_utf8 did: stored text reads back unchanged. */
+const utf8 = new TextDecoder('utf-8', { ignoreBOM: true });
+
+/**
+ * Records of many entities read in one native call. Strings stay UTF-8 in a
+ * single buffer until asked for, and numbers sit in typed arrays, so a large
+ * result costs a few allocations instead of several JS values per entity.
+ * Only the READ_* columns the batch was read with are available.
+ */
+export class EntityBatch {
+  readonly length: number;
+  private readonly k: number;
+  private readonly typeSlot: number;
+  private readonly obsSlot: number;
+
+  constructor(private readonly cols: EntityColumns, fields: number) {
+    this.typeSlot = fields & READ_NAME ? 1 : 0;
+    this.obsSlot = this.typeSlot + (fields & READ_TYPE ? 1 : 0);
+    this.k = this.obsSlot + (fields & READ_OBS ? 2 : 0);
+    this.length = cols.count;
+  }
+
+  private str(i: number, slot: number): string {
+    const at = i * this.k + slot;
+    return utf8.decode(this.cols.text.subarray(this.cols.spans[at], this.cols.spans[at + 1]));
+  }
+
+  name(i: number): string { return this.str(i, 0); }
+  type(i: number): string { return this.str(i, this.typeSlot); }
+  observations(i: number): string[] {
+    const present = this.cols.obs![i];
+    const out: string[] = [];
+    if (present & 1) out.push(this.str(i, this.obsSlot));
+    if (present & 2) out.push(this.str(i, this.obsSlot + 1));
+    return out;
+  }
+  /** Timestamps as numbers (0 = unset), like Entity.mtime rather than NativeEntity.mtime. */
+  mtime(i: number): number { return this.cols.mtime![i]; }
+  obsMtime(i: number): number { return this.cols.obsMtime![i]; }
+  structuralVisits(i: number): number { return this.cols.structuralVisits![i]; }
+  walkerVisits(i: number): number { return this.cols.walkerVisits![i]; }
+  psi(i: number): number { return this.cols.psi![i]; }
+}
+
 /** One adjacency entry; relType is resolved to its string by the native op. */
 export interface NativeEdge {
   target: bigint;
@@ -43,6 +166,23 @@ export interface NativeEdge {
   mtime: bigint;
 }
 
+/** Relations packed by the native setRelations op: relation i is
+ *  names[rels[3i]] -> names[rels[3i+1]] of type types[rels[3i+2]], with mtime[i] (0 = unset). */
+export interface PackedRelations {
+  names: string[];
+  types: string[];
+  rels: Uint32Array;
+  mtime: Float64Array;
+}
+
+/** Relations changed since an instant: entry[i] is relation i's position in
+ *  the recency order, where relation types linking one pair at one instant
+ *  share an entry; total counts the entries. */
+export interface RecentRelations extends PackedRelations {
+  entry: Uint32Array;
+  total: number;
+}
+
 interface NativeStore {
   open(graphPath: string, strPath: string, initialSize: number): unknown;
   close(h: unknown): void;
@@ -52,24 +192,58 @@ interface NativeStore {
   unlock(h: unknown): void;
   refresh(h: unknown): void;
   lookup(h: unknown, name: string): bigint;
+  fuzzyLookup(h: unknown, name: string, maxDist: number, k: number): FuzzyHit[];
+  nearDuplicates(h: unknown, text: string, minSimilarity: number, k: number): DuplicateHit[];
+  duplicateClusters(h: unknown, minSimilarity: number): bigint[][];
   createEntity(h: unknown, name: string, type: string, mtime: bigint): bigint;
   deleteEntity(h: unknown, offset: bigint): boolean;
   readEntity(h: unknown, offset: bigint): NativeEntity;
+  readEntities(h: unknown, offsets: bigint[], fields: number): EntityColumns;
   entityName(h: unknown, offset: bigint): string;
   addObservation(h: unknown, offset: bigint, obs: string, mtime: bigint): boolean;
   removeObservation(h: unknown, offset: bigint, obs: string, mtime: bigint): boolean;
+  compressObservations(h: unknown): number;
+  buildFoldIndex(h: unknown): boolean;
+  hasFoldIndex(h: unknown): boolean;
+  buildTrigramIndex(h: unknown): boolean;
+  hasTrigramIndex(h: unknown): boolean;
   createRelation(h: unknown, from: bigint, to: bigint, relType: string, mtime: bigint): void;
   deleteRelation(h: unknown, from: bigint, to: bigint, relType: string): boolean;
   edges(h: unknown, offset: bigint): NativeEdge[];
+  setRelations(h: unknown, offsets: bigint[], direction: number): PackedRelations;
+  relationsSince(h: unknown, since: bigint, asc: number, pos: number, max: number): RecentRelations;
+  changedSince(h: unknown, key: number, since: bigint, pos: number, max: number): { offsets: bigint[]; total: number };
+  rankSort(h: unknown, offsets: bigint[], rank: number): bigint[];
+  jsonPage(h: unknown, offsets: bigint[], rank: number, cursor: number, maxChars: number): string;
   neighbors(h: unknown, start: bigint, depth: number, direction: number): bigint[];
-  findPath(h: unknown, from: bigint, to: bigint, maxDepth: number, direction: number, budgetBytes: bigint): { path: bigint[]; targetReached: boolean; budgetExhausted: boolean; farthest: bigint };
-  search(h: unknown, pattern: string): bigint[];
+  findPath(h: unknown, from: bigint, to: bigint, maxDepth: number, direction: number, budgetBytes: bigint, bidi?: number): { path: bigint[]; targetReached: boolean; budgetExhausted: boolean; farthest: bigint };
+  search(h: unknown, pattern: string, flags?: number): bigint[];
+  searchPage(h: unknown, pattern: string, flags: number, rank: number, cursor: number, limit: number, direction: number): SearchPage;
+  buildTextIndex(h: unknown): boolean;
+  hasTextIndex(h: unknown): boolean;
+  textSearch(h: unknown, query: string, k: number): TextHit[];
+  vectorIndex(h: unknown, dim: number, format: number): boolean;
+  vectorInfo(h: unknown): VectorInfo | null;
+  setVector(h: unknown, offset: bigint, v: Float32Array): boolean;
+  clearVector(h: unknown, offset: bigint): boolean;
+  getVector(h: unknown, offset: bigint): Float32Array | null;
+  vectorSearch(h: unknown, q: Float32Array, k: number, entityType: string | null): VectorHit[];
+  hasNameIndex(h: unknown): boolean;
+  nameRank(h: unknown, name: string): number;
+  namePrefix(h: unknown, prefix: string): { first: number; count: number };
+  namesAt(h: unknown, pos: number, max: number, desc: number): bigint[];
   regexValid(pattern: string): boolean;
+  regexIndexable(pattern: string): boolean;
   entitiesByType(h: unknown, type: string): bigint[];
   orphaned(h: unknown): bigint[];
+  buildComponents(h: unknown): boolean;
+  hasComponents(h: unknown): boolean;
+  outsideComponent(h: unknown, anchor: bigint): bigint[];
   listEntities(h: unknown): bigint[];
   entityTypes(h: unknown): string[];
+  entityTypeCounts(h: unknown): { type: string; count: number }[];
   relationTypes(h: unknown): string[];
+  relationTypeCounts(h: unknown): { type: string; count: number }[];
   entityCount(h: unknown): number;
   relationCount(h: unknown): number;
   incWalkerVisit(h: unknown, offset: bigint): void;
@@ -81,6 +255,7 @@ interface NativeStore {
   getPsi(h: unknown, offset: bigint): number;
   structuralSample(h: unknown, iterations: number, damping: number): number;
   computeMerwPsi(h: unknown, alpha: number, maxIter: number, tol: number): number;
+  resampleAsync(h: unknown, iterations: number, damping: number, alpha: number, maxIter: number, tol: number): Promise<{ visits: number; iterations: number }>;
   seedRng(h: unknown, seed: bigint): void;
   randomWalk(h: unknown, start: bigint, depth: number, direction: number, merwMode: number, seed: bigint): bigint[];
   validateObs(h: unknown): { offset: bigint; count: number; oversize: number }[];
@@ -132,31 +307,107 @@ export class Store {
 
   // entities
   lookup(name: string): bigint { return native.lookup(this.h, name); }
+  /** Up to `k` entities whose case-folded name is within `maxDist` (<= 2) edits of `name`, nearest first. */
+  fuzzyLookup(name: string, maxDist: number, k: number): FuzzyHit[] { return native.fuzzyLookup(this.h, name, maxDist, k); }
+  /** Up to `k` entities whose name + observations resemble `text` (MinHash estimate >= minSimilarity), most similar first. */
+  nearDuplicates(text: string, minSimilarity: number, k: number): DuplicateHit[] { return native.nearDuplicates(this.h, text, minSimilarity, k); }
+  /** Every group of entities chained by near-duplicate pairs, by least offset. */
+  duplicateClusters(minSimilarity: number): bigint[][] { return native.duplicateClusters(this.h, minSimilarity); }
   createEntity(name: string, type: string, mtime: bigint): bigint { return native.createEntity(this.h, name, type, mtime); }
   deleteEntity(offset: bigint): boolean { return native.deleteEntity(this.h, offset); }
   readEntity(offset: bigint): NativeEntity { return native.readEntity(this.h, offset); }
+  /** The `fields` (READ_* mask) of many entities at once; see EntityBatch. */
+  readEntities(offsets: bigint[], fields: number): EntityBatch {
+    return new EntityBatch(native.readEntities(this.h, offsets, fields), fields);
+  }
   entityName(offset: bigint): string { return native.entityName(this.h, offset); }
   addObservation(offset: bigint, obs: string, mtime: bigint): boolean { return native.addObservation(this.h, offset, obs, mtime); }
   removeObservation(offset: bigint, obs: string, mtime: bigint): boolean { return native.removeObservation(this.h, offset, obs, mtime); }
+  /** Train the strings-file symbol table (first call) and pack existing observations; returns how many shrank. */
+  compressObservations(): number { return native.compressObservations(this.h); }
+  /** Build the persistent case-fold shadow map (idempotent; kept current by the C side afterwards). */
+  buildFoldIndex(): boolean { return native.buildFoldIndex(this.h); }
+  hasFoldIndex(): boolean { return native.hasFoldIndex(this.h); }
+  buildTrigramIndex(): boolean { return native.buildTrigramIndex(this.h); }
+  hasTrigramIndex(): boolean { return native.hasTrigramIndex(this.h); }
 
   // relations
   createRelation(from: bigint, to: bigint, relType: string, mtime: bigint): void { native.createRelation(this.h, from, to, relType, mtime); }
   deleteRelation(from: bigint, to: bigint, relType: string): boolean { return native.deleteRelation(this.h, from, to, relType); }
   edges(offset: bigint): NativeEdge[] { return native.edges(this.h, offset); }
+  /** Relations touching a set of entities, each once: forward = out of the set, backward = into it,
+   *  any = both ends in it. Grouped by set member in order; reads only the members' adjacency. */
+  setRelations(offsets: bigint[], direction: Direction): PackedRelations { return native.setRelations(this.h, offsets, dirCode(direction)); }
+  /** Relations with mtime >= since, newest first unless `asc`, from entry position `pos`. */
+  relationsSince(since: bigint, pos: number, max: number, asc = false): RecentRelations {
+    return native.relationsSince(this.h, since, asc ? 1 : 0, pos, max);
+  }
+  /** The given entities in RANK_* order (| RANK_ASC), reading only their records; ties go to the lower offset. */
+  rankSort(offsets: bigint[], rank: number): bigint[] { return native.rankSort(this.h, offsets, rank); }
+  /** One paginated page of the given entities as JSON text, sorted by `rank` first
+   *  (0 keeps the order given), cut at `maxChars` as the server's paginateItems cuts. */
+  jsonPage(offsets: bigint[], rank: number, cursor: number, maxChars: number): string {
+    return native.jsonPage(this.h, offsets, rank, cursor, maxChars);
+  }
+  /** Entities whose mtime (RANK_MTIME) or obsMtime (RANK_OBS_MTIME) is >= since,
+   *  newest first unless the key has RANK_ASC, from position `pos`; total counts them all. */
+  changedSince(key: number, since: bigint, pos: number, max: number): { offsets: bigint[]; total: number } {
+    return native.changedSince(this.h, key, since, pos, max);
+  }
 
   // traversal / search / scans
   neighbors(start: bigint, depth: number, direction: Direction): bigint[] { return native.neighbors(this.h, start, depth, dirCode(direction)); }
-  findPath(from: bigint, to: bigint, maxDepth: number, direction: Direction, budgetBytes: bigint): { path: bigint[]; targetReached: boolean; budgetExhausted: boolean; farthest: bigint } {
-    return native.findPath(this.h, from, to, maxDepth, dirCode(direction), budgetBytes);
+  findPath(from: bigint, to: bigint, maxDepth: number, direction: Direction, budgetBytes: bigint, bidirectional = false): { path: bigint[]; targetReached: boolean; budgetExhausted: boolean; farthest: bigint } {
+    return native.findPath(this.h, from, to, maxDepth, dirCode(direction), budgetBytes, bidirectional ? 1 : 0);
   }
-  search(pattern: string): bigint[] { return native.search(this.h, pattern); }
+  /** POSIX ERE search; `caseInsensitive` matches the case-folded pattern against case-folded text. */
+  search(pattern: string, caseInsensitive = false): bigint[] { return native.search(this.h, pattern, caseInsensitive ? SEARCH_ICASE : 0); }
+  /** One page of `search`: unranked pages resume at a node-log position and stop when full;
+   *  ranked ones (RANK_*) keep only the best cursor + limit matches. */
+  searchPage(pattern: string, caseInsensitive: boolean, rank: number, cursor: number, limit: number, direction: Direction): SearchPage {
+    return native.searchPage(this.h, pattern, caseInsensitive ? SEARCH_ICASE : 0, rank, cursor, limit, dirCode(direction));
+  }
+  /** Build the BM25 word index over names + observations (idempotent; kept current by the C side afterwards). */
+  buildTextIndex(): boolean { return native.buildTextIndex(this.h); }
+  hasTextIndex(): boolean { return native.hasTextIndex(this.h); }
+  /** Best `k` entities for the words of `query` by BM25, best first (empty until the index is built). */
+  textSearch(query: string, k: number): TextHit[] { return native.textSearch(this.h, query, k); }
+  /** Create the entity-vector index with a fixed dimension and format (VEC_*); true too if it already exists as asked. */
+  vectorIndex(dim: number, format: number): boolean { return native.vectorIndex(this.h, dim, format); }
+  vectorInfo(): VectorInfo | null { return native.vectorInfo(this.h); }
+  /** Set an entity's vector (false for a zero vector, a wrong dimension, or no index). */
+  setVector(offset: bigint, v: Float32Array): boolean { return native.setVector(this.h, offset, v); }
+  clearVector(offset: bigint): boolean { return native.clearVector(this.h, offset); }
+  /** An entity's stored vector, scaled to unit length; null if it has none. */
+  getVector(offset: bigint): Float32Array | null { return native.getVector(this.h, offset); }
+  /** Best `k` entities by cosine similarity to `q` (approximate, HNSW), optionally of one type; most similar first. */
+  vectorSearch(q: Float32Array, k: number, entityType: string | null = null): VectorHit[] { return native.vectorSearch(this.h, q, k, entityType); }
+  /** Name order: entities by case-folded name (code points), then raw name. Built on open, kept current by the C side. */
+  hasNameIndex(): boolean { return native.hasNameIndex(this.h); }
+  /** Rank of the first name at or after `name` in name order. */
+  nameRank(name: string): number { return native.nameRank(this.h, name); }
+  /** Rank range of the names starting with `prefix` (case-insensitive). */
+  namePrefix(prefix: string): { first: number; count: number } { return native.namePrefix(this.h, prefix); }
+  /** Up to `max` entities in name order from rank `pos`, walking down when `desc`. */
+  namesAt(pos: number, max: number, desc = false): bigint[] { return native.namesAt(this.h, pos, max, desc ? 1 : 0); }
   /** True iff `pattern` compiles under the C POSIX ERE engine (same dialect as search). */
   regexValid(pattern: string): boolean { return native.regexValid(pattern); }
+  regexIndexable(pattern: string): boolean { return native.regexIndexable(pattern); }
   entitiesByType(type: string): bigint[] { return native.entitiesByType(this.h, type); }
+  /** Entities with no relation at all, by offset, from the maintained zero-degree set. */
   orphaned(): bigint[] { return native.orphaned(this.h); }
+  /** Relabel connected components; labels survive new relations, not removed ones. */
+  buildComponents(): boolean { return native.buildComponents(this.h); }
+  hasComponents(): boolean { return native.hasComponents(this.h); }
+  /** Entities not connected to `anchor` by relations in either direction (every entity for 0n). */
+  outsideComponent(anchor: bigint): bigint[] { return native.outsideComponent(this.h, anchor); }
   listEntities(): bigint[] { return native.listEntities(this.h); }
   entityTypes(): string[] { return native.entityTypes(this.h); }
+  /** Each entity type with how many entities have it, from the persistent type index. */
+  entityTypeCounts(): { type: string; count: number }[] { return native.entityTypeCounts(this.h); }
   relationTypes(): string[] { return native.relationTypes(this.h); }
+  /** Each relation type with how many relations have it, from the relation-type catalog. */
+  relationTypeCounts(): { type: string; count: number }[] { return native.relationTypeCounts(this.h); }
   entityCount(): number { return native.entityCount(this.h); }
   relationCount(): number { return native.relationCount(this.h); }
 
@@ -170,6 +421,12 @@ export class Store {
   getPsi(offset: bigint): number { return native.getPsi(this.h, offset); }
   structuralSample(iterations: number, damping: number): number { return native.structuralSample(this.h, iterations, damping); }
   computeMerwPsi(alpha: number, maxIter: number, tol: number): number { return native.computeMerwPsi(this.h, alpha, maxIter, tol); }
+  /** structuralSample + computeMerwPsi on a worker thread, which takes the locks
+   *  itself: shared to snapshot the adjacency, none while sampling the snapshot,
+   *  exclusive to store the result. Call with no lock held. */
+  resampleAsync(iterations: number, damping: number, alpha: number, maxIter: number, tol: number): Promise<{ visits: number; iterations: number }> {
+    return native.resampleAsync(this.h, iterations, damping, alpha, maxIter, tol);
+  }
   seedRng(seed: bigint): void { native.seedRng(this.h, seed); }
   randomWalk(start: bigint, depth: number, direction: Direction, merwMode: boolean, seed: bigint): bigint[] {
     return native.randomWalk(this.h, start, depth, dirCode(direction), merwMode ? 1 : 0, seed);
@@ -2,12 +2,14 @@
  * Concurrency tests: two MCP server instances sharing the same binary files.
  *
  * Verifies that flock-based locking + mmap refresh works correctly when
- * one instance writes and the other reads.
+ * one instance writes and the other reads, and that async native work on a
+ * worker thread coexists with reads and writes on the JS thread.
  */
 
 import { describe, it, expect, beforeEach, afterEach } from "@jest/globals";
 import { type Client } from "@modelcontextprotocol/sdk/client/index.js";
 import { createServer, type Entity } from "../server.js";
+import { Store } from "../src/store.js";
 import { createTestClient, callTool, type PaginatedResult, type PaginatedGraph } from "./test-utils.js";
 import * as fs from "fs";
 import * as path from "path";
@@ -239,3 +241,85 @@ describe("Concurrency - dual server instances", () => {
     expect(statsB.entityCount).toBe(100);
   });
 });
+
+describe("Concurrency - async resample within one process", () => {
+  let tmpDir: string;
+  let db: Store;
+
+  beforeEach(() => {
+    tmpDir = fs.mkdtempSync(path.join(os.tmpdir(), "memory-async-"));
+    db = new Store(path.join(tmpDir, "kb.graph"), path.join(tmpDir, "kb.strings"), 1 << 20);
+    db.lockExclusive();
+    const offsets: bigint[] = [];
+    for (let i = 0; i < 5000; i++) offsets.push(db.createEntity(`E_${i}`, "Bulk", 1n));
+    for (let i = 0; i < offsets.length; i++) {
+      db.createRelation(offsets[i], offsets[(i * 7 + 13) % offsets.length], "links", 1n);
+    }
+    db.sync();
+    db.unlock();
+  });
+
+  afterEach(() => {
+    db.close();
+    fs.rmSync(tmpDir, { recursive: true, force: true });
+  });
+
+  it("keeps serving reads while the resample runs, then applies it", async () => {
+    db.lockShared();
+    const before = db.structuralTotal();
+    db.unlock();
+
+    let settled = false;
+    const pending = db.resampleAsync(1, 0.85, 0.85, 200, 1e-8).finally(() => { settled = true; });
+    let reads = 0;
+    while (!settled) {
+      db.lockShared();
+      if (db.lookup(`E_${reads % 5000}`) !== 0n) reads++;
+      db.unlock();
+      await new Promise(resolve => setImmediate(resolve));
+    }
+    const result = await pending;
+
+    expect(reads).toBeGreaterThan(0);
+    expect(result.visits).toBeGreaterThan(0);
+    db.lockShared();
+    expect(db.structuralTotal() - before).toBe(BigInt(result.visits));
+    db.unlock();
+  });
+
+  it("keeps serving writes while the resample computes", async () => {
+    db.lockShared();
+    const before = db.structuralTotal();
+    db.unlock();
+
+    let settled = false;
+    const pending = db.resampleAsync(3, 0.85, 0.85, 200, 1e-8).finally(() => { settled = true; });
+    let writes = 0;
+    while (!settled) {
+      db.lockExclusive();
+      db.createEntity(`W_${writes++}`, "Late", 1n);
+      db.unlock();
+      await new Promise(resolve => setImmediate(resolve));
+    }
+    const result = await pending;
+
+    expect(writes).toBeGreaterThan(0);
+    db.lockShared();
+    expect(db.entityCount()).toBe(5000 + writes);
+    expect(db.structuralTotal() - before).toBe(BigInt(result.visits));
+    db.unlock();
+  });
+
+  it("lets writes interleave with resamples in flight", async () => {
+    const pending = [db.resampleAsync(1, 0.85, 0.85, 50, 1e-8), db.resampleAsync(1, 0.85, 0.85, 50, 1e-8)];
+    db.lockExclusive();
+    db.deleteEntity(db.lookup("E_0"));
+    db.unlock();
+    const results = await Promise.all(pending);
+
+    expect(results.every(r => r.visits > 0)).toBe(true);
+    db.lockShared();
+    expect(db.entityCount()).toBe(4999);
+    db.unlock();
+  });
+});
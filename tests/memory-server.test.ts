@@ -84,6 +84,60 @@ describe('MCP Memory Server E2E Tests', () => {
       ).rejects.toThrow(/already exists/);
     });
 
+    it('should flag near-duplicate entities on create and group them with find_duplicates', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [
+          { name: 'Alice Smith', entityType: 'Person', observations: ['Works at Acme as an engineer'] },
+          { name: 'Bob', entityType: 'Person', observations: ['Likes music'] }
+        ]
+      });
+
+      const result = await callTool(client, 'create_entities', {
+        entities: [
+          { name: 'alice smith', entityType: 'Person', observations: ['works at ACME as an engineer'] },
+          { name: 'Carol', entityType: 'Person', observations: ['Plays chess'] }
+        ]
+      }) as (Entity & { nearDuplicates?: string[] })[];
+      expect(result[0].nearDuplicates).toEqual(['Alice Smith']);
+      expect(result[1].nearDuplicates).toBeUndefined();
+
+      const groups = await callTool(client, 'find_duplicates', {}) as PaginatedResult<string[]>;
+      expect(groups.items).toEqual([['Alice Smith', 'alice smith']]);
+    });
+
+    it('should search entities by embedding, filter by type, and drop embeddings with their entity', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [
+          { name: 'Cats', entityType: 'Topic', observations: [] },
+          { name: 'Dogs', entityType: 'Topic', observations: [] },
+          { name: 'Kitten', entityType: 'Animal', observations: [] }
+        ]
+      });
+      const set = await callTool(client, 'set_embeddings', {
+        embeddings: [
+          { entityName: 'Cats', vector: [1, 0, 0.1] },
+          { entityName: 'Dogs', vector: [0, 1, 0.1] },
+          { entityName: 'Kitten', vector: [1, 0.05, 0] }
+        ]
+      }) as { set: number; dimensions: number; quantization: string };
+      expect(set).toEqual({ set: 3, dimensions: 3, quantization: 'float16' });
+
+      let page = await callTool(client, 'search_embeddings', { vector: [1, 0, 0] }) as PaginatedResult<Entity & { similarity: number }>;
+      expect(page.items.map(e => e.name)).toEqual(['Kitten', 'Cats', 'Dogs']);
+      expect(page.items[0].similarity).toBeGreaterThan(page.items[1].similarity);
+
+      page = await callTool(client, 'search_embeddings', { vector: [1, 0, 0], entityType: 'Topic' }) as PaginatedResult<Entity & { similarity: number }>;
+      expect(page.items.map(e => e.name)).toEqual(['Cats', 'Dogs']);
+
+      await expect(
+        callTool(client, 'set_embeddings', { embeddings: [{ entityName: 'Cats', vector: [1, 0] }] })
+      ).rejects.toThrow(/the index holds 3/);
+
+      await callTool(client, 'delete_entities', { entityNames: ['Kitten'] });
+      page = await callTool(client, 'search_embeddings', { vector: [1, 0, 0] }) as PaginatedResult<Entity & { similarity: number }>;
+      expect(page.items.map(e => e.name)).toEqual(['Cats', 'Dogs']);
+    });
+
     it('should reject entities with more than 2 observations', async () => {
       await expect(
         callTool(client, 'create_entities', {
@@ -300,6 +354,95 @@ describe('MCP Memory Server E2E Tests', () => {
       expect(result.entities.items[0].name).toBe('TypeScript');
     });
 
+    it('should return the relations of the matches by direction', async () => {
+      const rels = async (query: string, direction: string) =>
+        ((await callTool(client, 'search_nodes', { query, direction })) as PaginatedGraph).relations.items
+          .map(r => `${r.from} ${r.relationType} ${r.to}`);
+      const extendsJs = 'TypeScript extends JavaScript';
+
+      expect(await rels('^JavaScript$', 'forward')).toEqual([]);
+      expect(await rels('^JavaScript$', 'backward')).toEqual([extendsJs]);
+      expect(await rels('^JavaScript$', 'any')).toEqual([]);
+      expect(await rels('^TypeScript$', 'forward')).toEqual([extendsJs]);
+      expect(await rels('Script', 'any')).toEqual([extendsJs]);
+    });
+
+    it('should rank keyword matches with search_text', async () => {
+      const result = await callTool(client, 'search_text', {
+        query: 'dynamic PYTHON'
+      }) as PaginatedResult<Entity & { score: number }>;
+
+      // Python holds both words; JavaScript only "dynamic"; TypeScript neither.
+      expect(result.items.map(e => e.name)).toEqual(['Python', 'JavaScript']);
+      expect(result.items[0].score).toBeGreaterThan(result.items[1].score);
+      expect(result.nextCursor).toBeNull();
+
+      await callTool(client, 'add_observations', {
+        observations: [{ entityName: 'TypeScript', contents: ['Dynamic at runtime'] }]
+      });
+      const after = await callTool(client, 'search_text', { query: 'runtime' }) as PaginatedResult<Entity>;
+      expect(after.items.map(e => e.name)).toEqual(['TypeScript']);
+    });
+
+    it('should list names in order by prefix with list_names', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [{ name: 'typed racket', entityType: 'Language', observations: [] }]
+      });
+
+      const all = await callTool(client, 'list_names', {}) as PaginatedResult<{ name: string }>;
+      expect(all.items.map(e => e.name)).toEqual(['JavaScript', 'Python', 'typed racket', 'TypeScript']);
+
+      const ty = await callTool(client, 'list_names', { prefix: 'TY' }) as PaginatedResult<{ name: string; entityType: string }>;
+      expect(ty.items).toEqual([
+        { name: 'typed racket', entityType: 'Language' },
+        { name: 'TypeScript', entityType: 'Language' },
+      ]);
+      expect(ty.totalCount).toBe(2);
+
+      const from = await callTool(client, 'list_names', { startAt: 'python', cursor: 1 }) as PaginatedResult<{ name: string }>;
+      expect(from.items.map(e => e.name)).toEqual(['typed racket', 'TypeScript']);
+      expect(from.nextCursor).toBeNull();
+    });
+
+    it('should list what changed since a time with get_recent_changes', async () => {
+      await new Promise(r => setTimeout(r, 5));
+      const since = Date.now();
+      await callTool(client, 'add_observations', {
+        observations: [{ entityName: 'Python', contents: ['Indented blocks'] }]
+      });
+      await callTool(client, 'create_entities', {
+        entities: [{ name: 'Go', entityType: 'Language', observations: [] }]
+      });
+      await callTool(client, 'create_relations', {
+        relations: [{ from: 'Go', to: 'Python', relationType: 'unlike' }]
+      });
+
+      type Changes = { entities: PaginatedResult<Entity>; relations: PaginatedResult<Relation> };
+      const recent = await callTool(client, 'get_recent_changes', { since }) as Changes;
+      expect(recent.entities.items.map(e => e.name).sort()).toEqual(['Go', 'Python']);
+      expect(recent.relations.items).toEqual([expect.objectContaining({ from: 'Go', to: 'Python', relationType: 'unlike' })]);
+      expect(recent.relations.nextCursor).toBeNull();
+
+      const obs = await callTool(client, 'get_recent_changes', { since, sortBy: 'obsMtime' }) as Changes;
+      expect(obs.entities.items.map(e => e.name)).toEqual(['Python']);
+
+      const everything = await callTool(client, 'get_recent_changes', {}) as Changes;
+      expect(everything.entities.totalCount).toBe(4);
+      const mtimes = everything.entities.items.map(e => e.mtime ?? 0);
+      expect(mtimes).toEqual([...mtimes].sort((a, b) => b - a));
+    });
+
+    it('should search case-insensitively when asked', async () => {
+      const exact = await callTool(client, 'search_nodes', { query: 'static' }) as PaginatedGraph;
+      expect(exact.entities.items).toHaveLength(0);
+
+      const folded = await callTool(client, 'search_nodes', {
+        query: 'static|^PYTHON$',
+        caseInsensitive: true
+      }) as PaginatedGraph;
+      expect(folded.entities.items.map(e => e.name).sort()).toEqual(['Python', 'TypeScript']);
+    });
+
     it('should reject invalid regex', async () => {
       await expect(
         callTool(client, 'search_nodes', { query: '[invalid' })
@@ -378,6 +521,36 @@ describe('MCP Memory Server E2E Tests', () => {
       }
     });
 
+    it('relations span the whole result, not the entity page', async () => {
+      // 150 matches need two entity pages; each relation joins an entity on
+      // the first page to one on the second, so a per-page relation set would
+      // drop all of them under 'any'.
+      const entities = [];
+      for (let i = 0; i < 150; i++) {
+        entities.push({ name: `Span_${i.toString().padStart(3, '0')}`, entityType: 'Span', observations: [] });
+      }
+      await callTool(client, 'create_entities', { entities });
+      const relations = [];
+      for (let i = 0; i < 10; i++) {
+        relations.push({ from: `Span_${i.toString().padStart(3, '0')}`, to: `Span_${(140 + i).toString()}`, relationType: 'spans' });
+      }
+      await callTool(client, 'create_relations', { relations });
+
+      const first = await callTool(client, 'search_nodes', {
+        query: '^Span_', sortBy: 'name', sortDir: 'asc', direction: 'any',
+      }) as PaginatedGraph;
+      expect(first.entities.nextCursor).not.toBeNull();
+      expect(first.entities.items.some(e => e.name === 'Span_140')).toBe(false);
+      expect(first.relations.totalCount).toBe(10);
+      expect(first.relations.items).toHaveLength(10);
+
+      const second = await callTool(client, 'search_nodes', {
+        query: '^Span_', sortBy: 'name', sortDir: 'asc', direction: 'any',
+        entityCursor: first.entities.nextCursor,
+      }) as PaginatedGraph;
+      expect(second.relations.totalCount).toBe(10);
+    });
+
     it('trigram path: queries with metacharacters fall back to scan correctly', async () => {
       // `.*foo` and similar shapes can't be reduced to required substrings —
       // the extractor returns null and search_nodes uses the linear scan
@@ -579,6 +752,36 @@ describe('MCP Memory Server E2E Tests', () => {
       // A->B and A->C both have from='A' which is in the set
       expect(result.relations.items).toHaveLength(2);
     });
+
+    it('should return names and observations byte-exact, in request order', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [{ name: 'Ünï 名前 😀', entityType: 'Tÿpe', observations: ['first', 'zweite "ü"\n'] }]
+      });
+      await callTool(client, 'delete_observations', {
+        deletions: [{ entityName: 'Ünï 名前 😀', observations: ['first'] }]
+      });
+
+      const result = await callTool(client, 'open_nodes', {
+        names: ['C', 'Ünï 名前 😀', 'missing', 'A']
+      }) as PaginatedGraph;
+
+      expect(result.entities.items.map(e => e.name)).toEqual(['C', 'Ünï 名前 😀', 'A']);
+      expect(result.entities.items[1].entityType).toBe('Tÿpe');
+      expect(result.entities.items[1].observations).toEqual(['zweite "ü"\n']);
+      expect(result.entities.items[2].observations).toEqual(['Root']);
+    });
+
+    it('should keep a leading byte order mark in names and observations', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [{ name: '\uFEFFBom', entityType: 'Node', observations: ['\uFEFFmarked'] }]
+      });
+
+      const result = await callTool(client, 'open_nodes', { names: ['\uFEFFBom'] }) as PaginatedGraph;
+
+      expect(result.entities.items).toHaveLength(1);
+      expect(result.entities.items[0].name).toBe('\uFEFFBom');
+      expect(result.entities.items[0].observations).toEqual(['\uFEFFmarked']);
+    });
   });
 
   describe('Graph Traversal', () => {
@@ -1129,6 +1332,33 @@ describe('MCP Memory Server E2E Tests', () => {
       expect(names).toEqual(['Island1', 'Island2']);
     });
 
+    it('should follow relation changes in both orphan modes', async () => {
+      await callTool(client, 'create_entities', {
+        entities: [
+          { name: 'Self', entityType: 'Agent', observations: [] },
+          { name: 'Bridge', entityType: 'Node', observations: [] },
+          { name: 'Far', entityType: 'Node', observations: [] }
+        ]
+      });
+      await callTool(client, 'create_relations', {
+        relations: [
+          { from: 'Self', to: 'Bridge', relationType: 'knows' },
+          { from: 'Bridge', to: 'Far', relationType: 'links' }
+        ]
+      });
+      let strict = await callTool(client, 'get_orphaned_entities', { strict: true }) as PaginatedResult<Entity>;
+      expect(strict.items).toHaveLength(0);
+
+      // Removing the bridge edge splits the component; Far then has no relation at all
+      await callTool(client, 'delete_relations', {
+        relations: [{ from: 'Bridge', to: 'Far', relationType: 'links' }]
+      });
+      strict = await callTool(client, 'get_orphaned_entities', { strict: true }) as PaginatedResult<Entity>;
+      expect(strict.items.map(e => e.name)).toEqual(['Far']);
+      const nonStrict = await callTool(client, 'get_orphaned_entities', {}) as PaginatedResult<Entity>;
+      expect(nonStrict.items.map(e => e.name)).toEqual(['Far']);
+    });
+
     it('should validate graph and report no violations on clean graph', async () => {
       // Create a valid graph through the API
       await callTool(client, 'create_entities', {
@@ -1333,6 +1563,12 @@ describe('MCP Memory Server E2E Tests', () => {
       ).rejects.toThrow(/not found/);
     });
 
+    it('should suggest near-miss names for a mistyped start entity', async () => {
+      await expect(
+        callTool(client, 'random_walk', { start: 'centre', depth: 2 })
+      ).rejects.toThrow(/Did you mean "Center"\?/);
+    });
+
     it('should accept mode=uniform and produce a valid walk', async () => {
       const result = await callTool(client, 'random_walk', {
         start: 'Center',
@@ -1771,6 +2007,36 @@ describe('MCP Memory Server E2E Tests', () => {
         const sortedNames = [...names].sort().reverse();
         expect(names).toEqual(sortedNames);
       });
+
+      it('should page get_entities_by_type without gaps or repeats', async () => {
+        const entities = [];
+        for (let i = 0; i < 30; i++) {
+          entities.push({
+            name: `Paged "${i}"\n${'x'.repeat(i * 10)}`,
+            entityType: 'PagedType',
+            observations: [`Ünïcödé 😀 ${i}`]
+          });
+        }
+        await callTool(client, 'create_entities', { entities });
+
+        const names: string[] = [];
+        let cursor: number | null = 0;
+        let pages = 0;
+        while (cursor !== null) {
+          const result = await callTool(client, 'get_entities_by_type', {
+            entityType: 'PagedType',
+            sortBy: 'name',
+            cursor
+          }) as { items: Entity[]; nextCursor: number | null; totalCount: number };
+          expect(result.totalCount).toBe(30);
+          names.push(...result.items.map(e => e.name));
+          cursor = result.nextCursor;
+          pages++;
+        }
+
+        expect(pages).toBeGreaterThan(1);
+        expect(names).toEqual(entities.map(e => e.name).sort());
+      });
     });
 
     describe('pagerank sorting', () => {
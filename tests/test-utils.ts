@@ -64,6 +64,11 @@ export async function createTestClient(server: Server): Promise<{
 // Read operations that should be paginated
 const PAGINATED_TOOLS = new Set([
   'search_nodes',
+  'search_text',
+  'list_names',
+  'get_recent_changes',
+  'find_duplicates',
+  'search_embeddings',
   'open_nodes',
   'open_nodes_filtered',
   'get_neighbors',